@@ -0,0 +1,94 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2016 Blender Foundation.
+ * All rights reserved.
+ *
+ * Contributor(s): none yet.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file elbeem/extern/LBM_meshseq.h
+ *  \ingroup elbeem
+ *
+ * File layout of baked fluid surface sequences, written by the elbeem
+ * dumper and read by Blender (see BKE_fluidsim_meshseq_read).
+ *
+ * Each surface (final, preview) is stored in one file holding all frames:
+ *
+ *   header | record ...
+ *
+ * Records are only ever appended, so the file can be read while the bake is
+ * still running; readers index it by walking the record headers. Each record
+ * is followed by its own uncompressed header and a zlib compressed payload.
+ *
+ * Triangles are stored in topology records which are only written again when
+ * the triangles change, frame records point at the topology they use.
+ * Frame payloads hold the quantized vertex positions, the normals and
+ * optionally the vertex velocities:
+ *
+ *   unsigned short co[totvert][3] | short no[totvert][3] | float vel[totvert][3]
+ */
+
+#ifndef __LBM_MESHSEQ_H__
+#define __LBM_MESHSEQ_H__
+
+#include <stdint.h>
+
+#define LBM_MESHSEQ_ID              "BFLUIDSQ"
+#define LBM_MESHSEQ_VERSION         1
+#define LBM_MESHSEQ_FRAME_ID        "FRAM"
+#define LBM_MESHSEQ_TOPOLOGY_ID     "TOPO"
+
+/* LbmMeshSeqFrame.flag */
+#define LBM_MESHSEQ_FRAME_VELOCITY  (1 << 0)
+
+/* positions are stored relative to the frame bounds in this many steps */
+#define LBM_MESHSEQ_CO_RANGE        65535.0f
+/* same scale as normal_float_to_short_v3() */
+#define LBM_MESHSEQ_NO_RANGE        32767.0f
+
+typedef struct LbmMeshSeqHeader {
+	char id[8];
+	uint32_t version, pad;
+} LbmMeshSeqHeader;
+
+typedef struct LbmMeshSeqRecord {
+	char id[4];
+	/* size of the record specific header following this one */
+	uint32_t head_len;
+	/* payload size before and after compression */
+	uint32_t raw_len, stored_len;
+} LbmMeshSeqRecord;
+
+/* head of LBM_MESHSEQ_TOPOLOGY_ID records, payload is int tri[tottri][3] */
+typedef struct LbmMeshSeqTopology {
+	int32_t tottri, pad;
+} LbmMeshSeqTopology;
+
+/* head of LBM_MESHSEQ_FRAME_ID records */
+typedef struct LbmMeshSeqFrame {
+	int32_t frame, flag;
+	int32_t totvert, pad;
+	/* file offset of the topology record */
+	uint64_t topology_offset;
+	/* range of the quantized positions */
+	float co_min[3], co_size[3];
+} LbmMeshSeqFrame;
+
+#endif  /* __LBM_MESHSEQ_H__ */
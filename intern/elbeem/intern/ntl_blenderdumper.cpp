@@ -11,6 +11,7 @@
  *****************************************************************************/
 
 #include <fstream>
+#include <string.h>
 #include <sys/types.h>
 
 #include "utilities.h"
@@ -20,6 +21,8 @@
 #include "solver_interface.h"
 #include "globals.h"
 
+#include "LBM_meshseq.h"
+
 #include <zlib.h>
 
 
@@ -127,46 +130,19 @@ int ntlBlenderDumper::renderScene( void )
 
 				// always dump mesh, even empty ones...
 
-				// dump to binary file
-				std::ostringstream boutfilename("");
-				//boutfilename << ecrpath.str() << outname <<"_"<< (*siter)->getName() <<"_" << nrStr << ".obj";
-				boutfilename << outname <<"_"<< (*siter)->getName() <<"_" << nrStr;
-				if(debugOut) debMsgStd("ntlBlenderDumper::renderScene",DM_MSG,"B-Dumping: "<< (*siter)->getName() 
-						<<", triangles:"<<Triangles.size()<<", vertices:"<<Vertices.size()<<
-						" to "<<boutfilename.str() , 7);
-				gzFile gzf;
-
-				// output velocities if desired
+				// output velocities if desired, sampled before transforming the vertices
+				vector<float> velocities;
 				if((!isPreview) && (lbm->getDumpVelocities())) {
-					std::ostringstream bvelfilename;
-					bvelfilename << boutfilename.str();
-					bvelfilename << ".bvel.gz";
-					gzf = gzopen(bvelfilename.str().c_str(), "wb9");
-					if(gzf) {
-						int numVerts;
-						if(sizeof(numVerts)!=4) { errMsg("ntlBlenderDumper::renderScene","Invalid int size"); return 1; }
-						numVerts = Vertices.size();
-						gzwrite(gzf, &numVerts, sizeof(numVerts));
-						for(size_t i=0; i<Vertices.size(); i++) {
-							// returns smoothed velocity, scaled by frame time
-							ntlVec3Gfx v = lbm->getVelocityAt( Vertices[i][0], Vertices[i][1], Vertices[i][2] );
-							// translation not necessary, test rotation & scaling?
-							for(int j=0; j<3; j++) {
-								float vertp = v[j];
-								//if(i<20) errMsg("ntlBlenderDumper","DUMP_VEL final "<<i<<" = "<<v);
-								gzwrite(gzf, &vertp, sizeof(vertp)); }
-						}
-						gzclose( gzf );
+					velocities.resize(Vertices.size() * 3);
+					for(size_t i=0; i<Vertices.size(); i++) {
+						// returns smoothed velocity, scaled by frame time
+						ntlVec3Gfx v = lbm->getVelocityAt( Vertices[i][0], Vertices[i][1], Vertices[i][2] );
+						// translation not necessary, test rotation & scaling?
+						for(int j=0; j<3; j++) {
+							velocities[i*3+j] = v[j]; }
 					}
 				}
 
-				// compress all bobj's 
-				boutfilename << ".bobj.gz";
-				gzf = gzopen(boutfilename.str().c_str(), "wb1"); // wb9 is slow for large meshes!
-				if (!gzf) {
-					errMsg("ntlBlenderDumper::renderScene","Unable to open output '" + boutfilename.str() + "' ");
-					return 1; }
-
 				// dont transform velocity output, this is handled in blender
 				// current transform matrix
 				ntlMatrix4x4<gfxReal> *trafo;
@@ -193,39 +169,23 @@ int ntlBlenderDumper::renderScene( void )
 					}
 				}
 
-				
-				// write to file
-				int numVerts;
-				if(sizeof(numVerts)!=4) { errMsg("ntlBlenderDumper::renderScene","Invalid int size"); return 1; }
-				numVerts = Vertices.size();
-				gzwrite(gzf, &numVerts, sizeof(numVerts));
-				for(size_t i=0; i<Vertices.size(); i++) {
-					for(int j=0; j<3; j++) {
-						float vertp = Vertices[i][j];
-						gzwrite(gzf, &vertp, sizeof(vertp)); }
-				}
-
 				// should be the same as Vertices.size
-				if(VertNormals.size() != (size_t)numVerts) {
+				if(VertNormals.size() != Vertices.size()) {
 					errMsg("ntlBlenderDumper::renderScene","Normals have to have same size as vertices!");
 					VertNormals.resize( Vertices.size() );
 				}
-				gzwrite(gzf, &numVerts, sizeof(numVerts));
-				for(size_t i=0; i<VertNormals.size(); i++) {
-					for(int j=0; j<3; j++) {
-						float normp = VertNormals[i][j];
-						gzwrite(gzf, &normp, sizeof(normp)); }
-				}
 
-				int numTris = Triangles.size();
-				gzwrite(gzf, &numTris, sizeof(numTris));
-				for(size_t i=0; i<Triangles.size(); i++) {
-					for(int j=0; j<3; j++) {
-						int triIndex = Triangles[i].getPoints()[j];
-						gzwrite(gzf, &triIndex, sizeof(triIndex)); }
-				}
-				gzclose( gzf );
-				debMsgStd("ntlBlenderDumper::renderScene",DM_NOTIFY," Wrote: '"<<boutfilename.str()<<"' ", 2);
+				// all frames of a surface go into a single sequence file
+				std::ostringstream boutfilename("");
+				boutfilename << outname <<"_"<< (*siter)->getName() << ".bmsh";
+				if(debugOut) debMsgStd("ntlBlenderDumper::renderScene",DM_MSG,"B-Dumping: "<< (*siter)->getName() 
+						<<", triangles:"<<Triangles.size()<<", vertices:"<<Vertices.size()<<
+						" to "<<boutfilename.str() , 7);
+
+				if(dumpMeshSequence(boutfilename.str(), glob->getAniCount(), Vertices, VertNormals, Triangles,
+				                    velocities.empty() ? NULL : &velocities)) {
+					return 1; }
+				debMsgStd("ntlBlenderDumper::renderScene",DM_NOTIFY," Wrote: '"<<boutfilename.str()<<"' frame "<<nrStr, 2);
 				numGMs++;
 			}
 		}
@@ -262,3 +222,130 @@ int ntlBlenderDumper::renderScene( void )
 
 
 
+
+
+
+/******************************************************************************
+ * Mesh sequence output, see LBM_meshseq.h for the file layout
+ *****************************************************************************/
+
+// compress & append a record, returns false upon error
+static bool writeMeshSequenceRecord(FILE *fp, const char *id, const void *head, uint32_t headLen,
+		const vector<unsigned char> &raw, unsigned long long *len)
+{
+	LbmMeshSeqRecord rec;
+	uLongf storedLen = compressBound(raw.size());
+	vector<unsigned char> stored(storedLen + 1);
+	const Bytef *src = raw.empty() ? (const Bytef *)"" : &raw[0];
+
+	// level 1, higher levels are slow for large meshes!
+	if(compress2(&stored[0], &storedLen, src, raw.size(), 1) != Z_OK) return false;
+
+	memcpy(rec.id, id, sizeof(rec.id));
+	rec.head_len = headLen;
+	rec.raw_len = raw.size();
+	rec.stored_len = storedLen;
+
+	if(fwrite(&rec, sizeof(rec), 1, fp) != 1) return false;
+	if(fwrite(head, headLen, 1, fp) != 1) return false;
+	if(storedLen && (fwrite(&stored[0], storedLen, 1, fp) != 1)) return false;
+
+	*len += sizeof(rec) + headLen + storedLen;
+	return true;
+}
+
+int ntlBlenderDumper::dumpMeshSequence(string filename, int frame,
+		vector<ntlVec3Gfx> &vertices, vector<ntlVec3Gfx> &normals,
+		vector<ntlTriangle> &triangles, vector<float> *velocities)
+{
+	// the first frame of a bake replaces old files
+	bool isNew = (mMeshSequences.find(filename) == mMeshSequences.end());
+	MeshSequenceFile &seq = mMeshSequences[filename];
+
+	FILE *fp = fopen(filename.c_str(), isNew ? "wb" : "ab");
+	if(!fp) {
+		errMsg("ntlBlenderDumper::dumpMeshSequence","Unable to open output '" + filename + "' ");
+		return 1; }
+
+	bool ok = true;
+	if(isNew) {
+		LbmMeshSeqHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.id, LBM_MESHSEQ_ID, sizeof(header.id));
+		header.version = LBM_MESHSEQ_VERSION;
+		ok = (fwrite(&header, sizeof(header), 1, fp) == 1);
+		seq.mLength = sizeof(header);
+	}
+
+	// only write the triangles when they changed since the last frame
+	vector<int> tris(triangles.size() * 3);
+	for(size_t i=0; i<triangles.size(); i++) {
+		for(int j=0; j<3; j++) {
+			tris[i*3+j] = triangles[i].getPoints()[j]; }
+	}
+	if(ok && (isNew || (tris != seq.mTriangles))) {
+		LbmMeshSeqTopology topo;
+		memset(&topo, 0, sizeof(topo));
+		topo.tottri = triangles.size();
+
+		vector<unsigned char> raw(tris.size() * sizeof(int));
+		if(!raw.empty()) memcpy(&raw[0], &tris[0], raw.size());
+
+		seq.mTopologyOffset = seq.mLength;
+		seq.mTriangles.swap(tris);
+		ok = writeMeshSequenceRecord(fp, LBM_MESHSEQ_TOPOLOGY_ID, &topo, sizeof(topo), raw, &seq.mLength);
+	}
+
+	if(ok) {
+		LbmMeshSeqFrame head;
+		memset(&head, 0, sizeof(head));
+		head.frame = frame;
+		head.flag = velocities ? LBM_MESHSEQ_FRAME_VELOCITY : 0;
+		head.totvert = vertices.size();
+		head.topology_offset = seq.mTopologyOffset;
+
+		// positions are quantized within the bounds of this frame
+		if(!vertices.empty()) {
+			float co_max[3];
+			for(int j=0; j<3; j++) {
+				head.co_min[j] = co_max[j] = vertices[0][j]; }
+			for(size_t i=1; i<vertices.size(); i++) {
+				for(int j=0; j<3; j++) {
+					if(vertices[i][j] < head.co_min[j]) head.co_min[j] = vertices[i][j];
+					if(vertices[i][j] > co_max[j])      co_max[j] = vertices[i][j];
+				}
+			}
+			for(int j=0; j<3; j++) {
+				head.co_size[j] = co_max[j] - head.co_min[j]; }
+		}
+
+		const size_t numVerts = vertices.size();
+		vector<unsigned char> raw(numVerts * (3 * sizeof(unsigned short) + 3 * sizeof(short) +
+				(velocities ? 3 * sizeof(float) : 0)));
+		if(numVerts) {
+			unsigned short *co = (unsigned short *)&raw[0];
+			short *no = (short *)(co + numVerts * 3);
+			float *vel = (float *)(no + numVerts * 3);
+
+			for(size_t i=0; i<numVerts; i++) {
+				for(int j=0; j<3; j++) {
+					float fac = (head.co_size[j] > 0.0f) ? (vertices[i][j] - head.co_min[j]) / head.co_size[j] : 0.0f;
+					co[i*3+j] = (unsigned short)(fac * LBM_MESHSEQ_CO_RANGE + 0.5f);
+					no[i*3+j] = (short)(normals[i][j] * LBM_MESHSEQ_NO_RANGE);
+				}
+			}
+			if(velocities) {
+				memcpy(vel, &(*velocities)[0], numVerts * 3 * sizeof(float));
+			}
+		}
+
+		ok = writeMeshSequenceRecord(fp, LBM_MESHSEQ_FRAME_ID, &head, sizeof(head), raw, &seq.mLength);
+	}
+
+	if(fclose(fp) != 0) ok = false;
+
+	if(!ok) {
+		errMsg("ntlBlenderDumper::dumpMeshSequence","Unable to write output '" + filename + "' ");
+		return 1; }
+	return 0;
+}
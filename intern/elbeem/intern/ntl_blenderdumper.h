@@ -32,6 +32,23 @@ public:
 protected:
 
 private:
+	/*! append a frame to the sequence file of a surface, returns !=0 upon error */
+	int dumpMeshSequence(string filename, int frame,
+			vector<ntlVec3Gfx> &vertices, vector<ntlVec3Gfx> &normals,
+			vector<ntlTriangle> &triangles, vector<float> *velocities);
+
+	/*! sequence files written by this bake */
+	class MeshSequenceFile {
+		public:
+			MeshSequenceFile() : mLength(0), mTopologyOffset(0) { }
+			/*! bytes written so far */
+			unsigned long long mLength;
+			/*! last topology record and its triangles */
+			unsigned long long mTopologyOffset;
+			vector<int> mTriangles;
+	};
+	map<string, MeshSequenceFile> mMeshSequences;
+
 #ifdef WITH_CXX_GUARDEDALLOC
 	MEM_CXX_CLASS_ALLOC_FUNCS("ELBEEM:ntlBlenderDumper")
 #endif
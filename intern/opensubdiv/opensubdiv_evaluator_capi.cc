@@ -38,10 +38,17 @@
 #include <opensubdiv/osd/cpuEvaluator.h>
 #include <opensubdiv/osd/cpuPatchTable.h>
 #include <opensubdiv/osd/cpuVertexBuffer.h>
+#ifdef OPENSUBDIV_HAS_TBB
+#  include <opensubdiv/osd/tbbEvaluator.h>
+#elif defined(OPENSUBDIV_HAS_OPENMP)
+#  include <opensubdiv/osd/ompEvaluator.h>
+#endif
 #include <opensubdiv/osd/mesh.h>
 #include <opensubdiv/osd/types.h>
 
+#include "opensubdiv_converter_capi.h"
 #include "opensubdiv_intern.h"
+#include "opensubdiv_topology_refiner.h"
 
 #include "MEM_guardedalloc.h"
 
@@ -140,6 +147,11 @@ protected:
 };
 
 /* Volatile evaluator which can be used from threads.
+ *
+ * Stencils are evaluated with STENCIL_EVALUATOR, which is allowed to be
+ * threaded, since all the coarse points are refined at once. Limit patches
+ * are evaluated one point at a time from already threaded code, so they
+ * always use EVALUATOR.
  *
  * TODO(sergey): Make it possible to evaluate coordinates in chuncks.
  */
@@ -148,6 +160,7 @@ template<typename SRC_VERTEX_BUFFER,
          typename STENCIL_TABLE,
          typename PATCH_TABLE,
          typename EVALUATOR,
+         typename STENCIL_EVALUATOR = EVALUATOR,
          typename DEVICE_CONTEXT = void>
 class VolatileEvalOutput {
 public:
@@ -201,34 +214,25 @@ public:
 
 	void Refine()
 	{
+		/* None of the CPU side stencil evaluators need an instance. */
+		const STENCIL_EVALUATOR *eval_instance = NULL;
 		BufferDescriptor dst_desc = src_desc_;
 		dst_desc.offset += num_coarse_verts_ * src_desc_.stride;
 
-		const EVALUATOR *eval_instance =
-		        OpenSubdiv::Osd::GetEvaluator<EVALUATOR>(evaluator_cache_,
-		                                                 src_desc_,
-		                                                 dst_desc,
-		                                                 device_context_);
-
-		EVALUATOR::EvalStencils(src_data_, src_desc_,
-		                        src_data_, dst_desc,
-		                        vertex_stencils_,
-		                        eval_instance,
-		                        device_context_);
+		STENCIL_EVALUATOR::EvalStencils(src_data_, src_desc_,
+		                                src_data_, dst_desc,
+		                                vertex_stencils_,
+		                                eval_instance,
+		                                device_context_);
 
 		dst_desc = src_varying_desc_;
 		dst_desc.offset += num_coarse_verts_ * src_varying_desc_.stride;
-		eval_instance =
-		        OpenSubdiv::Osd::GetEvaluator<EVALUATOR>(evaluator_cache_,
-		                                                 src_varying_desc_,
-		                                                 dst_desc,
-		                                                 device_context_);
 
-		EVALUATOR::EvalStencils(src_varying_data_, src_varying_desc_,
-		                        src_varying_data_, dst_desc,
-		                        varying_stencils_,
-		                        eval_instance,
-		                        device_context_);
+		STENCIL_EVALUATOR::EvalStencils(src_varying_data_, src_varying_desc_,
+		                                src_varying_data_, dst_desc,
+		                                varying_stencils_,
+		                                eval_instance,
+		                                device_context_);
 	}
 
 	void EvalPatchCoord(PatchCoord& patch_coord, float P[3])
@@ -324,11 +328,23 @@ private:
 
 }  /* namespace */
 
+/* Refinement of the coarse points is done for every frame of deforming
+ * animation, so use threaded stencil evaluator when it's available.
+ */
+#if defined(OPENSUBDIV_HAS_TBB)
+typedef OpenSubdiv::Osd::TbbEvaluator CpuStencilEvaluator;
+#elif defined(OPENSUBDIV_HAS_OPENMP)
+typedef OpenSubdiv::Osd::OmpEvaluator CpuStencilEvaluator;
+#else
+typedef OpenSubdiv::Osd::CpuEvaluator CpuStencilEvaluator;
+#endif
+
 typedef VolatileEvalOutput<OpenSubdiv::Osd::CpuVertexBuffer,
                            OpenSubdiv::Osd::CpuVertexBuffer,
                            OpenSubdiv::Far::StencilTable,
                            OpenSubdiv::Osd::CpuPatchTable,
-                           OpenSubdiv::Osd::CpuEvaluator> CpuEvalOutput;
+                           OpenSubdiv::Osd::CpuEvaluator,
+                           CpuStencilEvaluator> CpuEvalOutput;
 
 typedef struct OpenSubdiv_EvaluatorDescr {
 	CpuEvalOutput *eval_output;
@@ -341,11 +357,11 @@ OpenSubdiv_EvaluatorDescr *openSubdiv_createEvaluatorDescr(
         int subsurf_level)
 {
 	/* TODO(sergey): Look into re-using refiner with GLMesh. */
-	TopologyRefiner *refiner = (TopologyRefiner *)topology_refiner;
-	if(refiner == NULL) {
+	if (topology_refiner == NULL) {
 		/* Happens on bad topology. */
 		return NULL;
 	}
+	TopologyRefiner *refiner = topology_refiner->osd_refiner;
 
 	const StencilTable *vertex_stencils = NULL;
 	const StencilTable *varying_stencils = NULL;
@@ -423,7 +439,10 @@ OpenSubdiv_EvaluatorDescr *openSubdiv_createEvaluatorDescr(
 	delete varying_stencils;
 	delete vertex_stencils;
 
-	delete refiner;
+	/* Everything needed for evaluation is in the stencil and patch tables
+	 * now, so the refiner with all its refined levels could go away.
+	 */
+	openSubdiv_deleteTopologyRefinerDescr(topology_refiner);
 
 	return evaluator_descr;
 }
@@ -66,6 +66,11 @@ typedef struct rbMeshData rbMeshData;
 /* Constraint */
 typedef struct rbConstraint rbConstraint;
 
+/* Parallel-for used to spread simulation work over threads, thread_id is
+ * in the range [0, num_threads) as passed to RB_dworld_set_parallel. */
+typedef void (*rbParallelRangeFunc)(void *userdata, int index, int thread_id);
+typedef void (*rbParallelForFunc)(int start, int stop, void *userdata, rbParallelRangeFunc func);
+
 /* ********************************** */
 /* Dynamics World Methods */
 
@@ -89,6 +94,9 @@ void RB_dworld_set_solver_iterations(rbDynamicsWorld *world, int num_solver_iter
 /* Split Impulse */
 void RB_dworld_set_split_impulse(rbDynamicsWorld *world, int split_impulse);
 
+/* Multithreading, run collision detection and island solving through parallel_for (NULL to disable) */
+void RB_dworld_set_parallel(rbDynamicsWorld *world, rbParallelForFunc parallel_for, int num_threads);
+
 /* Simulation ----------------------- */
 
 /* Step the simulation by the desired amount (in seconds) with extra controls on substep sizes and maximum substeps */
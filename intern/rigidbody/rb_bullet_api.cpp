@@ -60,6 +60,7 @@ subject to the following restrictions:
 #include <errno.h>
 
 #include "RBI_api.h"
+#include "rb_bullet_threads.h"
 
 #include "btBulletDynamicsCommon.h"
 
@@ -74,9 +75,9 @@ subject to the following restrictions:
 #include "BulletCollision/CollisionShapes/btScaledBvhTriangleMeshShape.h"
 
 struct rbDynamicsWorld {
-	btDiscreteDynamicsWorld *dynamicsWorld;
+	rbDiscreteDynamicsWorld *dynamicsWorld;
 	btDefaultCollisionConfiguration *collisionConfiguration;
-	btDispatcher *dispatcher;
+	rbCollisionDispatcher *dispatcher;
 	btBroadphaseInterface *pairCache;
 	btConstraintSolver *constraintSolver;
 	btOverlapFilterCallback *filterCallback;
@@ -146,10 +147,10 @@ rbDynamicsWorld *RB_dworld_new(const float gravity[3])
 	rbDynamicsWorld *world = new rbDynamicsWorld;
 	
 	/* collision detection/handling */
-	world->collisionConfiguration = new btDefaultCollisionConfiguration();
+	world->collisionConfiguration = new rbCollisionConfiguration();
 	
-	world->dispatcher = new btCollisionDispatcher(world->collisionConfiguration);
-	btGImpactCollisionAlgorithm::registerAlgorithm((btCollisionDispatcher *)world->dispatcher);
+	world->dispatcher = new rbCollisionDispatcher(world->collisionConfiguration);
+	btGImpactCollisionAlgorithm::registerAlgorithm(world->dispatcher);
 	
 	world->pairCache = new btDbvtBroadphase();
 	
@@ -160,7 +161,7 @@ rbDynamicsWorld *RB_dworld_new(const float gravity[3])
 	world->constraintSolver = new btSequentialImpulseConstraintSolver();
 
 	/* world */
-	world->dynamicsWorld = new btDiscreteDynamicsWorld(world->dispatcher,
+	world->dynamicsWorld = new rbDiscreteDynamicsWorld(world->dispatcher,
 	                                                   world->pairCache,
 	                                                   world->constraintSolver,
 	                                                   world->collisionConfiguration);
@@ -211,6 +212,13 @@ void RB_dworld_set_split_impulse(rbDynamicsWorld *world, int split_impulse)
 	info.m_splitImpulse = split_impulse;
 }
 
+/* Multithreading */
+void RB_dworld_set_parallel(rbDynamicsWorld *world, rbParallelForFunc parallel_for, int num_threads)
+{
+	world->dispatcher->setParallel(parallel_for);
+	world->dynamicsWorld->setParallel(parallel_for, num_threads);
+}
+
 /* Simulation ----------------------- */
 
 void RB_dworld_step_simulation(rbDynamicsWorld *world, float timeStep, int maxSubSteps, float timeSubStep)
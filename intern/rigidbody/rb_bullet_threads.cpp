@@ -0,0 +1,570 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2016 Blender Foundation
+ * All rights reserved.
+ *
+ * The Original Code is: all of this file.
+ *
+ * Contributor(s): none yet.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file rb_bullet_threads.cpp
+ *  \ingroup RigidBody
+ *  \brief Threaded narrowphase and island solving for Bullet
+ *
+ * Stepping stays serial apart from two phases:
+ *
+ * - Narrowphase: the overlapping pairs are split in chunks and processed
+ *   concurrently. Manifold and algorithm allocation is serialized with a
+ *   spin lock, GImpact pairs are processed serially afterwards since GImpact
+ *   shapes keep lock counts on their mesh data. The manifold array is sorted
+ *   back into pair order afterwards, so island building and solving see the
+ *   same order in every run.
+ *
+ * - Constraint solving: islands are batched like btDiscreteDynamicsWorld
+ *   does and each batch is solved by a per thread solver. Islands touching
+ *   kinematic bodies are collected into a single batch, since the solver
+ *   temporarily stores its own data in those bodies.
+ */
+
+#include "rb_bullet_threads.h"
+
+#include "BulletCollision/CollisionDispatch/btConvexConvexAlgorithm.h"
+#include "BulletCollision/CollisionDispatch/btSimulationIslandManager.h"
+#include "BulletCollision/NarrowPhaseCollision/btVoronoiSimplexSolver.h"
+
+#include "atomic_ops.h"
+
+/* Pairs processed by one narrowphase task. */
+#define NARROWPHASE_CHUNK_SIZE 64
+/* Don't bother with threads for small scenes. */
+#define NARROWPHASE_MIN_PAIRS 256
+
+/* ********************************** */
+/* Collision Configuration */
+
+class rbConvexConvexAlgorithm : public btConvexConvexAlgorithm
+{
+	btVoronoiSimplexSolver m_threadSimplexSolver;
+
+public:
+	rbConvexConvexAlgorithm(btPersistentManifold *mf, const btCollisionAlgorithmConstructionInfo &ci,
+	                        const btCollisionObjectWrapper *body0Wrap, const btCollisionObjectWrapper *body1Wrap,
+	                        btConvexPenetrationDepthSolver *pdSolver,
+	                        int numPerturbationIterations, int minimumPointsPerturbationThreshold)
+	    : btConvexConvexAlgorithm(mf, ci, body0Wrap, body1Wrap, &m_threadSimplexSolver, pdSolver,
+	                              numPerturbationIterations, minimumPointsPerturbationThreshold)
+	{
+	}
+
+	struct CreateFunc : public btConvexConvexAlgorithm::CreateFunc
+	{
+		CreateFunc(btConvexPenetrationDepthSolver *pdSolver)
+		    : btConvexConvexAlgorithm::CreateFunc(NULL, pdSolver)
+		{
+		}
+
+		virtual btCollisionAlgorithm *CreateCollisionAlgorithm(btCollisionAlgorithmConstructionInfo &ci,
+		                                                       const btCollisionObjectWrapper *body0Wrap,
+		                                                       const btCollisionObjectWrapper *body1Wrap)
+		{
+			void *mem = ci.m_dispatcher1->allocateCollisionAlgorithm(sizeof(rbConvexConvexAlgorithm));
+			return new(mem) rbConvexConvexAlgorithm(ci.m_manifold, ci, body0Wrap, body1Wrap, m_pdSolver,
+			                                        m_numPerturbationIterations,
+			                                        m_minimumPointsPerturbationThreshold);
+		}
+	};
+};
+
+static btDefaultCollisionConstructionInfo rb_collision_construction_info()
+{
+	btDefaultCollisionConstructionInfo info;
+
+	/* the algorithm pool has fixed size elements */
+	info.m_customCollisionAlgorithmMaxElementSize = sizeof(rbConvexConvexAlgorithm);
+
+	return info;
+}
+
+rbCollisionConfiguration::rbCollisionConfiguration()
+    : btDefaultCollisionConfiguration(rb_collision_construction_info())
+{
+	void *mem = btAlignedAlloc(sizeof(rbConvexConvexAlgorithm::CreateFunc), 16);
+	m_threadedConvexConvexCreateFunc = new(mem) rbConvexConvexAlgorithm::CreateFunc(m_pdSolver);
+}
+
+rbCollisionConfiguration::~rbCollisionConfiguration()
+{
+	m_threadedConvexConvexCreateFunc->~btCollisionAlgorithmCreateFunc();
+	btAlignedFree(m_threadedConvexConvexCreateFunc);
+}
+
+btCollisionAlgorithmCreateFunc *rbCollisionConfiguration::getCollisionAlgorithmCreateFunc(int proxyType0, int proxyType1)
+{
+	btCollisionAlgorithmCreateFunc *createFunc =
+	        btDefaultCollisionConfiguration::getCollisionAlgorithmCreateFunc(proxyType0, proxyType1);
+
+	if (createFunc == m_convexConvexCreateFunc) {
+		return m_threadedConvexConvexCreateFunc;
+	}
+	return createFunc;
+}
+
+/* ********************************** */
+/* Collision Dispatcher */
+
+rbCollisionDispatcher::rbCollisionDispatcher(btCollisionConfiguration *collisionConfiguration)
+    : btCollisionDispatcher(collisionConfiguration),
+      m_parallel_for(NULL),
+      m_lock(0)
+{
+}
+
+void rbCollisionDispatcher::setParallel(rbParallelForFunc parallel_for)
+{
+	m_parallel_for = parallel_for;
+}
+
+void rbCollisionDispatcher::lock()
+{
+	while (atomic_cas_uint32(&m_lock, 0, 1) != 0) {
+		/* pass */
+	}
+}
+
+void rbCollisionDispatcher::unlock()
+{
+	atomic_cas_uint32(&m_lock, 1, 0);
+}
+
+btPersistentManifold *rbCollisionDispatcher::getNewManifold(const btCollisionObject *b0, const btCollisionObject *b1)
+{
+	lock();
+	btPersistentManifold *manifold = btCollisionDispatcher::getNewManifold(b0, b1);
+	unlock();
+	return manifold;
+}
+
+void rbCollisionDispatcher::releaseManifold(btPersistentManifold *manifold)
+{
+	lock();
+	btCollisionDispatcher::releaseManifold(manifold);
+	unlock();
+}
+
+void *rbCollisionDispatcher::allocateCollisionAlgorithm(int size)
+{
+	lock();
+	void *mem = btCollisionDispatcher::allocateCollisionAlgorithm(size);
+	unlock();
+	return mem;
+}
+
+void rbCollisionDispatcher::freeCollisionAlgorithm(void *ptr)
+{
+	lock();
+	btCollisionDispatcher::freeCollisionAlgorithm(ptr);
+	unlock();
+}
+
+static bool rb_pair_is_gimpact(const btBroadphasePair &pair)
+{
+	const btCollisionObject *ob0 = (const btCollisionObject *)pair.m_pProxy0->m_clientObject;
+	const btCollisionObject *ob1 = (const btCollisionObject *)pair.m_pProxy1->m_clientObject;
+
+	return (ob0->getCollisionShape()->getShapeType() == GIMPACT_SHAPE_PROXYTYPE ||
+	        ob1->getCollisionShape()->getShapeType() == GIMPACT_SHAPE_PROXYTYPE);
+}
+
+typedef struct rbNarrowphaseData {
+	btCollisionDispatcher *dispatcher;
+	const btDispatcherInfo *dispatchInfo;
+	btBroadphasePair *pairs;
+	int totpair;
+} rbNarrowphaseData;
+
+static void rb_narrowphase_chunk(void *userdata, int chunk, int /*thread_id*/)
+{
+	rbNarrowphaseData *data = (rbNarrowphaseData *)userdata;
+	btNearCallback nearCallback = data->dispatcher->getNearCallback();
+	const int start = chunk * NARROWPHASE_CHUNK_SIZE;
+	const int end = btMin(start + NARROWPHASE_CHUNK_SIZE, data->totpair);
+
+	for (int i = start; i < end; i++) {
+		btBroadphasePair &pair = data->pairs[i];
+
+		if (!rb_pair_is_gimpact(pair)) {
+			nearCallback(pair, *data->dispatcher, *data->dispatchInfo);
+		}
+	}
+}
+
+void rbCollisionDispatcher::dispatchAllCollisionPairs(btOverlappingPairCache *pairCache,
+                                                      const btDispatcherInfo &dispatchInfo,
+                                                      btDispatcher *dispatcher)
+{
+	btBroadphasePairArray &pairs = pairCache->getOverlappingPairArray();
+	const int totpair = pairs.size();
+
+	/* continuous collision writes the time of impact back into the shared dispatch info */
+	if (m_parallel_for == NULL || totpair < NARROWPHASE_MIN_PAIRS ||
+	    dispatchInfo.m_dispatchFunc != btDispatcherInfo::DISPATCH_DISCRETE)
+	{
+		btCollisionDispatcher::dispatchAllCollisionPairs(pairCache, dispatchInfo, dispatcher);
+		return;
+	}
+
+	rbNarrowphaseData data;
+	data.dispatcher = this;
+	data.dispatchInfo = &dispatchInfo;
+	data.pairs = &pairs[0];
+	data.totpair = totpair;
+
+	m_parallel_for(0, (totpair + NARROWPHASE_CHUNK_SIZE - 1) / NARROWPHASE_CHUNK_SIZE, &data, rb_narrowphase_chunk);
+
+	btNearCallback nearCallback = getNearCallback();
+	for (int i = 0; i < totpair; i++) {
+		if (rb_pair_is_gimpact(pairs[i])) {
+			nearCallback(pairs[i], *this, dispatchInfo);
+		}
+	}
+
+	sortManifolds(pairs);
+}
+
+/* New manifolds were appended in whatever order the threads created them,
+ * put them back in the order of the pairs owning them. */
+void rbCollisionDispatcher::sortManifolds(btBroadphasePairArray &pairs)
+{
+	const int totmanifold = m_manifoldsPtr.size();
+	btAlignedObjectArray<btPersistentManifold *> sorted;
+	btManifoldArray manifolds;
+
+	sorted.reserve(totmanifold);
+
+	for (int i = 0; i < totmanifold; i++) {
+		m_manifoldsPtr[i]->m_index1a = -1;
+	}
+
+	for (int i = 0; i < pairs.size(); i++) {
+		if (pairs[i].m_algorithm == NULL) {
+			continue;
+		}
+
+		manifolds.resize(0);
+		pairs[i].m_algorithm->getAllContactManifolds(manifolds);
+
+		for (int j = 0; j < manifolds.size(); j++) {
+			btPersistentManifold *manifold = manifolds[j];
+
+			if (manifold->m_index1a == -1) {
+				manifold->m_index1a = sorted.size();
+				sorted.push_back(manifold);
+			}
+		}
+	}
+
+	/* manifolds not reported by any algorithm keep their relative order */
+	for (int i = 0; i < totmanifold; i++) {
+		btPersistentManifold *manifold = m_manifoldsPtr[i];
+
+		if (manifold->m_index1a == -1) {
+			manifold->m_index1a = sorted.size();
+			sorted.push_back(manifold);
+		}
+	}
+
+	btAssert(sorted.size() == totmanifold);
+	m_manifoldsPtr = sorted;
+}
+
+/* ********************************** */
+/* Dynamics World */
+
+/* Same as the island id used by btDiscreteDynamicsWorld to sort constraints. */
+static int rb_constraint_island_id(const btTypedConstraint *constraint)
+{
+	const btCollisionObject &ob0 = constraint->getRigidBodyA();
+	const btCollisionObject &ob1 = constraint->getRigidBodyB();
+
+	return ob0.getIslandTag() >= 0 ? ob0.getIslandTag() : ob1.getIslandTag();
+}
+
+class rbSortConstraintOnIslandPredicate
+{
+public:
+	bool operator() (const btTypedConstraint *lhs, const btTypedConstraint *rhs) const
+	{
+		return rb_constraint_island_id(lhs) < rb_constraint_island_id(rhs);
+	}
+};
+
+typedef struct rbIslandBatch {
+	int body_start, totbody;
+	int manifold_start, totmanifold;
+	int constraint_start, totconstraint;
+} rbIslandBatch;
+
+/* Collects the islands into batches, which are solved after the island
+ * manager is done. Islands share no dynamic bodies, so batches can be
+ * solved concurrently as long as kinematic bodies are kept in one batch. */
+class rbIslandCollector : public btSimulationIslandManager::IslandCallback
+{
+public:
+	btAlignedObjectArray<btCollisionObject *> m_bodies;
+	btAlignedObjectArray<btPersistentManifold *> m_manifolds;
+	btAlignedObjectArray<btTypedConstraint *> m_constraints;
+	btAlignedObjectArray<rbIslandBatch> m_batches;
+
+	rbIslandCollector(btTypedConstraint **sortedConstraints, int numConstraints, int minimumBatchSize)
+	    : m_sortedConstraints(sortedConstraints),
+	      m_numConstraints(numConstraints),
+	      m_minimumBatchSize(minimumBatchSize)
+	{
+		memset(&m_open, 0, sizeof(m_open));
+	}
+
+	virtual void processIsland(btCollisionObject **bodies, int numBodies, btPersistentManifold **manifolds,
+	                           int numManifolds, int islandId)
+	{
+		btTypedConstraint **constraints;
+		int numConstraints;
+
+		if (islandId < 0) {
+			/* islands are not split, everything is passed in at once */
+			constraints = m_sortedConstraints;
+			numConstraints = m_numConstraints;
+		}
+		else {
+			findIslandConstraints(islandId, &constraints, &numConstraints);
+		}
+
+		if (islandIsShared(manifolds, numManifolds, constraints, numConstraints) || islandId < 0) {
+			append(m_sharedBodies, bodies, numBodies);
+			append(m_sharedManifolds, manifolds, numManifolds);
+			append(m_sharedConstraints, constraints, numConstraints);
+			return;
+		}
+
+		append(m_bodies, bodies, numBodies);
+		append(m_manifolds, manifolds, numManifolds);
+		append(m_constraints, constraints, numConstraints);
+
+		m_open.totbody += numBodies;
+		m_open.totmanifold += numManifolds;
+		m_open.totconstraint += numConstraints;
+
+		if (m_open.totmanifold + m_open.totconstraint > m_minimumBatchSize) {
+			closeBatch();
+		}
+	}
+
+	void finish()
+	{
+		if (m_open.totbody) {
+			closeBatch();
+		}
+
+		if (m_sharedBodies.size() || m_sharedManifolds.size() || m_sharedConstraints.size()) {
+			append(m_bodies, m_sharedBodies.size() ? &m_sharedBodies[0] : NULL, m_sharedBodies.size());
+			append(m_manifolds, m_sharedManifolds.size() ? &m_sharedManifolds[0] : NULL, m_sharedManifolds.size());
+			append(m_constraints, m_sharedConstraints.size() ? &m_sharedConstraints[0] : NULL,
+			       m_sharedConstraints.size());
+
+			m_open.totbody = m_sharedBodies.size();
+			m_open.totmanifold = m_sharedManifolds.size();
+			m_open.totconstraint = m_sharedConstraints.size();
+			closeBatch();
+		}
+	}
+
+private:
+	btTypedConstraint **m_sortedConstraints;
+	int m_numConstraints;
+	int m_minimumBatchSize;
+
+	rbIslandBatch m_open;
+
+	btAlignedObjectArray<btCollisionObject *> m_sharedBodies;
+	btAlignedObjectArray<btPersistentManifold *> m_sharedManifolds;
+	btAlignedObjectArray<btTypedConstraint *> m_sharedConstraints;
+
+	template<typename T>
+	static void append(btAlignedObjectArray<T *> &array, T **items, int numItems)
+	{
+		for (int i = 0; i < numItems; i++) {
+			array.push_back(items[i]);
+		}
+	}
+
+	void closeBatch()
+	{
+		m_batches.push_back(m_open);
+
+		m_open.body_start = m_bodies.size();
+		m_open.manifold_start = m_manifolds.size();
+		m_open.constraint_start = m_constraints.size();
+		m_open.totbody = m_open.totmanifold = m_open.totconstraint = 0;
+	}
+
+	/* constraints are sorted by island id, so this is a binary search */
+	void findIslandConstraints(int islandId, btTypedConstraint ***r_constraints, int *r_numConstraints)
+	{
+		int lo = 0, hi = m_numConstraints;
+
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			if (rb_constraint_island_id(m_sortedConstraints[mid]) < islandId)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		hi = lo;
+		while (hi < m_numConstraints && rb_constraint_island_id(m_sortedConstraints[hi]) == islandId) {
+			hi++;
+		}
+
+		*r_constraints = m_sortedConstraints + lo;
+		*r_numConstraints = hi - lo;
+	}
+
+	static bool islandIsShared(btPersistentManifold **manifolds, int numManifolds,
+	                           btTypedConstraint **constraints, int numConstraints)
+	{
+		for (int i = 0; i < numManifolds; i++) {
+			if (manifolds[i]->getBody0()->isKinematicObject() || manifolds[i]->getBody1()->isKinematicObject())
+				return true;
+		}
+		for (int i = 0; i < numConstraints; i++) {
+			if (constraints[i]->getRigidBodyA().isKinematicObject() ||
+			    constraints[i]->getRigidBodyB().isKinematicObject())
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+rbDiscreteDynamicsWorld::rbDiscreteDynamicsWorld(btDispatcher *dispatcher, btBroadphaseInterface *pairCache,
+                                                 btConstraintSolver *constraintSolver,
+                                                 btCollisionConfiguration *collisionConfiguration)
+    : btDiscreteDynamicsWorld(dispatcher, pairCache, constraintSolver, collisionConfiguration),
+      m_parallel_for(NULL)
+{
+}
+
+rbDiscreteDynamicsWorld::~rbDiscreteDynamicsWorld()
+{
+	setParallel(NULL, 0);
+}
+
+void rbDiscreteDynamicsWorld::setParallel(rbParallelForFunc parallel_for, int num_threads)
+{
+	if (parallel_for == NULL) {
+		num_threads = 0;
+	}
+
+	for (int i = num_threads; i < m_threadSolvers.size(); i++) {
+		delete m_threadSolvers[i];
+	}
+	for (int i = m_threadSolvers.size(); i < num_threads; i++) {
+		m_threadSolvers.push_back(new btSequentialImpulseConstraintSolver());
+	}
+	m_threadSolvers.resize(num_threads);
+
+	m_parallel_for = parallel_for;
+}
+
+typedef struct rbSolveData {
+	rbIslandCollector *collector;
+	btAlignedObjectArray<btConstraintSolver *> *solvers;
+	btContactSolverInfo *solverInfo;
+	btIDebugDraw *debugDrawer;
+	btDispatcher *dispatcher;
+} rbSolveData;
+
+static void rb_solve_batch(rbSolveData *data, btConstraintSolver *solver, int index)
+{
+	rbIslandCollector *collector = data->collector;
+	const rbIslandBatch &batch = collector->m_batches[index];
+
+	solver->solveGroup(batch.totbody ? &collector->m_bodies[batch.body_start] : NULL, batch.totbody,
+	                   batch.totmanifold ? &collector->m_manifolds[batch.manifold_start] : NULL, batch.totmanifold,
+	                   batch.totconstraint ? &collector->m_constraints[batch.constraint_start] : NULL,
+	                   batch.totconstraint, *data->solverInfo, data->debugDrawer, data->dispatcher);
+}
+
+static void rb_solve_batch_cb(void *userdata, int index, int thread_id)
+{
+	rbSolveData *data = (rbSolveData *)userdata;
+
+	btAssert(thread_id < data->solvers->size());
+	rb_solve_batch(data, (*data->solvers)[thread_id], index);
+}
+
+void rbDiscreteDynamicsWorld::solveConstraints(btContactSolverInfo &solverInfo)
+{
+	if (m_parallel_for == NULL) {
+		btDiscreteDynamicsWorld::solveConstraints(solverInfo);
+		return;
+	}
+
+	m_sortedConstraints.resize(m_constraints.size());
+	for (int i = 0; i < m_constraints.size(); i++) {
+		m_sortedConstraints[i] = m_constraints[i];
+	}
+	m_sortedConstraints.quickSort(rbSortConstraintOnIslandPredicate());
+
+	rbIslandCollector collector(m_sortedConstraints.size() ? &m_sortedConstraints[0] : NULL,
+	                            m_sortedConstraints.size(), solverInfo.m_minimumSolverBatchSize);
+
+	m_islandManager->buildAndProcessIslands(getCollisionWorld()->getDispatcher(), getCollisionWorld(), &collector);
+	collector.finish();
+
+	rbSolveData data;
+	data.collector = &collector;
+	data.solvers = &m_threadSolvers;
+	data.solverInfo = &solverInfo;
+	data.debugDrawer = getDebugDrawer();
+	data.dispatcher = getCollisionWorld()->getDispatcher();
+
+	const int totbatch = collector.m_batches.size();
+
+	if (totbatch > 1) {
+		for (int i = 0; i < m_threadSolvers.size(); i++) {
+			m_threadSolvers[i]->prepareSolve(getNumCollisionObjects(), data.dispatcher->getNumManifolds());
+		}
+
+		m_parallel_for(0, totbatch, &data, rb_solve_batch_cb);
+
+		for (int i = 0; i < m_threadSolvers.size(); i++) {
+			m_threadSolvers[i]->allSolved(solverInfo, m_debugDrawer);
+		}
+	}
+	else {
+		m_constraintSolver->prepareSolve(getNumCollisionObjects(), data.dispatcher->getNumManifolds());
+		if (totbatch == 1) {
+			rb_solve_batch(&data, m_constraintSolver, 0);
+		}
+		m_constraintSolver->allSolved(solverInfo, m_debugDrawer);
+	}
+}
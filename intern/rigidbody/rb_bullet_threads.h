@@ -0,0 +1,102 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2016 Blender Foundation
+ * All rights reserved.
+ *
+ * The Original Code is: all of this file.
+ *
+ * Contributor(s): none yet.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file rb_bullet_threads.h
+ *  \ingroup RigidBody
+ *  \brief Threaded narrowphase and island solving for Bullet
+ *
+ * Our Bullet version has no task scheduler of its own, so the collision
+ * dispatcher and dynamics world are subclassed here to run the pair cache
+ * and simulation islands through a parallel-for supplied by the caller
+ * (see RB_dworld_set_parallel).
+ */
+
+#ifndef __RB_BULLET_THREADS_H__
+#define __RB_BULLET_THREADS_H__
+
+#include "RBI_api.h"
+
+#include "btBulletDynamicsCommon.h"
+
+/* Collision configuration giving each convex-convex algorithm its own
+ * simplex solver, the default one shares a single solver between all pairs. */
+class rbCollisionConfiguration : public btDefaultCollisionConfiguration
+{
+public:
+	rbCollisionConfiguration();
+	virtual ~rbCollisionConfiguration();
+
+	virtual btCollisionAlgorithmCreateFunc *getCollisionAlgorithmCreateFunc(int proxyType0, int proxyType1);
+
+private:
+	btCollisionAlgorithmCreateFunc *m_threadedConvexConvexCreateFunc;
+};
+
+/* Dispatcher which can process the overlapping pairs in parallel. */
+class rbCollisionDispatcher : public btCollisionDispatcher
+{
+public:
+	rbCollisionDispatcher(btCollisionConfiguration *collisionConfiguration);
+
+	void setParallel(rbParallelForFunc parallel_for);
+
+	virtual btPersistentManifold *getNewManifold(const btCollisionObject *b0, const btCollisionObject *b1);
+	virtual void releaseManifold(btPersistentManifold *manifold);
+	virtual void *allocateCollisionAlgorithm(int size);
+	virtual void freeCollisionAlgorithm(void *ptr);
+
+	virtual void dispatchAllCollisionPairs(btOverlappingPairCache *pairCache, const btDispatcherInfo &dispatchInfo,
+	                                       btDispatcher *dispatcher);
+
+private:
+	void lock();
+	void unlock();
+	void sortManifolds(btBroadphasePairArray &pairs);
+
+	rbParallelForFunc m_parallel_for;
+	unsigned int m_lock;
+};
+
+/* Dynamics world solving independent simulation islands in parallel. */
+class rbDiscreteDynamicsWorld : public btDiscreteDynamicsWorld
+{
+public:
+	rbDiscreteDynamicsWorld(btDispatcher *dispatcher, btBroadphaseInterface *pairCache,
+	                        btConstraintSolver *constraintSolver, btCollisionConfiguration *collisionConfiguration);
+	virtual ~rbDiscreteDynamicsWorld();
+
+	void setParallel(rbParallelForFunc parallel_for, int num_threads);
+
+protected:
+	virtual void solveConstraints(btContactSolverInfo &solverInfo);
+
+private:
+	rbParallelForFunc m_parallel_for;
+	btAlignedObjectArray<btConstraintSolver *> m_threadSolvers;
+};
+
+#endif  /* __RB_BULLET_THREADS_H__ */
@@ -51,6 +51,7 @@ FLUID_3D::FLUID_3D(int *res, float dx, float dtdef, int init_heat, int init_fire
 	_dt = dtdef;	// just in case. set in step from a RNA factor
 
 	_iterations = 100;
+	_activeBlocks = NULL;
 	_tempAmb = 0; 
 	_heatDiffusion = 1e-3;
 	_totalTime = 0.0f;
@@ -260,6 +261,8 @@ void FLUID_3D::setBorderObstacles()
 
 FLUID_3D::~FLUID_3D()
 {
+	if (_activeBlocks) delete _activeBlocks;
+
 	if (_xVelocity) delete[] _xVelocity;
 	if (_yVelocity) delete[] _yVelocity;
 	if (_zVelocity) delete[] _zVelocity;
@@ -400,33 +403,19 @@ void FLUID_3D::step(float dt, float gravity[3])
 	SWAP_POINTERS(_zVelocity, _zVelocityTemp);
 #if PARALLEL==1
 	}	// end of single
+	}	// end of parallel
+#endif
 
-	#pragma omp barrier
+	/*
+	* The pressure solver splits its work over z-slabs by itself,
+	* so it has to run outside of the parallel region.
+	*/
+	project();
 
-	#pragma omp for
-	for (int i=0; i<2; i++)
-	{
-		if (i==0)
-		{
-#endif
-			project();
-#if PARALLEL==1
-		}
-		else if (i==1)
-		{
-#endif
-			if (_heat) {
-				diffuseHeat();
-			}
-#if PARALLEL==1
-		}
+	if (_heat) {
+		diffuseHeat();
 	}
 
-	#pragma omp barrier
-
-	#pragma omp single
-	{
-#endif
 	/*
 	* For thread safety use "Old" to read
 	* "current" values but still allow changing values.
@@ -446,12 +435,13 @@ void FLUID_3D::step(float dt, float gravity[3])
 
 	advectMacCormackBegin(0, _zRes);
 
-#if PARALLEL==1
-	}	// end of single
-
-	#pragma omp barrier
-
+	if (_activeBlocks) {
+		updateActiveBlocks();
+	}
 
+#if PARALLEL==1
+	#pragma omp parallel
+	{
 	#pragma omp for schedule(static,1)
 	for (int i=0; i<stepParts; i++)
 	{
@@ -1626,6 +1616,62 @@ void FLUID_3D::addVorticity(int zBegin, int zEnd)
 }
 
 
+//////////////////////////////////////////////////////////////////////
+// Sparse simulation: only advect scalar fields close to where they are
+// non-empty. Velocities are still advected and projected everywhere.
+//////////////////////////////////////////////////////////////////////
+void FLUID_3D::setSparse(bool useSparse)
+{
+	if (useSparse && !_activeBlocks) {
+		_activeBlocks = new SPARSE_BLOCKS(_res);
+	}
+	else if (!useSparse && _activeBlocks) {
+		delete _activeBlocks;
+		_activeBlocks = NULL;
+	}
+}
+
+// Uses the "Old" fields, so has to be called right before advection
+void FLUID_3D::updateActiveBlocks()
+{
+	const float *fields[] = {_densityOld, _heatOld, _fuelOld, _reactOld,
+	                         _color_rOld, _color_gOld, _color_bOld};
+	const int numFields = sizeof(fields) / sizeof(fields[0]);
+	const int blockSlabs = _activeBlocks->_blockRes[2];
+	float maxVelMag = 0.0f;
+
+	// a slab of blocks per iteration, so no two threads write the same block
+#if PARALLEL==1
+	#pragma omp parallel for schedule(static)
+#endif
+	for (int bz = 0; bz < blockSlabs; bz++)
+	{
+		const int zBegin = bz << SPARSE_BLOCK_SHIFT;
+		const int zEnd = (zBegin + SPARSE_BLOCK_SIZE < _zRes) ? zBegin + SPARSE_BLOCK_SIZE : _zRes;
+		const size_t end = (size_t)zEnd * _slabSize;
+		float slabMaxVelMag = 0.0f;
+
+		_activeBlocks->markSlab(fields, numFields, bz);
+
+		for (size_t i = (size_t)zBegin * _slabSize; i < end; i++) {
+			const float velMag = _xVelocityOld[i] * _xVelocityOld[i] +
+			                     _yVelocityOld[i] * _yVelocityOld[i] +
+			                     _zVelocityOld[i] * _zVelocityOld[i];
+			if (velMag > slabMaxVelMag) slabMaxVelMag = velMag;
+		}
+
+#if PARALLEL==1
+		#pragma omp critical
+#endif
+		{
+			if (slabMaxVelMag > maxVelMag) maxVelMag = slabMaxVelMag;
+		}
+	}
+
+	// MacCormack traces forward and backward, plus the interpolation stencil
+	_activeBlocks->dilate(2.0f * (_dt / _dx) * sqrtf(maxVelMag) + 2.0f);
+}
+
 void FLUID_3D::advectMacCormackBegin(int zBegin, int zEnd)
 {
 	Vec3Int res = Vec3Int(_xRes,_yRes,_zRes);
@@ -1651,18 +1697,18 @@ void FLUID_3D::advectMacCormackEnd1(int zBegin, int zEnd)
 
 	// advectFieldMacCormack1(dt, xVelocity, yVelocity, zVelocity, oldField, newField, res)
 
-	advectFieldMacCormack1(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _densityOld, _densityTemp, res, zBegin, zEnd);
+	advectFieldMacCormack1(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _densityOld, _densityTemp, res, zBegin, zEnd, _activeBlocks);
 	if (_heat) {
-		advectFieldMacCormack1(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _heatOld, _heatTemp, res, zBegin, zEnd);
+		advectFieldMacCormack1(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _heatOld, _heatTemp, res, zBegin, zEnd, _activeBlocks);
 	}
 	if (_fuel) {
-		advectFieldMacCormack1(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _fuelOld, _fuelTemp, res, zBegin, zEnd);
-		advectFieldMacCormack1(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _reactOld, _reactTemp, res, zBegin, zEnd);
+		advectFieldMacCormack1(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _fuelOld, _fuelTemp, res, zBegin, zEnd, _activeBlocks);
+		advectFieldMacCormack1(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _reactOld, _reactTemp, res, zBegin, zEnd, _activeBlocks);
 	}
 	if (_color_r) {
-		advectFieldMacCormack1(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _color_rOld, _color_rTemp, res, zBegin, zEnd);
-		advectFieldMacCormack1(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _color_gOld, _color_gTemp, res, zBegin, zEnd);
-		advectFieldMacCormack1(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _color_bOld, _color_bTemp, res, zBegin, zEnd);
+		advectFieldMacCormack1(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _color_rOld, _color_rTemp, res, zBegin, zEnd, _activeBlocks);
+		advectFieldMacCormack1(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _color_gOld, _color_gTemp, res, zBegin, zEnd, _activeBlocks);
+		advectFieldMacCormack1(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _color_bOld, _color_bTemp, res, zBegin, zEnd, _activeBlocks);
 	}
 	advectFieldMacCormack1(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _xVelocityOld, _xVelocity, res, zBegin, zEnd);
 	advectFieldMacCormack1(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _yVelocityOld, _yVelocity, res, zBegin, zEnd);
@@ -1685,18 +1731,18 @@ void FLUID_3D::advectMacCormackEnd2(int zBegin, int zEnd)
 	// advectFieldMacCormack2(dt, xVelocity, yVelocity, zVelocity, oldField, newField, tempfield, temp, res, obstacles)
 
 	/* finish advection */
-	advectFieldMacCormack2(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _densityOld, _density, _densityTemp, t1, res, _obstacles, zBegin, zEnd);
+	advectFieldMacCormack2(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _densityOld, _density, _densityTemp, t1, res, _obstacles, zBegin, zEnd, _activeBlocks);
 	if (_heat) {
-		advectFieldMacCormack2(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _heatOld, _heat, _heatTemp, t1, res, _obstacles, zBegin, zEnd);
+		advectFieldMacCormack2(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _heatOld, _heat, _heatTemp, t1, res, _obstacles, zBegin, zEnd, _activeBlocks);
 	}
 	if (_fuel) {
-		advectFieldMacCormack2(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _fuelOld, _fuel, _fuelTemp, t1, res, _obstacles, zBegin, zEnd);
-		advectFieldMacCormack2(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _reactOld, _react, _reactTemp, t1, res, _obstacles, zBegin, zEnd);
+		advectFieldMacCormack2(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _fuelOld, _fuel, _fuelTemp, t1, res, _obstacles, zBegin, zEnd, _activeBlocks);
+		advectFieldMacCormack2(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _reactOld, _react, _reactTemp, t1, res, _obstacles, zBegin, zEnd, _activeBlocks);
 	}
 	if (_color_r) {
-		advectFieldMacCormack2(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _color_rOld, _color_r, _color_rTemp, t1, res, _obstacles, zBegin, zEnd);
-		advectFieldMacCormack2(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _color_gOld, _color_g, _color_gTemp, t1, res, _obstacles, zBegin, zEnd);
-		advectFieldMacCormack2(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _color_bOld, _color_b, _color_bTemp, t1, res, _obstacles, zBegin, zEnd);
+		advectFieldMacCormack2(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _color_rOld, _color_r, _color_rTemp, t1, res, _obstacles, zBegin, zEnd, _activeBlocks);
+		advectFieldMacCormack2(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _color_gOld, _color_g, _color_gTemp, t1, res, _obstacles, zBegin, zEnd, _activeBlocks);
+		advectFieldMacCormack2(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _color_bOld, _color_b, _color_bTemp, t1, res, _obstacles, zBegin, zEnd, _activeBlocks);
 	}
 	advectFieldMacCormack2(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _xVelocityOld, _xVelocityTemp, _xVelocity, t1, res, _obstacles, zBegin, zEnd);
 	advectFieldMacCormack2(dt0, _xVelocityOld, _yVelocityOld, _zVelocityOld, _yVelocityOld, _yVelocityTemp, _yVelocity, t1, res, _obstacles, zBegin, zEnd);
@@ -38,6 +38,7 @@
 #include "OBSTACLE.h"
 // #include "WTURBULENCE.h"
 #include "VEC3.h"
+#include "SPARSE_BLOCKS.h"
 
 using namespace std;
 using namespace BasicVector;
@@ -144,6 +145,12 @@ struct FLUID_3D
 		// CG fields
 		int _iterations;
 
+		// blocks close to smoke, heat or fire, only scalar fields in these
+		// are advected. NULL when the whole domain is simulated.
+		SPARSE_BLOCKS *_activeBlocks;
+		void setSparse(bool useSparse);
+		void updateActiveBlocks();
+
 		// simulation constants
 		float _dt;
 		float *_dtFactor;
@@ -237,12 +244,14 @@ struct FLUID_3D
 		
 
 		// static advection functions, also used by WTURBULENCE
+		// cells outside of the optional active blocks keep their old value
 		static void advectFieldSemiLagrange(const float dt, const float* velx, const float* vely,  const float* velz,
-				float* oldField, float* newField, Vec3Int res, int zBegin, int zEnd);
+				float* oldField, float* newField, Vec3Int res, int zBegin, int zEnd, const SPARSE_BLOCKS *blocks = NULL);
 		static void advectFieldMacCormack1(const float dt, const float* xVelocity, const float* yVelocity, const float* zVelocity, 
-				float* oldField, float* tempResult, Vec3Int res, int zBegin, int zEnd);
+				float* oldField, float* tempResult, Vec3Int res, int zBegin, int zEnd, const SPARSE_BLOCKS *blocks = NULL);
 		static void advectFieldMacCormack2(const float dt, const float* xVelocity, const float* yVelocity, const float* zVelocity, 
-				float* oldField, float* newField, float* tempResult, float* temp1,Vec3Int res, const unsigned char* obstacles, int zBegin, int zEnd);
+				float* oldField, float* newField, float* tempResult, float* temp1,Vec3Int res, const unsigned char* obstacles, int zBegin, int zEnd,
+				const SPARSE_BLOCKS *blocks = NULL);
 
 
 		// temp ones for testing
@@ -253,9 +262,10 @@ struct FLUID_3D
 
 		// maccormack helper functions
 		static void clampExtrema(const float dt, const float* xVelocity, const float* yVelocity,  const float* zVelocity,
-				float* oldField, float* newField, Vec3Int res, int zBegin, int zEnd);
+				float* oldField, float* newField, Vec3Int res, int zBegin, int zEnd, const SPARSE_BLOCKS *blocks = NULL);
 		static void clampOutsideRays(const float dt, const float* xVelocity, const float* yVelocity,  const float* zVelocity,
-				float* oldField, float* newField, Vec3Int res, const unsigned char* obstacles, const float *oldAdvection, int zBegin, int zEnd);
+				float* oldField, float* newField, Vec3Int res, const unsigned char* obstacles, const float *oldAdvection, int zBegin, int zEnd,
+				const SPARSE_BLOCKS *blocks = NULL);
 
 
 
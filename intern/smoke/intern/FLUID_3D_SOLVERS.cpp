@@ -28,7 +28,12 @@
 //////////////////////////////////////////////////////////////////////
 
 #include "FLUID_3D.h"
+#include "IMAGE.h"
 #include <cstring>
+
+#if PARALLEL==1
+#include <omp.h>
+#endif // PARALLEL
 #define SOLVER_ACCURACY 1e-06
 
 //////////////////////////////////////////////////////////////////////
@@ -165,164 +170,640 @@ void FLUID_3D::solveHeat(float* field, float* b, unsigned char* skip)
 	if (_Acenter)  delete[] _Acenter;
 }
 
-void FLUID_3D::solvePressurePre(float* field, float* b, unsigned char* skip)
+//////////////////////////////////////////////////////////////////////
+// Multigrid preconditioner for the pressure solve
+//
+// One V-cycle of geometric multigrid is used as preconditioner for CG
+// (MGPCG), which keeps iteration counts nearly independent of the grid
+// resolution. Coarse levels use 2x2x2 cell agglomeration with the
+// Galerkin operator R*A*P, where P is injection into the children and
+// R = P^T / 8, so obstacle cells never couple with fluid cells on any
+// level. Damped Jacobi is used for smoothing, with the same number of
+// sweeps before and after the coarse correction, so the preconditioner
+// stays symmetric.
+//
+// All passes split the grid into z-slabs in the same way FLUID_3D::step
+// does, reductions are summed per slab and then in slab order so results
+// only depend on the number of threads.
+//////////////////////////////////////////////////////////////////////
+
+#define MG_SMOOTH_SWEEPS 2
+#define MG_COARSEST_SWEEPS 32
+#define MG_JACOBI_WEIGHT (2.0f / 3.0f)
+#define MG_MIN_RES 4
+
+struct MGLevel
 {
-	int x, y, z;
-	size_t index;
-	float *_q, *_Precond, *_h, *_residual, *_direction;
+	int res[3];
+	size_t slab;
+	size_t total;
+
+	// diagonal of the operator, zero for cells which are not solved for
+	float *diag;
+	// coupling to the +x, +y and +z neighbours, only used on coarse levels
+	float *off[3];
+	// cells which are solved for, only used on the finest level
+	unsigned char *fluid;
+
+	float *x;
+	float *b;
+	float *tmp;
+};
+
+static int solverSlabParts(int zRes)
+{
+#if PARALLEL==1
+	int threadval = omp_get_max_threads();
+
+	// Same slab splitting as FLUID_3D::step
+	int stepParts = threadval*2;
+	float partSize = (float)zRes/stepParts;
+
+	if (partSize < 4) {stepParts = threadval;
+					partSize = (float)zRes/stepParts;}
+	if (partSize < 4) {stepParts = (int)(ceil((float)zRes/4.0f));
+					partSize = (float)zRes/stepParts;}
+
+	return (stepParts > 0) ? stepParts : 1;
+#else
+	(void)zRes;
+	return 1;
+#endif
+}
 
-	// i = 0
-	int i = 0;
+// Run kernel(zBegin, zEnd, part) over all slabs of a grid
+template<typename Kernel>
+static void solverRunSlabs(Kernel &kernel, int zRes, int parts)
+{
+	const float partSize = (float)zRes/parts;
+
+#if PARALLEL==1
+	#pragma omp parallel for schedule(static,1)
+#endif
+	for (int i = 0; i < parts; i++)
+	{
+		int zBegin = (int)((float)i*partSize + 0.5f);
+		int zEnd = (int)((float)(i+1)*partSize + 0.5f);
+
+		kernel(zBegin, zEnd, i);
+	}
+}
 
-	_residual     = new float[_totalCells]; // set 0
-	_direction    = new float[_totalCells]; // set 0
-	_q            = new float[_totalCells]; // set 0
-	_h			  = new float[_totalCells]; // set 0
-	_Precond	  = new float[_totalCells]; // set 0
+static inline int mgMin(int a, int b)
+{
+	return (a < b) ? a : b;
+}
 
-	memset(_residual, 0, sizeof(float)*_xRes*_yRes*_zRes);
-	memset(_q, 0, sizeof(float)*_xRes*_yRes*_zRes);
-	memset(_direction, 0, sizeof(float)*_xRes*_yRes*_zRes);
-	memset(_h, 0, sizeof(float)*_xRes*_yRes*_zRes);
-	memset(_Precond, 0, sizeof(float)*_xRes*_yRes*_zRes);
+static inline int mgMax(int a, int b)
+{
+	return (a > b) ? a : b;
+}
 
-	float deltaNew = 0.0f;
+static inline float mgOffDiag(const MGLevel &lv, int axis, size_t index, size_t stride)
+{
+	if (lv.fluid)
+		return (lv.fluid[index] && lv.fluid[index + stride]) ? -1.0f : 0.0f;
+	return lv.off[axis][index];
+}
 
-	// r = b - Ax
-	index = _slabSize + _xRes + 1;
-	for (z = 1; z < _zRes - 1; z++, index += 2 * _xRes)
-		for (y = 1; y < _yRes - 1; y++, index += 2)
-		  for (x = 1; x < _xRes - 1; x++, index++)
-		  {
-			// if the cell is a variable
-			float Acenter = 0.0f;
-			if (!skip[index])
+// (A * v) at one interior cell of the finest level, v has to be zero
+// in all cells which are not solved for
+static inline float mgApplyFine(const MGLevel &lv, const float *v, size_t index)
+{
+	return lv.diag[index] * v[index] -
+	       (v[index - 1] + v[index + 1] +
+	        v[index - lv.res[0]] + v[index + lv.res[0]] +
+	        v[index - lv.slab] + v[index + lv.slab]);
+}
+
+// (A * v) at one cell
+static inline float mgApply(const MGLevel &lv, const float *v, int x, int y, int z, size_t index)
+{
+	float sum = lv.diag[index] * v[index];
+
+	if (x > 0)            sum += mgOffDiag(lv, 0, index - 1, 1) * v[index - 1];
+	if (x < lv.res[0] - 1) sum += mgOffDiag(lv, 0, index, 1) * v[index + 1];
+	if (y > 0)            sum += mgOffDiag(lv, 1, index - lv.res[0], lv.res[0]) * v[index - lv.res[0]];
+	if (y < lv.res[1] - 1) sum += mgOffDiag(lv, 1, index, lv.res[0]) * v[index + lv.res[0]];
+	if (z > 0)            sum += mgOffDiag(lv, 2, index - lv.slab, lv.slab) * v[index - lv.slab];
+	if (z < lv.res[2] - 1) sum += mgOffDiag(lv, 2, index, lv.slab) * v[index + lv.slab];
+
+	return sum;
+}
+
+struct MGZeroKernel
+{
+	MGLevel *lv;
+
+	void operator()(int zBegin, int zEnd, int /*part*/)
+	{
+		memset(lv->x + lv->slab * zBegin, 0, sizeof(float) * lv->slab * (zEnd - zBegin));
+	}
+};
+
+struct MGJacobiKernel
+{
+	MGLevel *lv;
+
+	void operator()(int zBegin, int zEnd, int /*part*/)
+	{
+		const MGLevel &l = *lv;
+
+		if (l.fluid) {
+			// only interior cells are solved for on the finest level
+			for (int z = mgMax(zBegin, 1); z < mgMin(zEnd, l.res[2] - 1); z++)
+				for (int y = 1; y < l.res[1] - 1; y++)
+				{
+					size_t index = l.slab * z + (size_t)l.res[0] * y + 1;
+					for (int x = 1; x < l.res[0] - 1; x++, index++)
+					{
+						if (l.fluid[index])
+							l.tmp[index] = l.x[index] + MG_JACOBI_WEIGHT *
+							               (l.b[index] - mgApplyFine(l, l.x, index)) / l.diag[index];
+						else
+							l.tmp[index] = 0.0f;
+					}
+				}
+			return;
+		}
+
+		for (int z = zBegin; z < zEnd; z++)
+			for (int y = 0; y < l.res[1]; y++)
 			{
-			  // set the matrix to the Poisson stencil in order
-			  if (!skip[index + 1]) Acenter += 1.0f;
-			  if (!skip[index - 1]) Acenter += 1.0f;
-			  if (!skip[index + _xRes]) Acenter += 1.0f;
-			  if (!skip[index - _xRes]) Acenter += 1.0f;
-			  if (!skip[index + _slabSize]) Acenter += 1.0f;
-			  if (!skip[index - _slabSize]) Acenter += 1.0f;
-
-			  _residual[index] = b[index] - (Acenter * field[index] +  
-			  field[index - 1] * (skip[index - 1] ? 0.0f : -1.0f) +
-			  field[index + 1] * (skip[index + 1] ? 0.0f : -1.0f) +
-			  field[index - _xRes] * (skip[index - _xRes] ? 0.0f : -1.0f)+
-			  field[index + _xRes] * (skip[index + _xRes] ? 0.0f : -1.0f)+
-			  field[index - _slabSize] * (skip[index - _slabSize] ? 0.0f : -1.0f)+
-			  field[index + _slabSize] * (skip[index + _slabSize] ? 0.0f : -1.0f) );
+				size_t index = l.slab * z + (size_t)l.res[0] * y;
+				for (int x = 0; x < l.res[0]; x++, index++)
+				{
+					if (l.diag[index] > 0.0f)
+						l.tmp[index] = l.x[index] + MG_JACOBI_WEIGHT *
+						               (l.b[index] - mgApply(l, l.x, x, y, z, index)) / l.diag[index];
+					else
+						l.tmp[index] = 0.0f;
+				}
 			}
-			else
+	}
+};
+
+// b_coarse = R * (b_fine - A_fine * x_fine)
+struct MGRestrictKernel
+{
+	MGLevel *fine, *coarse;
+
+	void operator()(int zBegin, int zEnd, int /*part*/)
+	{
+		const MGLevel &f = *fine;
+		MGLevel &c = *coarse;
+
+		for (int z = zBegin; z < zEnd; z++)
+			for (int y = 0; y < c.res[1]; y++)
+				for (int x = 0; x < c.res[0]; x++)
+				{
+					float sum = 0.0f;
+
+					for (int fz = 2 * z; fz < mgMin(2 * z + 2, f.res[2]); fz++)
+						for (int fy = 2 * y; fy < mgMin(2 * y + 2, f.res[1]); fy++)
+							for (int fx = 2 * x; fx < mgMin(2 * x + 2, f.res[0]); fx++)
+							{
+								const size_t index = f.slab * fz + (size_t)f.res[0] * fy + fx;
+								if (f.diag[index] > 0.0f)
+									sum += f.b[index] - (f.fluid ? mgApplyFine(f, f.x, index) :
+									                              mgApply(f, f.x, fx, fy, fz, index));
+							}
+
+					c.b[c.slab * z + (size_t)c.res[0] * y + x] = sum * 0.125f;
+				}
+	}
+};
+
+// x_fine += P * x_coarse
+struct MGProlongKernel
+{
+	MGLevel *fine, *coarse;
+
+	void operator()(int zBegin, int zEnd, int /*part*/)
+	{
+		MGLevel &f = *fine;
+		const MGLevel &c = *coarse;
+
+		for (int z = zBegin; z < zEnd; z++)
+			for (int y = 0; y < f.res[1]; y++)
 			{
-			_residual[index] = 0.0f;
+				size_t index = f.slab * z + (size_t)f.res[0] * y;
+				const size_t cindex = c.slab * (z / 2) + (size_t)c.res[0] * (y / 2);
+
+				for (int x = 0; x < f.res[0]; x++, index++)
+					if (f.diag[index] > 0.0f)
+						f.x[index] += c.x[cindex + x / 2];
 			}
+	}
+};
 
-			// P^-1
-			if(Acenter < 1.0f)
-				_Precond[index] = 0.0;
-			else
-				_Precond[index] = 1.0f / Acenter;
+// A_coarse = R * A_fine * P
+struct MGCoarsenKernel
+{
+	MGLevel *fine, *coarse;
+
+	void operator()(int zBegin, int zEnd, int /*part*/)
+	{
+		const MGLevel &f = *fine;
+		MGLevel &c = *coarse;
+
+		for (int z = zBegin; z < zEnd; z++)
+			for (int y = 0; y < c.res[1]; y++)
+				for (int x = 0; x < c.res[0]; x++)
+				{
+					const size_t cindex = c.slab * z + (size_t)c.res[0] * y + x;
+					float diag = 0.0f, off[3] = {0.0f, 0.0f, 0.0f};
+
+					for (int fz = 2 * z; fz < mgMin(2 * z + 2, f.res[2]); fz++)
+						for (int fy = 2 * y; fy < mgMin(2 * y + 2, f.res[1]); fy++)
+							for (int fx = 2 * x; fx < mgMin(2 * x + 2, f.res[0]); fx++)
+							{
+								const size_t index = f.slab * fz + (size_t)f.res[0] * fy + fx;
+								const int fc[3] = {fx, fy, fz};
+								const size_t stride[3] = {1, (size_t)f.res[0], f.slab};
+
+								if (f.diag[index] <= 0.0f)
+									continue;
+
+								diag += f.diag[index];
+
+								for (int axis = 0; axis < 3; axis++)
+								{
+									if ((fc[axis] & 1) == 0)
+										continue;
+
+									// coupling with the other child along this axis, counted for both of them
+									diag += 2.0f * mgOffDiag(f, axis, index - stride[axis], stride[axis]);
+
+									// coupling across the positive face of the coarse cell
+									if (fc[axis] + 1 < f.res[axis])
+										off[axis] += mgOffDiag(f, axis, index, stride[axis]);
+								}
+							}
+
+					c.diag[cindex] = diag * 0.125f;
+					for (int axis = 0; axis < 3; axis++)
+						c.off[axis][cindex] = off[axis] * 0.125f;
+				}
+	}
+};
+
+static void mgVCycle(MGLevel *levels, int totlevel, int level)
+{
+	MGLevel *lv = &levels[level];
+	const int parts = solverSlabParts(lv->res[2]);
+	const int sweeps = (level == totlevel - 1) ? MG_COARSEST_SWEEPS : MG_SMOOTH_SWEEPS;
 
-			// p = P^-1 * r
-			_direction[index] = _residual[index] * _Precond[index];
+	MGZeroKernel zero = {lv};
+	solverRunSlabs(zero, lv->res[2], parts);
 
-			deltaNew += _residual[index] * _direction[index];
-		  }
+	MGJacobiKernel jacobi = {lv};
+	for (int i = 0; i < sweeps; i++)
+	{
+		solverRunSlabs(jacobi, lv->res[2], parts);
+		SWAP_POINTERS(lv->x, lv->tmp);
+	}
 
+	if (level == totlevel - 1)
+		return;
 
-  // While deltaNew > (eps^2) * delta0
-  const float eps  = SOLVER_ACCURACY;
-  //while ((i < _iterations) && (deltaNew > eps*delta0))
-  float maxR = 2.0f * eps;
-  // while (i < _iterations)
-  while ((i < _iterations) && (maxR > 0.001f * eps))
-  {
+	MGLevel *coarse = &levels[level + 1];
 
-	float alpha = 0.0f;
+	MGRestrictKernel restrict_kernel = {lv, coarse};
+	solverRunSlabs(restrict_kernel, coarse->res[2], solverSlabParts(coarse->res[2]));
 
-    index = _slabSize + _xRes + 1;
-    for (z = 1; z < _zRes - 1; z++, index += 2 * _xRes)
-      for (y = 1; y < _yRes - 1; y++, index += 2)
-        for (x = 1; x < _xRes - 1; x++, index++)
-        {
-          // if the cell is a variable
-          float Acenter = 0.0f;
-          if (!skip[index])
-          {
-            // set the matrix to the Poisson stencil in order
-            if (!skip[index + 1]) Acenter += 1.0f;
-            if (!skip[index - 1]) Acenter += 1.0f;
-            if (!skip[index + _xRes]) Acenter += 1.0f;
-            if (!skip[index - _xRes]) Acenter += 1.0f;
-            if (!skip[index + _slabSize]) Acenter += 1.0f;
-            if (!skip[index - _slabSize]) Acenter += 1.0f;
-
-			_q[index] = Acenter * _direction[index] +  
-            _direction[index - 1] * (skip[index - 1] ? 0.0f : -1.0f) +
-            _direction[index + 1] * (skip[index + 1] ? 0.0f : -1.0f) +
-            _direction[index - _xRes] * (skip[index - _xRes] ? 0.0f : -1.0f) +
-            _direction[index + _xRes] * (skip[index + _xRes] ? 0.0f : -1.0f)+
-            _direction[index - _slabSize] * (skip[index - _slabSize] ? 0.0f : -1.0f) +
-            _direction[index + _slabSize] * (skip[index + _slabSize] ? 0.0f : -1.0f);
-          }
-		  else
-		  {
-          _q[index] = 0.0f;
-		  }
+	mgVCycle(levels, totlevel, level + 1);
 
-		  alpha += _direction[index] * _q[index];
-        }
+	MGProlongKernel prolong = {lv, coarse};
+	solverRunSlabs(prolong, lv->res[2], parts);
 
+	for (int i = 0; i < sweeps; i++)
+	{
+		solverRunSlabs(jacobi, lv->res[2], parts);
+		SWAP_POINTERS(lv->x, lv->tmp);
+	}
+}
 
-    if (fabs(alpha) > 0.0f)
-      alpha = deltaNew / alpha;
+// Build the coarse levels below levels[0], returns the number of levels
+static int mgBuildLevels(MGLevel *levels, int maxlevel)
+{
+	int totlevel = 1;
 
-	float deltaOld = deltaNew;
-	deltaNew = 0.0f;
+	while (totlevel < maxlevel)
+	{
+		MGLevel *fine = &levels[totlevel - 1];
+		MGLevel *coarse = &levels[totlevel];
 
-	maxR = 0.0;
+		if (mgMin(fine->res[0], mgMin(fine->res[1], fine->res[2])) < 2 * MG_MIN_RES)
+			break;
 
-	float tmp;
+		for (int axis = 0; axis < 3; axis++)
+			coarse->res[axis] = (fine->res[axis] + 1) / 2;
+		coarse->slab = (size_t)coarse->res[0] * coarse->res[1];
+		coarse->total = coarse->slab * coarse->res[2];
 
-    // x = x + alpha * d
-    index = _slabSize + _xRes + 1;
-    for (z = 1; z < _zRes - 1; z++, index += 2 * _xRes)
-      for (y = 1; y < _yRes - 1; y++, index += 2)
-        for (x = 1; x < _xRes - 1; x++, index++)
-		{
-          field[index] += alpha * _direction[index];
+		coarse->diag = new float[coarse->total];
+		for (int axis = 0; axis < 3; axis++)
+			coarse->off[axis] = new float[coarse->total];
+		coarse->fluid = NULL;
+		coarse->x = new float[coarse->total];
+		coarse->b = new float[coarse->total];
+		coarse->tmp = new float[coarse->total];
 
-		  _residual[index] -= alpha * _q[index];
+		MGCoarsenKernel coarsen = {fine, coarse};
+		solverRunSlabs(coarsen, coarse->res[2], solverSlabParts(coarse->res[2]));
+
+		totlevel++;
+	}
+
+	return totlevel;
+}
+
+static void mgFreeLevels(MGLevel *levels, int totlevel)
+{
+	// the finest level uses the solver's arrays
+	for (int level = 1; level < totlevel; level++)
+	{
+		delete[] levels[level].diag;
+		for (int axis = 0; axis < 3; axis++)
+			delete[] levels[level].off[axis];
+		delete[] levels[level].x;
+		delete[] levels[level].b;
+		delete[] levels[level].tmp;
+	}
+}
+
+#define MG_MAX_LEVELS 16
+
+struct PressureSetupKernel
+{
+	FLUID_3D *fluid;
+	float *field, *b, *residual, *Acenter, *Precond;
+	unsigned char *skip, *mask;
+
+	void operator()(int zBegin, int zEnd, int /*part*/)
+	{
+		const int xRes = fluid->_xRes, yRes = fluid->_yRes, zRes = fluid->_zRes;
+		const size_t slabSize = fluid->_slabSize;
+
+		for (int z = zBegin; z < zEnd; z++)
+			for (int y = 0; y < yRes; y++)
+			{
+				size_t index = slabSize * z + (size_t)xRes * y;
+				for (int x = 0; x < xRes; x++, index++)
+				{
+					float A = 0.0f;
+
+					if (x > 0 && x < xRes - 1 && y > 0 && y < yRes - 1 && z > 0 && z < zRes - 1 && !skip[index])
+					{
+						// set the matrix to the Poisson stencil in order
+						if (!skip[index + 1]) A += 1.0f;
+						if (!skip[index - 1]) A += 1.0f;
+						if (!skip[index + xRes]) A += 1.0f;
+						if (!skip[index - xRes]) A += 1.0f;
+						if (!skip[index + slabSize]) A += 1.0f;
+						if (!skip[index - slabSize]) A += 1.0f;
+					}
+
+					// P^-1
+					if (A < 1.0f)
+					{
+						Acenter[index] = 0.0f;
+						Precond[index] = 0.0f;
+						mask[index] = 0;
+						residual[index] = 0.0f;
+						continue;
+					}
+
+					Acenter[index] = A;
+					Precond[index] = 1.0f / A;
+					mask[index] = 1;
+
+					residual[index] = b[index] - (A * field[index] +
+					field[index - 1] * (skip[index - 1] ? 0.0f : -1.0f) +
+					field[index + 1] * (skip[index + 1] ? 0.0f : -1.0f) +
+					field[index - xRes] * (skip[index - xRes] ? 0.0f : -1.0f) +
+					field[index + xRes] * (skip[index + xRes] ? 0.0f : -1.0f) +
+					field[index - slabSize] * (skip[index - slabSize] ? 0.0f : -1.0f) +
+					field[index + slabSize] * (skip[index + slabSize] ? 0.0f : -1.0f));
+				}
+			}
+	}
+};
+
+// q = A * d, partial[part] = d . q
+struct PressureApplyKernel
+{
+	MGLevel *lv;
+	float *direction, *q, *partial;
+
+	void operator()(int zBegin, int zEnd, int part)
+	{
+		const MGLevel &l = *lv;
+		float sum = 0.0f;
+
+		for (int z = mgMax(zBegin, 1); z < mgMin(zEnd, l.res[2] - 1); z++)
+			for (int y = 1; y < l.res[1] - 1; y++)
+			{
+				size_t index = l.slab * z + (size_t)l.res[0] * y + 1;
+				for (int x = 1; x < l.res[0] - 1; x++, index++)
+				{
+					if (l.fluid[index])
+					{
+						q[index] = mgApplyFine(l, direction, index);
+						sum += direction[index] * q[index];
+					}
+					else
+						q[index] = 0.0f;
+				}
+			}
+
+		partial[part] = sum;
+	}
+};
 
-		  _h[index] = _Precond[index] * _residual[index];
+// x = x + alpha * d, r = r - alpha * q, partial[part] = mgMax(r * r / A)
+struct PressureUpdateKernel
+{
+	FLUID_3D *fluid;
+	float *field, *residual, *direction, *q, *Precond, *partial;
+	float alpha;
+
+	void operator()(int zBegin, int zEnd, int part)
+	{
+		const size_t begin = fluid->_slabSize * zBegin, end = fluid->_slabSize * zEnd;
+		float maxR = 0.0f;
 
-		  tmp = _residual[index] * _h[index];
-		  deltaNew += tmp;
-		  maxR = (tmp > maxR) ? tmp : maxR;
+		for (size_t index = begin; index < end; index++)
+		{
+			if (Precond[index] == 0.0f)
+				continue;
 
+			field[index] += alpha * direction[index];
+			residual[index] -= alpha * q[index];
+
+			const float tmp = residual[index] * residual[index] * Precond[index];
+			maxR = (tmp > maxR) ? tmp : maxR;
 		}
 
+		partial[part] = maxR;
+	}
+};
 
-    // beta = deltaNew / deltaOld
-    float beta = deltaNew / deltaOld;
+// partial[part] = r . h
+struct PressureDotKernel
+{
+	FLUID_3D *fluid;
+	float *residual, *h, *partial;
 
-    // d = h + beta * d
-    index = _slabSize + _xRes + 1;
-    for (z = 1; z < _zRes - 1; z++, index += 2 * _xRes)
-      for (y = 1; y < _yRes - 1; y++, index += 2)
-        for (x = 1; x < _xRes - 1; x++, index++)
-          _direction[index] = _h[index] + beta * _direction[index];
+	void operator()(int zBegin, int zEnd, int part)
+	{
+		const size_t begin = fluid->_slabSize * zBegin, end = fluid->_slabSize * zEnd;
+		float sum = 0.0f;
 
-    // i = i + 1
-    i++;
-  }
-  // cout << i << " iterations converged to " << sqrt(maxR) << endl;
+		for (size_t index = begin; index < end; index++)
+			sum += residual[index] * h[index];
 
-	if (_h) delete[] _h;
-	if (_Precond) delete[] _Precond;
-	if (_residual) delete[] _residual;
-	if (_direction) delete[] _direction;
-	if (_q)       delete[] _q;
+		partial[part] = sum;
+	}
+};
+
+// d = h + beta * d
+struct PressureDirectionKernel
+{
+	FLUID_3D *fluid;
+	float *direction, *h;
+	float beta;
+
+	void operator()(int zBegin, int zEnd, int /*part*/)
+	{
+		const size_t begin = fluid->_slabSize * zBegin, end = fluid->_slabSize * zEnd;
+
+		for (size_t index = begin; index < end; index++)
+			direction[index] = h[index] + beta * direction[index];
+	}
+};
+
+static float solverSumParts(const float *partial, int parts)
+{
+	float sum = 0.0f;
+	for (int i = 0; i < parts; i++)
+		sum += partial[i];
+	return sum;
+}
+
+static float solverMaxParts(const float *partial, int parts)
+{
+	float maxR = 0.0f;
+	for (int i = 0; i < parts; i++)
+		maxR = (partial[i] > maxR) ? partial[i] : maxR;
+	return maxR;
+}
+
+void FLUID_3D::solvePressurePre(float* field, float* b, unsigned char* skip)
+{
+	float *_q, *_Precond, *_h, *_residual, *_direction, *_Acenter, *_tmp;
+	unsigned char *_fluid;
+	const int parts = solverSlabParts(_zRes);
+	float *partial = new float[parts];
+
+	// i = 0
+	int i = 0;
+
+	_residual     = new float[_totalCells];
+	_direction    = new float[_totalCells];
+	_q            = new float[_totalCells];
+	_h            = new float[_totalCells];
+	_Precond      = new float[_totalCells];
+	_Acenter      = new float[_totalCells];
+	_tmp          = new float[_totalCells];
+	_fluid        = new unsigned char[_totalCells];
+
+	// the smoother never writes the border cells
+	memset(_tmp, 0, sizeof(float)*_totalCells);
+
+	// r = b - Ax
+	PressureSetupKernel setup = {this, field, b, _residual, _Acenter, _Precond, skip, _fluid};
+	solverRunSlabs(setup, _zRes, parts);
+
+	// multigrid hierarchy, the finest level works on the CG vectors
+	MGLevel levels[MG_MAX_LEVELS];
+	levels[0].res[0] = _xRes;
+	levels[0].res[1] = _yRes;
+	levels[0].res[2] = _zRes;
+	levels[0].slab = _slabSize;
+	levels[0].total = _totalCells;
+	levels[0].diag = _Acenter;
+	levels[0].off[0] = levels[0].off[1] = levels[0].off[2] = NULL;
+	levels[0].fluid = _fluid;
+	levels[0].b = _residual;
+	levels[0].x = _h;
+	levels[0].tmp = _tmp;
+
+	const int totlevel = mgBuildLevels(levels, MG_MAX_LEVELS);
+
+	// h = M^-1 * r, the V-cycle may swap the finest level's x and tmp
+	mgVCycle(levels, totlevel, 0);
+	_h = levels[0].x;
+	_tmp = levels[0].tmp;
+
+	// p = h
+	memcpy(_direction, _h, sizeof(float)*_totalCells);
+
+	PressureDotKernel dot = {this, _residual, _h, partial};
+	solverRunSlabs(dot, _zRes, parts);
+	float deltaNew = solverSumParts(partial, parts);
+
+	// While deltaNew > (eps^2) * delta0
+	const float eps  = SOLVER_ACCURACY;
+	float maxR = 2.0f * eps;
+	while ((i < _iterations) && (maxR > 0.001f * eps))
+	{
+		// q = Ad
+		PressureApplyKernel apply = {&levels[0], _direction, _q, partial};
+		solverRunSlabs(apply, _zRes, parts);
+		float alpha = solverSumParts(partial, parts);
+
+		if (fabs(alpha) > 0.0f)
+			alpha = deltaNew / alpha;
+
+		float deltaOld = deltaNew;
+
+		// x = x + alpha * d
+		PressureUpdateKernel update = {this, field, _residual, _direction, _q, _Precond, partial, alpha};
+		solverRunSlabs(update, _zRes, parts);
+		maxR = solverMaxParts(partial, parts);
+
+		// h = M^-1 * r
+		mgVCycle(levels, totlevel, 0);
+		_h = levels[0].x;
+		_tmp = levels[0].tmp;
+
+		dot.h = _h;
+		solverRunSlabs(dot, _zRes, parts);
+		deltaNew = solverSumParts(partial, parts);
+
+		// beta = deltaNew / deltaOld
+		float beta = deltaNew / deltaOld;
+
+		// d = h + beta * d
+		PressureDirectionKernel direction = {this, _direction, _h, beta};
+		solverRunSlabs(direction, _zRes, parts);
+
+		// i = i + 1
+		i++;
+	}
+	// cout << i << " iterations converged to " << sqrt(maxR) << endl;
+
+	mgFreeLevels(levels, totlevel);
+
+	delete[] partial;
+	delete[] _h;
+	delete[] _tmp;
+	delete[] _Precond;
+	delete[] _Acenter;
+	delete[] _fluid;
+	delete[] _residual;
+	delete[] _direction;
+	delete[] _q;
 }
@@ -297,7 +297,7 @@ void FLUID_3D::copyBorderZ(float* field, Vec3Int res, int zBegin, int zEnd)
 // advect field with the semi lagrangian method
 //////////////////////////////////////////////////////////////////////
 void FLUID_3D::advectFieldSemiLagrange(const float dt, const float* velx, const float* vely,  const float* velz,
-		float* oldField, float* newField, Vec3Int res, int zBegin, int zEnd)
+		float* oldField, float* newField, Vec3Int res, int zBegin, int zEnd, const SPARSE_BLOCKS *blocks)
 {
 	const int xres = res[0];
 	const int yres = res[1];
@@ -310,6 +310,11 @@ void FLUID_3D::advectFieldSemiLagrange(const float dt, const float* velx, const
 			for (int x = 0; x < xres; x++)
 			{
 				const int index = x + y * xres + z * xres*yres;
+
+				if (blocks && !blocks->isActive(x, y, z)) {
+					newField[index] = oldField[index];
+					continue;
+				}
 				
         // backtrace
 				float xTrace = x - dt * velx[index];
@@ -369,7 +374,7 @@ void FLUID_3D::advectFieldSemiLagrange(const float dt, const float* velx, const
 // comments are the pseudocode from selle's paper
 //////////////////////////////////////////////////////////////////////
 void FLUID_3D::advectFieldMacCormack1(const float dt, const float* xVelocity, const float* yVelocity, const float* zVelocity, 
-				float* oldField, float* tempResult, Vec3Int res, int zBegin, int zEnd)
+				float* oldField, float* tempResult, Vec3Int res, int zBegin, int zEnd, const SPARSE_BLOCKS *blocks)
 {
 	/*const int sx= res[0];
 	const int sy= res[1];
@@ -384,13 +389,14 @@ void FLUID_3D::advectFieldMacCormack1(const float dt, const float* xVelocity, co
 
 
 	// phiHatN1 = A(phiN)
-	advectFieldSemiLagrange(  dt, xVelocity, yVelocity, zVelocity, phiN, phiN1, res, zBegin, zEnd);		// uses wide data from old field and velocities (both are whole)
+	advectFieldSemiLagrange(  dt, xVelocity, yVelocity, zVelocity, phiN, phiN1, res, zBegin, zEnd, blocks);		// uses wide data from old field and velocities (both are whole)
 }
 
 
 
 void FLUID_3D::advectFieldMacCormack2(const float dt, const float* xVelocity, const float* yVelocity, const float* zVelocity, 
-				float* oldField, float* newField, float* tempResult, float* temp1, Vec3Int res, const unsigned char* obstacles, int zBegin, int zEnd)
+				float* oldField, float* newField, float* tempResult, float* temp1, Vec3Int res, const unsigned char* obstacles, int zBegin, int zEnd,
+				const SPARSE_BLOCKS *blocks)
 {
 	float* phiHatN  = tempResult;
 	float* t1  = temp1;
@@ -403,7 +409,7 @@ void FLUID_3D::advectFieldMacCormack2(const float dt, const float* xVelocity, co
 
 
 	// phiHatN = A^R(phiHatN1)
-	advectFieldSemiLagrange( -1.0f*dt, xVelocity, yVelocity, zVelocity, phiHatN, t1, res, zBegin, zEnd);		// uses wide data from old field and velocities (both are whole)
+	advectFieldSemiLagrange( -1.0f*dt, xVelocity, yVelocity, zVelocity, phiHatN, t1, res, zBegin, zEnd, blocks);		// uses wide data from old field and velocities (both are whole)
 
 	// phiN1 = phiHatN1 + (phiN - phiHatN) / 2
 	const int border = 0; 
@@ -419,10 +425,10 @@ void FLUID_3D::advectFieldMacCormack2(const float dt, const float* xVelocity, co
 	copyBorderZ(phiN1, res, zBegin, zEnd);
 
 	// clamp any newly created extrema
-	clampExtrema(dt, xVelocity, yVelocity, zVelocity, oldField, newField, res, zBegin, zEnd);		// uses wide data from old field and velocities (both are whole)
+	clampExtrema(dt, xVelocity, yVelocity, zVelocity, oldField, newField, res, zBegin, zEnd, blocks);		// uses wide data from old field and velocities (both are whole)
 
 	// if the error estimate was bad, revert to first order
-	clampOutsideRays(dt, xVelocity, yVelocity, zVelocity, oldField, newField, res, obstacles, phiHatN, zBegin, zEnd);	// phiHatN is only used at cells within thread range, so its ok
+	clampOutsideRays(dt, xVelocity, yVelocity, zVelocity, oldField, newField, res, obstacles, phiHatN, zBegin, zEnd, blocks);	// phiHatN is only used at cells within thread range, so its ok
 
 } 
 
@@ -431,7 +437,7 @@ void FLUID_3D::advectFieldMacCormack2(const float dt, const float* xVelocity, co
 // Clamp the extrema generated by the BFECC error correction
 //////////////////////////////////////////////////////////////////////
 void FLUID_3D::clampExtrema(const float dt, const float* velx, const float* vely,  const float* velz,
-		float* oldField, float* newField, Vec3Int res, int zBegin, int zEnd)
+		float* oldField, float* newField, Vec3Int res, int zBegin, int zEnd, const SPARSE_BLOCKS *blocks)
 {
 	const int xres= res[0];
 	const int yres= res[1];
@@ -450,6 +456,10 @@ void FLUID_3D::clampExtrema(const float dt, const float* velx, const float* vely
 			for (int x = 1; x < xres-1; x++)
 			{
 				const int index = x + y * xres+ z * xres*yres;
+
+				// keeps the old value from the first advection pass
+				if (blocks && !blocks->isActive(x, y, z)) continue;
+
 				// backtrace
 				float xTrace = x - dt * velx[index];
 				float yTrace = y - dt * vely[index];
@@ -515,7 +525,8 @@ void FLUID_3D::clampExtrema(const float dt, const float* velx, const float* vely
 // incorrect
 //////////////////////////////////////////////////////////////////////
 void FLUID_3D::clampOutsideRays(const float dt, const float* velx, const float* vely,  const float* velz,
-				float* oldField, float* newField, Vec3Int res, const unsigned char* obstacles, const float *oldAdvection, int zBegin, int zEnd)
+				float* oldField, float* newField, Vec3Int res, const unsigned char* obstacles, const float *oldAdvection, int zBegin, int zEnd,
+				const SPARSE_BLOCKS *blocks)
 {
 	const int sx= res[0];
 	const int sy= res[1];
@@ -533,6 +544,10 @@ void FLUID_3D::clampOutsideRays(const float dt, const float* velx, const float*
 			for (int x = 1; x < sx-1; x++)
 			{
 				const int index = x + y * sx+ z * slabSize;
+
+				// keeps the old value from the first advection pass
+				if (blocks && !blocks->isActive(x, y, z)) continue;
+
 				// backtrace
 				float xBackward = x + dt * velx[index];
 				float yBackward = y + dt * vely[index];
@@ -0,0 +1,132 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2016 Blender Foundation.
+ * All rights reserved.
+ *
+ * Contributor(s): none yet.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file smoke/intern/SPARSE_BLOCKS.cpp
+ *  \ingroup smoke
+ */
+
+#include "SPARSE_BLOCKS.h"
+
+#include <cmath>
+#include <cstring>
+
+SPARSE_BLOCKS::SPARSE_BLOCKS(Vec3Int res) :
+	_res(res)
+{
+	for (int i = 0; i < 3; i++)
+		_blockRes[i] = (res[i] + SPARSE_BLOCK_SIZE - 1) >> SPARSE_BLOCK_SHIFT;
+
+	_blockSlabSize = _blockRes[0] * _blockRes[1];
+	_totalBlocks = (size_t)_blockSlabSize * _blockRes[2];
+
+	_active = new unsigned char[_totalBlocks];
+	_activeTemp = new unsigned char[_totalBlocks];
+
+	// everything is active until the first pass
+	memset(_active, 1, sizeof(unsigned char) * _totalBlocks);
+	_totalActive = _totalBlocks;
+}
+
+SPARSE_BLOCKS::~SPARSE_BLOCKS()
+{
+	delete[] _active;
+	delete[] _activeTemp;
+}
+
+void SPARSE_BLOCKS::markSlab(const float *const *fields, int numFields, int bz, float threshold)
+{
+	unsigned char *slab = _active + (size_t)bz * _blockSlabSize;
+	const int zBegin = bz << SPARSE_BLOCK_SHIFT;
+	const int zEnd = (zBegin + SPARSE_BLOCK_SIZE < _res[2]) ? zBegin + SPARSE_BLOCK_SIZE : _res[2];
+	const size_t slabSize = (size_t)_res[0] * _res[1];
+
+	memset(slab, 0, sizeof(unsigned char) * _blockSlabSize);
+
+	for (int f = 0; f < numFields; f++)
+	{
+		const float *field = fields[f];
+
+		if (!field)
+			continue;
+
+		for (int z = zBegin; z < zEnd; z++)
+			for (int y = 0; y < _res[1]; y++)
+			{
+				unsigned char *row = slab + (y >> SPARSE_BLOCK_SHIFT) * _blockRes[0];
+				const float *line = field + z * slabSize + (size_t)y * _res[0];
+
+				for (int bx = 0; bx < _blockRes[0]; bx++)
+				{
+					// already known to be active, no need to look at the cells
+					if (row[bx])
+						continue;
+
+					const int xBegin = bx << SPARSE_BLOCK_SHIFT;
+					const int xEnd = (xBegin + SPARSE_BLOCK_SIZE < _res[0]) ? xBegin + SPARSE_BLOCK_SIZE : _res[0];
+
+					for (int x = xBegin; x < xEnd; x++)
+						if (fabsf(line[x]) > threshold) {
+							row[bx] = 1;
+							break;
+						}
+				}
+			}
+	}
+}
+
+void SPARSE_BLOCKS::dilate(float cells)
+{
+	// a block is kept if any cell within reach could be non-empty
+	const int margin = (int)ceilf(cells / SPARSE_BLOCK_SIZE);
+
+	// separable dilation, one axis at a time
+	for (int axis = 0; axis < 3 && margin > 0; axis++)
+	{
+		const int stride = (axis == 0) ? 1 : (axis == 1) ? _blockRes[0] : _blockSlabSize;
+
+		memcpy(_activeTemp, _active, sizeof(unsigned char) * _totalBlocks);
+
+		for (int bz = 0; bz < _blockRes[2]; bz++)
+			for (int by = 0; by < _blockRes[1]; by++)
+				for (int bx = 0; bx < _blockRes[0]; bx++)
+				{
+					const int coord[3] = {bx, by, bz};
+					const size_t index = bx + by * _blockRes[0] + (size_t)bz * _blockSlabSize;
+
+					if (!_activeTemp[index])
+						continue;
+
+					const int begin = (coord[axis] - margin < 0) ? 0 : coord[axis] - margin;
+					const int end = (coord[axis] + margin >= _blockRes[axis]) ? _blockRes[axis] - 1 : coord[axis] + margin;
+
+					for (int i = begin; i <= end; i++)
+						_active[index + (i - coord[axis]) * stride] = 1;
+				}
+	}
+
+	_totalActive = 0;
+	for (size_t i = 0; i < _totalBlocks; i++)
+		_totalActive += _active[i];
+}
@@ -0,0 +1,87 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2016 Blender Foundation.
+ * All rights reserved.
+ *
+ * Contributor(s): none yet.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file smoke/intern/SPARSE_BLOCKS.h
+ *  \ingroup smoke
+ */
+
+//////////////////////////////////////////////////////////////////////
+// Tracks which 8^3 blocks of a grid contain smoke, heat or fire, so
+// that scalar fields only need to be advected close to where they
+// are non-empty. Empty blocks keep their previous values.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef SPARSE_BLOCKS_H
+#define SPARSE_BLOCKS_H
+
+#include <cstddef>
+
+#include "VEC3.h"
+
+using namespace BasicVector;
+
+#define SPARSE_BLOCK_SHIFT 3
+#define SPARSE_BLOCK_SIZE (1 << SPARSE_BLOCK_SHIFT)
+
+// field values at or below this are treated as empty
+#define SPARSE_BLOCK_THRESHOLD 1e-4f
+
+struct SPARSE_BLOCKS
+{
+	public:
+		SPARSE_BLOCKS(Vec3Int res);
+		virtual ~SPARSE_BLOCKS();
+
+		// start a new activity pass for one z-slab of blocks: only the blocks in
+		// which any of the fields has a value above the threshold are active.
+		// NULL fields are skipped, different slabs can be marked in parallel
+		void markSlab(const float *const *fields, int numFields, int bz,
+		              float threshold = SPARSE_BLOCK_THRESHOLD);
+
+		// grow the active region by the given number of cells in all directions,
+		// and update the active block count
+		void dilate(float cells);
+
+		inline bool isActive(int x, int y, int z) const {
+			return _active[(x >> SPARSE_BLOCK_SHIFT) +
+			               (y >> SPARSE_BLOCK_SHIFT) * _blockRes[0] +
+			               (z >> SPARSE_BLOCK_SHIFT) * _blockSlabSize] != 0;
+		}
+
+		// fraction of blocks which are active
+		float activeFraction() const { return (float)_totalActive / (float)_totalBlocks; }
+
+	public:
+		Vec3Int _res;
+		int _blockRes[3];
+		int _blockSlabSize;
+		size_t _totalBlocks;
+		size_t _totalActive;
+
+		unsigned char *_active;
+		unsigned char *_activeTemp;
+};
+
+#endif
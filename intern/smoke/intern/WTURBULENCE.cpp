@@ -27,6 +27,7 @@
 //////////////////////////////////////////////////////////////////////
 
 #include "WTURBULENCE.h"
+#include "SPARSE_BLOCKS.h"
 #include "INTERPOLATE.h"
 #include "IMAGE.h"
 #include <MERSENNETWISTER.h>
@@ -56,6 +57,8 @@ WTURBULENCE::WTURBULENCE(int xResSm, int yResSm, int zResSm, int amplify, int no
 	// if noise magnitude is below this threshold, its contribution
 	// is negilgible, so stop evaluating new octaves
 	_cullingThreshold = 1e-3;
+
+	_activeBlocksBig = NULL;
 	
 	// factor by which to increase the simulation resolution
 	_amplify = amplify;
@@ -178,6 +181,8 @@ void WTURBULENCE::initColors(float init_r, float init_g, float init_b)
 // destructor
 //////////////////////////////////////////////////////////////////////
 WTURBULENCE::~WTURBULENCE() {
+  if (_activeBlocksBig) delete _activeBlocksBig;
+
   delete[] _densityBig;
   delete[] _densityBigOld;
   if (_flameBig) delete[] _flameBig;
@@ -233,6 +238,18 @@ void WTURBULENCE::setNoise(int type, const char *noisefile_path)
 	generateTile_WAVELET(_noiseTile, noiseTileFilename);
 }
 
+// sparse advection of the big grids, see SPARSE_BLOCKS
+void WTURBULENCE::setSparse(bool useSparse)
+{
+	if (useSparse && !_activeBlocksBig) {
+		_activeBlocksBig = new SPARSE_BLOCKS(_resBig);
+	}
+	else if (!useSparse && _activeBlocksBig) {
+		delete _activeBlocksBig;
+		_activeBlocksBig = NULL;
+	}
+}
+
 // init direct access functions from blender
 void WTURBULENCE::initBlenderRNA(float *strength)
 {
@@ -1084,6 +1101,20 @@ void WTURBULENCE::stepTurbulenceFull(float dtOrg, float* xvel, float* yvel, floa
   // do the MacCormack advection, with substepping if necessary
   for(int substep = 0; substep < totalSubsteps; substep++)
   {
+	if (_activeBlocksBig) {
+		const float *fields[] = {_densityBigOld, _fuelBigOld, _reactBigOld,
+		                         _color_rBigOld, _color_gBigOld, _color_bBigOld};
+		const int numFields = sizeof(fields) / sizeof(fields[0]);
+
+#if PARALLEL==1
+		#pragma omp parallel for schedule(static)
+#endif
+		for (int bz = 0; bz < _activeBlocksBig->_blockRes[2]; bz++)
+			_activeBlocksBig->markSlab(fields, numFields, bz);
+
+		// forward and backward trace of one substep, plus the interpolation stencil
+		_activeBlocksBig->dilate(2.0f * maxVelMag / totalSubsteps + 2.0f);
+	}
 
 #if PARALLEL==1
 	#pragma omp parallel
@@ -1096,20 +1127,20 @@ void WTURBULENCE::stepTurbulenceFull(float dtOrg, float* xvel, float* yvel, floa
 		int zEnd = (int)((float)(i+1)*partSize + 0.5f);
 #endif
 		FLUID_3D::advectFieldMacCormack1(dtSubdiv, bigUx, bigUy, bigUz, 
-		    _densityBigOld, tempDensityBig, _resBig, zBegin, zEnd);
+		    _densityBigOld, tempDensityBig, _resBig, zBegin, zEnd, _activeBlocksBig);
 		if (_fuelBig) {
 			FLUID_3D::advectFieldMacCormack1(dtSubdiv, bigUx, bigUy, bigUz, 
-				_fuelBigOld, tempFuelBig, _resBig, zBegin, zEnd);
+				_fuelBigOld, tempFuelBig, _resBig, zBegin, zEnd, _activeBlocksBig);
 			FLUID_3D::advectFieldMacCormack1(dtSubdiv, bigUx, bigUy, bigUz, 
-				_reactBigOld, tempReactBig, _resBig, zBegin, zEnd);
+				_reactBigOld, tempReactBig, _resBig, zBegin, zEnd, _activeBlocksBig);
 		}
 		if (_color_rBig) {
 			FLUID_3D::advectFieldMacCormack1(dtSubdiv, bigUx, bigUy, bigUz, 
-				_color_rBigOld, tempColor_rBig, _resBig, zBegin, zEnd);
+				_color_rBigOld, tempColor_rBig, _resBig, zBegin, zEnd, _activeBlocksBig);
 			FLUID_3D::advectFieldMacCormack1(dtSubdiv, bigUx, bigUy, bigUz, 
-				_color_gBigOld, tempColor_gBig, _resBig, zBegin, zEnd);
+				_color_gBigOld, tempColor_gBig, _resBig, zBegin, zEnd, _activeBlocksBig);
 			FLUID_3D::advectFieldMacCormack1(dtSubdiv, bigUx, bigUy, bigUz, 
-				_color_bBigOld, tempColor_bBig, _resBig, zBegin, zEnd);
+				_color_bBigOld, tempColor_bBig, _resBig, zBegin, zEnd, _activeBlocksBig);
 		}
 #if PARALLEL==1
 	}
@@ -1123,20 +1154,20 @@ void WTURBULENCE::stepTurbulenceFull(float dtOrg, float* xvel, float* yvel, floa
 		int zEnd = (int)((float)(i+1)*partSize + 0.5f);
 #endif
 		FLUID_3D::advectFieldMacCormack2(dtSubdiv, bigUx, bigUy, bigUz, 
-		    _densityBigOld, _densityBig, tempDensityBig, tempBig, _resBig, NULL, zBegin, zEnd);
+		    _densityBigOld, _densityBig, tempDensityBig, tempBig, _resBig, NULL, zBegin, zEnd, _activeBlocksBig);
 		if (_fuelBig) {
 			FLUID_3D::advectFieldMacCormack2(dtSubdiv, bigUx, bigUy, bigUz, 
-				_fuelBigOld, _fuelBig, tempFuelBig, tempBig, _resBig, NULL, zBegin, zEnd);
+				_fuelBigOld, _fuelBig, tempFuelBig, tempBig, _resBig, NULL, zBegin, zEnd, _activeBlocksBig);
 			FLUID_3D::advectFieldMacCormack2(dtSubdiv, bigUx, bigUy, bigUz, 
-				_reactBigOld, _reactBig, tempReactBig, tempBig, _resBig, NULL, zBegin, zEnd);
+				_reactBigOld, _reactBig, tempReactBig, tempBig, _resBig, NULL, zBegin, zEnd, _activeBlocksBig);
 		}
 		if (_color_rBig) {
 			FLUID_3D::advectFieldMacCormack2(dtSubdiv, bigUx, bigUy, bigUz, 
-				_color_rBigOld, _color_rBig, tempColor_rBig, tempBig, _resBig, NULL, zBegin, zEnd);
+				_color_rBigOld, _color_rBig, tempColor_rBig, tempBig, _resBig, NULL, zBegin, zEnd, _activeBlocksBig);
 			FLUID_3D::advectFieldMacCormack2(dtSubdiv, bigUx, bigUy, bigUz, 
-				_color_gBigOld, _color_gBig, tempColor_gBig, tempBig, _resBig, NULL, zBegin, zEnd);
+				_color_gBigOld, _color_gBig, tempColor_gBig, tempBig, _resBig, NULL, zBegin, zEnd, _activeBlocksBig);
 			FLUID_3D::advectFieldMacCormack2(dtSubdiv, bigUx, bigUy, bigUz, 
-				_color_bBigOld, _color_bBig, tempColor_bBig, tempBig, _resBig, NULL, zBegin, zEnd);
+				_color_bBigOld, _color_bBig, tempColor_bBig, tempBig, _resBig, NULL, zBegin, zEnd, _activeBlocksBig);
 		}
 #if PARALLEL==1
 	}
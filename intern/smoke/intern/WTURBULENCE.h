@@ -28,6 +28,7 @@
 #include "VEC3.h"
 using namespace BasicVector;
 class SIMPLE_PARSER;
+struct SPARSE_BLOCKS;
 
 ///////////////////////////////////////////////////////////////////////////////
 /// Main WTURBULENCE class, stores large density array etc.
@@ -47,6 +48,9 @@ struct WTURBULENCE
 		void setNoise(int type, const char *noisefile_path);
 		void initBlenderRNA(float *strength);
 
+		// only advect the big grids close to where they are non-empty
+		void setSparse(bool useSparse);
+
 		// step more readable version -- no rotation correction
 		void stepTurbulenceReadable(float dt, float* xvel, float* yvel, float* zvel, unsigned char *obstacles);
 
@@ -141,6 +145,9 @@ struct WTURBULENCE
 
 		// step counter
 		int _totalStepsBig;
+
+		// blocks of the big grid which are advected, NULL when sparse advection is off
+		SPARSE_BLOCKS *_activeBlocksBig;
 		
 		void computeEigenvalues(float *_eigMin, float *_eigMax);
 		void decomposeEnergy(float *energy, float *_highFreqEnergy);
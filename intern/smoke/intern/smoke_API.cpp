@@ -448,6 +448,16 @@ extern "C" void smoke_turbulence_set_noise(WTURBULENCE *wt, int type, const char
 	wt->setNoise(type, noisefile_path);
 }
 
+extern "C" void smoke_turbulence_set_sparse(WTURBULENCE *wt, int use_sparse)
+{
+	wt->setSparse(use_sparse != 0);
+}
+
+extern "C" void smoke_set_sparse(FLUID_3D *fluid, int use_sparse)
+{
+	fluid->setSparse(use_sparse != 0);
+}
+
 extern "C" int smoke_has_heat(FLUID_3D *fluid)
 {
 	return (fluid->_heat) ? 1 : 0;
@@ -68,6 +68,7 @@ class PHYSICS_PT_smoke(PhysicButtonsPanel, Panel):
             col.prop(domain, "time_scale", text="Scale")
             col.label(text="Border Collisions:")
             col.prop(domain, "collision_extents", text="")
+            col.prop(domain, "use_sparse_blocks")
 
             col = split.column()
             col.label(text="Behavior:")
@@ -316,6 +317,7 @@ class PHYSICS_PT_smoke_cache(PhysicButtonsPanel, Panel):
         layout = self.layout
 
         domain = context.smoke.domain_settings
+        cache = domain.point_cache
         cache_file_format = domain.cache_file_format
 
         layout.prop(domain, "cache_file_format")
@@ -323,6 +325,9 @@ class PHYSICS_PT_smoke_cache(PhysicButtonsPanel, Panel):
         if cache_file_format == 'POINTCACHE':
             layout.label(text="Compression:")
             layout.prop(domain, "point_cache_compress_type", expand=True)
+            row = layout.row()
+            row.enabled = not cache.is_baked
+            row.prop(cache, "use_disk_cache_single_file")
         elif cache_file_format == 'OPENVDB':
             if not bpy.app.build_options.openvdb:
                 layout.label("Built without OpenVDB support")
@@ -334,7 +339,6 @@ class PHYSICS_PT_smoke_cache(PhysicButtonsPanel, Panel):
             row.label("Data Depth:")
             row.prop(domain, "data_depth", expand=True, text="Data Depth")
 
-        cache = domain.point_cache
         point_cache_ui(self, context, cache, (cache.is_baked is False), 'SMOKE')
 
 
@@ -365,6 +365,7 @@ class SCENE_PT_rigid_body_world(SceneButtonsPanel, Panel):
             col = split.column()
             col.prop(rbw, "time_scale", text="Speed")
             col.prop(rbw, "use_split_impulse")
+            col.prop(rbw, "use_multithreading")
 
             col = split.column()
             col.prop(rbw, "steps_per_second", text="Steps Per Second")
@@ -489,10 +489,20 @@ class USERPREF_PT_system(Panel):
         col.separator()
 
         col.label(text="Sequencer/Clip Editor:")
-        # currently disabled in the code
-        # col.prop(system, "prefetch_frames")
+        col.prop(system, "prefetch_frames")
         col.prop(system, "memory_cache_limit")
 
+        col.label(text="Sequencer Disk Cache:")
+        col.prop(system, "sequencer_disk_cache_dir", text="")
+        sub = col.column(align=True)
+        sub.prop(system, "sequencer_disk_cache_size_limit", text="Limit")
+        sub.prop(system, "sequencer_disk_cache_compression", text="Compression")
+
+        col.separator()
+
+        col.label(text="Modifiers:")
+        col.prop(system, "modifier_cache_limit", text="Cache Limit")
+
         # 3. Column
         column = split.column()
 
@@ -32,10 +32,13 @@
  *  \ingroup bke
  */
 
-struct Object;
-struct Scene;
+struct DerivedMesh;
+struct FluidVertexVelocity;
 struct FluidsimSettings;
+struct MPoly;
 struct MVert;
+struct Object;
+struct Scene;
 
 /* old interface */
 
@@ -50,5 +53,13 @@ void fluid_get_bb(struct MVert *mvert, int totvert, float obmat[4][4],
 
 void fluid_estimate_memory(struct Object *ob, struct FluidsimSettings *fss, char *value);
 
+/* baked surface sequences */
+struct DerivedMesh *BKE_fluidsim_meshseq_read(
+        const char *filepath, int frame, const struct MPoly *mp_example,
+        struct FluidVertexVelocity **r_velocities);
+int BKE_fluidsim_meshseq_last_frame(const char *filepath);
+void BKE_fluidsim_meshseq_forget(const char *filepath);
+void BKE_fluidsim_meshseq_exit(void);
+
 #endif
 
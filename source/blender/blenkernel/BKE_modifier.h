@@ -103,6 +103,11 @@ typedef enum {
 	/* For modifiers that use CD_PREVIEW_MCOL for preview. */
 	eModifierTypeFlag_UsesPreview = (1 << 9),
 	eModifierTypeFlag_AcceptsLattice = (1 << 10),
+
+	/* For modifiers whose result only depends on the input mesh, the settings stored in the
+	 * modifier itself and linked mesh objects, so it can be reused from the modifier result
+	 * cache (see BKE_modifier_cache.h). */
+	eModifierTypeFlag_SupportsResultCache = (1 << 11),
 } ModifierTypeFlag;
 
 /* IMPORTANT! Keep ObjectWalkFunc and IDWalkFunc signatures compatible. */
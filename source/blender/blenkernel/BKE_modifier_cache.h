@@ -0,0 +1,86 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2016 Blender Foundation.
+ * All rights reserved.
+ *
+ * Contributor(s): none yet.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+#ifndef __BKE_MODIFIER_CACHE_H__
+#define __BKE_MODIFIER_CACHE_H__
+
+/** \file BKE_modifier_cache.h
+ *  \ingroup bke
+ *
+ * Cache of intermediate modifier stack results.
+ *
+ * Results of constructive modifiers are stored per modifier, keyed by a hash
+ * of everything the result depends on (input mesh, deformed coordinates,
+ * modifier settings, ...), so evaluation of the stack can restart from the
+ * first modifier whose input actually changed.
+ */
+
+#include "BKE_customdata.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct DerivedMesh;
+struct Mesh;
+struct ModifierData;
+struct Object;
+
+typedef struct ModifierCacheKey {
+	unsigned int hash[2];
+} ModifierCacheKey;
+
+typedef struct ModifierCacheEntry ModifierCacheEntry;
+
+void BKE_modifier_cache_init(void);
+void BKE_modifier_cache_exit(void);
+
+void BKE_modifier_cache_clear(void);
+void BKE_modifier_cache_discard(struct ModifierData *md);
+size_t BKE_modifier_cache_memory_in_use(void);
+
+bool BKE_modifier_cache_is_enabled(void);
+bool BKE_modifier_cache_supports(struct ModifierData *md);
+
+/* Key building. */
+void BKE_modifier_cache_key_mesh(ModifierCacheKey *r_key, struct Object *ob, struct Mesh *me);
+bool BKE_modifier_cache_key_modifier(
+        ModifierCacheKey *r_key, const ModifierCacheKey *input,
+        struct Object *ob, struct ModifierData *md,
+        float (*deformedVerts)[3], int numVerts,
+        CustomDataMask mask, CustomDataMask nextmask, int app_flags);
+
+/* Lookup and storage. */
+ModifierCacheEntry *BKE_modifier_cache_acquire(struct ModifierData *md, const ModifierCacheKey *key);
+struct DerivedMesh *BKE_modifier_cache_entry_copy(ModifierCacheEntry *entry);
+void BKE_modifier_cache_release(ModifierCacheEntry *entry);
+void BKE_modifier_cache_store(
+        struct ModifierData *md, const ModifierCacheKey *key, struct DerivedMesh *dm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __BKE_MODIFIER_CACHE_H__ */
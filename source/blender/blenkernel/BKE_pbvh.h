@@ -223,6 +223,11 @@ float *BKE_pbvh_node_layer_disp_get(PBVH *pbvh, PBVHNode *node);
 /* If the node has a displacement layer, free it and set to null */
 void BKE_pbvh_node_layer_disp_free(PBVHNode *node);
 
+/* Undo data, lets threads pushing undo for different nodes work without locking */
+void *BKE_pbvh_node_undo_data_get(PBVHNode *node);
+void *BKE_pbvh_node_undo_data_set_if_unset(PBVHNode *node, void *undo_data);
+void BKE_pbvh_node_undo_data_clear(PBVHNode *node);
+
 /* vertex deformer */
 float (*BKE_pbvh_get_vertCos(struct PBVH *pbvh))[3];
 void BKE_pbvh_apply_vertCos(struct PBVH *pbvh, float (*vertCos)[3]);
@@ -53,6 +53,8 @@
 
 /* Add the blendfile name after blendcache_ */
 #define PTCACHE_EXT ".bphys"
+/* All frames in one file, see PTCACHE_DISK_SINGLE_FILE */
+#define PTCACHE_CONTAINER_EXT ".bpcache"
 #define PTCACHE_PATH "blendcache_"
 
 /* File open options, for BKE_ptcache_file_open */
@@ -112,6 +114,12 @@ typedef struct PTCacheData {
 typedef struct PTCacheFile {
 	FILE *fp;
 
+	/* frame data in memory instead of fp, for single file caches */
+	struct PTCacheContainer *container;
+	unsigned char *mem;
+	size_t mem_len, mem_alloc, mem_pos;
+	int mem_compression;
+
 	int frame, old_format;
 	unsigned int totpoint, type;
 	unsigned int data_types, flag;
@@ -280,6 +288,7 @@ void BKE_ptcache_ids_from_object(struct ListBase *lb, struct Object *ob, struct
 
 /***************** Global funcs ****************************/
 void BKE_ptcache_remove(void);
+void BKE_ptcache_container_exit(void);
 
 /************ ID specific functions ************************/
 void    BKE_ptcache_id_clear(PTCacheID *id, int mode, unsigned int cfra);
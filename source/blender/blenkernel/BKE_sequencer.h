@@ -102,6 +102,8 @@ typedef struct SeqRenderData {
 	float motion_blur_shutter;
 	bool skip_cache;
 	bool is_proxy_render;
+	/* look-ahead render, must not push other frames out of the cache */
+	bool is_prefetch_render;
 	int view_id;
 
 	/* special case for OpenGL render */
@@ -187,10 +189,13 @@ struct SeqEffectHandle {
  * ********************************************************************** */
 
 struct ImBuf *BKE_sequencer_give_ibuf(const SeqRenderData *context, float cfra, int chanshown);
-struct ImBuf *BKE_sequencer_give_ibuf_threaded(const SeqRenderData *context, float cfra, int chanshown);
+struct ImBuf *BKE_sequencer_give_ibuf_threaded(const SeqRenderData *context, float cfra, int chanshown, int prefetch_frames);
 struct ImBuf *BKE_sequencer_give_ibuf_direct(const SeqRenderData *context, float cfra, struct Sequence *seq);
 struct ImBuf *BKE_sequencer_give_ibuf_seqbase(const SeqRenderData *context, float cfra, int chan_shown, struct ListBase *seqbasep);
-void BKE_sequencer_give_ibuf_prefetch_request(const SeqRenderData *context, float cfra, int chan_shown);
+/* stop rendering frames ahead in the background,
+ * needed before strips are changed or freed */
+void BKE_sequencer_prefetch_stop(void);
+void BKE_sequencer_prefetch_free(void);
 
 /* **********************************************************************
  * sequencer.c
@@ -243,6 +248,7 @@ void BKE_sequence_calc_disp(struct Scene *scene, struct Sequence *seq);
 void BKE_sequence_reload_new_file(struct Scene *scene, struct Sequence *seq, const bool lock_range);
 int BKE_sequencer_evaluate_frame(struct Scene *scene, int cfra);
 
+float BKE_sequencer_give_stripelem_index(struct Sequence *seq, float cfra);
 struct StripElem *BKE_sequencer_give_stripelem(struct Sequence *seq, int cfra);
 
 /* intern */
@@ -251,7 +257,9 @@ bool BKE_sequencer_input_have_to_preprocess(const SeqRenderData *context, struct
 
 void BKE_sequencer_proxy_rebuild_context(struct Main *bmain, struct Scene *scene, struct Sequence *seq, struct GSet *file_list, ListBase *queue);
 void BKE_sequencer_proxy_rebuild(struct SeqIndexBuildContext *context, short *stop, short *do_update, float *progress);
+bool BKE_sequencer_proxy_rebuild_is_threadsafe(struct SeqIndexBuildContext *context);
 void BKE_sequencer_proxy_rebuild_finish(struct SeqIndexBuildContext *context, bool stop);
+bool BKE_sequencer_proxy_filepath_get(const SeqRenderData *context, struct Sequence *seq, int cfra, char *filepath);
 
 void BKE_sequencer_proxy_set(struct Sequence *seq, bool value);
 /* **********************************************************************
@@ -269,6 +277,7 @@ typedef enum {
 
 void BKE_sequencer_cache_destruct(void);
 void BKE_sequencer_cache_cleanup(void);
+void BKE_sequencer_disk_cache_init(void);
 
 /* returned ImBuf is properly refed and has to be freed */
 struct ImBuf *BKE_sequencer_cache_get(const SeqRenderData *context, struct Sequence *seq, float cfra, eSeqStripElemIBuf type);
@@ -306,6 +306,7 @@ CCGSubSurf *ccgSubSurf_new(CCGMeshIFC *ifc, int subdivLevels, CCGAllocatorIFC *a
 
 #ifdef WITH_OPENSUBDIV
 		ss->osd_evaluator = NULL;
+		memset(&ss->osd_evaluator_key, 0, sizeof(ss->osd_evaluator_key));
 		ss->osd_mesh = NULL;
 		ss->osd_topology_refiner = NULL;
 		ss->osd_mesh_invalid = false;
@@ -329,8 +330,9 @@ void ccgSubSurf_free(CCGSubSurf *ss)
 	CCGAllocatorHDL allocator = ss->allocator;
 #ifdef WITH_OPENSUBDIV
 	if (ss->osd_evaluator != NULL) {
-		openSubdiv_deleteEvaluatorDescr(ss->osd_evaluator);
+		ccgSubSurf__evaluator_cache_push(ss->osd_evaluator, &ss->osd_evaluator_key);
 	}
+	ccgSubSurf_topology_key_free(&ss->osd_evaluator_key);
 	if (ss->osd_mesh != NULL) {
 		ccgSubSurf__delete_osdGLMesh(ss->osd_mesh);
 	}
@@ -166,6 +166,13 @@ typedef enum {
 #endif
 } SyncState;
 
+/* Everything an OpenSubdiv topology refiner is built from. */
+typedef struct CCGTopologyKey {
+	int *data;
+	int len;
+	unsigned int hash;
+} CCGTopologyKey;
+
 struct CCGSubSurf {
 	EHash *vMap;   /* map of CCGVertHDL -> Vert */
 	EHash *eMap;   /* map of CCGEdgeHDL -> Edge */
@@ -250,6 +257,8 @@ struct CCGSubSurf {
 
 	/* Limit evaluator, used to evaluate CCG. */
 	struct OpenSubdiv_EvaluatorDescr *osd_evaluator;
+	/* Topology and subdivision level osd_evaluator was created for. */
+	CCGTopologyKey osd_evaluator_key;
 	/* Next PTex face index, used while CCG synchronization
 	 * to fill in PTex index of CCGFace.
 	 */
@@ -308,6 +317,12 @@ void ccgSubSurf__sync_opensubdiv(CCGSubSurf *ss);
 void ccgSubSurf__delete_osdGLMesh(struct OpenSubdiv_GLMesh *osd_mesh);
 void ccgSubSurf__delete_vertex_array(unsigned int vao);
 void ccgSubSurf__delete_pending(void);
+
+/* Evaluators are kept around after the CCGSubSurf is freed, so they could
+ * be re-used by the next CCGSubSurf with the same topology.
+ */
+void ccgSubSurf__evaluator_cache_push(struct OpenSubdiv_EvaluatorDescr *evaluator,
+                                      CCGTopologyKey *topology_key);
 #endif
 
 /* * CCGSubSurf_opensubdiv_converter.c * */
@@ -326,6 +341,14 @@ void ccgSubSurf_converter_setup_from_ccg(
 void ccgSubSurf_converter_free(
         struct OpenSubdiv_Converter *converter);
 
+void ccgSubSurf_converter_topology_key(
+        const struct OpenSubdiv_Converter *converter,
+        int level,
+        CCGTopologyKey *r_key);
+
+bool ccgSubSurf_topology_key_equals(const CCGTopologyKey *a, const CCGTopologyKey *b);
+void ccgSubSurf_topology_key_free(CCGTopologyKey *key);
+
 /* * CCGSubSurf_util.c * */
 
 #ifdef DUMP_RESULT_GRIDS
@@ -24,6 +24,8 @@
 
 #ifdef WITH_OPENSUBDIV
 
+#include <string.h>
+
 #include "MEM_guardedalloc.h"
 #include "BLI_sys_types.h" // for intptr_t support
 
@@ -203,6 +205,7 @@ void ccgSubSurf_checkTopologyChanged(CCGSubSurf *ss, DerivedMesh *dm)
 			openSubdiv_deleteEvaluatorDescr(ss->osd_evaluator);
 			ss->osd_evaluator = NULL;
 		}
+		ccgSubSurf_topology_key_free(&ss->osd_evaluator_key);
 	}
 }
 
@@ -445,15 +448,118 @@ void ccgSubSurf_evaluatorFVarUV(CCGSubSurf *ss,
 	zero_v2(uv);
 }
 
+/* ** Evaluator cache ** */
+
+/* Creating an evaluator means refining the whole topology and building
+ * stencil and patch tables from it, which is much more expensive than the
+ * evaluation itself. None of this depends on the coarse coordinates, so
+ * instead of being freed together with the CCGSubSurf, evaluators are kept
+ * here for a while and given to the next CCGSubSurf with the same topology.
+ *
+ * This way deforming-only animation only refines coarse positions every
+ * frame, even for renders which don't keep CCGSubSurf between frames.
+ */
+
+#define OSD_EVALUATOR_CACHE_MAX_ITEMS 8
+
+typedef struct OsdEvaluatorCacheItem {
+	struct OsdEvaluatorCacheItem *next, *prev;
+	OpenSubdiv_EvaluatorDescr *evaluator;
+	CCGTopologyKey topology_key;
+} OsdEvaluatorCacheItem;
+
+static SpinLock evaluator_cache_spin;
+static ListBase evaluator_cache = {NULL, NULL};
+static int evaluator_cache_len = 0;
+
+/* Takes ownership of the evaluator and the topology key data. */
+void ccgSubSurf__evaluator_cache_push(OpenSubdiv_EvaluatorDescr *evaluator,
+                                      CCGTopologyKey *topology_key)
+{
+	OsdEvaluatorCacheItem *item = MEM_mallocN(sizeof(OsdEvaluatorCacheItem),
+	                                          "opensubdiv evaluator cache item");
+	OsdEvaluatorCacheItem *evicted = NULL;
+	item->evaluator = evaluator;
+	item->topology_key = *topology_key;
+	memset(topology_key, 0, sizeof(*topology_key));
+
+	BLI_spin_lock(&evaluator_cache_spin);
+	BLI_addhead(&evaluator_cache, item);
+	if (evaluator_cache_len == OSD_EVALUATOR_CACHE_MAX_ITEMS) {
+		evicted = evaluator_cache.last;
+		BLI_remlink(&evaluator_cache, evicted);
+	}
+	else {
+		evaluator_cache_len++;
+	}
+	BLI_spin_unlock(&evaluator_cache_spin);
+
+	/* Evaluator is freed outside of the lock, it might take a while. */
+	if (evicted != NULL) {
+		openSubdiv_deleteEvaluatorDescr(evicted->evaluator);
+		ccgSubSurf_topology_key_free(&evicted->topology_key);
+		MEM_freeN(evicted);
+	}
+}
+
+/* Full key comparison, a hash collision must never give an evaluator built
+ * for another topology. */
+static OpenSubdiv_EvaluatorDescr *opensubdiv_evaluatorCachePop(const CCGTopologyKey *topology_key)
+{
+	OsdEvaluatorCacheItem *item;
+	OpenSubdiv_EvaluatorDescr *evaluator = NULL;
+
+	BLI_spin_lock(&evaluator_cache_spin);
+	for (item = evaluator_cache.first; item != NULL; item = item->next) {
+		if (ccgSubSurf_topology_key_equals(&item->topology_key, topology_key)) {
+			BLI_remlink(&evaluator_cache, item);
+			evaluator_cache_len--;
+			break;
+		}
+	}
+	BLI_spin_unlock(&evaluator_cache_spin);
+
+	if (item != NULL) {
+		evaluator = item->evaluator;
+		ccgSubSurf_topology_key_free(&item->topology_key);
+		MEM_freeN(item);
+	}
+	return evaluator;
+}
+
+static void opensubdiv_evaluatorCacheClear(void)
+{
+	OsdEvaluatorCacheItem *item;
+	BLI_spin_lock(&evaluator_cache_spin);
+	for (item = evaluator_cache.first; item != NULL; item = item->next) {
+		openSubdiv_deleteEvaluatorDescr(item->evaluator);
+		ccgSubSurf_topology_key_free(&item->topology_key);
+	}
+	BLI_freelistN(&evaluator_cache);
+	evaluator_cache_len = 0;
+	BLI_spin_unlock(&evaluator_cache_spin);
+}
+
 static bool opensubdiv_createEvaluator(CCGSubSurf *ss)
 {
 	OpenSubdiv_Converter converter;
 	OpenSubdiv_TopologyRefinerDescr *topology_refiner;
+	CCGTopologyKey topology_key;
 	if (ss->fMap->numEntries == 0) {
 		/* OpenSubdiv doesn't support meshes without faces. */
 		return false;
 	}
 	ccgSubSurf_converter_setup_from_ccg(ss, &converter);
+	/* Evaluator is only valid for the level it was refined to. */
+	ccgSubSurf_converter_topology_key(&converter, ss->subdivLevels, &topology_key);
+	ccgSubSurf_topology_key_free(&ss->osd_evaluator_key);
+	ss->osd_evaluator = opensubdiv_evaluatorCachePop(&topology_key);
+	if (ss->osd_evaluator != NULL) {
+		OSD_LOG("Re-using cached evaluator, topology hash %u\n", topology_key.hash);
+		ccgSubSurf_converter_free(&converter);
+		ss->osd_evaluator_key = topology_key;
+		return true;
+	}
 	topology_refiner = openSubdiv_createTopologyRefinerDescr(&converter);
 	ccgSubSurf_converter_free(&converter);
 	ss->osd_evaluator =
@@ -461,8 +567,10 @@ static bool opensubdiv_createEvaluator(CCGSubSurf *ss)
 	                                        ss->subdivLevels);
 	if (ss->osd_evaluator == NULL) {
 		BLI_assert(!"OpenSubdiv initialization failed, should not happen.");
+		ccgSubSurf_topology_key_free(&topology_key);
 		return false;
 	}
+	ss->osd_evaluator_key = topology_key;
 	return true;
 }
 
@@ -995,6 +1103,7 @@ void BKE_subsurf_osd_init(void)
 {
 	openSubdiv_init(GPU_legacy_support());
 	BLI_spin_init(&delete_spin);
+	BLI_spin_init(&evaluator_cache_spin);
 }
 
 void BKE_subsurf_free_unused_buffers(void)
@@ -1004,9 +1113,11 @@ void BKE_subsurf_free_unused_buffers(void)
 
 void BKE_subsurf_osd_cleanup(void)
 {
+	opensubdiv_evaluatorCacheClear();
 	openSubdiv_cleanup();
 	ccgSubSurf__delete_pending();
 	BLI_spin_end(&delete_spin);
+	BLI_spin_end(&evaluator_cache_spin);
 }
 
 #endif  /* WITH_OPENSUBDIV */
@@ -25,12 +25,14 @@
 #ifdef WITH_OPENSUBDIV
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "MEM_guardedalloc.h"
 #include "BLI_sys_types.h" // for intptr_t support
 
 #include "BLI_utildefines.h" /* for BLI_assert */
 #include "BLI_math.h"
+#include "BLI_hash_mm2a.h"
 
 #include "CCGSubSurf.h"
 #include "CCGSubSurf_intern.h"
@@ -751,4 +753,94 @@ void ccgSubSurf_converter_free(
 	}
 }
 
+/**
+ * Everything topology refiner is built from, stored in a flat array.
+ *
+ * Used to find evaluators which could be re-used for the converted mesh,
+ * coordinates and UVs are not taken into account. Keys are compared in
+ * full, the hash only speeds up the lookup.
+ */
+void ccgSubSurf_converter_topology_key(
+        const struct OpenSubdiv_Converter *converter,
+        int level,
+        CCGTopologyKey *r_key)
+{
+	const int num_faces = converter->get_num_faces(converter);
+	const int num_edges = converter->get_num_edges(converter);
+	const int num_verts = converter->get_num_verts(converter);
+	int *data;
+	int len = 6, i;
+
+	for (i = 0; i < num_faces; i++) {
+		len += 1 + 2 * converter->get_num_face_verts(converter, i);
+	}
+	for (i = 0; i < num_edges; i++) {
+		len += 4 + converter->get_num_edge_faces(converter, i);
+	}
+	for (i = 0; i < num_verts; i++) {
+		len += 2 + converter->get_num_vert_edges(converter, i) +
+		       converter->get_num_vert_faces(converter, i);
+	}
+
+	data = MEM_mallocN(sizeof(int) * len, "opensubdiv topology key");
+	r_key->data = data;
+	r_key->len = len;
+
+	*data++ = level;
+	*data++ = converter->get_type(converter);
+	*data++ = converter->get_subdiv_uvs(converter);
+	*data++ = num_faces;
+	*data++ = num_edges;
+	*data++ = num_verts;
+
+	for (i = 0; i < num_faces; i++) {
+		const int num_face_verts = converter->get_num_face_verts(converter, i);
+		*data++ = num_face_verts;
+		converter->get_face_verts(converter, i, data);
+		data += num_face_verts;
+		converter->get_face_edges(converter, i, data);
+		data += num_face_verts;
+	}
+
+	for (i = 0; i < num_edges; i++) {
+		const int num_edge_faces = converter->get_num_edge_faces(converter, i);
+		const float sharpness = converter->get_edge_sharpness(converter, i);
+		converter->get_edge_verts(converter, i, data);
+		data += 2;
+		memcpy(data++, &sharpness, sizeof(int));
+		*data++ = num_edge_faces;
+		converter->get_edge_faces(converter, i, data);
+		data += num_edge_faces;
+	}
+
+	for (i = 0; i < num_verts; i++) {
+		const int num_vert_edges = converter->get_num_vert_edges(converter, i);
+		const int num_vert_faces = converter->get_num_vert_faces(converter, i);
+		*data++ = num_vert_edges;
+		converter->get_vert_edges(converter, i, data);
+		data += num_vert_edges;
+		*data++ = num_vert_faces;
+		converter->get_vert_faces(converter, i, data);
+		data += num_vert_faces;
+	}
+
+	BLI_assert(data - r_key->data == len);
+
+	r_key->hash = BLI_hash_mm2((const unsigned char *)r_key->data, sizeof(int) * len, 0);
+}
+
+bool ccgSubSurf_topology_key_equals(const CCGTopologyKey *a, const CCGTopologyKey *b)
+{
+	return (a->hash == b->hash &&
+	        a->len == b->len &&
+	        memcmp(a->data, b->data, sizeof(int) * a->len) == 0);
+}
+
+void ccgSubSurf_topology_key_free(CCGTopologyKey *key)
+{
+	MEM_SAFE_FREE(key->data);
+	key->len = 0;
+	key->hash = 0;
+}
+
 #endif  /* WITH_OPENSUBDIV */
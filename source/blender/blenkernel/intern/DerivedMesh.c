@@ -57,6 +57,7 @@
 #include "BKE_library.h"
 #include "BKE_material.h"
 #include "BKE_modifier.h"
+#include "BKE_modifier_cache.h"
 #include "BKE_mesh.h"
 #include "BKE_mesh_mapping.h"
 #include "BKE_object.h"
@@ -1722,6 +1723,53 @@ static void dm_ensure_display_normals(DerivedMesh *dm)
 	}
 }
 
+static bool modifiers_has_enabled_after(Scene *scene, ModifierData *md, const int required_mode)
+{
+	for (md = md->next; md; md = md->next) {
+		if (modifier_isEnabled(scene, md, required_mode)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Results of the modifier stack can only be reused when nothing else than the
+ * final result is requested, orco and mapping data are computed along the way.
+ */
+static bool mesh_calc_modifiers_use_result_cache(
+        Object *ob, const CDMaskLink *datamasks, CustomDataMask dataMask,
+        const bool useRenderParams, int useDeform, const bool need_mapping,
+        const int index, const bool useCache, const bool build_shapekey_layers)
+{
+	const CustomDataMask orco_mask = CD_MASK_ORCO | CD_MASK_CLOTH_ORCO;
+	const CDMaskLink *curr;
+
+	if (!useCache || useRenderParams || useDeform < 0 || need_mapping || index != -1 || build_shapekey_layers) {
+		return false;
+	}
+
+	if ((ob->mode & OB_MODE_SCULPT) && ob->sculpt) {
+		return false;
+	}
+
+	if (!BKE_modifier_cache_is_enabled()) {
+		return false;
+	}
+
+	if (dataMask & orco_mask) {
+		return false;
+	}
+
+	for (curr = datamasks; curr; curr = curr->next) {
+		if (curr->mask & orco_mask) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 /**
  * new value for useDeform -1  (hack for the gameengine):
  *
@@ -1774,6 +1822,10 @@ static void mesh_calc_modifiers(
 	ModifierApplyFlag app_flags = useRenderParams ? MOD_APPLY_RENDER : 0;
 	ModifierApplyFlag deform_app_flags = app_flags;
 
+	/* Result cache: key of the current input, and a cached result not copied yet. */
+	bool use_result_cache;
+	ModifierCacheKey cache_key, cache_key_md;
+	ModifierCacheEntry *cache_entry = NULL;
 
 	if (useCache)
 		app_flags |= MOD_APPLY_USECACHE;
@@ -1814,6 +1866,13 @@ static void mesh_calc_modifiers(
 	datamasks = modifiers_calcDataMasks(scene, ob, md, dataMask, required_mode, previewmd, previewmask);
 	curr = datamasks;
 
+	use_result_cache = mesh_calc_modifiers_use_result_cache(
+	        ob, datamasks, dataMask, useRenderParams, useDeform, need_mapping,
+	        index, useCache, build_shapekey_layers) && !previewmd && !do_init_wmcol;
+	if (use_result_cache) {
+		BKE_modifier_cache_key_mesh(&cache_key, ob, me);
+	}
+
 	if (r_deform) {
 		*r_deform = NULL;
 	}
@@ -1885,6 +1944,7 @@ static void mesh_calc_modifiers(
 
 	for (; md; md = md->next, curr = curr->next) {
 		const ModifierTypeInfo *mti = modifierType_getInfo(md->type);
+		bool do_cache_store = false;
 
 		md->scene = scene;
 
@@ -1896,7 +1956,7 @@ static void mesh_calc_modifiers(
 			continue;
 		}
 
-		if ((mti->flags & eModifierTypeFlag_RequiresOriginalData) && dm) {
+		if ((mti->flags & eModifierTypeFlag_RequiresOriginalData) && (dm || cache_entry)) {
 			modifier_setError(md, "Modifier requires original data, bad stack position");
 			continue;
 		}
@@ -1941,6 +2001,54 @@ static void mesh_calc_modifiers(
 			continue;
 		}
 
+		/* Skip the modifier when its result for the exact same input is cached.
+		 * The chain of keys stops at the first modifier which can't be cached. */
+		if (use_result_cache && mti->type != eModifierTypeType_OnlyDeform) {
+			ModifierCacheEntry *entry = NULL;
+
+			nextmask = curr->next ? curr->next->mask : dataMask;
+
+			if (BKE_modifier_cache_supports(md) &&
+			    BKE_modifier_cache_key_modifier(
+			            &cache_key_md, &cache_key, ob, md, deformedVerts, numVerts,
+			            curr->mask | append_mask, nextmask, app_flags))
+			{
+				entry = BKE_modifier_cache_acquire(md, &cache_key_md);
+				do_cache_store = (entry == NULL) && modifiers_has_enabled_after(scene, md, required_mode);
+			}
+			else {
+				use_result_cache = false;
+			}
+
+			if (entry) {
+				if (cache_entry) {
+					BKE_modifier_cache_release(cache_entry);
+				}
+				cache_entry = entry;
+				cache_key = cache_key_md;
+
+				if (dm) {
+					dm->release(dm);
+					dm = NULL;
+				}
+				if (deformedVerts) {
+					if (deformedVerts != inputVertexCos)
+						MEM_freeN(deformedVerts);
+					deformedVerts = NULL;
+				}
+
+				isPrevDeform = false;
+				continue;
+			}
+		}
+
+		/* A cached result is only copied once something actually needs it. */
+		if (cache_entry) {
+			dm = BKE_modifier_cache_entry_copy(cache_entry);
+			BKE_modifier_cache_release(cache_entry);
+			cache_entry = NULL;
+		}
+
 		/* add an orco layer if needed by this modifier */
 		if (mti->requiredDataMask)
 			mask = mti->requiredDataMask(ob, md);
@@ -2074,6 +2182,14 @@ static void mesh_calc_modifiers(
 				}
 			}
 
+			if (use_result_cache) {
+				/* Don't cache errors, they would not be reported on reuse. */
+				if (do_cache_store && ndm && md->error == NULL) {
+					BKE_modifier_cache_store(md, &cache_key_md, dm);
+				}
+				cache_key = cache_key_md;
+			}
+
 			/* create an orco derivedmesh in parallel */
 			if (nextmask & CD_MASK_ORCO) {
 				if (!orcodm)
@@ -2136,6 +2252,11 @@ static void mesh_calc_modifiers(
 		}
 	}
 
+	if (cache_entry) {
+		dm = BKE_modifier_cache_entry_copy(cache_entry);
+		BKE_modifier_cache_release(cache_entry);
+	}
+
 	for (md = firstmd; md; md = md->next)
 		modifier_freeTemporaryData(md);
 
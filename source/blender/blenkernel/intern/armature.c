@@ -749,16 +749,17 @@ static void pchan_b_bone_defmats(bPoseChannel *pchan, bPoseChanDeform *pdef_info
 	}
 }
 
-static void b_bone_deform(bPoseChanDeform *pdef_info, Bone *bone, float co[3], DualQuat *dq, float defmat[3][3])
+/* Index of the B-Bone segment which deforms co. */
+static int b_bone_deform_segment(const bPoseChanDeform *pdef_info, const Bone *bone, const float co[3])
 {
 	Mat4 *b_bone = pdef_info->b_bone_mats;
 	float (*mat)[4] = b_bone[0].mat;
 	float segment, y;
 	int a;
-	
+
 	/* need to transform co back to bonespace, only need y */
 	y = mat[0][1] * co[0] + mat[1][1] * co[1] + mat[2][1] * co[2] + mat[3][1];
-	
+
 	/* now calculate which of the b_bones are deforming this */
 	segment = bone->length / ((float)bone->segments);
 	a = (int)(y / segment);
@@ -767,6 +768,14 @@ static void b_bone_deform(bPoseChanDeform *pdef_info, Bone *bone, float co[3], D
 	 * straight joints in restpos. */
 	CLAMP(a, 0, bone->segments - 1);
 
+	return a;
+}
+
+static void b_bone_deform(bPoseChanDeform *pdef_info, Bone *bone, float co[3], DualQuat *dq, float defmat[3][3])
+{
+	Mat4 *b_bone = pdef_info->b_bone_mats;
+	const int a = b_bone_deform_segment(pdef_info, bone, co);
+
 	if (dq) {
 		copy_dq_dq(dq, &(pdef_info->b_bone_dual_quats)[a]);
 	}
@@ -954,26 +963,336 @@ static void armature_bbone_defmats_cb(void *userdata, Link *iter, int index)
 	}
 }
 
+/* Vertex group influence of a deforming bone on a vertex. */
+typedef struct ArmatureDeformInfluence {
+	int index;  /* Index of the pose channel in pchan_array and pdef_info_array. */
+	float weight;
+} ArmatureDeformInfluence;
+
+typedef struct ArmatureDeformData {
+	bPoseChannel **pchan_array;
+	bPoseChanDeform *pdef_info_array;
+	int totchan;
+
+	/* Influences of vertex i are influences[influence_offset[i]] .. influences[influence_offset[i + 1] - 1],
+	 * in the order of the vertex groups weights. Only created when vertex groups are used. */
+	int *influence_offset;
+	ArmatureDeformInfluence *influences;
+
+	MDeformVert *dverts;
+	int dverts_tot;
+
+	float (*vertexCos)[3];
+	float (*defMats)[3][3];
+	float (*prevCos)[3];
+
+	float premat[4][4];
+	float postmat[4][4];
+
+	int armature_def_nr;
+	bool use_envelope;
+	bool use_quaternion;
+	bool invert_vgroup;
+	bool use_dverts;
+} ArmatureDeformData;
+
+/* Gather vertex group weights of deforming bones into a flat table,
+ * so the per-vertex loop doesn't need to map groups to channels. */
+static void armature_deform_influences_build(
+        ArmatureDeformData *data, Object *armOb, Object *target, const int numVerts, const int defbase_tot)
+{
+	bPoseChannel **defnr_to_pchan;
+	int *defnr_to_index;
+	bDeformGroup *dg;
+	int i, tot_influences = 0;
+
+	defnr_to_pchan = MEM_callocN(sizeof(*defnr_to_pchan) * defbase_tot, "defnrToBone");
+	defnr_to_index = MEM_callocN(sizeof(*defnr_to_index) * defbase_tot, "defnrToIndex");
+	for (i = 0, dg = target->defbase.first; dg; i++, dg = dg->next) {
+		defnr_to_pchan[i] = BKE_pose_channel_find_name(armOb->pose, dg->name);
+		/* exclude non-deforming bones */
+		if (defnr_to_pchan[i]) {
+			if (defnr_to_pchan[i]->bone->flag & BONE_NO_DEFORM) {
+				defnr_to_pchan[i] = NULL;
+			}
+			else {
+				defnr_to_index[i] = BLI_findindex(&armOb->pose->chanbase, defnr_to_pchan[i]);
+			}
+		}
+	}
+
+	data->influence_offset = MEM_mallocN(sizeof(*data->influence_offset) * (numVerts + 1), "armature influence offset");
+
+	for (i = 0; i < numVerts; i++) {
+		MDeformVert *dvert = (i < data->dverts_tot) ? &data->dverts[i] : NULL;
+
+		data->influence_offset[i] = tot_influences;
+		if (dvert) {
+			MDeformWeight *dw = dvert->dw;
+			unsigned int j;
+
+			for (j = dvert->totweight; j != 0; j--, dw++) {
+				const int index = dw->def_nr;
+				if (index >= 0 && index < defbase_tot && defnr_to_pchan[index]) {
+					tot_influences++;
+				}
+			}
+		}
+	}
+	data->influence_offset[numVerts] = tot_influences;
+
+	data->influences = MEM_mallocN(sizeof(*data->influences) * max_ii(tot_influences, 1), "armature influences");
+
+	for (i = 0; i < numVerts; i++) {
+		MDeformVert *dvert = (i < data->dverts_tot) ? &data->dverts[i] : NULL;
+		ArmatureDeformInfluence *influence = &data->influences[data->influence_offset[i]];
+
+		if (dvert) {
+			MDeformWeight *dw = dvert->dw;
+			unsigned int j;
+
+			for (j = dvert->totweight; j != 0; j--, dw++) {
+				const int index = dw->def_nr;
+				if (index >= 0 && index < defbase_tot && defnr_to_pchan[index]) {
+					influence->index = defnr_to_index[index];
+					influence->weight = dw->weight;
+					influence++;
+				}
+			}
+		}
+	}
+
+	MEM_freeN(defnr_to_pchan);
+	MEM_freeN(defnr_to_index);
+}
+
+/* Linear blend skinning of a single vertex: all the influencing matrices are
+ * weighted and summed first, so the vertex is only transformed once.
+ * The fixed-size loops over the matrix are meant to be vectorized. */
+static void armature_deform_blend_linear(
+        const ArmatureDeformData *data, const ArmatureDeformInfluence *influence, const int tot_influence,
+        const float co[3], float vec[3], float (*smat)[3], float *contrib)
+{
+	float blend_mat[4][4] = {{0.0f}};
+	float weight_sum = 0.0f;
+	float cop[3];
+	int j, k;
+
+	for (j = 0; j < tot_influence; j++, influence++) {
+		bPoseChannel *pchan = data->pchan_array[influence->index];
+		const bPoseChanDeform *pdef_info = &data->pdef_info_array[influence->index];
+		Bone *bone = pchan->bone;
+		float weight = influence->weight;
+		const float *mat;
+
+		if (bone->flag & BONE_MULT_VG_ENV) {
+			weight *= distfactor_to_bone(co, bone->arm_head, bone->arm_tail,
+			                             bone->rad_head, bone->rad_tail, bone->dist);
+		}
+
+		if (weight == 0.0f) {
+			continue;
+		}
+
+		if (bone->segments > 1) {
+			mat = &pdef_info->b_bone_mats[b_bone_deform_segment(pdef_info, bone, co) + 1].mat[0][0];
+		}
+		else {
+			mat = &pchan->chan_mat[0][0];
+		}
+
+		for (k = 0; k < 16; k++) {
+			(&blend_mat[0][0])[k] += mat[k] * weight;
+		}
+		weight_sum += weight;
+	}
+
+	/* Same as summing (mat * co - co) * weight for every influence. */
+	mul_v3_m4v3(cop, blend_mat, co);
+	madd_v3_v3fl(cop, co, -weight_sum);
+	add_v3_v3(vec, cop);
+
+	if (smat) {
+		float wmat[3][3];
+		copy_m3_m4(wmat, blend_mat);
+		add_m3_m3m3(smat, smat, wmat);
+	}
+
+	(*contrib) += weight_sum;
+}
+
+static void armature_deform_envelope(
+        const ArmatureDeformData *data, float vec[3], DualQuat *dq, float (*smat)[3], const float co[3],
+        float *contrib)
+{
+	int i;
+
+	for (i = 0; i < data->totchan; i++) {
+		bPoseChannel *pchan = data->pchan_array[i];
+		if (!(pchan->bone->flag & BONE_NO_DEFORM)) {
+			(*contrib) += dist_bone_deform(pchan, &data->pdef_info_array[i], vec, dq, smat, co);
+		}
+	}
+}
+
+static void armature_deform_vert_cb(void *userdata, const int i)
+{
+	ArmatureDeformData *data = userdata;
+	float (*vertexCos)[3] = data->vertexCos;
+	float (*defMats)[3][3] = data->defMats;
+	float (*prevCos)[3] = data->prevCos;
+	const bool use_quaternion = data->use_quaternion;
+	MDeformVert *dvert;
+	DualQuat sumdq, *dq = NULL;
+	float *co, dco[3];
+	float sumvec[3], summat[3][3];
+	float *vec = NULL, (*smat)[3] = NULL;
+	float contrib = 0.0f;
+	float armature_weight = 1.0f; /* default to 1 if no overall def group */
+	float prevco_weight = 1.0f;   /* weight for optional cached vertexcos */
+
+	if (use_quaternion) {
+		memset(&sumdq, 0, sizeof(DualQuat));
+		dq = &sumdq;
+	}
+	else {
+		sumvec[0] = sumvec[1] = sumvec[2] = 0.0f;
+		vec = sumvec;
+
+		if (defMats) {
+			zero_m3(summat);
+			smat = summat;
+		}
+	}
+
+	if (data->dverts && i < data->dverts_tot)
+		dvert = data->dverts + i;
+	else
+		dvert = NULL;
+
+	if (data->armature_def_nr != -1 && dvert) {
+		armature_weight = defvert_find_weight(dvert, data->armature_def_nr);
+
+		if (data->invert_vgroup)
+			armature_weight = 1.0f - armature_weight;
+
+		/* hackish: the blending factor can be used for blending with prevCos too */
+		if (prevCos) {
+			prevco_weight = armature_weight;
+			armature_weight = 1.0f;
+		}
+	}
+
+	/* check if there's any  point in calculating for this vert */
+	if (armature_weight == 0.0f)
+		return;
+
+	/* get the coord we work on */
+	co = prevCos ? prevCos[i] : vertexCos[i];
+
+	/* Apply the object's matrix */
+	mul_m4_v3(data->premat, co);
+
+	if (data->use_dverts && dvert && dvert->totweight) { /* use weight groups ? */
+		const ArmatureDeformInfluence *influence = &data->influences[data->influence_offset[i]];
+		const int tot_influence = data->influence_offset[i + 1] - data->influence_offset[i];
+
+		if (tot_influence != 0) {
+			if (use_quaternion) {
+				int j;
+
+				/* Dual quaternions are blended one by one exactly as before. */
+				for (j = 0; j < tot_influence; j++, influence++) {
+					bPoseChannel *pchan = data->pchan_array[influence->index];
+					Bone *bone = pchan->bone;
+					float weight = influence->weight;
+
+					if (bone->flag & BONE_MULT_VG_ENV) {
+						weight *= distfactor_to_bone(co, bone->arm_head, bone->arm_tail,
+						                             bone->rad_head, bone->rad_tail, bone->dist);
+					}
+					pchan_bone_deform(pchan, &data->pdef_info_array[influence->index], weight,
+					                  vec, dq, smat, co, &contrib);
+				}
+			}
+			else {
+				armature_deform_blend_linear(data, influence, tot_influence, co, vec, smat, &contrib);
+			}
+		}
+		/* if there are vertexgroups but not groups with bones
+		 * (like for softbody groups) */
+		else if (data->use_envelope) {
+			armature_deform_envelope(data, vec, dq, smat, co, &contrib);
+		}
+	}
+	else if (data->use_envelope) {
+		armature_deform_envelope(data, vec, dq, smat, co, &contrib);
+	}
+
+	/* actually should be EPSILON? weight values and contrib can be like 10e-39 small */
+	if (contrib > 0.0001f) {
+		if (use_quaternion) {
+			normalize_dq(dq, contrib);
+
+			if (armature_weight != 1.0f) {
+				copy_v3_v3(dco, co);
+				mul_v3m3_dq(dco, (defMats) ? summat : NULL, dq);
+				sub_v3_v3(dco, co);
+				mul_v3_fl(dco, armature_weight);
+				add_v3_v3(co, dco);
+			}
+			else
+				mul_v3m3_dq(co, (defMats) ? summat : NULL, dq);
+
+			smat = summat;
+		}
+		else {
+			mul_v3_fl(vec, armature_weight / contrib);
+			add_v3_v3v3(co, vec, co);
+		}
+
+		if (defMats) {
+			float pre[3][3], post[3][3], tmpmat[3][3];
+
+			copy_m3_m4(pre, data->premat);
+			copy_m3_m4(post, data->postmat);
+			copy_m3_m3(tmpmat, defMats[i]);
+
+			if (!use_quaternion) /* quaternion already is scale corrected */
+				mul_m3_fl(smat, armature_weight / contrib);
+
+			mul_m3_series(defMats[i], post, smat, pre, tmpmat);
+		}
+	}
+
+	/* always, check above code */
+	mul_m4_v3(data->postmat, co);
+
+	/* interpolate with previous modifier position using weight group */
+	if (prevCos) {
+		float mw = 1.0f - prevco_weight;
+		vertexCos[i][0] = prevco_weight * vertexCos[i][0] + mw * co[0];
+		vertexCos[i][1] = prevco_weight * vertexCos[i][1] + mw * co[1];
+		vertexCos[i][2] = prevco_weight * vertexCos[i][2] + mw * co[2];
+	}
+}
+
 void armature_deform_verts(Object *armOb, Object *target, DerivedMesh *dm, float (*vertexCos)[3],
                            float (*defMats)[3][3], int numVerts, int deformflag,
                            float (*prevCos)[3], const char *defgrp_name)
 {
+	ArmatureDeformData data = {NULL};
 	bPoseChanDeform *pdef_info_array;
 	bPoseChanDeform *pdef_info = NULL;
 	bArmature *arm = armOb->data;
-	bPoseChannel *pchan, **defnrToPC = NULL;
-	int *defnrToPCIndex = NULL;
+	bPoseChannel *pchan;
 	MDeformVert *dverts = NULL;
-	bDeformGroup *dg;
 	DualQuat *dualquats = NULL;
-	float obinv[4][4], premat[4][4], postmat[4][4];
-	const bool use_envelope   = (deformflag & ARM_DEF_ENVELOPE) != 0;
+	float obinv[4][4];
 	const bool use_quaternion = (deformflag & ARM_DEF_QUATERNION) != 0;
-	const bool invert_vgroup  = (deformflag & ARM_DEF_INVERT_VGROUP) != 0;
 	int defbase_tot = 0;       /* safety for vertexgroup index overflow */
 	int i, target_totvert = 0; /* safety for vertexgroup overflow */
 	bool use_dverts = false;
-	int armature_def_nr;
 	int totchan;
 
 	/* in editmode, or not an armature */
@@ -982,9 +1301,8 @@ void armature_deform_verts(Object *armOb, Object *target, DerivedMesh *dm, float
 	}
 
 	invert_m4_m4(obinv, target->obmat);
-	copy_m4_m4(premat, target->obmat);
-	mul_m4_m4m4(postmat, obinv, armOb->obmat);
-	invert_m4_m4(premat, postmat);
+	mul_m4_m4m4(data.postmat, obinv, armOb->obmat);
+	invert_m4_m4(data.premat, data.postmat);
 
 	/* bone defmats are already in the channels, chan_mat */
 
@@ -997,13 +1315,20 @@ void armature_deform_verts(Object *armOb, Object *target, DerivedMesh *dm, float
 
 	pdef_info_array = MEM_callocN(sizeof(bPoseChanDeform) * totchan, "bPoseChanDeform");
 
-	ArmatureBBoneDefmatsData data = {
+	ArmatureBBoneDefmatsData bbone_data = {
 	    .pdef_info_array = pdef_info_array, .dualquats = dualquats, .use_quaternion = use_quaternion
 	};
-	BLI_task_parallel_listbase(&armOb->pose->chanbase, &data, armature_bbone_defmats_cb, totchan > 512);
+	BLI_task_parallel_listbase(&armOb->pose->chanbase, &bbone_data, armature_bbone_defmats_cb, totchan > 512);
+
+	data.pchan_array = MEM_mallocN(sizeof(*data.pchan_array) * max_ii(totchan, 1), "armature pchan array");
+	for (i = 0, pchan = armOb->pose->chanbase.first; pchan; i++, pchan = pchan->next) {
+		data.pchan_array[i] = pchan;
+	}
+	data.pdef_info_array = pdef_info_array;
+	data.totchan = totchan;
 
 	/* get the def_nr for the overall armature vertex group if present */
-	armature_def_nr = defgroup_name_index(target, defgrp_name);
+	data.armature_def_nr = defgroup_name_index(target, defgrp_name);
 
 	if (ELEM(target->type, OB_MESH, OB_LATTICE)) {
 		defbase_tot = BLI_listbase_count(&target->defbase);
@@ -1032,177 +1357,43 @@ void armature_deform_verts(Object *armOb, Object *target, DerivedMesh *dm, float
 			else if (dverts) {
 				use_dverts = true;
 			}
-
-			if (use_dverts) {
-				defnrToPC = MEM_callocN(sizeof(*defnrToPC) * defbase_tot, "defnrToBone");
-				defnrToPCIndex = MEM_callocN(sizeof(*defnrToPCIndex) * defbase_tot, "defnrToIndex");
-				for (i = 0, dg = target->defbase.first; dg; i++, dg = dg->next) {
-					defnrToPC[i] = BKE_pose_channel_find_name(armOb->pose, dg->name);
-					/* exclude non-deforming bones */
-					if (defnrToPC[i]) {
-						if (defnrToPC[i]->bone->flag & BONE_NO_DEFORM) {
-							defnrToPC[i] = NULL;
-						}
-						else {
-							defnrToPCIndex[i] = BLI_findindex(&armOb->pose->chanbase, defnrToPC[i]);
-						}
-					}
-				}
-			}
 		}
 	}
 
-	for (i = 0; i < numVerts; i++) {
-		MDeformVert *dvert;
-		DualQuat sumdq, *dq = NULL;
-		float *co, dco[3];
-		float sumvec[3], summat[3][3];
-		float *vec = NULL, (*smat)[3] = NULL;
-		float contrib = 0.0f;
-		float armature_weight = 1.0f; /* default to 1 if no overall def group */
-		float prevco_weight = 1.0f;   /* weight for optional cached vertexcos */
-
-		if (use_quaternion) {
-			memset(&sumdq, 0, sizeof(DualQuat));
-			dq = &sumdq;
+	/* Vertex groups are read from the derived mesh when there is one,
+	 * fetch the layer once here rather than per vertex from threads. */
+	if (use_dverts || data.armature_def_nr != -1) {
+		if (dm) {
+			data.dverts = dm->getVertDataArray(dm, CD_MDEFORMVERT);
+			data.dverts_tot = numVerts;
 		}
-		else {
-			sumvec[0] = sumvec[1] = sumvec[2] = 0.0f;
-			vec = sumvec;
-
-			if (defMats) {
-				zero_m3(summat);
-				smat = summat;
-			}
-		}
-
-		if (use_dverts || armature_def_nr != -1) {
-			if (dm)
-				dvert = dm->getVertData(dm, i, CD_MDEFORMVERT);
-			else if (dverts && i < target_totvert)
-				dvert = dverts + i;
-			else
-				dvert = NULL;
-		}
-		else
-			dvert = NULL;
-
-		if (armature_def_nr != -1 && dvert) {
-			armature_weight = defvert_find_weight(dvert, armature_def_nr);
-
-			if (invert_vgroup)
-				armature_weight = 1.0f - armature_weight;
-
-			/* hackish: the blending factor can be used for blending with prevCos too */
-			if (prevCos) {
-				prevco_weight = armature_weight;
-				armature_weight = 1.0f;
-			}
-		}
-
-		/* check if there's any  point in calculating for this vert */
-		if (armature_weight == 0.0f)
-			continue;
-
-		/* get the coord we work on */
-		co = prevCos ? prevCos[i] : vertexCos[i];
-
-		/* Apply the object's matrix */
-		mul_m4_v3(premat, co);
-
-		if (use_dverts && dvert && dvert->totweight) { /* use weight groups ? */
-			MDeformWeight *dw = dvert->dw;
-			int deformed = 0;
-			unsigned int j;
-
-			for (j = dvert->totweight; j != 0; j--, dw++) {
-				const int index = dw->def_nr;
-				if (index >= 0 && index < defbase_tot && (pchan = defnrToPC[index])) {
-					float weight = dw->weight;
-					Bone *bone = pchan->bone;
-					pdef_info = pdef_info_array + defnrToPCIndex[index];
-
-					deformed = 1;
-
-					if (bone && bone->flag & BONE_MULT_VG_ENV) {
-						weight *= distfactor_to_bone(co, bone->arm_head, bone->arm_tail,
-						                             bone->rad_head, bone->rad_tail, bone->dist);
-					}
-					pchan_bone_deform(pchan, pdef_info, weight, vec, dq, smat, co, &contrib);
-				}
-			}
-			/* if there are vertexgroups but not groups with bones
-			 * (like for softbody groups) */
-			if (deformed == 0 && use_envelope) {
-				pdef_info = pdef_info_array;
-				for (pchan = armOb->pose->chanbase.first; pchan; pchan = pchan->next, pdef_info++) {
-					if (!(pchan->bone->flag & BONE_NO_DEFORM))
-						contrib += dist_bone_deform(pchan, pdef_info, vec, dq, smat, co);
-				}
-			}
-		}
-		else if (use_envelope) {
-			pdef_info = pdef_info_array;
-			for (pchan = armOb->pose->chanbase.first; pchan; pchan = pchan->next, pdef_info++) {
-				if (!(pchan->bone->flag & BONE_NO_DEFORM))
-					contrib += dist_bone_deform(pchan, pdef_info, vec, dq, smat, co);
-			}
-		}
-
-		/* actually should be EPSILON? weight values and contrib can be like 10e-39 small */
-		if (contrib > 0.0001f) {
-			if (use_quaternion) {
-				normalize_dq(dq, contrib);
-
-				if (armature_weight != 1.0f) {
-					copy_v3_v3(dco, co);
-					mul_v3m3_dq(dco, (defMats) ? summat : NULL, dq);
-					sub_v3_v3(dco, co);
-					mul_v3_fl(dco, armature_weight);
-					add_v3_v3(co, dco);
-				}
-				else
-					mul_v3m3_dq(co, (defMats) ? summat : NULL, dq);
-
-				smat = summat;
-			}
-			else {
-				mul_v3_fl(vec, armature_weight / contrib);
-				add_v3_v3v3(co, vec, co);
-			}
-
-			if (defMats) {
-				float pre[3][3], post[3][3], tmpmat[3][3];
-
-				copy_m3_m4(pre, premat);
-				copy_m3_m4(post, postmat);
-				copy_m3_m3(tmpmat, defMats[i]);
-
-				if (!use_quaternion) /* quaternion already is scale corrected */
-					mul_m3_fl(smat, armature_weight / contrib);
-
-				mul_m3_series(defMats[i], post, smat, pre, tmpmat);
-			}
+		else if (dverts) {
+			data.dverts = dverts;
+			data.dverts_tot = target_totvert;
 		}
+	}
 
-		/* always, check above code */
-		mul_m4_v3(postmat, co);
+	data.vertexCos = vertexCos;
+	data.defMats = defMats;
+	data.prevCos = prevCos;
+	data.use_envelope = (deformflag & ARM_DEF_ENVELOPE) != 0;
+	data.use_quaternion = use_quaternion;
+	data.invert_vgroup = (deformflag & ARM_DEF_INVERT_VGROUP) != 0;
+	data.use_dverts = use_dverts;
 
-		/* interpolate with previous modifier position using weight group */
-		if (prevCos) {
-			float mw = 1.0f - prevco_weight;
-			vertexCos[i][0] = prevco_weight * vertexCos[i][0] + mw * co[0];
-			vertexCos[i][1] = prevco_weight * vertexCos[i][1] + mw * co[1];
-			vertexCos[i][2] = prevco_weight * vertexCos[i][2] + mw * co[2];
-		}
+	if (use_dverts) {
+		armature_deform_influences_build(&data, armOb, target, numVerts, defbase_tot);
 	}
 
+	BLI_task_parallel_range(0, numVerts, &data, armature_deform_vert_cb, numVerts > 1024);
+
 	if (dualquats)
 		MEM_freeN(dualquats);
-	if (defnrToPC)
-		MEM_freeN(defnrToPC);
-	if (defnrToPCIndex)
-		MEM_freeN(defnrToPCIndex);
+	if (data.influence_offset)
+		MEM_freeN(data.influence_offset);
+	if (data.influences)
+		MEM_freeN(data.influences);
+	MEM_freeN(data.pchan_array);
 
 	/* free B_bone matrices */
 	pdef_info = pdef_info_array;
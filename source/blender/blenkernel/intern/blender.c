@@ -52,11 +52,14 @@
 #include "BKE_cachefile.h"
 #include "BKE_context.h"
 #include "BKE_depsgraph.h"
+#include "BKE_fluidsim.h"
 #include "BKE_global.h"
 #include "BKE_idprop.h"
 #include "BKE_image.h"
 #include "BKE_library.h"
+#include "BKE_modifier_cache.h"
 #include "BKE_node.h"
+#include "BKE_pointcache.h"
 #include "BKE_report.h"
 #include "BKE_scene.h"
 #include "BKE_screen.h"
@@ -87,6 +90,9 @@ void BKE_blender_free(void)
 	IMB_exit();
 	BKE_cachefiles_exit();
 	BKE_images_exit();
+	BKE_modifier_cache_exit();
+	BKE_ptcache_container_exit();
+	BKE_fluidsim_meshseq_exit();
 	DAG_exit();
 
 	BKE_brush_system_exit();
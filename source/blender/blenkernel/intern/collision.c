@@ -44,6 +44,7 @@
 #include "BLI_blenlib.h"
 #include "BLI_math.h"
 #include "BLI_edgehash.h"
+#include "BLI_task.h"
 
 #include "BKE_cloth.h"
 #include "BKE_effect.h"
@@ -60,6 +61,11 @@
 #include "eltopo-capi.h"
 #endif
 
+/* Below this many overlaps or collision pairs, threading is not worth it. */
+#define COLLISION_PARALLEL_MIN 1024
+/* Number of overlaps handled by one task of the near check. */
+#define COLLISION_OVERLAP_BATCH 256
+
 
 /***********************************
 Collision modifier code start
@@ -226,9 +232,18 @@ DO_INLINE void collision_interpolateOnTriangle ( float to[3], float v1[3], float
 	VECADDMUL(to, v3, w3);
 }
 
-static int cloth_collision_response_static ( ClothModifierData *clmd, CollisionModifierData *collmd, CollPair *collpair, CollPair *collision_end )
+/* Impulses of one collision pair on the vertices of its cloth triangle. */
+typedef struct CollPairImpulse {
+	float i1[3], i2[3], i3[3];
+	bool result;
+} CollPairImpulse;
+
+/* Computes the impulses of a static collision pair. Only reads the cloth state,
+ * so pairs can be handled in parallel. */
+static bool cloth_collision_impulse_static(
+        ClothModifierData *clmd, CollisionModifierData *collmd, CollPair *collpair,
+        float i1[3], float i2[3], float i3[3])
 {
-	int result = 0;
 	Cloth *cloth1;
 	float w1, w2, w3, u1, u2, u3;
 	float v1[3], v2[3], relativeVelocity[3];
@@ -237,154 +252,199 @@ static int cloth_collision_response_static ( ClothModifierData *clmd, CollisionM
 
 	cloth1 = clmd->clothObject;
 
-	for ( ; collpair != collision_end; collpair++ ) {
-		float i1[3], i2[3], i3[3];
+	zero_v3(i1);
+	zero_v3(i2);
+	zero_v3(i3);
 
-		zero_v3(i1);
-		zero_v3(i2);
-		zero_v3(i3);
+	/* only handle static collisions here */
+	if ( collpair->flag & COLLISION_IN_FUTURE )
+		return false;
 
-		/* only handle static collisions here */
-		if ( collpair->flag & COLLISION_IN_FUTURE )
-			continue;
+	/* compute barycentric coordinates for both collision points */
+	collision_compute_barycentric ( collpair->pa,
+		cloth1->verts[collpair->ap1].txold,
+		cloth1->verts[collpair->ap2].txold,
+		cloth1->verts[collpair->ap3].txold,
+		&w1, &w2, &w3 );
 
-		/* compute barycentric coordinates for both collision points */
-		collision_compute_barycentric ( collpair->pa,
-			cloth1->verts[collpair->ap1].txold,
-			cloth1->verts[collpair->ap2].txold,
-			cloth1->verts[collpair->ap3].txold,
-			&w1, &w2, &w3 );
+	/* was: txold */
+	collision_compute_barycentric ( collpair->pb,
+		collmd->current_x[collpair->bp1].co,
+		collmd->current_x[collpair->bp2].co,
+		collmd->current_x[collpair->bp3].co,
+		&u1, &u2, &u3 );
 
-		/* was: txold */
-		collision_compute_barycentric ( collpair->pb,
-			collmd->current_x[collpair->bp1].co,
-			collmd->current_x[collpair->bp2].co,
-			collmd->current_x[collpair->bp3].co,
-			&u1, &u2, &u3 );
+	/* Calculate relative "velocity". */
+	collision_interpolateOnTriangle ( v1, cloth1->verts[collpair->ap1].tv, cloth1->verts[collpair->ap2].tv, cloth1->verts[collpair->ap3].tv, w1, w2, w3 );
+
+	collision_interpolateOnTriangle ( v2, collmd->current_v[collpair->bp1].co, collmd->current_v[collpair->bp2].co, collmd->current_v[collpair->bp3].co, u1, u2, u3 );
 
-		/* Calculate relative "velocity". */
-		collision_interpolateOnTriangle ( v1, cloth1->verts[collpair->ap1].tv, cloth1->verts[collpair->ap2].tv, cloth1->verts[collpair->ap3].tv, w1, w2, w3 );
+	sub_v3_v3v3(relativeVelocity, v2, v1);
 
-		collision_interpolateOnTriangle ( v2, collmd->current_v[collpair->bp1].co, collmd->current_v[collpair->bp2].co, collmd->current_v[collpair->bp3].co, u1, u2, u3 );
+	/* Calculate the normal component of the relative velocity (actually only the magnitude - the direction is stored in 'normal'). */
+	magrelVel = dot_v3v3(relativeVelocity, collpair->normal);
 
-		sub_v3_v3v3(relativeVelocity, v2, v1);
+	/* printf("magrelVel: %f\n", magrelVel); */
 
-		/* Calculate the normal component of the relative velocity (actually only the magnitude - the direction is stored in 'normal'). */
-		magrelVel = dot_v3v3(relativeVelocity, collpair->normal);
+	/* Calculate masses of points.
+	 * TODO */
 
-		/* printf("magrelVel: %f\n", magrelVel); */
+	/* If v_n_mag < 0 the edges are approaching each other. */
+	if ( magrelVel > ALMOST_ZERO ) {
+		/* Calculate Impulse magnitude to stop all motion in normal direction. */
+		float magtangent = 0, repulse = 0, d = 0;
+		double impulse = 0.0;
+		float vrel_t_pre[3];
+		float temp[3], spf;
 
-		/* Calculate masses of points.
-		 * TODO */
+		/* calculate tangential velocity */
+		copy_v3_v3 ( temp, collpair->normal );
+		mul_v3_fl(temp, magrelVel);
+		sub_v3_v3v3(vrel_t_pre, relativeVelocity, temp);
 
-		/* If v_n_mag < 0 the edges are approaching each other. */
-		if ( magrelVel > ALMOST_ZERO ) {
-			/* Calculate Impulse magnitude to stop all motion in normal direction. */
-			float magtangent = 0, repulse = 0, d = 0;
-			double impulse = 0.0;
-			float vrel_t_pre[3];
-			float temp[3], spf;
+		/* Decrease in magnitude of relative tangential velocity due to coulomb friction
+		 * in original formula "magrelVel" should be the "change of relative velocity in normal direction" */
+		magtangent = min_ff(clmd->coll_parms->friction * 0.01f * magrelVel, len_v3(vrel_t_pre));
 
-			/* calculate tangential velocity */
-			copy_v3_v3 ( temp, collpair->normal );
-			mul_v3_fl(temp, magrelVel);
-			sub_v3_v3v3(vrel_t_pre, relativeVelocity, temp);
+		/* Apply friction impulse. */
+		if ( magtangent > ALMOST_ZERO ) {
+			normalize_v3(vrel_t_pre);
 
-			/* Decrease in magnitude of relative tangential velocity due to coulomb friction
-			 * in original formula "magrelVel" should be the "change of relative velocity in normal direction" */
-			magtangent = min_ff(clmd->coll_parms->friction * 0.01f * magrelVel, len_v3(vrel_t_pre));
+			impulse = magtangent / ( 1.0f + w1*w1 + w2*w2 + w3*w3 ); /* 2.0 * */
+			VECADDMUL ( i1, vrel_t_pre, w1 * impulse );
+			VECADDMUL ( i2, vrel_t_pre, w2 * impulse );
+			VECADDMUL ( i3, vrel_t_pre, w3 * impulse );
+		}
 
-			/* Apply friction impulse. */
-			if ( magtangent > ALMOST_ZERO ) {
-				normalize_v3(vrel_t_pre);
+		/* Apply velocity stopping impulse
+		 * I_c = m * v_N / 2.0
+		 * no 2.0 * magrelVel normally, but looks nicer DG */
+		impulse =  magrelVel / ( 1.0 + w1*w1 + w2*w2 + w3*w3 );
 
-				impulse = magtangent / ( 1.0f + w1*w1 + w2*w2 + w3*w3 ); /* 2.0 * */
-				VECADDMUL ( i1, vrel_t_pre, w1 * impulse );
-				VECADDMUL ( i2, vrel_t_pre, w2 * impulse );
-				VECADDMUL ( i3, vrel_t_pre, w3 * impulse );
-			}
+		VECADDMUL ( i1, collpair->normal, w1 * impulse );
 
-			/* Apply velocity stopping impulse
-			 * I_c = m * v_N / 2.0
-			 * no 2.0 * magrelVel normally, but looks nicer DG */
-			impulse =  magrelVel / ( 1.0 + w1*w1 + w2*w2 + w3*w3 );
+		VECADDMUL ( i2, collpair->normal, w2 * impulse );
 
-			VECADDMUL ( i1, collpair->normal, w1 * impulse );
-			cloth1->verts[collpair->ap1].impulse_count++;
+		VECADDMUL ( i3, collpair->normal, w3 * impulse );
 
-			VECADDMUL ( i2, collpair->normal, w2 * impulse );
-			cloth1->verts[collpair->ap2].impulse_count++;
-
-			VECADDMUL ( i3, collpair->normal, w3 * impulse );
-			cloth1->verts[collpair->ap3].impulse_count++;
-
-			/* Apply repulse impulse if distance too short
-			 * I_r = -min(dt*kd, m(0, 1d/dt - v_n))
-			 * DG: this formula ineeds to be changed for this code since we apply impulses/repulses like this:
-			 * v += impulse; x_new = x + v;
-			 * We don't use dt!!
-			 * DG TODO: Fix usage of dt here! */
-			spf = (float)clmd->sim_parms->stepsPerFrame / clmd->sim_parms->timescale;
-
-			d = clmd->coll_parms->epsilon*8.0f/9.0f + epsilon2*8.0f/9.0f - collpair->distance;
-			if ( ( magrelVel < 0.1f*d*spf ) && ( d > ALMOST_ZERO ) ) {
-				repulse = MIN2 ( d*1.0f/spf, 0.1f*d*spf - magrelVel );
-
-				/* stay on the safe side and clamp repulse */
-				if ( impulse > ALMOST_ZERO )
-					repulse = min_ff( repulse, 5.0*impulse );
-				repulse = max_ff(impulse, repulse);
-
-				impulse = repulse / ( 1.0f + w1*w1 + w2*w2 + w3*w3 ); /* original 2.0 / 0.25 */
-				VECADDMUL ( i1, collpair->normal,  impulse );
-				VECADDMUL ( i2, collpair->normal,  impulse );
-				VECADDMUL ( i3, collpair->normal,  impulse );
-			}
+		/* Apply repulse impulse if distance too short
+		 * I_r = -min(dt*kd, m(0, 1d/dt - v_n))
+		 * DG: this formula ineeds to be changed for this code since we apply impulses/repulses like this:
+		 * v += impulse; x_new = x + v;
+		 * We don't use dt!!
+		 * DG TODO: Fix usage of dt here! */
+		spf = (float)clmd->sim_parms->stepsPerFrame / clmd->sim_parms->timescale;
+
+		d = clmd->coll_parms->epsilon*8.0f/9.0f + epsilon2*8.0f/9.0f - collpair->distance;
+		if ( ( magrelVel < 0.1f*d*spf ) && ( d > ALMOST_ZERO ) ) {
+			repulse = MIN2 ( d*1.0f/spf, 0.1f*d*spf - magrelVel );
 
-			result = 1;
+			/* stay on the safe side and clamp repulse */
+			if ( impulse > ALMOST_ZERO )
+				repulse = min_ff( repulse, 5.0*impulse );
+			repulse = max_ff(impulse, repulse);
+
+			impulse = repulse / ( 1.0f + w1*w1 + w2*w2 + w3*w3 ); /* original 2.0 / 0.25 */
+			VECADDMUL ( i1, collpair->normal,  impulse );
+			VECADDMUL ( i2, collpair->normal,  impulse );
+			VECADDMUL ( i3, collpair->normal,  impulse );
 		}
-		else {
-			/* Apply repulse impulse if distance too short
-			 * I_r = -min(dt*kd, max(0, 1d/dt - v_n))
-			 * DG: this formula ineeds to be changed for this code since we apply impulses/repulses like this:
-			 * v += impulse; x_new = x + v;
-			 * We don't use dt!! */
-			float spf = (float)clmd->sim_parms->stepsPerFrame / clmd->sim_parms->timescale;
 
-			float d = clmd->coll_parms->epsilon*8.0f/9.0f + epsilon2*8.0f/9.0f - (float)collpair->distance;
-			if ( d > ALMOST_ZERO) {
-				/* stay on the safe side and clamp repulse */
-				float repulse = d*1.0f/spf;
+		return true;
+	}
+	else {
+		/* Apply repulse impulse if distance too short
+		 * I_r = -min(dt*kd, max(0, 1d/dt - v_n))
+		 * DG: this formula ineeds to be changed for this code since we apply impulses/repulses like this:
+		 * v += impulse; x_new = x + v;
+		 * We don't use dt!! */
+		float spf = (float)clmd->sim_parms->stepsPerFrame / clmd->sim_parms->timescale;
 
-				float impulse = repulse / ( 3.0f * ( 1.0f + w1*w1 + w2*w2 + w3*w3 )); /* original 2.0 / 0.25 */
+		float d = clmd->coll_parms->epsilon*8.0f/9.0f + epsilon2*8.0f/9.0f - (float)collpair->distance;
+		if ( d > ALMOST_ZERO) {
+			/* stay on the safe side and clamp repulse */
+			float repulse = d*1.0f/spf;
 
-				VECADDMUL ( i1, collpair->normal,  impulse );
-				VECADDMUL ( i2, collpair->normal,  impulse );
-				VECADDMUL ( i3, collpair->normal,  impulse );
+			float impulse = repulse / ( 3.0f * ( 1.0f + w1*w1 + w2*w2 + w3*w3 )); /* original 2.0 / 0.25 */
 
-				cloth1->verts[collpair->ap1].impulse_count++;
-				cloth1->verts[collpair->ap2].impulse_count++;
-				cloth1->verts[collpair->ap3].impulse_count++;
+			VECADDMUL ( i1, collpair->normal,  impulse );
+			VECADDMUL ( i2, collpair->normal,  impulse );
+			VECADDMUL ( i3, collpair->normal,  impulse );
 
-				result = 1;
-			}
+			return true;
 		}
+	}
 
-		if (result) {
-			int i = 0;
+	return false;
+}
 
-			for (i = 0; i < 3; i++) {
-				if (cloth1->verts[collpair->ap1].impulse_count > 0 && ABS(cloth1->verts[collpair->ap1].impulse[i]) < ABS(i1[i]))
-					cloth1->verts[collpair->ap1].impulse[i] = i1[i];
+typedef struct CollisionResponseData {
+	ClothModifierData *clmd;
+	CollisionModifierData *collmd;
+	CollPair *collisions;
+	CollPairImpulse *impulses;
+} CollisionResponseData;
 
-				if (cloth1->verts[collpair->ap2].impulse_count > 0 && ABS(cloth1->verts[collpair->ap2].impulse[i]) < ABS(i2[i]))
-					cloth1->verts[collpair->ap2].impulse[i] = i2[i];
+static void cloth_collision_response_static_cb(void *userdata, const int index)
+{
+	CollisionResponseData *data = userdata;
+	CollPairImpulse *impulse = &data->impulses[index];
 
-				if (cloth1->verts[collpair->ap3].impulse_count > 0 && ABS(cloth1->verts[collpair->ap3].impulse[i]) < ABS(i3[i]))
-					cloth1->verts[collpair->ap3].impulse[i] = i3[i];
-			}
+	impulse->result = cloth_collision_impulse_static(
+	        data->clmd, data->collmd, &data->collisions[index], impulse->i1, impulse->i2, impulse->i3);
+}
+
+static int cloth_collision_response_static ( ClothModifierData *clmd, CollisionModifierData *collmd, CollPair *collpair, CollPair *collision_end )
+{
+	ClothVertex *verts = clmd->clothObject->verts;
+	const int collisions_num = (int)(collision_end - collpair);
+	CollisionResponseData data;
+	CollPairImpulse *impulses;
+	int result = 0;
+	int i, j;
+
+	if (collisions_num == 0)
+		return 0;
+
+	impulses = MEM_mallocN(sizeof(*impulses) * (size_t)collisions_num, __func__);
+
+	data.clmd = clmd;
+	data.collmd = collmd;
+	data.collisions = collpair;
+	data.impulses = impulses;
+
+	BLI_task_parallel_range(0, collisions_num, &data, cloth_collision_response_static_cb,
+	                        collisions_num > COLLISION_PARALLEL_MIN);
+
+	/* Keep the largest impulse per vertex and axis, going over the pairs in order
+	 * so the result does not depend on the number of threads. */
+	for (i = 0; i < collisions_num; i++) {
+		const CollPair *cp = &collpair[i];
+		const CollPairImpulse *impulse = &impulses[i];
+
+		if (!impulse->result)
+			continue;
+
+		verts[cp->ap1].impulse_count++;
+		verts[cp->ap2].impulse_count++;
+		verts[cp->ap3].impulse_count++;
+
+		for (j = 0; j < 3; j++) {
+			if (ABS(verts[cp->ap1].impulse[j]) < ABS(impulse->i1[j]))
+				verts[cp->ap1].impulse[j] = impulse->i1[j];
+
+			if (ABS(verts[cp->ap2].impulse[j]) < ABS(impulse->i2[j]))
+				verts[cp->ap2].impulse[j] = impulse->i2[j];
+
+			if (ABS(verts[cp->ap3].impulse[j]) < ABS(impulse->i3[j]))
+				verts[cp->ap3].impulse[j] = impulse->i3[j];
 		}
+
+		result = 1;
 	}
+
+	MEM_freeN(impulses);
+
 	return result;
 }
 
@@ -619,18 +679,107 @@ void free_collider_cache(ListBase **colliders)
 }
 
 
-static void cloth_bvh_objcollisions_nearcheck ( ClothModifierData * clmd, CollisionModifierData *collmd,
-	CollPair **collisions, CollPair **collisions_index, int numresult, BVHTreeOverlap *overlap, double dt)
+/* Overlapping triangle pairs of the cloth with one collision object. */
+typedef struct ColliderOverlap {
+	CollisionModifierData *collmd;
+	BVHTreeOverlap *overlap;
+	unsigned int overlap_num;
+
+	/* One slot per overlap, only the first (collisions_end - collisions) are actual collisions. */
+	CollPair *collisions;
+	CollPair *collisions_end;
+} ColliderOverlap;
+
+/* Consecutive range of overlaps of one collider, checked by a single task. */
+typedef struct ColliderOverlapBatch {
+	ColliderOverlap *collider;
+	unsigned int start, end;
+	unsigned int collisions_num;
+} ColliderOverlapBatch;
+
+typedef struct CollisionNearcheckData {
+	ClothModifierData *clmd;
+	ColliderOverlapBatch *batches;
+	float dt;
+} CollisionNearcheckData;
+
+static void cloth_bvh_objcollisions_nearcheck_cb(void *userdata, const int index)
 {
-	int i;
-	
-	*collisions = (CollPair *) MEM_mallocN(sizeof(CollPair) * numresult * 4, "collision array" ); // * 4 since cloth_collision_static can return more than 1 collision
-	*collisions_index = *collisions;
+	CollisionNearcheckData *data = userdata;
+	ColliderOverlapBatch *batch = &data->batches[index];
+	ColliderOverlap *collider = batch->collider;
+	CollPair *collisions = collider->collisions + batch->start;
+	CollPair *collisions_index = collisions;
+	unsigned int i;
+
+	for (i = batch->start; i < batch->end; i++) {
+		collisions_index = cloth_collision((ModifierData *)data->clmd, (ModifierData *)collider->collmd,
+		                                   &collider->overlap[i], collisions_index, data->dt);
+	}
 
-	for ( i = 0; i < numresult; i++ ) {
-		*collisions_index = cloth_collision((ModifierData *)clmd, (ModifierData *)collmd,
-		                                    overlap+i, *collisions_index, dt);
+	batch->collisions_num = (unsigned int)(collisions_index - collisions);
+}
+
+/* Check if collisions really happen (costly near check), for all colliders at once.
+ * Every batch of overlaps writes into its own part of the collider's array, the
+ * parts are then packed in order, so the result does not depend on threading. */
+static void cloth_bvh_objcollisions_nearcheck(
+        ClothModifierData *clmd, ColliderOverlap *colliders, unsigned int colliders_num, float dt)
+{
+	CollisionNearcheckData data;
+	ColliderOverlapBatch *batches;
+	unsigned int overlap_tot = 0, batches_num = 0;
+	unsigned int i, j;
+
+	for (i = 0; i < colliders_num; i++) {
+		ColliderOverlap *collider = &colliders[i];
+
+		if (collider->overlap_num == 0)
+			continue;
+
+		/* cloth_collision() returns at most one collision per overlap */
+		collider->collisions = MEM_mallocN(sizeof(CollPair) * collider->overlap_num, "collision array");
+		collider->collisions_end = collider->collisions;
+
+		overlap_tot += collider->overlap_num;
+		batches_num += (collider->overlap_num + COLLISION_OVERLAP_BATCH - 1) / COLLISION_OVERLAP_BATCH;
 	}
+
+	if (batches_num == 0)
+		return;
+
+	batches = MEM_mallocN(sizeof(*batches) * batches_num, __func__);
+
+	for (i = 0, j = 0; i < colliders_num; i++) {
+		ColliderOverlap *collider = &colliders[i];
+		unsigned int start;
+
+		for (start = 0; start < collider->overlap_num; start += COLLISION_OVERLAP_BATCH, j++) {
+			batches[j].collider = collider;
+			batches[j].start = start;
+			batches[j].end = MIN2(start + COLLISION_OVERLAP_BATCH, collider->overlap_num);
+			batches[j].collisions_num = 0;
+		}
+	}
+
+	data.clmd = clmd;
+	data.batches = batches;
+	data.dt = dt;
+
+	BLI_task_parallel_range(0, (int)batches_num, &data, cloth_bvh_objcollisions_nearcheck_cb,
+	                        overlap_tot > COLLISION_PARALLEL_MIN);
+
+	for (j = 0; j < batches_num; j++) {
+		ColliderOverlap *collider = batches[j].collider;
+
+		if (batches[j].collisions_num) {
+			memmove(collider->collisions_end, collider->collisions + batches[j].start,
+			        sizeof(CollPair) * batches[j].collisions_num);
+			collider->collisions_end += batches[j].collisions_num;
+		}
+	}
+
+	MEM_freeN(batches);
 }
 
 static int cloth_bvh_objcollisions_resolve ( ClothModifierData * clmd, CollisionModifierData *collmd, CollPair *collisions, CollPair *collisions_index)
@@ -675,6 +824,43 @@ static int cloth_bvh_objcollisions_resolve ( ClothModifierData * clmd, Collision
 	return ret;
 }
 
+typedef struct SelfCollisionFilterData {
+	ClothModifierData *clmd;
+	const BVHTreeOverlap *overlap;
+	bool *skip;
+} SelfCollisionFilterData;
+
+/* Tags self collision pairs which never collide, independent of the vertex positions. */
+static void cloth_selfcollision_filter_cb(void *userdata, const int index)
+{
+	SelfCollisionFilterData *data = userdata;
+	ClothModifierData *clmd = data->clmd;
+	Cloth *cloth = clmd->clothObject;
+	const unsigned int i = data->overlap[index].indexA;
+	const unsigned int j = data->overlap[index].indexB;
+	bool skip = false;
+
+	if ( clmd->sim_parms->flags & CLOTH_SIMSETTINGS_FLAG_GOAL ) {
+		if ( ( cloth->verts [i].flags & CLOTH_VERT_FLAG_PINNED ) &&
+		     ( cloth->verts [j].flags & CLOTH_VERT_FLAG_PINNED ) )
+		{
+			skip = true;
+		}
+	}
+
+	if ((cloth->verts[i].flags & CLOTH_VERT_FLAG_NOSELFCOLL) ||
+	    (cloth->verts[j].flags & CLOTH_VERT_FLAG_NOSELFCOLL))
+	{
+		skip = true;
+	}
+
+	if (!skip && BLI_edgeset_haskey(cloth->edgeset, i, j)) {
+		skip = true;
+	}
+
+	data->skip[index] = skip;
+}
+
 // cloth - object collisions
 int cloth_bvh_objcollision(Object *ob, ClothModifierData *clmd, float step, float dt )
 {
@@ -720,48 +906,46 @@ int cloth_bvh_objcollision(Object *ob, ClothModifierData *clmd, float step, floa
 	}
 
 	do {
-		CollPair **collisions, **collisions_index;
+		ColliderOverlap *colliders;
 		
 		ret2 = 0;
 
-		collisions = MEM_callocN(sizeof(CollPair *) *numcollobj, "CollPair");
-		collisions_index = MEM_callocN(sizeof(CollPair *) *numcollobj, "CollPair");
+		colliders = MEM_callocN(sizeof(ColliderOverlap) * numcollobj, "ColliderOverlap");
 		
 		// check all collision objects
 		for (i = 0; i < numcollobj; i++) {
 			Object *collob= collobjs[i];
 			CollisionModifierData *collmd = (CollisionModifierData *)modifiers_findByType(collob, eModifierType_Collision);
-			BVHTreeOverlap *overlap = NULL;
-			unsigned int result = 0;
 			
+			colliders[i].collmd = collmd;
+
 			if (!collmd->bvhtree)
 				continue;
 			
 			/* search for overlapping collision pairs */
-			overlap = BLI_bvhtree_overlap(cloth_bvh, collmd->bvhtree, &result, NULL, NULL);
-				
+			colliders[i].overlap = BLI_bvhtree_overlap(cloth_bvh, collmd->bvhtree, &colliders[i].overlap_num, NULL, NULL);
+		}
+
+		cloth_bvh_objcollisions_nearcheck(clmd, colliders, numcollobj, dt / (float)clmd->coll_parms->loop_count);
+
+		/* Colliders are resolved one after the other, each one sees the velocities
+		 * left by the previous ones. */
+		for (i = 0; i < numcollobj; i++) {
 			// go to next object if no overlap is there
-			if ( result && overlap ) {
-				/* check if collisions really happen (costly near check) */
-				cloth_bvh_objcollisions_nearcheck ( clmd, collmd, &collisions[i], 
-					&collisions_index[i], result, overlap, dt/(float)clmd->coll_parms->loop_count);
-			
+			if (colliders[i].collisions) {
 				// resolve nearby collisions
-				ret += cloth_bvh_objcollisions_resolve ( clmd, collmd, collisions[i],  collisions_index[i]);
+				ret += cloth_bvh_objcollisions_resolve ( clmd, colliders[i].collmd, colliders[i].collisions, colliders[i].collisions_end);
 				ret2 += ret;
+
+				MEM_freeN(colliders[i].collisions);
 			}
 
-			if ( overlap )
-				MEM_freeN ( overlap );
+			if ( colliders[i].overlap )
+				MEM_freeN ( colliders[i].overlap );
 		}
 		rounds++;
-		
-		for (i = 0; i < numcollobj; i++) {
-			if ( collisions[i] ) MEM_freeN ( collisions[i] );
-		}
 			
-		MEM_freeN(collisions);
-		MEM_freeN(collisions_index);
+		MEM_freeN(colliders);
 
 		////////////////////////////////////////////////////////////
 		// update positions
@@ -799,42 +983,42 @@ int cloth_bvh_objcollision(Object *ob, ClothModifierData *clmd, float step, floa
 				verts = cloth->verts;
 	
 				if ( cloth->bvhselftree ) {
+					SelfCollisionFilterData filter_data;
+					bool *overlap_skip = NULL;
+
 					// search for overlapping collision pairs
 					overlap = BLI_bvhtree_overlap(cloth->bvhselftree, cloth->bvhselftree, &result, NULL, NULL);
+
+					if (result) {
+						overlap_skip = MEM_mallocN(sizeof(bool) * result, __func__);
+
+						filter_data.clmd = clmd;
+						filter_data.overlap = overlap;
+						filter_data.skip = overlap_skip;
+
+						BLI_task_parallel_range(0, (int)result, &filter_data, cloth_selfcollision_filter_cb,
+						                        result > COLLISION_PARALLEL_MIN);
+					}
 	
-	// #pragma omp parallel for private(k, i, j) schedule(static)
+					/* Corrections move the vertices of the following pairs, so they are applied in order. */
 					for ( k = 0; k < result; k++ ) {
 						float temp[3];
 						float length = 0;
 						float mindistance;
+
+						if (overlap_skip[k]) {
+							continue;
+						}
 	
 						i = overlap[k].indexA;
 						j = overlap[k].indexB;
 	
 						mindistance = clmd->coll_parms->selfepsilon* ( cloth->verts[i].avg_spring_len + cloth->verts[j].avg_spring_len );
 	
-						if ( clmd->sim_parms->flags & CLOTH_SIMSETTINGS_FLAG_GOAL ) {
-							if ( ( cloth->verts [i].flags & CLOTH_VERT_FLAG_PINNED ) &&
-							     ( cloth->verts [j].flags & CLOTH_VERT_FLAG_PINNED ) )
-							{
-								continue;
-							}
-						}
-
-						if ((cloth->verts[i].flags & CLOTH_VERT_FLAG_NOSELFCOLL) ||
-						    (cloth->verts[j].flags & CLOTH_VERT_FLAG_NOSELFCOLL))
-						{
-							continue;
-						}
-	
 						sub_v3_v3v3(temp, verts[i].tx, verts[j].tx);
 	
 						if ( ( ABS ( temp[0] ) > mindistance ) || ( ABS ( temp[1] ) > mindistance ) || ( ABS ( temp[2] ) > mindistance ) ) continue;
 	
-						if (BLI_edgeset_haskey(cloth->edgeset, i, j)) {
-							continue;
-						}
-	
 						length = normalize_v3(temp );
 	
 						if ( length < mindistance ) {
@@ -864,6 +1048,8 @@ int cloth_bvh_objcollision(Object *ob, ClothModifierData *clmd, float step, floa
 	
 					if ( overlap )
 						MEM_freeN ( overlap );
+					if ( overlap_skip )
+						MEM_freeN ( overlap_skip );
 	
 				}
 			}
@@ -0,0 +1,571 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2016 Blender Foundation.
+ * All rights reserved.
+ *
+ * Contributor(s): none yet.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenkernel/intern/fluidsim_meshseq.c
+ *  \ingroup bke
+ *
+ * Reading of baked fluid surface sequences, see LBM_meshseq.h for the layout.
+ *
+ * Sequence files are memory mapped and kept open until exit, their frame
+ * index is built by walking the record headers and extended whenever the
+ * file has grown, so frames can be viewed while the bake is still running.
+ * After reading a frame the records of its neighbors are handed to the OS
+ * for read-ahead, which hides most of the latency of network drives when
+ * scrubbing or playing back.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+
+#ifdef WIN32
+#  include <io.h>
+#  include "mmap_win.h"
+#else
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+#include "MEM_guardedalloc.h"
+
+#include "DNA_meshdata_types.h"
+#include "DNA_object_fluidsim.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_fileops.h"
+#include "BLI_listbase.h"
+#include "BLI_math_base.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+#include "BLI_threads.h"
+
+#include "BKE_cdderivedmesh.h"
+#include "BKE_DerivedMesh.h"
+#include "BKE_fluidsim.h"
+#include "BKE_global.h"
+
+#ifdef WITH_MOD_FLUID
+
+#include <zlib.h>
+
+#include "LBM_meshseq.h"
+
+/* neighbors read ahead after loading a frame, ahead of and behind it */
+#define MESHSEQ_PREFETCH_AHEAD   2
+#define MESHSEQ_PREFETCH_BEHIND  1
+
+typedef struct FluidMeshSeq {
+	struct FluidMeshSeq *next, *prev;
+
+	char filepath[FILE_MAX];
+
+	int file;
+	const unsigned char *map;
+	size_t map_len;
+
+	/* record offset of each frame, zero when missing */
+	uint64_t *frames;
+	int frames_len;
+	/* records before this offset are indexed */
+	uint64_t scan_offset;
+
+	/* last decoded topology, shared by all frames until the triangles change */
+	uint64_t topology_offset;
+	int (*tris)[3];
+	int tottri;
+} FluidMeshSeq;
+
+static ThreadMutex meshseq_lock = BLI_MUTEX_INITIALIZER;
+static ListBase meshseq_list = {NULL, NULL};
+
+static void meshseq_unmap(FluidMeshSeq *seq)
+{
+	if (seq->map) {
+		munmap((void *)seq->map, seq->map_len);
+		seq->map = NULL;
+		seq->map_len = 0;
+	}
+}
+
+static void meshseq_reset(FluidMeshSeq *seq)
+{
+	meshseq_unmap(seq);
+
+	MEM_SAFE_FREE(seq->frames);
+	MEM_SAFE_FREE(seq->tris);
+	seq->frames_len = 0;
+	seq->scan_offset = 0;
+	seq->topology_offset = 0;
+	seq->tottri = 0;
+}
+
+static void meshseq_free(FluidMeshSeq *seq)
+{
+	meshseq_reset(seq);
+
+	if (seq->file != -1) {
+		close(seq->file);
+	}
+
+	MEM_freeN(seq);
+}
+
+/* Record header at the given offset, false if it is not complete (yet). */
+static bool meshseq_record_get(
+        const FluidMeshSeq *seq, uint64_t offset, LbmMeshSeqRecord *r_rec, uint64_t *r_next)
+{
+	if (offset + sizeof(*r_rec) > seq->map_len) {
+		return false;
+	}
+
+	/* records are not aligned in the file */
+	memcpy(r_rec, seq->map + offset, sizeof(*r_rec));
+	*r_next = offset + sizeof(*r_rec) + r_rec->head_len + r_rec->stored_len;
+
+	return (*r_next <= seq->map_len);
+}
+
+static void meshseq_frame_set(FluidMeshSeq *seq, int frame, uint64_t offset)
+{
+	if (frame >= seq->frames_len) {
+		int frames_len = max_ii(frame + 1, seq->frames_len * 2);
+
+		if (seq->frames) {
+			seq->frames = MEM_recallocN(seq->frames, sizeof(*seq->frames) * frames_len);
+		}
+		else {
+			seq->frames = MEM_callocN(sizeof(*seq->frames) * frames_len, "fluid meshseq frames");
+		}
+		seq->frames_len = frames_len;
+	}
+
+	/* a frame written again replaces the old one */
+	seq->frames[frame] = offset;
+}
+
+/* Map the file again when it has grown and index the new records. */
+static bool meshseq_update(FluidMeshSeq *seq)
+{
+	LbmMeshSeqRecord rec;
+	LbmMeshSeqFrame head;
+	uint64_t offset, next;
+	size_t len;
+	void *map;
+
+	if (seq->file == -1) {
+		seq->file = BLI_open(seq->filepath, O_BINARY | O_RDONLY, 0);
+		if (seq->file == -1) {
+			return false;
+		}
+	}
+
+	len = BLI_file_descriptor_size(seq->file);
+	if (len == (size_t)-1) {
+		return false;
+	}
+
+	if (len < seq->scan_offset) {
+		/* rewritten by a new bake */
+		meshseq_reset(seq);
+	}
+
+	if (len != seq->map_len) {
+		meshseq_unmap(seq);
+
+		if (len == 0) {
+			return false;
+		}
+
+		map = mmap(NULL, len, PROT_READ, MAP_SHARED, seq->file, 0);
+		if (map == (void *)-1) {
+			if (G.debug & G_DEBUG)
+				printf("%s: couldn't map %s\n", __func__, seq->filepath);
+			return false;
+		}
+
+		seq->map = map;
+		seq->map_len = len;
+	}
+
+	if (seq->scan_offset == 0) {
+		LbmMeshSeqHeader header;
+
+		if (seq->map_len < sizeof(header)) {
+			return false;
+		}
+
+		memcpy(&header, seq->map, sizeof(header));
+		if (memcmp(header.id, LBM_MESHSEQ_ID, sizeof(header.id)) != 0 ||
+		    header.version != LBM_MESHSEQ_VERSION)
+		{
+			printf("Fluidsim: %s is not a supported surface sequence file.\n", seq->filepath);
+			return false;
+		}
+
+		seq->scan_offset = sizeof(header);
+	}
+
+	for (offset = seq->scan_offset; meshseq_record_get(seq, offset, &rec, &next); offset = next) {
+		if (memcmp(rec.id, LBM_MESHSEQ_FRAME_ID, sizeof(rec.id)) == 0 && rec.head_len >= sizeof(head)) {
+			memcpy(&head, seq->map + offset + sizeof(rec), sizeof(head));
+
+			if (head.frame >= 0) {
+				meshseq_frame_set(seq, head.frame, offset);
+			}
+		}
+	}
+
+	seq->scan_offset = offset;
+
+	return true;
+}
+
+static FluidMeshSeq *meshseq_find(const char *filepath)
+{
+	FluidMeshSeq *seq;
+
+	for (seq = meshseq_list.first; seq; seq = seq->next) {
+		if (BLI_path_cmp(seq->filepath, filepath) == 0) {
+			break;
+		}
+	}
+
+	return seq;
+}
+
+static FluidMeshSeq *meshseq_ensure(const char *filepath)
+{
+	FluidMeshSeq *seq = meshseq_find(filepath);
+
+	if (seq == NULL) {
+		if (!BLI_exists(filepath)) {
+			return NULL;
+		}
+
+		seq = MEM_callocN(sizeof(FluidMeshSeq), "FluidMeshSeq");
+		BLI_strncpy(seq->filepath, filepath, sizeof(seq->filepath));
+		seq->file = -1;
+
+		BLI_addtail(&meshseq_list, seq);
+	}
+
+	return seq;
+}
+
+static uint64_t meshseq_frame_offset(const FluidMeshSeq *seq, int frame)
+{
+	return (frame >= 0 && frame < seq->frames_len) ? seq->frames[frame] : 0;
+}
+
+/* Decompress the payload of the record at offset, to be freed with MEM_freeN. */
+static void *meshseq_payload_read(
+        const FluidMeshSeq *seq, uint64_t offset, const char *id,
+        void *r_head, size_t head_len, unsigned int *r_len)
+{
+	LbmMeshSeqRecord rec;
+	uint64_t next;
+	uLongf raw_len;
+	void *raw;
+
+	if (!meshseq_record_get(seq, offset, &rec, &next) ||
+	    memcmp(rec.id, id, sizeof(rec.id)) != 0 ||
+	    rec.head_len < head_len)
+	{
+		return NULL;
+	}
+
+	memcpy(r_head, seq->map + offset + sizeof(rec), head_len);
+
+	raw = MEM_mallocN(MAX2(rec.raw_len, 1), "fluid meshseq payload");
+	raw_len = rec.raw_len;
+
+	if (uncompress(raw, &raw_len, seq->map + offset + sizeof(rec) + rec.head_len, rec.stored_len) != Z_OK ||
+	    raw_len != rec.raw_len)
+	{
+		MEM_freeN(raw);
+		return NULL;
+	}
+
+	*r_len = rec.raw_len;
+	return raw;
+}
+
+static bool meshseq_topology_ensure(FluidMeshSeq *seq, uint64_t offset, int totvert)
+{
+	LbmMeshSeqTopology head;
+	int (*tris)[3];
+	unsigned int len;
+	int i;
+
+	if (seq->tris && seq->topology_offset == offset) {
+		return true;
+	}
+
+	MEM_SAFE_FREE(seq->tris);
+	seq->topology_offset = 0;
+	seq->tottri = 0;
+
+	tris = meshseq_payload_read(seq, offset, LBM_MESHSEQ_TOPOLOGY_ID, &head, sizeof(head), &len);
+	if (tris == NULL) {
+		return false;
+	}
+
+	if (head.tottri < 0 || len != sizeof(int[3]) * (unsigned int)head.tottri) {
+		MEM_freeN(tris);
+		return false;
+	}
+
+	/* don't trust the file with indices */
+	for (i = 0; i < head.tottri; i++) {
+		if ((unsigned int)tris[i][0] >= (unsigned int)totvert ||
+		    (unsigned int)tris[i][1] >= (unsigned int)totvert ||
+		    (unsigned int)tris[i][2] >= (unsigned int)totvert)
+		{
+			MEM_freeN(tris);
+			return false;
+		}
+	}
+
+	seq->tris = tris;
+	seq->tottri = head.tottri;
+	seq->topology_offset = offset;
+
+	return true;
+}
+
+static void meshseq_prefetch(const FluidMeshSeq *seq, int frame)
+{
+#ifndef WIN32
+	const uint64_t page_size = (uint64_t)sysconf(_SC_PAGESIZE);
+	int f;
+
+	for (f = frame - MESHSEQ_PREFETCH_BEHIND; f <= frame + MESHSEQ_PREFETCH_AHEAD; f++) {
+		const uint64_t offset = meshseq_frame_offset(seq, f);
+		LbmMeshSeqRecord rec;
+		uint64_t next, start;
+
+		if (f == frame || offset == 0 || !meshseq_record_get(seq, offset, &rec, &next)) {
+			continue;
+		}
+
+		start = offset - (offset % page_size);
+		posix_madvise((void *)(seq->map + start), next - start, POSIX_MADV_WILLNEED);
+	}
+#else
+	(void)seq;
+	(void)frame;
+#endif
+}
+
+static DerivedMesh *meshseq_frame_read(
+        FluidMeshSeq *seq, int frame, const MPoly *mp_example, FluidVertexVelocity **r_velocities)
+{
+	const uint64_t offset = meshseq_frame_offset(seq, frame);
+	LbmMeshSeqFrame head;
+	const unsigned short *co;
+	short (*normals)[3];
+	unsigned int len, vert_len;
+	void *raw;
+	DerivedMesh *dm;
+	MVert *mv;
+	MPoly *mp;
+	MLoop *ml;
+	int i;
+
+	if (offset == 0) {
+		return NULL;
+	}
+
+	raw = meshseq_payload_read(seq, offset, LBM_MESHSEQ_FRAME_ID, &head, sizeof(head), &len);
+	if (raw == NULL) {
+		printf("Fluidsim: error reading frame %d from %s.\n", frame, seq->filepath);
+		return NULL;
+	}
+
+	vert_len = sizeof(unsigned short[3]) + sizeof(short[3]) +
+	           ((head.flag & LBM_MESHSEQ_FRAME_VELOCITY) ? sizeof(float[3]) : 0);
+
+	if (head.totvert <= 0 || len != vert_len * (unsigned int)head.totvert ||
+	    !meshseq_topology_ensure(seq, head.topology_offset, head.totvert) || seq->tottri == 0)
+	{
+		/* empty surface or damaged file, show the original mesh */
+		MEM_freeN(raw);
+		return NULL;
+	}
+
+	co = raw;
+	normals = (short (*)[3])(co + head.totvert * 3);
+
+	dm = CDDM_new(head.totvert, 0, 0, seq->tottri * 3, seq->tottri);
+
+	mv = CDDM_get_verts(dm);
+	for (i = 0; i < head.totvert; i++, mv++, co += 3) {
+		mv->co[0] = head.co_min[0] + head.co_size[0] * ((float)co[0] / LBM_MESHSEQ_CO_RANGE);
+		mv->co[1] = head.co_min[1] + head.co_size[1] * ((float)co[1] / LBM_MESHSEQ_CO_RANGE);
+		mv->co[2] = head.co_min[2] + head.co_size[2] * ((float)co[2] / LBM_MESHSEQ_CO_RANGE);
+	}
+
+	mp = CDDM_get_polys(dm);
+	ml = CDDM_get_loops(dm);
+	for (i = 0; i < seq->tottri; i++, mp++, ml += 3) {
+		/* initialize from existing face */
+		mp->mat_nr = mp_example->mat_nr;
+		mp->flag =   mp_example->flag;
+
+		mp->loopstart = i * 3;
+		mp->totloop = 3;
+
+		ml[0].v = seq->tris[i][0];
+		ml[1].v = seq->tris[i][1];
+		ml[2].v = seq->tris[i][2];
+	}
+
+	CDDM_calc_edges(dm);
+	CDDM_apply_vert_normals(dm, normals);
+
+	if (r_velocities) {
+		if (head.flag & LBM_MESHSEQ_FRAME_VELOCITY) {
+			*r_velocities = MEM_mallocN(sizeof(FluidVertexVelocity) * head.totvert, "Fluidsim_velocities");
+			memcpy(*r_velocities, normals + head.totvert, sizeof(FluidVertexVelocity) * head.totvert);
+		}
+		else {
+			*r_velocities = NULL;
+		}
+	}
+
+	MEM_freeN(raw);
+
+	return dm;
+}
+
+/**
+ * Read a frame from a surface sequence file, returns NULL when the file or
+ * the frame does not exist. Velocities are only returned if they were baked.
+ */
+DerivedMesh *BKE_fluidsim_meshseq_read(
+        const char *filepath, int frame, const MPoly *mp_example, FluidVertexVelocity **r_velocities)
+{
+	FluidMeshSeq *seq;
+	DerivedMesh *dm = NULL;
+
+	if (r_velocities) {
+		*r_velocities = NULL;
+	}
+
+	BLI_mutex_lock(&meshseq_lock);
+
+	seq = meshseq_ensure(filepath);
+
+	/* only look for new records when the frame is not known yet */
+	if (seq && (meshseq_frame_offset(seq, frame) != 0 || meshseq_update(seq))) {
+		dm = meshseq_frame_read(seq, frame, mp_example, r_velocities);
+
+		if (dm) {
+			meshseq_prefetch(seq, frame);
+		}
+	}
+
+	BLI_mutex_unlock(&meshseq_lock);
+
+	return dm;
+}
+
+/**
+ * Last frame of the sequence counting up from the first one, or -1 when
+ * there is no sequence file.
+ */
+int BKE_fluidsim_meshseq_last_frame(const char *filepath)
+{
+	FluidMeshSeq *seq;
+	int frame = -1;
+
+	BLI_mutex_lock(&meshseq_lock);
+
+	seq = meshseq_ensure(filepath);
+
+	if (seq && meshseq_update(seq)) {
+		for (frame = 1; meshseq_frame_offset(seq, frame) != 0; frame++) {
+			/* pass */
+		}
+		frame--;
+	}
+
+	BLI_mutex_unlock(&meshseq_lock);
+
+	return frame;
+}
+
+/* Close the file, for when it is about to be deleted or rewritten. */
+void BKE_fluidsim_meshseq_forget(const char *filepath)
+{
+	FluidMeshSeq *seq;
+
+	BLI_mutex_lock(&meshseq_lock);
+
+	seq = meshseq_find(filepath);
+	if (seq) {
+		BLI_remlink(&meshseq_list, seq);
+		meshseq_free(seq);
+	}
+
+	BLI_mutex_unlock(&meshseq_lock);
+}
+
+void BKE_fluidsim_meshseq_exit(void)
+{
+	FluidMeshSeq *seq;
+
+	while ((seq = BLI_pophead(&meshseq_list))) {
+		meshseq_free(seq);
+	}
+}
+
+#else  /* WITH_MOD_FLUID */
+
+DerivedMesh *BKE_fluidsim_meshseq_read(
+        const char *UNUSED(filepath), int UNUSED(frame), const MPoly *UNUSED(mp_example),
+        FluidVertexVelocity **r_velocities)
+{
+	if (r_velocities) {
+		*r_velocities = NULL;
+	}
+	return NULL;
+}
+
+int BKE_fluidsim_meshseq_last_frame(const char *UNUSED(filepath))
+{
+	return -1;
+}
+
+void BKE_fluidsim_meshseq_forget(const char *UNUSED(filepath))
+{
+}
+
+void BKE_fluidsim_meshseq_exit(void)
+{
+}
+
+#endif  /* WITH_MOD_FLUID */
@@ -60,6 +60,7 @@
 #include "BKE_key.h"
 #include "BKE_multires.h"
 #include "BKE_DerivedMesh.h"
+#include "BKE_modifier_cache.h"
 
 /* may move these, only for modifier_path_relbase */
 #include "BKE_global.h" /* ugh, G.main->name only */
@@ -140,6 +141,8 @@ void modifier_free(ModifierData *md)
 	if (mti->freeData) mti->freeData(md);
 	if (md->error) MEM_freeN(md->error);
 
+	BKE_modifier_cache_discard(md);
+
 	MEM_freeN(md);
 }
 
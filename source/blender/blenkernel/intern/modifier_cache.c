@@ -0,0 +1,600 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2016 Blender Foundation.
+ * All rights reserved.
+ *
+ * Contributor(s): none yet.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenkernel/intern/modifier_cache.c
+ *  \ingroup bke
+ *
+ * Memory limited LRU cache of intermediate modifier stack results.
+ *
+ * There is at most one entry per modifier, it holds a private copy of the
+ * modifier's result together with the key it was computed for. A key is
+ * chained from the key of the previous modifier in the stack, so a match
+ * means the whole stack above (including its input mesh) is unchanged.
+ */
+
+#include <string.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_modifier_types.h"
+#include "DNA_object_types.h"
+#include "DNA_scene_types.h"
+#include "DNA_userdef_types.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_ghash.h"
+#include "BLI_hash_mm2a.h"
+#include "BLI_listbase.h"
+#include "BLI_threads.h"
+
+#include "BKE_cdderivedmesh.h"
+#include "BKE_customdata.h"
+#include "BKE_DerivedMesh.h"
+#include "BKE_deform.h"
+#include "BKE_modifier.h"
+#include "BKE_modifier_cache.h"
+
+#include "RNA_access.h"
+
+/* Seeds of the two independent hash streams forming a key. */
+#define MODCACHE_SEED_A 0x1dc7e81bu
+#define MODCACHE_SEED_B 0x7f4a7c15u
+
+struct ModifierCacheEntry {
+	struct ModifierCacheEntry *next, *prev;
+
+	ModifierData *md;
+	ModifierCacheKey key;
+	DerivedMesh *dm;
+	size_t size;
+
+	/* Number of evaluations currently reading the entry, it can't be freed while used. */
+	int users;
+	/* Entry was removed from the cache while in use, free it on last release. */
+	bool is_orphan;
+};
+
+typedef struct ModifierCacheHash {
+	BLI_HashMurmur2A a, b;
+} ModifierCacheHash;
+
+static struct {
+	GHash *entries;          /* ModifierData -> ModifierCacheEntry */
+	ListBase lru;            /* least recently used entry first */
+	size_t memory_in_use;
+	ThreadMutex mutex;
+} modcache = {NULL};
+
+/* -------------------------------------------------------------------- */
+/** \name Hashing
+ * \{ */
+
+static void modcache_hash_init(ModifierCacheHash *mh)
+{
+	BLI_hash_mm2a_init(&mh->a, MODCACHE_SEED_A);
+	BLI_hash_mm2a_init(&mh->b, MODCACHE_SEED_B);
+}
+
+static void modcache_hash_add(ModifierCacheHash *mh, const void *data, size_t len)
+{
+	BLI_hash_mm2a_add(&mh->a, data, len);
+	BLI_hash_mm2a_add(&mh->b, data, len);
+}
+
+static void modcache_hash_add_int(ModifierCacheHash *mh, int data)
+{
+	BLI_hash_mm2a_add_int(&mh->a, data);
+	BLI_hash_mm2a_add_int(&mh->b, data);
+}
+
+static void modcache_hash_end(ModifierCacheHash *mh, ModifierCacheKey *r_key)
+{
+	r_key->hash[0] = BLI_hash_mm2a_end(&mh->a);
+	r_key->hash[1] = BLI_hash_mm2a_end(&mh->b);
+}
+
+static void modcache_hash_customdata(ModifierCacheHash *mh, const CustomData *data, int totelem)
+{
+	int i;
+
+	modcache_hash_add_int(mh, totelem);
+	modcache_hash_add_int(mh, data->totlayer);
+
+	for (i = 0; i < data->totlayer; i++) {
+		const CustomDataLayer *layer = &data->layers[i];
+
+		modcache_hash_add_int(mh, layer->type);
+		modcache_hash_add_int(mh, layer->flag);
+		modcache_hash_add(mh, layer->name, strlen(layer->name));
+
+		if (layer->data == NULL) {
+			continue;
+		}
+
+		if (layer->type == CD_MDEFORMVERT) {
+			/* Weights live outside of the layer itself. */
+			const MDeformVert *dvert = layer->data;
+			int j;
+
+			for (j = 0; j < totelem; j++, dvert++) {
+				modcache_hash_add_int(mh, dvert->totweight);
+				if (dvert->totweight) {
+					modcache_hash_add(mh, dvert->dw, sizeof(*dvert->dw) * (size_t)dvert->totweight);
+				}
+			}
+		}
+		else {
+			modcache_hash_add(mh, layer->data, (size_t)CustomData_sizeof(layer->type) * (size_t)totelem);
+		}
+	}
+}
+
+static void modcache_hash_derivedmesh(ModifierCacheHash *mh, DerivedMesh *dm)
+{
+	const int totvert = dm->getNumVerts(dm);
+	MVert *mvert = dm->getVertArray(dm);
+	int i;
+
+	modcache_hash_add_int(mh, totvert);
+	modcache_hash_add_int(mh, dm->getNumEdges(dm));
+	modcache_hash_add_int(mh, dm->getNumLoops(dm));
+	modcache_hash_add_int(mh, dm->getNumPolys(dm));
+
+	for (i = 0; i < totvert; i++) {
+		modcache_hash_add(mh, mvert[i].co, sizeof(mvert[i].co));
+	}
+}
+
+/* Hash the user settings of the modifier, walking its RNA properties so
+ * runtime data and read-only outputs stored in the DNA struct are left out.
+ * Settings shared by all modifiers (name, visibility, ...) don't change the
+ * result, and linked data-blocks are hashed by #modcache_hash_id_link. */
+static void modcache_hash_modifier_settings(ModifierCacheHash *mh, Object *ob, ModifierData *md)
+{
+	PointerRNA ptr;
+
+	RNA_pointer_create(&ob->id, &RNA_Modifier, md, &ptr);
+
+	RNA_STRUCT_BEGIN (&ptr, prop)
+	{
+		const PropertyType type = RNA_property_type(prop);
+		const char *identifier = RNA_property_identifier(prop);
+		int len;
+
+		if (ELEM(type, PROP_POINTER, PROP_COLLECTION) ||
+		    (RNA_property_flag(prop) & PROP_EDITABLE) == 0 ||
+		    RNA_struct_type_find_property(&RNA_Modifier, identifier))
+		{
+			continue;
+		}
+
+		modcache_hash_add(mh, identifier, strlen(identifier));
+		len = RNA_property_array_length(&ptr, prop);
+
+		switch (type) {
+			case PROP_BOOLEAN:
+				if (len) {
+					int *values = MEM_mallocN(sizeof(int) * (size_t)len, __func__);
+					RNA_property_boolean_get_array(&ptr, prop, values);
+					modcache_hash_add(mh, values, sizeof(int) * (size_t)len);
+					MEM_freeN(values);
+				}
+				else {
+					modcache_hash_add_int(mh, RNA_property_boolean_get(&ptr, prop));
+				}
+				break;
+			case PROP_INT:
+				if (len) {
+					int *values = MEM_mallocN(sizeof(int) * (size_t)len, __func__);
+					RNA_property_int_get_array(&ptr, prop, values);
+					modcache_hash_add(mh, values, sizeof(int) * (size_t)len);
+					MEM_freeN(values);
+				}
+				else {
+					modcache_hash_add_int(mh, RNA_property_int_get(&ptr, prop));
+				}
+				break;
+			case PROP_FLOAT:
+				if (len) {
+					float *values = MEM_mallocN(sizeof(float) * (size_t)len, __func__);
+					RNA_property_float_get_array(&ptr, prop, values);
+					modcache_hash_add(mh, values, sizeof(float) * (size_t)len);
+					MEM_freeN(values);
+				}
+				else {
+					const float value = RNA_property_float_get(&ptr, prop);
+					modcache_hash_add(mh, &value, sizeof(value));
+				}
+				break;
+			case PROP_ENUM:
+				modcache_hash_add_int(mh, RNA_property_enum_get(&ptr, prop));
+				break;
+			case PROP_STRING:
+			{
+				char fixedbuf[256];
+				int str_len;
+				char *str = RNA_property_string_get_alloc(&ptr, prop, fixedbuf, sizeof(fixedbuf), &str_len);
+
+				modcache_hash_add(mh, str, (size_t)str_len + 1);
+				if (str != fixedbuf) {
+					MEM_freeN(str);
+				}
+				break;
+			}
+			default:
+				break;
+		}
+	}
+	RNA_STRUCT_END;
+}
+
+typedef struct ModifierCacheLinkData {
+	ModifierCacheHash *mh;
+	bool is_supported;
+} ModifierCacheLinkData;
+
+/* Only mesh objects with an evaluated result can be hashed, anything else
+ * (textures, curves, ...) makes the modifier uncacheable. */
+static void modcache_hash_id_link(void *userData, Object *UNUSED(ob), ID **idpoin, int UNUSED(cd_flag))
+{
+	ModifierCacheLinkData *data = userData;
+	ID *id = *idpoin;
+
+	if (id == NULL) {
+		return;
+	}
+
+	if (GS(id->name) == ID_OB) {
+		Object *link_ob = (Object *)id;
+
+		if (link_ob->type == OB_MESH && link_ob->derivedFinal) {
+			modcache_hash_add(data->mh, &link_ob, sizeof(link_ob));
+			modcache_hash_add(data->mh, link_ob->obmat, sizeof(link_ob->obmat));
+			modcache_hash_derivedmesh(data->mh, link_ob->derivedFinal);
+			return;
+		}
+	}
+
+	data->is_supported = false;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Keys
+ * \{ */
+
+/**
+ * Key of the un-modified mesh, the start of every key chain of the object.
+ */
+void BKE_modifier_cache_key_mesh(ModifierCacheKey *r_key, Object *ob, Mesh *me)
+{
+	ModifierCacheHash mh;
+	bDeformGroup *dg;
+
+	modcache_hash_init(&mh);
+
+	modcache_hash_customdata(&mh, &me->vdata, me->totvert);
+	modcache_hash_customdata(&mh, &me->edata, me->totedge);
+	modcache_hash_customdata(&mh, &me->ldata, me->totloop);
+	modcache_hash_customdata(&mh, &me->pdata, me->totpoly);
+	modcache_hash_add_int(&mh, me->flag);
+
+	/* Modifiers reference vertex groups by name. */
+	for (dg = ob->defbase.first; dg; dg = dg->next) {
+		modcache_hash_add(&mh, dg->name, strlen(dg->name) + 1);
+	}
+
+	modcache_hash_end(&mh, r_key);
+}
+
+/**
+ * Key of the result of \a md, given the key of its input mesh.
+ *
+ * \param deformedVerts: Coordinates overriding the input mesh ones, when any
+ * deform-only modifiers were applied in between.
+ * \return false when the result depends on data that can't be hashed,
+ * in which case the chain of keys is broken for the rest of the stack.
+ */
+bool BKE_modifier_cache_key_modifier(
+        ModifierCacheKey *r_key, const ModifierCacheKey *input,
+        Object *ob, ModifierData *md,
+        float (*deformedVerts)[3], int numVerts,
+        CustomDataMask mask, CustomDataMask nextmask, int app_flags)
+{
+	const ModifierTypeInfo *mti = modifierType_getInfo(md->type);
+	ModifierCacheHash mh;
+
+	modcache_hash_init(&mh);
+	modcache_hash_add(&mh, input->hash, sizeof(input->hash));
+
+	if (deformedVerts) {
+		modcache_hash_add_int(&mh, numVerts);
+		modcache_hash_add(&mh, deformedVerts, sizeof(*deformedVerts) * (size_t)numVerts);
+	}
+
+	modcache_hash_add(&mh, &mask, sizeof(mask));
+	modcache_hash_add(&mh, &nextmask, sizeof(nextmask));
+	modcache_hash_add_int(&mh, app_flags);
+
+	modcache_hash_add_int(&mh, md->type);
+	modcache_hash_modifier_settings(&mh, ob, md);
+
+	if (md->scene) {
+		const RenderData *rd = &md->scene->r;
+		modcache_hash_add_int(&mh, rd->mode & R_SIMPLIFY);
+		modcache_hash_add_int(&mh, rd->simplify_subsurf);
+	}
+
+	if (mti->foreachIDLink || mti->foreachObjectLink) {
+		ModifierCacheLinkData data = {&mh, true};
+
+		modcache_hash_add(&mh, ob->obmat, sizeof(ob->obmat));
+
+		if (mti->foreachIDLink) {
+			mti->foreachIDLink(md, ob, modcache_hash_id_link, &data);
+		}
+		else {
+			mti->foreachObjectLink(md, ob, (ObjectWalkFunc)modcache_hash_id_link, &data);
+		}
+
+		if (!data.is_supported) {
+			return false;
+		}
+	}
+
+	modcache_hash_end(&mh, r_key);
+	return true;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Cache
+ * \{ */
+
+static size_t modcache_limit(void)
+{
+	return ((size_t)U.modcachelimit) * 1024 * 1024;
+}
+
+static size_t modcache_customdata_size(const CustomData *data, int totelem)
+{
+	size_t size = 0;
+	int i;
+
+	for (i = 0; i < data->totlayer; i++) {
+		size += (size_t)CustomData_sizeof(data->layers[i].type) * (size_t)totelem;
+	}
+
+	return size;
+}
+
+static size_t modcache_derivedmesh_size(DerivedMesh *dm)
+{
+	return (modcache_customdata_size(&dm->vertData, dm->numVertData) +
+	        modcache_customdata_size(&dm->edgeData, dm->numEdgeData) +
+	        modcache_customdata_size(&dm->faceData, dm->numTessFaceData) +
+	        modcache_customdata_size(&dm->loopData, dm->numLoopData) +
+	        modcache_customdata_size(&dm->polyData, dm->numPolyData));
+}
+
+static void modcache_entry_free(ModifierCacheEntry *entry)
+{
+	entry->dm->release(entry->dm);
+	MEM_freeN(entry);
+}
+
+/* Remove the entry from the cache, caller must hold the lock. */
+static void modcache_entry_remove(ModifierCacheEntry *entry)
+{
+	BLI_ghash_remove(modcache.entries, entry->md, NULL, NULL);
+	BLI_remlink(&modcache.lru, entry);
+	modcache.memory_in_use -= entry->size;
+
+	if (entry->users) {
+		entry->is_orphan = true;
+	}
+	else {
+		modcache_entry_free(entry);
+	}
+}
+
+static void modcache_enforce_limit(void)
+{
+	const size_t limit = modcache_limit();
+	ModifierCacheEntry *entry, *entry_next;
+
+	for (entry = modcache.lru.first; entry && modcache.memory_in_use > limit; entry = entry_next) {
+		entry_next = entry->next;
+		modcache_entry_remove(entry);
+	}
+}
+
+void BKE_modifier_cache_init(void)
+{
+	modcache.entries = BLI_ghash_ptr_new(__func__);
+	BLI_listbase_clear(&modcache.lru);
+	modcache.memory_in_use = 0;
+	BLI_mutex_init(&modcache.mutex);
+}
+
+void BKE_modifier_cache_exit(void)
+{
+	BKE_modifier_cache_clear();
+
+	BLI_ghash_free(modcache.entries, NULL, NULL);
+	modcache.entries = NULL;
+	BLI_mutex_end(&modcache.mutex);
+}
+
+void BKE_modifier_cache_clear(void)
+{
+	ModifierCacheEntry *entry, *entry_next;
+
+	BLI_mutex_lock(&modcache.mutex);
+	for (entry = modcache.lru.first; entry; entry = entry_next) {
+		entry_next = entry->next;
+		modcache_entry_remove(entry);
+	}
+	BLI_mutex_unlock(&modcache.mutex);
+}
+
+/**
+ * Called when the modifier is freed, its entry can never be used again.
+ */
+void BKE_modifier_cache_discard(ModifierData *md)
+{
+	ModifierCacheEntry *entry;
+
+	if (modcache.entries == NULL) {
+		return;
+	}
+
+	BLI_mutex_lock(&modcache.mutex);
+	entry = BLI_ghash_lookup(modcache.entries, md);
+	if (entry) {
+		modcache_entry_remove(entry);
+	}
+	BLI_mutex_unlock(&modcache.mutex);
+}
+
+size_t BKE_modifier_cache_memory_in_use(void)
+{
+	return modcache.memory_in_use;
+}
+
+bool BKE_modifier_cache_is_enabled(void)
+{
+	return (modcache.entries != NULL) && (modcache_limit() != 0);
+}
+
+bool BKE_modifier_cache_supports(ModifierData *md)
+{
+	const ModifierTypeInfo *mti = modifierType_getInfo(md->type);
+
+	if ((mti->flags & eModifierTypeFlag_SupportsResultCache) == 0) {
+		return false;
+	}
+
+	if (mti->dependsOnTime && mti->dependsOnTime(md)) {
+		return false;
+	}
+
+	if (md->type == eModifierType_Subsurf && ((SubsurfModifierData *)md)->use_opensubdiv) {
+		/* Result might only exist on the GPU. */
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Find the cached result of \a md matching \a key.
+ * The entry is kept alive until #BKE_modifier_cache_release is called.
+ */
+ModifierCacheEntry *BKE_modifier_cache_acquire(ModifierData *md, const ModifierCacheKey *key)
+{
+	ModifierCacheEntry *entry;
+
+	BLI_mutex_lock(&modcache.mutex);
+	entry = BLI_ghash_lookup(modcache.entries, md);
+	if (entry) {
+		if (memcmp(&entry->key, key, sizeof(*key)) == 0) {
+			entry->users++;
+
+			/* Move to the most recently used end. */
+			BLI_remlink(&modcache.lru, entry);
+			BLI_addtail(&modcache.lru, entry);
+		}
+		else {
+			entry = NULL;
+		}
+	}
+	BLI_mutex_unlock(&modcache.mutex);
+
+	return entry;
+}
+
+/**
+ * \return a new DerivedMesh owned by the caller.
+ */
+DerivedMesh *BKE_modifier_cache_entry_copy(ModifierCacheEntry *entry)
+{
+	/* Cached mesh is never modified, copying without the lock is fine. */
+	return CDDM_copy(entry->dm);
+}
+
+void BKE_modifier_cache_release(ModifierCacheEntry *entry)
+{
+	bool do_free;
+
+	BLI_mutex_lock(&modcache.mutex);
+	entry->users--;
+	do_free = (entry->users == 0 && entry->is_orphan);
+	BLI_mutex_unlock(&modcache.mutex);
+
+	if (do_free) {
+		modcache_entry_free(entry);
+	}
+}
+
+/**
+ * Store a copy of \a dm as the result of \a md for \a key,
+ * replacing the previously cached result of the modifier.
+ */
+void BKE_modifier_cache_store(ModifierData *md, const ModifierCacheKey *key, DerivedMesh *dm)
+{
+	ModifierCacheEntry *entry, *entry_old;
+	const size_t size = modcache_derivedmesh_size(dm);
+
+	if (size > modcache_limit()) {
+		BKE_modifier_cache_discard(md);
+		return;
+	}
+
+	entry = MEM_callocN(sizeof(*entry), "ModifierCacheEntry");
+	entry->md = md;
+	entry->key = *key;
+	entry->dm = CDDM_copy(dm);
+	entry->size = size;
+
+	BLI_mutex_lock(&modcache.mutex);
+	entry_old = BLI_ghash_lookup(modcache.entries, md);
+	if (entry_old) {
+		modcache_entry_remove(entry_old);
+	}
+
+	BLI_ghash_insert(modcache.entries, md, entry);
+	BLI_addtail(&modcache.lru, entry);
+	modcache.memory_in_use += size;
+
+	modcache_enforce_limit();
+	BLI_mutex_unlock(&modcache.mutex);
+}
+
+/** \} */
@@ -241,13 +241,18 @@ static void init_complex(fftw_complex cmpl, float real, float image)
 	cmpl[1] = image;
 }
 
+static void mul_complex_f(fftw_complex res, fftw_complex cmpl, float f)
+{
+	res[0] = cmpl[0] * (double)f;
+	res[1] = cmpl[1] * (double)f;
+}
+
 #if 0   /* unused */
 static void add_complex_f(fftw_complex res, fftw_complex cmpl, float f)
 {
 	res[0] = cmpl[0] + f;
 	res[1] = cmpl[1];
 }
-#endif
 
 static void add_comlex_c(fftw_complex res, fftw_complex cmpl1, fftw_complex cmpl2)
 {
@@ -255,12 +260,6 @@ static void add_comlex_c(fftw_complex res, fftw_complex cmpl1, fftw_complex cmpl
 	res[1] = cmpl1[1] + cmpl2[1];
 }
 
-static void mul_complex_f(fftw_complex res, fftw_complex cmpl, float f)
-{
-	res[0] = cmpl[0] * (double)f;
-	res[1] = cmpl[1] * (double)f;
-}
-
 static void mul_complex_c(fftw_complex res, fftw_complex cmpl1, fftw_complex cmpl2)
 {
 	fftwf_complex temp;
@@ -293,6 +292,7 @@ static void exp_complex(fftw_complex res, fftw_complex cmpl)
 	res[0] = cosf(cmpl[1]) * r;
 	res[1] = sinf(cmpl[1]) * r;
 }
+#endif
 
 float BKE_ocean_jminus_to_foam(float jminus, float coverage)
 {
@@ -502,32 +502,70 @@ typedef struct OceanSimulateData {
 	float chop_amount;
 } OceanSimulateData;
 
-static void ocean_compute_htilda(void *userdata, const int i)
+/* Evaluates htilda and the input spectra of all enabled FFTs for one row of the grid,
+ * the complex products are written out so the inner loop stays plain arithmetic. */
+static void ocean_compute_spectrum(void *userdata, const int i)
 {
 	OceanSimulateData *osd = userdata;
 	const Ocean *o = osd->o;
 	const float scale = osd->scale;
 	const float t = osd->t;
+	const float chop_amount = osd->chop_amount;
+	/* note the <= _N/2 here, see the fftw doco about the mechanics of the complex->real fft storage */
+	const int row_len = 1 + o->_N / 2;
+	const double kx = o->_kx[i];
 
 	int j;
 
-	/* note the <= _N/2 here, see the fftw doco about the mechanics of the complex->real fft storage */
-	for (j = 0; j <= o->_N / 2; ++j) {
-		fftw_complex exp_param1;
-		fftw_complex exp_param2;
-		fftw_complex conj_param;
-
-		init_complex(exp_param1, 0.0, omega(o->_k[i * (1 + o->_N / 2) + j], o->_depth) * t);
-		init_complex(exp_param2, 0.0, -omega(o->_k[i * (1 + o->_N / 2) + j], o->_depth) * t);
-		exp_complex(exp_param1, exp_param1);
-		exp_complex(exp_param2, exp_param2);
-		conj_complex(conj_param, o->_h0_minus[i * o->_N + j]);
-
-		mul_complex_c(exp_param1, o->_h0[i * o->_N + j], exp_param1);
-		mul_complex_c(exp_param2, conj_param, exp_param2);
-
-		add_comlex_c(o->_htilda[i * (1 + o->_N / 2) + j], exp_param1, exp_param2);
-		mul_complex_f(o->_fft_in[i * (1 + o->_N / 2) + j], o->_htilda[i * (1 + o->_N / 2) + j], scale);
+	for (j = 0; j < row_len; ++j) {
+		const int index = i * row_len + j;
+		const double *h0 = o->_h0[i * o->_N + j];
+		const double *h0_minus = o->_h0_minus[i * o->_N + j];
+		const float k = o->_k[index];
+		const float w = omega(k, o->_depth) * t;
+		const double c = cosf(w);
+		const double s = sinf(w);
+		/* 1/k with the DC term masked out */
+		const double k_inv = (k == 0.0f) ? 0.0 : 1.0 / (double)k;
+		double *htilda = o->_htilda[index];
+
+		/* htilda = h0 * exp(i w t) + conj(h0_minus) * exp(-i w t) */
+		htilda[0] = c * (h0[0] + h0_minus[0]) - s * (h0[1] + h0_minus[1]);
+		htilda[1] = s * (h0[0] - h0_minus[0]) + c * (h0[1] - h0_minus[1]);
+
+		o->_fft_in[index][0] = htilda[0] * scale;
+		o->_fft_in[index][1] = htilda[1] * scale;
+
+		if (o->_do_chop) {
+			/* i * htilda * k_xz / k */
+			const double fac = (double)scale * chop_amount * k_inv;
+
+			o->_fft_in_x[index][0] = -htilda[1] * fac * kx;
+			o->_fft_in_x[index][1] = htilda[0] * fac * kx;
+			o->_fft_in_z[index][0] = -htilda[1] * fac * o->_kz[j];
+			o->_fft_in_z[index][1] = htilda[0] * fac * o->_kz[j];
+		}
+
+		if (o->_do_jacobian) {
+			/* -htilda * k_a * k_b / k */
+			const double fac = -(double)chop_amount * k_inv;
+			const double kz = o->_kz[j];
+
+			o->_fft_in_jxx[index][0] = htilda[0] * fac * kx * kx;
+			o->_fft_in_jxx[index][1] = htilda[1] * fac * kx * kx;
+			o->_fft_in_jzz[index][0] = htilda[0] * fac * kz * kz;
+			o->_fft_in_jzz[index][1] = htilda[1] * fac * kz * kz;
+			o->_fft_in_jxz[index][0] = htilda[0] * fac * kx * kz;
+			o->_fft_in_jxz[index][1] = htilda[1] * fac * kx * kz;
+		}
+
+		if (o->_do_normals) {
+			/* -i * htilda * k_xz, note the z normal has always used the row wave number */
+			o->_fft_in_nx[index][0] = htilda[1] * kx;
+			o->_fft_in_nx[index][1] = -htilda[0] * kx;
+			o->_fft_in_nz[index][0] = htilda[1] * o->_kz[i];
+			o->_fft_in_nz[index][1] = -htilda[0] * o->_kz[i];
+		}
 	}
 }
 
@@ -543,27 +581,7 @@ static void ocean_compute_displacement_x(TaskPool * __restrict pool, void *UNUSE
 {
 	OceanSimulateData *osd = BLI_task_pool_userdata(pool);
 	const Ocean *o = osd->o;
-	const float scale = osd->scale;
-	const float chop_amount = osd->chop_amount;
-	int i, j;
 
-	for (i = 0; i < o->_M; ++i) {
-		for (j = 0; j <= o->_N / 2; ++j) {
-			fftw_complex mul_param;
-			fftw_complex minus_i;
-
-			init_complex(minus_i, 0.0, -1.0);
-			init_complex(mul_param, -scale, 0);
-			mul_complex_f(mul_param, mul_param, chop_amount);
-			mul_complex_c(mul_param, mul_param, minus_i);
-			mul_complex_c(mul_param, mul_param, o->_htilda[i * (1 + o->_N / 2) + j]);
-			mul_complex_f(mul_param, mul_param,
-			              ((o->_k[i * (1 + o->_N / 2) + j] == 0.0f) ?
-			               0.0f :
-			               o->_kx[i] / o->_k[i * (1 + o->_N / 2) + j]));
-			init_complex(o->_fft_in_x[i * (1 + o->_N / 2) + j], real_c(mul_param), image_c(mul_param));
-		}
-	}
 	fftw_execute(o->_disp_x_plan);
 }
 
@@ -571,27 +589,7 @@ static void ocean_compute_displacement_z(TaskPool * __restrict pool, void *UNUSE
 {
 	OceanSimulateData *osd = BLI_task_pool_userdata(pool);
 	const Ocean *o = osd->o;
-	const float scale = osd->scale;
-	const float chop_amount = osd->chop_amount;
-	int i, j;
 
-	for (i = 0; i < o->_M; ++i) {
-		for (j = 0; j <= o->_N / 2; ++j) {
-			fftw_complex mul_param;
-			fftw_complex minus_i;
-
-			init_complex(minus_i, 0.0, -1.0);
-			init_complex(mul_param, -scale, 0);
-			mul_complex_f(mul_param, mul_param, chop_amount);
-			mul_complex_c(mul_param, mul_param, minus_i);
-			mul_complex_c(mul_param, mul_param, o->_htilda[i * (1 + o->_N / 2) + j]);
-			mul_complex_f(mul_param, mul_param,
-			              ((o->_k[i * (1 + o->_N / 2) + j] == 0.0f) ?
-			               0.0f :
-			               o->_kz[j] / o->_k[i * (1 + o->_N / 2) + j]));
-			init_complex(o->_fft_in_z[i * (1 + o->_N / 2) + j], real_c(mul_param), image_c(mul_param));
-		}
-	}
 	fftw_execute(o->_disp_z_plan);
 }
 
@@ -599,31 +597,12 @@ static void ocean_compute_jacobian_jxx(TaskPool * __restrict pool, void *UNUSED(
 {
 	OceanSimulateData *osd = BLI_task_pool_userdata(pool);
 	const Ocean *o = osd->o;
-	const float chop_amount = osd->chop_amount;
-	int i, j;
+	int i;
 
-	for (i = 0; i < o->_M; ++i) {
-		for (j = 0; j <= o->_N / 2; ++j) {
-			fftw_complex mul_param;
-
-			/* init_complex(mul_param, -scale, 0); */
-			init_complex(mul_param, -1, 0);
-
-			mul_complex_f(mul_param, mul_param, chop_amount);
-			mul_complex_c(mul_param, mul_param, o->_htilda[i * (1 + o->_N / 2) + j]);
-			mul_complex_f(mul_param, mul_param,
-			              ((o->_k[i * (1 + o->_N / 2) + j] == 0.0f) ?
-			               0.0f :
-			               o->_kx[i] * o->_kx[i] / o->_k[i * (1 + o->_N / 2) + j]));
-			init_complex(o->_fft_in_jxx[i * (1 + o->_N / 2) + j], real_c(mul_param), image_c(mul_param));
-		}
-	}
 	fftw_execute(o->_Jxx_plan);
 
-	for (i = 0; i < o->_M; ++i) {
-		for (j = 0; j < o->_N; ++j) {
-			o->_Jxx[i * o->_N + j] += 1.0;
-		}
+	for (i = 0; i < o->_M * o->_N; ++i) {
+		o->_Jxx[i] += 1.0;
 	}
 }
 
@@ -631,31 +610,12 @@ static void ocean_compute_jacobian_jzz(TaskPool * __restrict pool, void *UNUSED(
 {
 	OceanSimulateData *osd = BLI_task_pool_userdata(pool);
 	const Ocean *o = osd->o;
-	const float chop_amount = osd->chop_amount;
-	int i, j;
+	int i;
 
-	for (i = 0; i < o->_M; ++i) {
-		for (j = 0; j <= o->_N / 2; ++j) {
-			fftw_complex mul_param;
-
-			/* init_complex(mul_param, -scale, 0); */
-			init_complex(mul_param, -1, 0);
-
-			mul_complex_f(mul_param, mul_param, chop_amount);
-			mul_complex_c(mul_param, mul_param, o->_htilda[i * (1 + o->_N / 2) + j]);
-			mul_complex_f(mul_param, mul_param,
-			              ((o->_k[i * (1 + o->_N / 2) + j] == 0.0f) ?
-			               0.0f :
-			               o->_kz[j] * o->_kz[j] / o->_k[i * (1 + o->_N / 2) + j]));
-			init_complex(o->_fft_in_jzz[i * (1 + o->_N / 2) + j], real_c(mul_param), image_c(mul_param));
-		}
-	}
 	fftw_execute(o->_Jzz_plan);
 
-	for (i = 0; i < o->_M; ++i) {
-		for (j = 0; j < o->_N; ++j) {
-			o->_Jzz[i * o->_N + j] += 1.0;
-		}
+	for (i = 0; i < o->_M * o->_N; ++i) {
+		o->_Jzz[i] += 1.0;
 	}
 }
 
@@ -663,25 +623,7 @@ static void ocean_compute_jacobian_jxz(TaskPool * __restrict pool, void *UNUSED(
 {
 	OceanSimulateData *osd = BLI_task_pool_userdata(pool);
 	const Ocean *o = osd->o;
-	const float chop_amount = osd->chop_amount;
-	int i, j;
 
-	for (i = 0; i < o->_M; ++i) {
-		for (j = 0; j <= o->_N / 2; ++j) {
-			fftw_complex mul_param;
-
-			/* init_complex(mul_param, -scale, 0); */
-			init_complex(mul_param, -1, 0);
-
-			mul_complex_f(mul_param, mul_param, chop_amount);
-			mul_complex_c(mul_param, mul_param, o->_htilda[i * (1 + o->_N / 2) + j]);
-			mul_complex_f(mul_param, mul_param,
-			              ((o->_k[i * (1 + o->_N / 2) + j] == 0.0f) ?
-			               0.0f :
-			               o->_kx[i] * o->_kz[j] / o->_k[i * (1 + o->_N / 2) + j]));
-			init_complex(o->_fft_in_jxz[i * (1 + o->_N / 2) + j], real_c(mul_param), image_c(mul_param));
-		}
-	}
 	fftw_execute(o->_Jxz_plan);
 }
 
@@ -689,18 +631,7 @@ static void ocean_compute_normal_x(TaskPool * __restrict pool, void *UNUSED(task
 {
 	OceanSimulateData *osd = BLI_task_pool_userdata(pool);
 	const Ocean *o = osd->o;
-	int i, j;
-
-	for (i = 0; i < o->_M; ++i) {
-		for (j = 0; j <= o->_N / 2; ++j) {
-			fftw_complex mul_param;
 
-			init_complex(mul_param, 0.0, -1.0);
-			mul_complex_c(mul_param, mul_param, o->_htilda[i * (1 + o->_N / 2) + j]);
-			mul_complex_f(mul_param, mul_param, o->_kx[i]);
-			init_complex(o->_fft_in_nx[i * (1 + o->_N / 2) + j], real_c(mul_param), image_c(mul_param));
-		}
-	}
 	fftw_execute(o->_N_x_plan);
 }
 
@@ -708,18 +639,7 @@ static void ocean_compute_normal_z(TaskPool * __restrict pool, void *UNUSED(task
 {
 	OceanSimulateData *osd = BLI_task_pool_userdata(pool);
 	const Ocean *o = osd->o;
-	int i, j;
 
-	for (i = 0; i < o->_M; ++i) {
-		for (j = 0; j <= o->_N / 2; ++j) {
-			fftw_complex mul_param;
-
-			init_complex(mul_param, 0.0, -1.0);
-			mul_complex_c(mul_param, mul_param, o->_htilda[i * (1 + o->_N / 2) + j]);
-			mul_complex_f(mul_param, mul_param, o->_kz[i]);
-			init_complex(o->_fft_in_nz[i * (1 + o->_N / 2) + j], real_c(mul_param), image_c(mul_param));
-		}
-	}
 	fftw_execute(o->_N_z_plan);
 }
 
@@ -741,14 +661,13 @@ void BKE_ocean_simulate(struct Ocean *o, float t, float scale, float chop_amount
 
 	BLI_rw_mutex_lock(&o->oceanmutex, THREAD_LOCK_WRITE);
 
-	/* Note about multi-threading here: we have to run a first set of computations (htilda one) before we can run
-	 * all others, since they all depend on it.
-	 * So we make a first parallelized forloop run for htilda, and then pack all other computations into
-	 * a set of parallel tasks.
+	/* Note about multi-threading here: all FFT inputs are derived from htilda, so a first parallelized forloop
+	 * fills the whole spectrum row by row, and the independent inverse FFTs then run concurrently as a set of
+	 * parallel tasks.
 	 * This is not optimal in all cases, but remains reasonably simple and should be OK most of the time. */
 
-	/* compute a new htilda */
-	BLI_task_parallel_range(0, o->_M, &osd, ocean_compute_htilda, o->_M > 16);
+	/* compute a new htilda and the spectra */
+	BLI_task_parallel_range(0, o->_M, &osd, ocean_compute_spectrum, o->_M > 16);
 
 	if (o->_do_disp_y) {
 		BLI_task_pool_push(pool, ocean_compute_displacement_y, NULL, false, TASK_PRIORITY_HIGH);
@@ -1248,6 +1167,41 @@ void BKE_ocean_simulate_cache(struct OceanCache *och, int frame)
 }
 
 
+typedef struct OceanBakeWriteData {
+	const OceanCache *och;
+	int frame;
+	/* foam and normal buffers are NULL when not baked */
+	ImBuf *ibuf_disp, *ibuf_foam, *ibuf_normal;
+} OceanBakeWriteData;
+
+static void ocean_bake_write_frame(TaskPool * __restrict pool, void *taskdata, int UNUSED(threadid))
+{
+	const ImageFormatData *imf = BLI_task_pool_userdata(pool);
+	OceanBakeWriteData *wd = taskdata;
+	const OceanCache *och = wd->och;
+	char string[FILE_MAX];
+
+	cache_filename(string, och->bakepath, och->relbase, wd->frame, CACHE_TYPE_DISPLACE);
+	if (0 == BKE_imbuf_write(wd->ibuf_disp, string, imf))
+		printf("Cannot save Displacement File Output to %s\n", string);
+
+	if (wd->ibuf_foam) {
+		cache_filename(string, och->bakepath, och->relbase, wd->frame, CACHE_TYPE_FOAM);
+		if (0 == BKE_imbuf_write(wd->ibuf_foam, string, imf))
+			printf("Cannot save Foam File Output to %s\n", string);
+	}
+
+	if (wd->ibuf_normal) {
+		cache_filename(string, och->bakepath, och->relbase, wd->frame, CACHE_TYPE_NORMAL);
+		if (0 == BKE_imbuf_write(wd->ibuf_normal, string, imf))
+			printf("Cannot save Normal File Output to %s\n", string);
+	}
+
+	IMB_freeImBuf(wd->ibuf_disp);
+	IMB_freeImBuf(wd->ibuf_foam);
+	IMB_freeImBuf(wd->ibuf_normal);
+}
+
 void BKE_ocean_bake(struct Ocean *o, struct OceanCache *och, void (*update_cb)(void *, float progress, int *cancel),
                     void *update_cb_data)
 {
@@ -1265,7 +1219,7 @@ void BKE_ocean_bake(struct Ocean *o, struct OceanCache *och, void (*update_cb)(v
 	float *prev_foam;
 	int res_x = och->resolution_x;
 	int res_y = och->resolution_y;
-	char string[FILE_MAX];
+	TaskPool *write_pool;
 	//RNG *rng;
 
 	if (!o) return;
@@ -1280,12 +1234,16 @@ void BKE_ocean_bake(struct Ocean *o, struct OceanCache *och, void (*update_cb)(v
 	imf.depth =  R_IMF_CHAN_DEPTH_16;
 	imf.exr_codec = R_IMF_EXR_CODEC_ZIP;
 
+	/* compressing and writing the EXR files of a frame overlaps with simulating the next one */
+	write_pool = BLI_task_pool_create_background(BLI_task_scheduler_get(), &imf);
+
 	for (f = och->start, i = 0; f <= och->end; f++, i++) {
+		OceanBakeWriteData *wd;
 
 		/* create a new imbuf to store image for this frame */
-		ibuf_foam = IMB_allocImBuf(res_x, res_y, 32, IB_rectfloat);
 		ibuf_disp = IMB_allocImBuf(res_x, res_y, 32, IB_rectfloat);
-		ibuf_normal = IMB_allocImBuf(res_x, res_y, 32, IB_rectfloat);
+		ibuf_foam = o->_do_jacobian ? IMB_allocImBuf(res_x, res_y, 32, IB_rectfloat) : NULL;
+		ibuf_normal = o->_do_normals ? IMB_allocImBuf(res_x, res_y, 32, IB_rectfloat) : NULL;
 
 		BKE_ocean_simulate(o, och->time[i], och->wave_scale, och->chop_amount);
 
@@ -1363,41 +1321,35 @@ void BKE_ocean_bake(struct Ocean *o, struct OceanCache *och, void (*update_cb)(v
 			}
 		}
 
-		/* write the images */
-		cache_filename(string, och->bakepath, och->relbase, f, CACHE_TYPE_DISPLACE);
-		if (0 == BKE_imbuf_write(ibuf_disp, string, &imf))
-			printf("Cannot save Displacement File Output to %s\n", string);
-
-		if (o->_do_jacobian) {
-			cache_filename(string, och->bakepath, och->relbase, f, CACHE_TYPE_FOAM);
-			if (0 == BKE_imbuf_write(ibuf_foam, string, &imf))
-				printf("Cannot save Foam File Output to %s\n", string);
-		}
+		/* only one frame is written at a time, this keeps the memory use of long bakes bounded */
+		BLI_task_pool_work_and_wait(write_pool);
 
-		if (o->_do_normals) {
-			cache_filename(string, och->bakepath, och->relbase, f, CACHE_TYPE_NORMAL);
-			if (0 == BKE_imbuf_write(ibuf_normal, string, &imf))
-				printf("Cannot save Normal File Output to %s\n", string);
-		}
-
-		IMB_freeImBuf(ibuf_disp);
-		IMB_freeImBuf(ibuf_foam);
-		IMB_freeImBuf(ibuf_normal);
+		wd = MEM_mallocN(sizeof(OceanBakeWriteData), "ocean bake write data");
+		wd->och = och;
+		wd->frame = f;
+		wd->ibuf_disp = ibuf_disp;
+		wd->ibuf_foam = ibuf_foam;
+		wd->ibuf_normal = ibuf_normal;
+		BLI_task_pool_push(write_pool, ocean_bake_write_frame, wd, true, TASK_PRIORITY_LOW);
 
 		progress = (f - och->start) / (float)och->duration;
 
 		update_cb(update_cb_data, progress, &cancel);
 
 		if (cancel) {
-			if (prev_foam) MEM_freeN(prev_foam);
-			//BLI_rng_free(rng);
-			return;
+			break;
 		}
 	}
 
+	BLI_task_pool_work_and_wait(write_pool);
+	BLI_task_pool_free(write_pool);
+
 	//BLI_rng_free(rng);
 	if (prev_foam) MEM_freeN(prev_foam);
-	och->baked = 1;
+
+	if (!cancel) {
+		och->baked = 1;
+	}
 }
 
 #else /* WITH_OCEANSIM */
@@ -588,7 +588,7 @@ void psys_free(Object *ob, ParticleSystem *psys)
 		
 		BLI_freelistN(&psys->targets);
 
-		BLI_bvhtree_free(psys->bvhtree);
+		psys_sph_grid_free(psys->sph_grid);
 		BLI_kdtree_free(psys->tree);
  
 		if (psys->fluid_springs)
@@ -103,7 +103,7 @@
 
 #endif // WITH_MOD_FLUID
 
-static ThreadRWMutex psys_bvhtree_rwlock = BLI_RWLOCK_INITIALIZER;
+static ThreadRWMutex psys_sph_grid_rwlock = BLI_RWLOCK_INITIALIZER;
 
 /************************************************/
 /*			Reacting to system events			*/
@@ -1225,43 +1225,255 @@ void psys_get_pointcache_start_end(Scene *scene, ParticleSystem *psys, int *sfra
 /************************************************/
 /*			Effectors							*/
 /************************************************/
-static void psys_update_particle_bvhtree(ParticleSystem *psys, float cfra)
+/* Spatial hash of particle positions for the SPH neighbor search.
+ *
+ * Particles are counting-sorted by hash bucket of their grid cell, with
+ * positions copied in bucket order so range queries read contiguous memory. */
+typedef struct ParticleSPHGrid {
+	float cell_size, inv_cell_size;
+
+	int totbucket;          /* power of two */
+	int *bucket_start;      /* totbucket + 1 offsets into the sorted arrays */
+
+	int totpoint;
+	int *index;             /* particle index */
+	int (*cell)[3];         /* grid cell, buckets can hold multiple cells */
+	float (*co)[3];         /* particle location */
+} ParticleSPHGrid;
+
+#define SPH_GRID_PARALLEL_CHUNK 4096
+
+BLI_INLINE int sph_grid_bucket(const ParticleSPHGrid *grid, const int cell[3])
+{
+	const unsigned int h = ((unsigned int)cell[0] * 73856093u) ^
+	                       ((unsigned int)cell[1] * 19349663u) ^
+	                       ((unsigned int)cell[2] * 83492791u);
+	return (int)(h & (unsigned int)(grid->totbucket - 1));
+}
+
+/* beyond this float cell coordinates aren't exact integers anymore */
+#define SPH_GRID_CELL_MAX 16777216.0f
+
+BLI_INLINE int sph_grid_cell_axis(const ParticleSPHGrid *grid, float co)
+{
+	float f = floorf(co * grid->inv_cell_size);
+
+	/* diverged particles can be infinite or NaN, casting those is undefined */
+	if (!(f >= -SPH_GRID_CELL_MAX)) {
+		f = -SPH_GRID_CELL_MAX;
+	}
+	else if (f > SPH_GRID_CELL_MAX) {
+		f = SPH_GRID_CELL_MAX;
+	}
+
+	return (int)f;
+}
+
+BLI_INLINE void sph_grid_cell(const ParticleSPHGrid *grid, const float co[3], int r_cell[3])
+{
+	r_cell[0] = sph_grid_cell_axis(grid, co[0]);
+	r_cell[1] = sph_grid_cell_axis(grid, co[1]);
+	r_cell[2] = sph_grid_cell_axis(grid, co[2]);
+}
+
+typedef struct SPHGridBuildData {
+	ParticleSPHGrid *grid;
+	const float (*co)[3];
+	int (*cell)[3];
+	int *bucket;
+	int totpoint;
+} SPHGridBuildData;
+
+static void sph_grid_bucket_cb(void *userdata, const int chunk)
+{
+	SPHGridBuildData *data = userdata;
+	const int start = chunk * SPH_GRID_PARALLEL_CHUNK;
+	const int end = min_ii(start + SPH_GRID_PARALLEL_CHUNK, data->totpoint);
+	int i;
+
+	for (i = start; i < end; i++) {
+		sph_grid_cell(data->grid, data->co[i], data->cell[i]);
+		data->bucket[i] = sph_grid_bucket(data->grid, data->cell[i]);
+	}
+}
+
+static ParticleSPHGrid *sph_grid_new(ParticleSystem *psys, float cfra)
+{
+	SPHFluidSettings *fluid = psys->part->fluid;
+	ParticleSPHGrid *grid = MEM_callocN(sizeof(ParticleSPHGrid), "ParticleSPHGrid");
+	SPHGridBuildData data;
+	float (*co)[3];
+	int (*cell)[3];
+	int *bucket, *index, *cursor;
+	int totpoint = 0, chunks, i;
+	PARTICLE_P;
+
+	/* nominal interaction radius, queries with a larger radius visit more cells */
+	grid->cell_size = fluid ? fluid->radius * (fluid->flag & SPH_FAC_RADIUS ? 4.0f * psys->part->size : 1.0f) : 1.0f;
+	grid->cell_size = max_ff(grid->cell_size, 1e-4f);
+	grid->inv_cell_size = 1.0f / grid->cell_size;
+
+	LOOP_SHOWN_PARTICLES {
+		if (pa->alive == PARS_ALIVE) {
+			totpoint++;
+		}
+	}
+
+	grid->totbucket = (int)power_of_2_max_u((unsigned int)max_ii(totpoint * 2, 1));
+	grid->bucket_start = MEM_callocN(sizeof(int) * (grid->totbucket + 1), "ParticleSPHGrid bucket_start");
+	grid->totpoint = totpoint;
+	grid->index = MEM_mallocN(sizeof(int) * max_ii(totpoint, 1), "ParticleSPHGrid index");
+	grid->cell = MEM_mallocN(sizeof(int[3]) * max_ii(totpoint, 1), "ParticleSPHGrid cell");
+	grid->co = MEM_mallocN(sizeof(float[3]) * max_ii(totpoint, 1), "ParticleSPHGrid co");
+
+	if (totpoint == 0) {
+		return grid;
+	}
+
+	co = MEM_mallocN(sizeof(float[3]) * totpoint, __func__);
+	cell = MEM_mallocN(sizeof(int[3]) * totpoint, __func__);
+	bucket = MEM_mallocN(sizeof(int) * totpoint, __func__);
+	index = MEM_mallocN(sizeof(int) * totpoint, __func__);
+
+	i = 0;
+	LOOP_SHOWN_PARTICLES {
+		if (pa->alive == PARS_ALIVE) {
+			copy_v3_v3(co[i], (pa->state.time == cfra) ? pa->prev_state.co : pa->state.co);
+			index[i] = p;
+			i++;
+		}
+	}
+
+	data.grid = grid;
+	data.co = (const float (*)[3])co;
+	data.cell = cell;
+	data.bucket = bucket;
+	data.totpoint = totpoint;
+
+	chunks = (totpoint + SPH_GRID_PARALLEL_CHUNK - 1) / SPH_GRID_PARALLEL_CHUNK;
+	BLI_task_parallel_range(0, chunks, &data, sph_grid_bucket_cb, chunks > 1);
+
+	/* counting sort by bucket, stable so the order is the same for every run */
+	for (i = 0; i < totpoint; i++) {
+		grid->bucket_start[bucket[i] + 1]++;
+	}
+	for (i = 0; i < grid->totbucket; i++) {
+		grid->bucket_start[i + 1] += grid->bucket_start[i];
+	}
+
+	cursor = MEM_mallocN(sizeof(int) * grid->totbucket, __func__);
+	memcpy(cursor, grid->bucket_start, sizeof(int) * grid->totbucket);
+
+	for (i = 0; i < totpoint; i++) {
+		const int j = cursor[bucket[i]]++;
+		grid->index[j] = index[i];
+		copy_v3_v3_int(grid->cell[j], cell[i]);
+		copy_v3_v3(grid->co[j], co[i]);
+	}
+
+	MEM_freeN(cursor);
+	MEM_freeN(co);
+	MEM_freeN(cell);
+	MEM_freeN(bucket);
+	MEM_freeN(index);
+
+	return grid;
+}
+
+void psys_sph_grid_free(ParticleSPHGrid *grid)
+{
+	if (grid) {
+		MEM_freeN(grid->bucket_start);
+		MEM_freeN(grid->index);
+		MEM_freeN(grid->cell);
+		MEM_freeN(grid->co);
+		MEM_freeN(grid);
+	}
+}
+
+/* Calls the callback for all particles within radius of co, like BLI_bvhtree_range_query(). */
+static void sph_grid_range_query(
+        const ParticleSPHGrid *grid, const float co[3], float radius,
+        BVHTree_RangeQuery callback, void *userdata)
+{
+	const float radius_sq = radius * radius;
+	int cell_min[3], cell_max[3], cell[3];
+	float co_min[3], co_max[3];
+	double totcell;
+	int i;
+
+	if (grid->totpoint == 0) {
+		return;
+	}
+
+	copy_v3_fl3(co_min, co[0] - radius, co[1] - radius, co[2] - radius);
+	copy_v3_fl3(co_max, co[0] + radius, co[1] + radius, co[2] + radius);
+	sph_grid_cell(grid, co_min, cell_min);
+	sph_grid_cell(grid, co_max, cell_max);
+
+	/* in double, cells of a huge or infinite radius overflow any integer type */
+	totcell = (double)(cell_max[0] - cell_min[0] + 1) *
+	          (double)(cell_max[1] - cell_min[1] + 1) *
+	          (double)(cell_max[2] - cell_min[2] + 1);
+
+	/* radius much larger than the cells, checking all particles is cheaper */
+	if (totcell > (double)grid->totpoint) {
+		for (i = 0; i < grid->totpoint; i++) {
+			const float dist_sq = len_squared_v3v3(grid->co[i], co);
+			if (dist_sq <= radius_sq) {
+				callback(userdata, grid->index[i], co, dist_sq);
+			}
+		}
+		return;
+	}
+
+	for (cell[2] = cell_min[2]; cell[2] <= cell_max[2]; cell[2]++) {
+		for (cell[1] = cell_min[1]; cell[1] <= cell_max[1]; cell[1]++) {
+			for (cell[0] = cell_min[0]; cell[0] <= cell_max[0]; cell[0]++) {
+				const int bucket = sph_grid_bucket(grid, cell);
+				const int end = grid->bucket_start[bucket + 1];
+
+				for (i = grid->bucket_start[bucket]; i < end; i++) {
+					float dist_sq;
+
+					/* other cells hashed to the same bucket */
+					if (grid->cell[i][0] != cell[0] || grid->cell[i][1] != cell[1] || grid->cell[i][2] != cell[2]) {
+						continue;
+					}
+
+					dist_sq = len_squared_v3v3(grid->co[i], co);
+					if (dist_sq <= radius_sq) {
+						callback(userdata, grid->index[i], co, dist_sq);
+					}
+				}
+			}
+		}
+	}
+}
+
+static void psys_update_particle_sph_grid(ParticleSystem *psys, float cfra)
 {
 	if (psys) {
-		PARTICLE_P;
-		int totpart = 0;
 		bool need_rebuild;
 
-		BLI_rw_mutex_lock(&psys_bvhtree_rwlock, THREAD_LOCK_READ);
-		need_rebuild = !psys->bvhtree || psys->bvhtree_frame != cfra;
-		BLI_rw_mutex_unlock(&psys_bvhtree_rwlock);
+		BLI_rw_mutex_lock(&psys_sph_grid_rwlock, THREAD_LOCK_READ);
+		need_rebuild = !psys->sph_grid || psys->sph_grid_frame != cfra;
+		BLI_rw_mutex_unlock(&psys_sph_grid_rwlock);
 		
 		if (need_rebuild) {
-			LOOP_SHOWN_PARTICLES {
-				totpart++;
-			}
-			
-			BLI_rw_mutex_lock(&psys_bvhtree_rwlock, THREAD_LOCK_WRITE);
-			
-			BLI_bvhtree_free(psys->bvhtree);
-			psys->bvhtree = BLI_bvhtree_new(totpart, 0.0, 4, 6);
-			
-			LOOP_SHOWN_PARTICLES {
-				if (pa->alive == PARS_ALIVE) {
-					if (pa->state.time == cfra)
-						BLI_bvhtree_insert(psys->bvhtree, p, pa->prev_state.co, 1);
-					else
-						BLI_bvhtree_insert(psys->bvhtree, p, pa->state.co, 1);
-				}
-			}
-			BLI_bvhtree_balance(psys->bvhtree);
+			ParticleSPHGrid *grid = sph_grid_new(psys, cfra);
+
+			BLI_rw_mutex_lock(&psys_sph_grid_rwlock, THREAD_LOCK_WRITE);
 			
-			psys->bvhtree_frame = cfra;
+			psys_sph_grid_free(psys->sph_grid);
+			psys->sph_grid = grid;
+			psys->sph_grid_frame = cfra;
 			
-			BLI_rw_mutex_unlock(&psys_bvhtree_rwlock);
+			BLI_rw_mutex_unlock(&psys_sph_grid_rwlock);
 		}
 	}
 }
+
 void psys_update_particle_tree(ParticleSystem *psys, float cfra)
 {
 	if (psys) {
@@ -1576,11 +1788,11 @@ static void sph_evaluate_func(BVHTree *tree, ParticleSystem **psys, float co[3],
 			break;
 		}
 		else {
-			BLI_rw_mutex_lock(&psys_bvhtree_rwlock, THREAD_LOCK_READ);
+			BLI_rw_mutex_lock(&psys_sph_grid_rwlock, THREAD_LOCK_READ);
 			
-			BLI_bvhtree_range_query(psys[i]->bvhtree, co, interaction_radius, callback, pfr);
+			sph_grid_range_query(psys[i]->sph_grid, co, interaction_radius, callback, pfr);
 			
-			BLI_rw_mutex_unlock(&psys_bvhtree_rwlock);
+			BLI_rw_mutex_unlock(&psys_sph_grid_rwlock);
 		}
 	}
 }
@@ -3531,11 +3743,11 @@ static void dynamics_step(ParticleSimulationData *sim, float cfra)
 		case PART_PHYS_FLUID:
 		{
 			ParticleTarget *pt = psys->targets.first;
-			psys_update_particle_bvhtree(psys, cfra);
+			psys_update_particle_sph_grid(psys, cfra);
 			
 			for (; pt; pt=pt->next) {  /* Updating others systems particle tree for fluid-fluid interaction */
 				if (pt->ob)
-					psys_update_particle_bvhtree(BLI_findlink(&pt->ob->particlesystem, pt->psys-1), cfra);
+					psys_update_particle_sph_grid(BLI_findlink(&pt->ob->particlesystem, pt->psys-1), cfra);
 			}
 			break;
 		}
@@ -30,6 +30,7 @@
 #include "BLI_math.h"
 #include "BLI_utildefines.h"
 #include "BLI_ghash.h"
+#include "BLI_sort_utils.h"
 #include "BLI_task.h"
 
 #include "BKE_pbvh.h"
@@ -284,9 +285,8 @@ static void build_mesh_leaf_node(PBVH *bvh, PBVHNode *node)
 	for (int i = 0; i < totface; ++i) {
 		const MLoopTri *lt = &bvh->looptri[node->prim_indices[i]];
 		for (int j = 0; j < 3; ++j) {
-			face_vert_indices[i][j] =
-			        map_insert_vert(bvh, map, &node->face_verts,
-			                        &node->uniq_verts, bvh->mloop[lt->tri[j]].v);
+			map_insert_vert(bvh, map, &node->face_verts,
+			                &node->uniq_verts, bvh->mloop[lt->tri[j]].v);
 		}
 
 		if (!paint_is_face_hidden(lt, bvh->verts, bvh->mloop)) {
@@ -311,14 +311,21 @@ static void build_mesh_leaf_node(PBVH *bvh, PBVHNode *node)
 		        GET_INT_FROM_POINTER(BLI_ghashIterator_getKey(&gh_iter));
 	}
 
-	for (int i = 0; i < totface; ++i) {
-		const int sides = 3;
+	/* Sort both parts of the list by mesh index, so iterating over the node's
+	 * vertices walks the mesh arrays in memory order instead of hash order. */
+	qsort(vert_indices, node->uniq_verts, sizeof(int), BLI_sortutil_cmp_int);
+	qsort(vert_indices + node->uniq_verts, node->face_verts, sizeof(int), BLI_sortutil_cmp_int);
+
+	const int totvert = node->uniq_verts + node->face_verts;
+	for (int i = 0; i < totvert; ++i) {
+		BLI_ghash_reinsert(map, SET_INT_IN_POINTER(vert_indices[i]), SET_INT_IN_POINTER(i), NULL, NULL);
+	}
 
-		for (int j = 0; j < sides; ++j) {
-			if (face_vert_indices[i][j] < 0)
-				face_vert_indices[i][j] =
-				        -face_vert_indices[i][j] +
-				        node->uniq_verts - 1;
+	for (int i = 0; i < totface; ++i) {
+		const MLoopTri *lt = &bvh->looptri[node->prim_indices[i]];
+		for (int j = 0; j < 3; ++j) {
+			face_vert_indices[i][j] =
+			        GET_INT_FROM_POINTER(BLI_ghash_lookup(map, SET_INT_IN_POINTER(bvh->mloop[lt->tri[j]].v)));
 		}
 	}
 
@@ -1896,6 +1903,25 @@ void BKE_pbvh_node_layer_disp_free(PBVHNode *node)
 	}
 }
 
+/* Sculpt undo node of the current undo push, owned by the undo system. */
+void *BKE_pbvh_node_undo_data_get(PBVHNode *node)
+{
+	return node->undo_data;
+}
+
+/* Store undo data for the node unless another thread already did so,
+ * returns the undo data the node ends up with. */
+void *BKE_pbvh_node_undo_data_set_if_unset(PBVHNode *node, void *undo_data)
+{
+	void *undo_data_prev = (void *)atomic_cas_z((size_t *)&node->undo_data, 0, (size_t)undo_data);
+	return undo_data_prev ? undo_data_prev : undo_data;
+}
+
+void BKE_pbvh_node_undo_data_clear(PBVHNode *node)
+{
+	node->undo_data = NULL;
+}
+
 float (*BKE_pbvh_get_vertCos(PBVH *pbvh))[3]
 {
 	float (*vertCos)[3] = NULL;
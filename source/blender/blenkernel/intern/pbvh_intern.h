@@ -102,6 +102,9 @@ struct PBVHNode {
 	int proxy_count;
 	PBVHProxyNode *proxies;
 
+	/* Sculpt undo node of the current undo push (not owned). */
+	void *undo_data;
+
 	/* Dyntopo */
 	GSet *bm_faces;
 	GSet *bm_unique_verts;
@@ -71,6 +71,8 @@
 
 #include "BIK_api.h"
 
+#include "pointcache_container.h"
+
 #ifdef WITH_BULLET
 #  include "RBI_api.h"
 #endif
@@ -141,6 +143,7 @@ static int ptcache_file_compressed_read(PTCacheFile *pf, unsigned char *result,
 static int ptcache_file_compressed_write(PTCacheFile *pf, unsigned char *in, unsigned int in_len, unsigned char *out, int mode);
 static int ptcache_file_write(PTCacheFile *pf, const void *f, unsigned int tot, unsigned int size);
 static int ptcache_file_read(PTCacheFile *pf, void *f, unsigned int tot, unsigned int size);
+static int ptcache_file_seek(PTCacheFile *pf, long offset, int origin);
 
 /* Common functions */
 static int ptcache_basic_header_read(PTCacheFile *pf)
@@ -148,10 +151,10 @@ static int ptcache_basic_header_read(PTCacheFile *pf)
 	int error=0;
 
 	/* Custom functions should read these basic elements too! */
-	if (!error && !fread(&pf->totpoint, sizeof(unsigned int), 1, pf->fp))
+	if (!error && !ptcache_file_read(pf, &pf->totpoint, 1, sizeof(unsigned int)))
 		error = 1;
 	
-	if (!error && !fread(&pf->data_types, sizeof(unsigned int), 1, pf->fp))
+	if (!error && !ptcache_file_read(pf, &pf->data_types, 1, sizeof(unsigned int)))
 		error = 1;
 
 	return !error;
@@ -159,10 +162,10 @@ static int ptcache_basic_header_read(PTCacheFile *pf)
 static int ptcache_basic_header_write(PTCacheFile *pf)
 {
 	/* Custom functions should write these basic elements too! */
-	if (!fwrite(&pf->totpoint, sizeof(unsigned int), 1, pf->fp))
+	if (!ptcache_file_write(pf, &pf->totpoint, 1, sizeof(unsigned int)))
 		return 0;
 	
-	if (!fwrite(&pf->data_types, sizeof(unsigned int), 1, pf->fp))
+	if (!ptcache_file_write(pf, &pf->data_types, 1, sizeof(unsigned int)))
 		return 0;
 
 	return 1;
@@ -777,7 +780,7 @@ static int ptcache_smoke_read(PTCacheFile *pf, void *smoke_v)
 	if (!STREQLEN(version, SMOKE_CACHE_VERSION, 4))
 	{
 		/* reset file pointer */
-		fseek(pf->fp, -4, SEEK_CUR);
+		ptcache_file_seek(pf, -4, SEEK_CUR);
 		return ptcache_smoke_read_old(pf, smoke_v);
 	}
 
@@ -1866,6 +1869,40 @@ static int ptcache_filename(PTCacheID *pid, char *filename, int cfra, short do_p
 	return len; /* make sure the above string is always 16 chars */
 }
 
+static bool ptcache_use_container(const PTCacheID *pid)
+{
+	return (pid->cache->flag & PTCACHE_DISK_SINGLE_FILE) && pid->file_type == PTCACHE_FILE_PTCACHE;
+}
+
+/* Same as ptcache_filename, without the frame number. */
+static int ptcache_container_filename(PTCacheID *pid, char *filename)
+{
+	int len = ptcache_filename(pid, filename, 0, 1, 0);
+
+	if (len == 0)
+		return 0;
+
+	if (pid->cache->index < 0)
+		pid->cache->index =  pid->stack_index = BKE_object_insert_ptcache(pid->ob);
+
+	if ((pid->cache->flag & PTCACHE_EXTERNAL) && pid->cache->index < 0)
+		len += BLI_snprintf(filename + len, MAX_PTCACHE_FILE - len, PTCACHE_CONTAINER_EXT);
+	else
+		len += BLI_snprintf(filename + len, MAX_PTCACHE_FILE - len, "_%02u"PTCACHE_CONTAINER_EXT, pid->stack_index);
+
+	return len;
+}
+
+static PTCacheContainer *ptcache_container_get(PTCacheID *pid)
+{
+	char filename[MAX_PTCACHE_FILE];
+
+	if (!ptcache_container_filename(pid, filename))
+		return NULL;
+
+	return ptcache_container_acquire(filename);
+}
+
 /* youll need to close yourself after! */
 static PTCacheFile *ptcache_file_open(PTCacheID *pid, int mode, int cfra)
 {
@@ -1880,6 +1917,36 @@ static PTCacheFile *ptcache_file_open(PTCacheID *pid, int mode, int cfra)
 #endif
 	if (!G.relbase_valid && (pid->cache->flag & PTCACHE_EXTERNAL)==0) return NULL; /* save blend file before using disk pointcache */
 	
+	if (ptcache_use_container(pid)) {
+		PTCacheContainer *container = ptcache_container_get(pid);
+		unsigned char *mem = NULL;
+		unsigned int mem_len = 0;
+
+		if (container == NULL || mode == PTCACHE_FILE_UPDATE)
+			return NULL;
+
+		if (mode == PTCACHE_FILE_READ) {
+			mem = ptcache_container_frame_read(container, cfra, &mem_len);
+			if (mem == NULL)
+				return NULL;
+		}
+
+		pf = MEM_callocN(sizeof(PTCacheFile), "PTCacheFile");
+		pf->frame = cfra;
+
+		if (mode == PTCACHE_FILE_READ) {
+			pf->mem = mem;
+			pf->mem_len = pf->mem_alloc = mem_len;
+		}
+		else {
+			/* written to the container on close */
+			pf->container = container;
+			pf->mem_compression = pid->cache->compression;
+		}
+
+		return pf;
+	}
+
 	ptcache_filename(pid, filename, cfra, 1, 1);
 
 	if (mode==PTCACHE_FILE_READ) {
@@ -1897,9 +1964,8 @@ static PTCacheFile *ptcache_file_open(PTCacheID *pid, int mode, int cfra)
 	if (!fp)
 		return NULL;
 
-	pf= MEM_mallocN(sizeof(PTCacheFile), "PTCacheFile");
+	pf= MEM_callocN(sizeof(PTCacheFile), "PTCacheFile");
 	pf->fp= fp;
-	pf->old_format = 0;
 	pf->frame = cfra;
 
 	return pf;
@@ -1907,7 +1973,16 @@ static PTCacheFile *ptcache_file_open(PTCacheID *pid, int mode, int cfra)
 static void ptcache_file_close(PTCacheFile *pf)
 {
 	if (pf) {
-		fclose(pf->fp);
+		if (pf->container && pf->mem) {
+			/* hands over the data */
+			ptcache_container_frame_write(pf->container, pf->frame, pf->mem, pf->mem_len, pf->mem_compression);
+		}
+		else if (pf->mem) {
+			MEM_freeN(pf->mem);
+		}
+
+		if (pf->fp)
+			fclose(pf->fp);
 		MEM_freeN(pf);
 	}
 }
@@ -1969,6 +2044,12 @@ static int ptcache_file_compressed_write(PTCacheFile *pf, unsigned char *in, uns
 
 	(void)mode; /* unused when building w/o compression */
 
+	/* single file caches compress whole frames when writing them in the background */
+	if (pf->container) {
+		pf->mem_compression = MAX2(pf->mem_compression, mode);
+		mode = 0;
+	}
+
 #ifdef WITH_LZO
 	out_len= LZO_OUT_LEN(in_len);
 	if (mode == 1) {
@@ -2015,12 +2096,51 @@ static int ptcache_file_compressed_write(PTCacheFile *pf, unsigned char *in, uns
 }
 static int ptcache_file_read(PTCacheFile *pf, void *f, unsigned int tot, unsigned int size)
 {
+	if (pf->fp == NULL) {
+		const size_t len = (size_t)tot * size;
+
+		if (pf->mem_pos + len > pf->mem_len)
+			return 0;
+
+		memcpy(f, pf->mem + pf->mem_pos, len);
+		pf->mem_pos += len;
+		return 1;
+	}
+
 	return (fread(f, size, tot, pf->fp) == tot);
 }
 static int ptcache_file_write(PTCacheFile *pf, const void *f, unsigned int tot, unsigned int size)
 {
+	if (pf->fp == NULL) {
+		const size_t len = (size_t)tot * size;
+
+		if (pf->mem_pos + len > pf->mem_alloc) {
+			pf->mem_alloc = MAX2(pf->mem_pos + len, pf->mem_alloc * 2);
+			pf->mem = pf->mem ? MEM_reallocN(pf->mem, pf->mem_alloc) : MEM_mallocN(pf->mem_alloc, "PTCacheFile mem");
+		}
+
+		memcpy(pf->mem + pf->mem_pos, f, len);
+		pf->mem_pos += len;
+		pf->mem_len = MAX2(pf->mem_len, pf->mem_pos);
+		return 1;
+	}
+
 	return (fwrite(f, size, tot, pf->fp) == tot);
 }
+static int ptcache_file_seek(PTCacheFile *pf, long offset, int origin)
+{
+	if (pf->fp == NULL) {
+		const long pos = (origin == SEEK_CUR) ? (long)pf->mem_pos + offset : offset;
+
+		if (pos < 0 || (size_t)pos > pf->mem_len)
+			return -1;
+
+		pf->mem_pos = (size_t)pos;
+		return 0;
+	}
+
+	return fseek(pf->fp, offset, origin);
+}
 static int ptcache_file_data_read(PTCacheFile *pf)
 {
 	int i;
@@ -2051,13 +2171,13 @@ static int ptcache_file_header_begin_read(PTCacheFile *pf)
 	
 	pf->data_types = 0;
 	
-	if (fread(bphysics, sizeof(char), 8, pf->fp) != 8)
+	if (!ptcache_file_read(pf, bphysics, 8, sizeof(char)))
 		error = 1;
 	
 	if (!error && !STREQLEN(bphysics, "BPHYSICS", 8))
 		error = 1;
 
-	if (!error && !fread(&typeflag, sizeof(unsigned int), 1, pf->fp))
+	if (!error && !ptcache_file_read(pf, &typeflag, 1, sizeof(unsigned int)))
 		error = 1;
 
 	pf->type = (typeflag & PTCACHE_TYPEFLAG_TYPEMASK);
@@ -2065,7 +2185,7 @@ static int ptcache_file_header_begin_read(PTCacheFile *pf)
 	
 	/* if there was an error set file as it was */
 	if (error)
-		fseek(pf->fp, 0, SEEK_SET);
+		ptcache_file_seek(pf, 0, SEEK_SET);
 
 	return !error;
 }
@@ -2074,10 +2194,10 @@ static int ptcache_file_header_begin_write(PTCacheFile *pf)
 	const char *bphysics = "BPHYSICS";
 	unsigned int typeflag = pf->type + pf->flag;
 	
-	if (fwrite(bphysics, sizeof(char), 8, pf->fp) != 8)
+	if (!ptcache_file_write(pf, bphysics, 8, sizeof(char)))
 		return 0;
 
-	if (!fwrite(&typeflag, sizeof(unsigned int), 1, pf->fp))
+	if (!ptcache_file_write(pf, &typeflag, 1, sizeof(unsigned int)))
 		return 0;
 	
 	return 1;
@@ -2978,7 +3098,31 @@ void BKE_ptcache_id_clear(PTCacheID *pid, int mode, unsigned int cfra)
 	case PTCACHE_CLEAR_ALL:
 	case PTCACHE_CLEAR_BEFORE:
 	case PTCACHE_CLEAR_AFTER:
-		if (pid->cache->flag & PTCACHE_DISK_CACHE) {
+		if ((pid->cache->flag & PTCACHE_DISK_CACHE) && ptcache_use_container(pid)) {
+			PTCacheContainer *container = ptcache_container_get(pid);
+
+			if (container)
+				ptcache_container_frames_remove(container, mode, cfra);
+
+			if (mode == PTCACHE_CLEAR_ALL) {
+				pid->cache->last_exact = MIN2(pid->cache->startframe, 0);
+
+				if (pid->cache->cached_frames)
+					memset(pid->cache->cached_frames, 0, MEM_allocN_len(pid->cache->cached_frames));
+			}
+			else if (pid->cache->cached_frames) {
+				int frame;
+
+				for (frame = (int)sta; frame <= (int)end; frame++) {
+					if ((mode == PTCACHE_CLEAR_BEFORE && frame < (int)cfra) ||
+					    (mode == PTCACHE_CLEAR_AFTER && frame > (int)cfra))
+					{
+						pid->cache->cached_frames[frame - sta] = 0;
+					}
+				}
+			}
+		}
+		else if (pid->cache->flag & PTCACHE_DISK_CACHE) {
 			ptcache_path(pid, path);
 			
 			dir = opendir(path);
@@ -3065,7 +3209,13 @@ void BKE_ptcache_id_clear(PTCacheID *pid, int mode, unsigned int cfra)
 		break;
 		
 	case PTCACHE_CLEAR_FRAME:
-		if (pid->cache->flag & PTCACHE_DISK_CACHE) {
+		if ((pid->cache->flag & PTCACHE_DISK_CACHE) && ptcache_use_container(pid)) {
+			PTCacheContainer *container = ptcache_container_get(pid);
+
+			if (container)
+				ptcache_container_frames_remove(container, mode, cfra);
+		}
+		else if (pid->cache->flag & PTCACHE_DISK_CACHE) {
 			if (BKE_ptcache_id_exist(pid, cfra)) {
 				ptcache_filename(pid, filename, cfra, 1, 1); /* no path */
 				BLI_delete(filename, false, false);
@@ -3101,7 +3251,12 @@ int  BKE_ptcache_id_exist(PTCacheID *pid, int cfra)
 	if (pid->cache->cached_frames &&	pid->cache->cached_frames[cfra-pid->cache->startframe]==0)
 		return 0;
 	
-	if (pid->cache->flag & PTCACHE_DISK_CACHE) {
+	if ((pid->cache->flag & PTCACHE_DISK_CACHE) && ptcache_use_container(pid)) {
+		PTCacheContainer *container = ptcache_container_get(pid);
+
+		return container && ptcache_container_frame_exists(container, cfra);
+	}
+	else if (pid->cache->flag & PTCACHE_DISK_CACHE) {
 		char filename[MAX_PTCACHE_FILE];
 		
 		ptcache_filename(pid, filename, cfra, 1, 1);
@@ -3179,7 +3334,22 @@ void BKE_ptcache_id_time(PTCacheID *pid, Scene *scene, float cfra, int *startfra
 
 		cache->cached_frames = MEM_callocN(sizeof(char) * (cache->endframe-cache->startframe+1), "cached frames array");
 
-		if (pid->cache->flag & PTCACHE_DISK_CACHE) {
+		if ((pid->cache->flag & PTCACHE_DISK_CACHE) && ptcache_use_container(pid)) {
+			PTCacheContainer *container = ptcache_container_get(pid);
+
+			if (container) {
+				int totframe, i;
+				int *frames = ptcache_container_frames(container, &totframe);
+
+				for (i = 0; i < totframe; i++) {
+					if (frames[i] >= (int)sta && frames[i] <= (int)end)
+						cache->cached_frames[frames[i] - sta] = 1;
+				}
+
+				MEM_freeN(frames);
+			}
+		}
+		else if (pid->cache->flag & PTCACHE_DISK_CACHE) {
 			/* mode is same as fopen's modes */
 			DIR *dir; 
 			struct dirent *de;
@@ -3365,6 +3535,9 @@ void BKE_ptcache_remove(void)
 	char path_full[MAX_PTCACHE_PATH];
 	int rmdir = 1;
 	
+	/* don't let queued frames recreate the files */
+	ptcache_container_flush();
+
 	ptcache_path(NULL, path);
 
 	if (BLI_exists(path)) {
@@ -3381,7 +3554,7 @@ void BKE_ptcache_remove(void)
 			if (FILENAME_IS_CURRPAR(de->d_name)) {
 				/* do nothing */
 			}
-			else if (strstr(de->d_name, PTCACHE_EXT)) { /* do we have the right extension?*/
+			else if (strstr(de->d_name, PTCACHE_EXT) || strstr(de->d_name, PTCACHE_CONTAINER_EXT)) { /* do we have the right extension?*/
 				BLI_join_dirfile(path_full, sizeof(path_full), path, de->d_name);
 				BLI_delete(path_full, false, false);
 			}
@@ -3851,6 +4024,25 @@ void BKE_ptcache_disk_cache_rename(PTCacheID *pid, const char *name_src, const c
 	/* save old name */
 	BLI_strncpy(old_name, pid->cache->name, sizeof(old_name));
 
+	if (ptcache_use_container(pid)) {
+		BLI_strncpy(pid->cache->name, name_src, sizeof(pid->cache->name));
+		len = ptcache_container_filename(pid, old_path_full);
+
+		BLI_strncpy(pid->cache->name, name_dst, sizeof(pid->cache->name));
+		len = len && ptcache_container_filename(pid, new_path_full);
+
+		if (len) {
+			ptcache_container_forget(old_path_full);
+			ptcache_container_forget(new_path_full);
+
+			if (BLI_exists(old_path_full))
+				BLI_rename(old_path_full, new_path_full);
+		}
+
+		BLI_strncpy(pid->cache->name, old_name, sizeof(pid->cache->name));
+		return;
+	}
+
 	/* get "from" filename */
 	BLI_strncpy(pid->cache->name, name_src, sizeof(pid->cache->name));
 
@@ -3908,39 +4100,65 @@ void BKE_ptcache_load_external(PTCacheID *pid)
 	if (!cache)
 		return;
 
-	ptcache_path(pid, path);
-	
-	len = ptcache_filename(pid, filename, 1, 0, 0); /* no path */
-	
-	dir = opendir(path);
-	if (dir==NULL)
-		return;
+	if (ptcache_use_container(pid)) {
+		PTCacheContainer *container;
+		int *frames, totframe, i;
 
-	const char *fext = ptcache_file_extension(pid);
+		if (!ptcache_container_filename(pid, filename))
+			return;
 
-	if (cache->index >= 0)
-		BLI_snprintf(ext, sizeof(ext), "_%02d%s", cache->index, fext);
-	else
-		BLI_strncpy(ext, fext, sizeof(ext));
-	
-	while ((de = readdir(dir)) != NULL) {
-		if (strstr(de->d_name, ext)) { /* do we have the right extension?*/
-			if (STREQLEN(filename, de->d_name, len)) { /* do we have the right prefix */
-				/* read the number of the file */
-				const int frame = ptcache_frame_from_filename(de->d_name, ext);
+		/* the file may have been written by another session */
+		ptcache_container_forget(filename);
+		container = ptcache_container_acquire(filename);
 
-				if (frame != -1) {
-					if (frame) {
-						start = MIN2(start, frame);
-						end = MAX2(end, frame);
+		frames = ptcache_container_frames(container, &totframe);
+
+		for (i = 0; i < totframe; i++) {
+			if (frames[i]) {
+				start = MIN2(start, frames[i]);
+				end = MAX2(end, frames[i]);
+			}
+			else
+				info = 1;
+		}
+
+		MEM_freeN(frames);
+	}
+	else {
+		ptcache_path(pid, path);
+		
+		len = ptcache_filename(pid, filename, 1, 0, 0); /* no path */
+		
+		dir = opendir(path);
+		if (dir==NULL)
+			return;
+
+		const char *fext = ptcache_file_extension(pid);
+
+		if (cache->index >= 0)
+			BLI_snprintf(ext, sizeof(ext), "_%02d%s", cache->index, fext);
+		else
+			BLI_strncpy(ext, fext, sizeof(ext));
+		
+		while ((de = readdir(dir)) != NULL) {
+			if (strstr(de->d_name, ext)) { /* do we have the right extension?*/
+				if (STREQLEN(filename, de->d_name, len)) { /* do we have the right prefix */
+					/* read the number of the file */
+					const int frame = ptcache_frame_from_filename(de->d_name, ext);
+
+					if (frame != -1) {
+						if (frame) {
+							start = MIN2(start, frame);
+							end = MAX2(end, frame);
+						}
+						else
+							info = 1;
 					}
-					else
-						info = 1;
 				}
 			}
 		}
+		closedir(dir);
 	}
-	closedir(dir);
 
 	if (start != MAXFRAME) {
 		PTCacheFile *pf;
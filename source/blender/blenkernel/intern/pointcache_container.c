@@ -0,0 +1,1058 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2016 Blender Foundation.
+ * All rights reserved.
+ *
+ * Contributor(s): none yet.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenkernel/intern/pointcache_container.c
+ *  \ingroup bke
+ *
+ * Single file storage for disk point caches.
+ *
+ * All frames of a cache are appended to one file, followed by a table of
+ * frames and a fixed size trailer pointing at the table:
+ *
+ *   header | frame record ... | frame table | (unused) | trailer
+ *
+ * New frames are written over the previous table, after which the table is
+ * written again. Before that the trailer is invalidated, and it holds a hash
+ * of the table, so a table which is missing, outdated or damaged (Blender quit
+ * while writing) is never used. The table is then rebuilt by scanning the
+ * frame records instead.
+ *
+ * Removed or replaced frames are only dropped from the table, their records
+ * stay in the file. Once these take more space than the frames still in use,
+ * the live records are copied to a new file which replaces the old one.
+ * Clearing the whole cache deletes the file.
+ *
+ * Compression and writing happen on a background thread. Frames are kept in
+ * memory until they are written, so the simulation never waits for the disk
+ * (unless the writer falls behind by more than #CONTAINER_MAX_PENDING bytes).
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "DNA_object_force.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_fileops.h"
+#include "BLI_ghash.h"
+#include "BLI_hash_mm2a.h"
+#include "BLI_listbase.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+#include "BLI_threads.h"
+
+#include "BKE_global.h"
+#include "BKE_pointcache.h"
+
+#include "pointcache_container.h"
+
+#ifdef WITH_LZO
+#  ifdef WITH_SYSTEM_LZO
+#    include <lzo/lzo1x.h>
+#  else
+#    include "minilzo.h"
+#  endif
+#  define LZO_HEAP_ALLOC(var,size) \
+	lzo_align_t __LZO_MMODEL var [ ((size) + (sizeof(lzo_align_t) - 1)) / sizeof(lzo_align_t) ]
+#  define LZO_OUT_LEN(size)     ((size) + (size) / 16 + 64 + 3)
+#endif
+
+#ifdef WITH_LZMA
+#include "LzmaLib.h"
+#endif
+
+#define CONTAINER_ID            "BPHYSCON"
+#define CONTAINER_VERSION       2
+#define CONTAINER_RECORD_ID     "FRAM"
+#define CONTAINER_TRAILER_ID    "BPIX"
+
+/* frames written between table updates while the writer is busy */
+#define CONTAINER_TABLE_INTERVAL    64
+/* unused records are removed when they take more than this and the frames in use */
+#define CONTAINER_COMPACT_MIN       ((uint64_t)16 * 1024 * 1024)
+/* writing a frame waits for the writer when more than this is queued */
+#define CONTAINER_MAX_PENDING       ((size_t)512 * 1024 * 1024)
+
+/* File layout */
+
+typedef struct ContainerHeader {
+	char id[8];
+	unsigned int version, pad;
+} ContainerHeader;
+
+typedef struct ContainerRecord {
+	char id[4];
+	int frame;
+	unsigned int compression, raw_len, stored_len;
+} ContainerRecord;
+
+typedef struct ContainerTableEntry {
+	uint64_t offset;
+	int frame;
+	unsigned int compression, raw_len, stored_len;
+} ContainerTableEntry;
+
+typedef struct ContainerTrailer {
+	uint64_t table_offset;
+	unsigned int totframe;
+	unsigned int table_hash;
+	char id[4];
+	unsigned int pad;
+} ContainerTrailer;
+
+/* Runtime data */
+
+typedef struct ContainerJob {
+	PTCacheContainer *container;
+	int frame, compression;
+	/* NULL when only the table needs writing */
+	unsigned char *data;
+	unsigned int len;
+} ContainerJob;
+
+typedef struct ContainerFrame {
+	ContainerTableEntry entry;
+	/* queued data, not on disk yet */
+	ContainerJob *job;
+} ContainerFrame;
+
+struct PTCacheContainer {
+	struct PTCacheContainer *next, *prev;
+
+	char filepath[FILE_MAX];
+	GHash *frames;
+
+	/* only used by the writer once loaded */
+	uint64_t data_end, file_len;
+	int unindexed;
+	/* trailer at the end of the file points at an up to date table */
+	bool trailer_valid;
+
+	/* incremented when the file is replaced by a compacted one, offsets
+	 * of entries read before that point into the old file */
+	int generation;
+
+	int pending;
+};
+
+static ThreadMutex container_lock = BLI_MUTEX_INITIALIZER;
+static ThreadCondition container_cond;
+static ListBase container_list = {NULL, NULL};
+static ListBase container_threads = {NULL, NULL};
+static ThreadQueue *container_queue = NULL;
+static size_t container_pending_len = 0;
+static int container_pending = 0;
+static bool container_initialized = false;
+
+/* -------------------------------------------------------------------- */
+/* Compression */
+
+static unsigned char *container_compress(
+        const unsigned char *in, unsigned int in_len, int *r_compression, unsigned int *r_len)
+{
+	unsigned char *out = NULL;
+
+	UNUSED_VARS(in, in_len, out, r_len);
+
+#ifdef WITH_LZO
+	if (*r_compression == PTCACHE_COMPRESS_LZO) {
+		lzo_uint out_len = LZO_OUT_LEN(in_len);
+		LZO_HEAP_ALLOC(wrkmem, LZO1X_MEM_COMPRESS);
+
+		out = MEM_mallocN(out_len, "ptcache container lzo");
+
+		if (lzo1x_1_compress(in, in_len, out, &out_len, wrkmem) == LZO_E_OK && out_len < in_len) {
+			*r_len = (unsigned int)out_len;
+			return out;
+		}
+
+		MEM_freeN(out);
+	}
+#endif
+#ifdef WITH_LZMA
+	if (*r_compression == PTCACHE_COMPRESS_LZMA) {
+		size_t props_len = LZMA_PROPS_SIZE;
+		size_t out_len = in_len;
+
+		/* properties are stored in front of the data */
+		out = MEM_mallocN(LZMA_PROPS_SIZE + in_len, "ptcache container lzma");
+
+		if (LzmaCompress(out + LZMA_PROPS_SIZE, &out_len, in, in_len, out, &props_len,
+		                 5, 1 << 24, 3, 0, 2, 32, 2) == SZ_OK &&
+		    props_len == LZMA_PROPS_SIZE && out_len + LZMA_PROPS_SIZE < in_len)
+		{
+			*r_len = (unsigned int)(out_len + LZMA_PROPS_SIZE);
+			return out;
+		}
+
+		MEM_freeN(out);
+	}
+#endif
+
+	*r_compression = PTCACHE_COMPRESS_NO;
+	return NULL;
+}
+
+static bool container_decompress(
+        int compression, const unsigned char *in, unsigned int in_len, unsigned char *out, unsigned int out_len)
+{
+	UNUSED_VARS(in, in_len, out, out_len);
+
+	switch (compression) {
+#ifdef WITH_LZO
+		case PTCACHE_COMPRESS_LZO:
+		{
+			lzo_uint len = out_len;
+			return (lzo1x_decompress_safe(in, in_len, out, &len, NULL) == LZO_E_OK && len == out_len);
+		}
+#endif
+#ifdef WITH_LZMA
+		case PTCACHE_COMPRESS_LZMA:
+		{
+			size_t len = out_len;
+			SizeT src_len = in_len - LZMA_PROPS_SIZE;
+
+			if (in_len < LZMA_PROPS_SIZE)
+				return false;
+
+			return (LzmaUncompress(out, &len, in + LZMA_PROPS_SIZE, &src_len, in, LZMA_PROPS_SIZE) == SZ_OK &&
+			        len == out_len);
+		}
+#endif
+		default:
+			return false;
+	}
+}
+
+/* -------------------------------------------------------------------- */
+/* Index */
+
+static void container_frame_free(void *frame)
+{
+	MEM_freeN(frame);
+}
+
+static ContainerFrame *container_frame_ensure(PTCacheContainer *container, int frame)
+{
+	void **val_p;
+
+	if (!BLI_ghash_ensure_p(container->frames, SET_INT_IN_POINTER(frame), &val_p)) {
+		*val_p = MEM_callocN(sizeof(ContainerFrame), "ContainerFrame");
+	}
+
+	return *val_p;
+}
+
+static unsigned int container_table_hash(const ContainerTableEntry *table, unsigned int totframe)
+{
+	return BLI_hash_mm2((const unsigned char *)table, sizeof(ContainerTableEntry) * totframe, 0);
+}
+
+static bool container_load_table(PTCacheContainer *container, FILE *fp, uint64_t file_len)
+{
+	ContainerTrailer trailer;
+	ContainerTableEntry *table;
+	unsigned int i;
+
+	if (file_len < sizeof(ContainerHeader) + sizeof(ContainerTrailer))
+		return false;
+
+	if (fseek(fp, file_len - sizeof(ContainerTrailer), SEEK_SET) != 0 ||
+	    fread(&trailer, sizeof(ContainerTrailer), 1, fp) != 1 ||
+	    !STREQLEN(trailer.id, CONTAINER_TRAILER_ID, 4))
+	{
+		return false;
+	}
+
+	if (trailer.table_offset < sizeof(ContainerHeader) ||
+	    trailer.table_offset + (uint64_t)trailer.totframe * sizeof(ContainerTableEntry) >
+	    file_len - sizeof(ContainerTrailer))
+	{
+		return false;
+	}
+
+	table = MEM_mallocN(sizeof(ContainerTableEntry) * MAX2(trailer.totframe, 1), __func__);
+
+	if (fseek(fp, trailer.table_offset, SEEK_SET) != 0 ||
+	    fread(table, sizeof(ContainerTableEntry), trailer.totframe, fp) != trailer.totframe ||
+	    container_table_hash(table, trailer.totframe) != trailer.table_hash)
+	{
+		MEM_freeN(table);
+		return false;
+	}
+
+	for (i = 0; i < trailer.totframe; i++) {
+		if (table[i].offset + table[i].stored_len <= trailer.table_offset) {
+			container_frame_ensure(container, table[i].frame)->entry = table[i];
+		}
+	}
+
+	MEM_freeN(table);
+
+	container->data_end = trailer.table_offset;
+	container->trailer_valid = true;
+
+	return true;
+}
+
+static void container_load_scan(PTCacheContainer *container, FILE *fp, uint64_t file_len)
+{
+	ContainerRecord record;
+	uint64_t offset = sizeof(ContainerHeader);
+
+	while (fseek(fp, offset, SEEK_SET) == 0 &&
+	       fread(&record, sizeof(ContainerRecord), 1, fp) == 1 &&
+	       STREQLEN(record.id, CONTAINER_RECORD_ID, 4) &&
+	       offset + sizeof(ContainerRecord) + record.stored_len <= file_len)
+	{
+		ContainerFrame *frame = container_frame_ensure(container, record.frame);
+
+		frame->entry.offset = offset + sizeof(ContainerRecord);
+		frame->entry.frame = record.frame;
+		frame->entry.compression = record.compression;
+		frame->entry.raw_len = record.raw_len;
+		frame->entry.stored_len = record.stored_len;
+
+		offset = frame->entry.offset + record.stored_len;
+	}
+
+	container->data_end = offset;
+}
+
+static void container_load(PTCacheContainer *container)
+{
+	ContainerHeader header;
+	uint64_t file_len;
+	FILE *fp;
+
+	if (!BLI_exists(container->filepath))
+		return;
+
+	fp = BLI_fopen(container->filepath, "rb");
+	if (fp == NULL)
+		return;
+
+	file_len = BLI_file_size(container->filepath);
+
+	if (fread(&header, sizeof(ContainerHeader), 1, fp) == 1 &&
+	    STREQLEN(header.id, CONTAINER_ID, 8) &&
+	    header.version == CONTAINER_VERSION)
+	{
+		if (!container_load_table(container, fp, file_len)) {
+			BLI_ghash_clear(container->frames, NULL, container_frame_free);
+			container_load_scan(container, fp, file_len);
+		}
+
+		container->file_len = file_len;
+	}
+
+	fclose(fp);
+}
+
+/* Wait until all queued jobs of container are done, container_lock must be held. */
+static void container_wait(PTCacheContainer *container)
+{
+	while (container->pending) {
+		BLI_condition_wait(&container_cond, &container_lock);
+	}
+}
+
+/* -------------------------------------------------------------------- */
+/* Writer thread */
+
+static int container_entry_cmp(const void *a_v, const void *b_v)
+{
+	const ContainerTableEntry *a = a_v, *b = b_v;
+
+	if (a->frame < b->frame) return -1;
+	else if (a->frame > b->frame) return 1;
+	return 0;
+}
+
+static bool container_write_table(PTCacheContainer *container, FILE *fp)
+{
+	GHashIterator gh_iter;
+	ContainerTableEntry *table;
+	ContainerTrailer trailer = {0};
+	uint64_t trailer_offset;
+	unsigned int totframe = 0;
+	bool ok;
+
+	BLI_mutex_lock(&container_lock);
+
+	table = MEM_mallocN(sizeof(ContainerTableEntry) * MAX2(BLI_ghash_size(container->frames), 1), __func__);
+
+	GHASH_ITER (gh_iter, container->frames) {
+		ContainerFrame *frame = BLI_ghashIterator_getValue(&gh_iter);
+
+		if (frame->job == NULL) {
+			table[totframe++] = frame->entry;
+		}
+	}
+
+	BLI_mutex_unlock(&container_lock);
+
+	qsort(table, totframe, sizeof(ContainerTableEntry), container_entry_cmp);
+
+	trailer.table_offset = container->data_end;
+	trailer.totframe = totframe;
+	trailer.table_hash = container_table_hash(table, totframe);
+	memcpy(trailer.id, CONTAINER_TRAILER_ID, 4);
+
+	/* the trailer has to end the file, which never shrinks, files too short
+	 * to hold one are corrupt and their tail is simply overwritten */
+	trailer_offset = container->data_end + (uint64_t)totframe * sizeof(ContainerTableEntry);
+	if (container->file_len >= sizeof(ContainerHeader) + sizeof(ContainerTrailer)) {
+		trailer_offset = MAX2(trailer_offset, container->file_len - sizeof(ContainerTrailer));
+	}
+
+	ok = (fseek(fp, container->data_end, SEEK_SET) == 0 &&
+	      fwrite(table, sizeof(ContainerTableEntry), totframe, fp) == totframe &&
+	      fflush(fp) == 0 &&
+	      fseek(fp, trailer_offset, SEEK_SET) == 0 &&
+	      fwrite(&trailer, sizeof(ContainerTrailer), 1, fp) == 1 &&
+	      fflush(fp) == 0);
+
+	if (ok) {
+		container->file_len = trailer_offset + sizeof(ContainerTrailer);
+		container->unindexed = 0;
+		container->trailer_valid = true;
+	}
+
+	MEM_freeN(table);
+
+	return ok;
+}
+
+/* Called before the table is overwritten, so it's never loaded after a crash. */
+static bool container_invalidate_trailer(PTCacheContainer *container, FILE *fp)
+{
+	const char id[4] = {0};
+
+	if (!container->trailer_valid)
+		return true;
+
+	if (fseek(fp, container->file_len - sizeof(ContainerTrailer) + offsetof(ContainerTrailer, id), SEEK_SET) != 0 ||
+	    fwrite(id, sizeof(id), 1, fp) != 1 ||
+	    fflush(fp) != 0)
+	{
+		return false;
+	}
+
+	container->trailer_valid = false;
+	return true;
+}
+
+static FILE *container_open_for_writing(PTCacheContainer *container)
+{
+	ContainerHeader header = {{0}};
+	FILE *fp = NULL;
+
+	if (container->data_end) {
+		fp = BLI_fopen(container->filepath, "rb+");
+		if (fp)
+			return fp;
+	}
+
+	BLI_make_existing_file(container->filepath);
+	fp = BLI_fopen(container->filepath, "wb+");
+	if (fp == NULL)
+		return NULL;
+
+	memcpy(header.id, CONTAINER_ID, 8);
+	header.version = CONTAINER_VERSION;
+
+	if (fwrite(&header, sizeof(ContainerHeader), 1, fp) != 1) {
+		fclose(fp);
+		return NULL;
+	}
+
+	container->data_end = container->file_len = sizeof(ContainerHeader);
+	container->trailer_valid = false;
+
+	return fp;
+}
+
+/* Bytes of records which aren't used by any frame anymore. */
+static uint64_t container_unused_len(PTCacheContainer *container)
+{
+	GHashIterator gh_iter;
+	uint64_t used = sizeof(ContainerHeader);
+
+	BLI_mutex_lock(&container_lock);
+
+	GHASH_ITER (gh_iter, container->frames) {
+		ContainerFrame *frame = BLI_ghashIterator_getValue(&gh_iter);
+
+		if (frame->job == NULL) {
+			used += sizeof(ContainerRecord) + frame->entry.stored_len;
+		}
+	}
+
+	BLI_mutex_unlock(&container_lock);
+
+	return (container->data_end > used) ? container->data_end - used : 0;
+}
+
+typedef struct ContainerMove {
+	int frame;
+	unsigned int stored_len;
+	uint64_t old_offset, new_offset;
+} ContainerMove;
+
+static int container_move_cmp(const void *a_v, const void *b_v)
+{
+	const ContainerMove *a = a_v, *b = b_v;
+
+	if (a->old_offset < b->old_offset) return -1;
+	else if (a->old_offset > b->old_offset) return 1;
+	return 0;
+}
+
+/* Copy the records in use to a new file replacing the old one, the table has
+ * to be written afterwards. Readers notice the new file by the generation. */
+static void container_compact(PTCacheContainer *container)
+{
+	GHashIterator gh_iter;
+	ContainerHeader header = {{0}};
+	ContainerMove *moves;
+	char filepath_tmp[FILE_MAX];
+	unsigned char *buf = NULL;
+	size_t buf_len = 0;
+	uint64_t offset = sizeof(ContainerHeader);
+	unsigned int totmove = 0, i;
+	FILE *fp_src, *fp_dst;
+	bool ok;
+
+	BLI_mutex_lock(&container_lock);
+
+	moves = MEM_mallocN(sizeof(ContainerMove) * MAX2(BLI_ghash_size(container->frames), 1), __func__);
+
+	GHASH_ITER (gh_iter, container->frames) {
+		ContainerFrame *frame = BLI_ghashIterator_getValue(&gh_iter);
+
+		if (frame->job == NULL) {
+			moves[totmove].frame = frame->entry.frame;
+			moves[totmove].stored_len = frame->entry.stored_len;
+			moves[totmove].old_offset = frame->entry.offset;
+			totmove++;
+		}
+	}
+
+	BLI_mutex_unlock(&container_lock);
+
+	qsort(moves, totmove, sizeof(ContainerMove), container_move_cmp);
+
+	BLI_snprintf(filepath_tmp, sizeof(filepath_tmp), "%s.tmp", container->filepath);
+
+	memcpy(header.id, CONTAINER_ID, 8);
+	header.version = CONTAINER_VERSION;
+
+	fp_src = BLI_fopen(container->filepath, "rb");
+	fp_dst = BLI_fopen(filepath_tmp, "wb");
+
+	ok = (fp_src && fp_dst && fwrite(&header, sizeof(ContainerHeader), 1, fp_dst) == 1);
+
+	for (i = 0; i < totmove && ok; i++) {
+		const size_t len = sizeof(ContainerRecord) + moves[i].stored_len;
+
+		if (len > buf_len) {
+			buf_len = len;
+			buf = MEM_reallocN_id(buf, buf_len, __func__);
+		}
+
+		ok = (fseek(fp_src, moves[i].old_offset - sizeof(ContainerRecord), SEEK_SET) == 0 &&
+		      fread(buf, 1, len, fp_src) == len &&
+		      STREQLEN((const char *)buf, CONTAINER_RECORD_ID, 4) &&
+		      fwrite(buf, 1, len, fp_dst) == len);
+
+		moves[i].new_offset = offset + sizeof(ContainerRecord);
+		offset += len;
+	}
+
+	if (fp_src)
+		fclose(fp_src);
+	if (fp_dst)
+		ok = (fclose(fp_dst) == 0) && ok;
+
+	BLI_mutex_lock(&container_lock);
+
+	if (ok && BLI_rename(filepath_tmp, container->filepath) == 0) {
+		for (i = 0; i < totmove; i++) {
+			ContainerFrame *frame = BLI_ghash_lookup(container->frames, SET_INT_IN_POINTER(moves[i].frame));
+
+			if (frame && frame->job == NULL && frame->entry.offset == moves[i].old_offset) {
+				frame->entry.offset = moves[i].new_offset;
+			}
+		}
+
+		container->generation++;
+		container->data_end = container->file_len = offset;
+		container->trailer_valid = false;
+	}
+	else {
+		ok = false;
+	}
+
+	BLI_mutex_unlock(&container_lock);
+
+	if (!ok) {
+		if (BLI_exists(filepath_tmp))
+			BLI_delete(filepath_tmp, false, false);
+
+		if (G.debug & G_DEBUG)
+			printf("Error compacting point cache file %s\n", container->filepath);
+	}
+
+	MEM_SAFE_FREE(buf);
+	MEM_freeN(moves);
+}
+
+static void container_job_process(ContainerJob *job)
+{
+	PTCacheContainer *container = job->container;
+	ContainerFrame *frame;
+	ContainerRecord record = {{0}};
+	bool write = true, ok = false;
+	FILE *fp;
+
+	if (job->data) {
+		/* skip frames removed or replaced since they were queued */
+		BLI_mutex_lock(&container_lock);
+		frame = BLI_ghash_lookup(container->frames, SET_INT_IN_POINTER(job->frame));
+		write = (frame && frame->job == job);
+		BLI_mutex_unlock(&container_lock);
+	}
+
+	fp = write ? container_open_for_writing(container) : NULL;
+
+	if (fp && job->data) {
+		int compression = job->compression;
+		unsigned int stored_len = job->len;
+		unsigned char *stored = container_compress(job->data, job->len, &compression, &stored_len);
+
+		memcpy(record.id, CONTAINER_RECORD_ID, 4);
+		record.frame = job->frame;
+		record.compression = compression;
+		record.raw_len = job->len;
+		record.stored_len = stored_len;
+
+		ok = (container_invalidate_trailer(container, fp) &&
+		      fseek(fp, container->data_end, SEEK_SET) == 0 &&
+		      fwrite(&record, sizeof(ContainerRecord), 1, fp) == 1 &&
+		      fwrite(stored ? stored : job->data, 1, stored_len, fp) == stored_len &&
+		      fflush(fp) == 0);
+
+		if (stored)
+			MEM_freeN(stored);
+
+		BLI_mutex_lock(&container_lock);
+
+		frame = BLI_ghash_lookup(container->frames, SET_INT_IN_POINTER(job->frame));
+		if (frame && frame->job == job) {
+			if (ok) {
+				frame->entry.offset = container->data_end + sizeof(ContainerRecord);
+				frame->entry.frame = record.frame;
+				frame->entry.compression = record.compression;
+				frame->entry.raw_len = record.raw_len;
+				frame->entry.stored_len = record.stored_len;
+				frame->job = NULL;
+			}
+			else {
+				BLI_ghash_remove(container->frames, SET_INT_IN_POINTER(job->frame), NULL, container_frame_free);
+			}
+		}
+
+		BLI_mutex_unlock(&container_lock);
+
+		if (ok) {
+			container->data_end += sizeof(ContainerRecord) + stored_len;
+			container->file_len = MAX2(container->file_len, container->data_end);
+			container->unindexed++;
+		}
+	}
+
+	if (fp) {
+		/* keep the table current when idle, rebuilding it by scanning is slow for long caches */
+		if (job->data == NULL ||
+		    container->unindexed >= CONTAINER_TABLE_INTERVAL ||
+		    BLI_thread_queue_is_empty(container_queue))
+		{
+			const uint64_t unused_len = container_unused_len(container);
+
+			if (unused_len > CONTAINER_COMPACT_MIN &&
+			    unused_len > container->data_end - unused_len)
+			{
+				fclose(fp);
+				container_compact(container);
+				fp = container_open_for_writing(container);
+			}
+
+			ok = fp && container_write_table(container, fp) && ok;
+		}
+
+		if (fp)
+			fclose(fp);
+	}
+
+	if (write && !ok && (G.debug & G_DEBUG))
+		printf("Error writing point cache file %s\n", container->filepath);
+
+	BLI_mutex_lock(&container_lock);
+	container->pending--;
+	container_pending--;
+	container_pending_len -= job->len;
+	BLI_condition_notify_all(&container_cond);
+	BLI_mutex_unlock(&container_lock);
+
+	if (job->data)
+		MEM_freeN(job->data);
+	MEM_freeN(job);
+}
+
+static void *container_writer_thread(void *UNUSED(data))
+{
+	ContainerJob *job;
+
+	while ((job = BLI_thread_queue_pop(container_queue))) {
+		container_job_process(job);
+	}
+
+	return NULL;
+}
+
+/* container_lock must be held */
+static void container_job_push(PTCacheContainer *container, ContainerJob *job)
+{
+	if (container_queue == NULL) {
+		container_queue = BLI_thread_queue_init();
+		BLI_init_threads(&container_threads, container_writer_thread, 1);
+		BLI_insert_thread(&container_threads, NULL);
+	}
+
+	job->container = container;
+	container->pending++;
+	container_pending++;
+	container_pending_len += job->len;
+
+	BLI_thread_queue_push(container_queue, job);
+}
+
+/* -------------------------------------------------------------------- */
+/* Public functions */
+
+PTCacheContainer *ptcache_container_acquire(const char *filepath)
+{
+	PTCacheContainer *container;
+
+	BLI_mutex_lock(&container_lock);
+
+	if (!container_initialized) {
+		BLI_condition_init(&container_cond);
+		container_initialized = true;
+	}
+
+	for (container = container_list.first; container; container = container->next) {
+		if (BLI_path_cmp(container->filepath, filepath) == 0)
+			break;
+	}
+
+	if (container == NULL) {
+		container = MEM_callocN(sizeof(PTCacheContainer), "PTCacheContainer");
+		BLI_strncpy(container->filepath, filepath, sizeof(container->filepath));
+		container->frames = BLI_ghash_int_new(__func__);
+
+		container_load(container);
+
+		BLI_addtail(&container_list, container);
+	}
+
+	BLI_mutex_unlock(&container_lock);
+
+	return container;
+}
+
+/* Drop the cached index, for when the file is renamed or changed by others. */
+void ptcache_container_forget(const char *filepath)
+{
+	PTCacheContainer *container;
+
+	BLI_mutex_lock(&container_lock);
+
+	for (container = container_list.first; container; container = container->next) {
+		if (BLI_path_cmp(container->filepath, filepath) == 0)
+			break;
+	}
+
+	if (container) {
+		container_wait(container);
+
+		BLI_remlink(&container_list, container);
+		BLI_ghash_free(container->frames, NULL, container_frame_free);
+		MEM_freeN(container);
+	}
+
+	BLI_mutex_unlock(&container_lock);
+}
+
+/* Wait until all queued frames are on disk. */
+void ptcache_container_flush(void)
+{
+	BLI_mutex_lock(&container_lock);
+
+	while (container_pending) {
+		BLI_condition_wait(&container_cond, &container_lock);
+	}
+
+	BLI_mutex_unlock(&container_lock);
+}
+
+bool ptcache_container_frame_exists(PTCacheContainer *container, int frame)
+{
+	bool exists;
+
+	BLI_mutex_lock(&container_lock);
+	exists = BLI_ghash_haskey(container->frames, SET_INT_IN_POINTER(frame));
+	BLI_mutex_unlock(&container_lock);
+
+	return exists;
+}
+
+static int container_int_cmp(const void *a_v, const void *b_v)
+{
+	const int a = *(const int *)a_v, b = *(const int *)b_v;
+
+	if (a < b) return -1;
+	else if (a > b) return 1;
+	return 0;
+}
+
+/* Returns sorted frame numbers, to be freed with MEM_freeN. */
+int *ptcache_container_frames(PTCacheContainer *container, int *r_totframe)
+{
+	GHashIterator gh_iter;
+	int *frames;
+	int totframe = 0;
+
+	BLI_mutex_lock(&container_lock);
+
+	frames = MEM_mallocN(sizeof(int) * MAX2(BLI_ghash_size(container->frames), 1), __func__);
+
+	GHASH_ITER (gh_iter, container->frames) {
+		frames[totframe++] = GET_INT_FROM_POINTER(BLI_ghashIterator_getKey(&gh_iter));
+	}
+
+	BLI_mutex_unlock(&container_lock);
+
+	qsort(frames, totframe, sizeof(int), container_int_cmp);
+
+	*r_totframe = totframe;
+	return frames;
+}
+
+unsigned char *ptcache_container_frame_read(PTCacheContainer *container, int frame, unsigned int *r_len)
+{
+	ContainerFrame *cframe;
+	ContainerTableEntry entry;
+	unsigned char *data, *stored;
+	int generation;
+	bool ok, replaced;
+	FILE *fp;
+
+	BLI_mutex_lock(&container_lock);
+
+	cframe = BLI_ghash_lookup(container->frames, SET_INT_IN_POINTER(frame));
+
+	if (cframe == NULL) {
+		BLI_mutex_unlock(&container_lock);
+		return NULL;
+	}
+
+	if (cframe->job) {
+		/* still queued for writing */
+		data = MEM_mallocN(MAX2(cframe->job->len, 1), "ptcache container frame");
+		memcpy(data, cframe->job->data, cframe->job->len);
+		*r_len = cframe->job->len;
+
+		BLI_mutex_unlock(&container_lock);
+		return data;
+	}
+
+	entry = cframe->entry;
+	generation = container->generation;
+
+	BLI_mutex_unlock(&container_lock);
+
+	fp = BLI_fopen(container->filepath, "rb");
+	if (fp == NULL)
+		return NULL;
+
+	/* file was replaced by a compacted one before it was opened */
+	BLI_mutex_lock(&container_lock);
+	replaced = (container->generation != generation);
+	BLI_mutex_unlock(&container_lock);
+
+	if (replaced) {
+		fclose(fp);
+		return ptcache_container_frame_read(container, frame, r_len);
+	}
+
+	data = MEM_mallocN(MAX2(entry.raw_len, 1), "ptcache container frame");
+	stored = (entry.compression == PTCACHE_COMPRESS_NO) ?
+	         data : MEM_mallocN(MAX2(entry.stored_len, 1), "ptcache container stored");
+
+	ok = (fseek(fp, entry.offset, SEEK_SET) == 0 &&
+	      fread(stored, 1, entry.stored_len, fp) == entry.stored_len);
+
+	fclose(fp);
+
+	if (stored != data) {
+		ok = ok && container_decompress(entry.compression, stored, entry.stored_len, data, entry.raw_len);
+		MEM_freeN(stored);
+	}
+	else {
+		ok = ok && (entry.stored_len == entry.raw_len);
+	}
+
+	if (!ok) {
+		if (G.debug & G_DEBUG)
+			printf("Error reading frame %d from point cache file %s\n", frame, container->filepath);
+
+		MEM_freeN(data);
+		return NULL;
+	}
+
+	*r_len = entry.raw_len;
+	return data;
+}
+
+void ptcache_container_frame_write(
+        PTCacheContainer *container, int frame, unsigned char *data, unsigned int len, int compression)
+{
+	ContainerJob *job = MEM_callocN(sizeof(ContainerJob), "ContainerJob");
+	ContainerFrame *cframe;
+
+	job->frame = frame;
+	job->compression = compression;
+	job->data = data;
+	job->len = len;
+
+	BLI_mutex_lock(&container_lock);
+
+	/* don't let the queue grow without bounds when the disk can't keep up */
+	while (container_pending_len > CONTAINER_MAX_PENDING) {
+		BLI_condition_wait(&container_cond, &container_lock);
+	}
+
+	cframe = container_frame_ensure(container, frame);
+	cframe->entry.frame = frame;
+	cframe->job = job;
+
+	container_job_push(container, job);
+
+	BLI_mutex_unlock(&container_lock);
+}
+
+void ptcache_container_frames_remove(PTCacheContainer *container, int mode, int frame)
+{
+	GHashIterator gh_iter;
+	int *remove;
+	int totremove = 0, i;
+	bool on_disk = false;
+
+	BLI_mutex_lock(&container_lock);
+
+	if (mode == PTCACHE_CLEAR_ALL) {
+		container_wait(container);
+
+		BLI_ghash_clear(container->frames, NULL, container_frame_free);
+
+		if (BLI_exists(container->filepath))
+			BLI_delete(container->filepath, false, false);
+
+		container->data_end = container->file_len = 0;
+		container->unindexed = 0;
+		container->trailer_valid = false;
+
+		BLI_mutex_unlock(&container_lock);
+		return;
+	}
+
+	remove = MEM_mallocN(sizeof(int) * MAX2(BLI_ghash_size(container->frames), 1), __func__);
+
+	GHASH_ITER (gh_iter, container->frames) {
+		ContainerFrame *cframe = BLI_ghashIterator_getValue(&gh_iter);
+		const int cfra = GET_INT_FROM_POINTER(BLI_ghashIterator_getKey(&gh_iter));
+
+		if ((mode == PTCACHE_CLEAR_FRAME && cfra == frame) ||
+		    (mode == PTCACHE_CLEAR_BEFORE && cfra < frame) ||
+		    (mode == PTCACHE_CLEAR_AFTER && cfra > frame))
+		{
+			remove[totremove++] = cfra;
+			on_disk |= (cframe->job == NULL);
+		}
+	}
+
+	/* queued frames are skipped by the writer once removed */
+	for (i = 0; i < totremove; i++) {
+		BLI_ghash_remove(container->frames, SET_INT_IN_POINTER(remove[i]), NULL, container_frame_free);
+	}
+
+	if (on_disk) {
+		container_job_push(container, MEM_callocN(sizeof(ContainerJob), "ContainerJob"));
+	}
+
+	BLI_mutex_unlock(&container_lock);
+
+	MEM_freeN(remove);
+}
+
+void BKE_ptcache_container_exit(void)
+{
+	PTCacheContainer *container;
+
+	ptcache_container_flush();
+
+	if (container_queue) {
+		BLI_thread_queue_nowait(container_queue);
+		BLI_end_threads(&container_threads);
+		BLI_thread_queue_free(container_queue);
+		container_queue = NULL;
+	}
+
+	while ((container = BLI_pophead(&container_list))) {
+		BLI_ghash_free(container->frames, NULL, container_frame_free);
+		MEM_freeN(container);
+	}
+
+	if (container_initialized) {
+		BLI_condition_end(&container_cond);
+		container_initialized = false;
+	}
+}
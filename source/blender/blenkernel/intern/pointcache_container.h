@@ -0,0 +1,53 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2016 Blender Foundation.
+ * All rights reserved.
+ *
+ * Contributor(s): none yet.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+#ifndef __POINTCACHE_CONTAINER_H__
+#define __POINTCACHE_CONTAINER_H__
+
+/** \file blender/blenkernel/intern/pointcache_container.h
+ *  \ingroup bke
+ *
+ * Single file storage for disk point caches, see pointcache_container.c.
+ */
+
+typedef struct PTCacheContainer PTCacheContainer;
+
+/* Containers are shared by file path and live until exit. */
+PTCacheContainer *ptcache_container_acquire(const char *filepath);
+void ptcache_container_forget(const char *filepath);
+void ptcache_container_flush(void);
+
+bool ptcache_container_frame_exists(PTCacheContainer *container, int frame);
+int *ptcache_container_frames(PTCacheContainer *container, int *r_totframe);
+
+/* Returns uncompressed frame data, to be freed with MEM_freeN. */
+unsigned char *ptcache_container_frame_read(PTCacheContainer *container, int frame, unsigned int *r_len);
+/* Takes ownership of data, compression and writing happens in the background. */
+void ptcache_container_frame_write(
+        PTCacheContainer *container, int frame, unsigned char *data, unsigned int len, int compression);
+/* Mode is one of PTCACHE_CLEAR_*. */
+void ptcache_container_frames_remove(PTCacheContainer *container, int mode, int frame);
+
+#endif  /* __POINTCACHE_CONTAINER_H__ */
@@ -41,6 +41,7 @@
 
 #include "BLI_blenlib.h"
 #include "BLI_math.h"
+#include "BLI_task.h"
 
 #ifdef WITH_BULLET
 #  include "RBI_api.h"
@@ -896,6 +897,29 @@ static void rigidbody_validate_sim_constraint(RigidBodyWorld *rbw, Object *ob, b
 
 /* --------------------- */
 
+typedef struct RigidBodyParallelData {
+	void *userdata;
+	rbParallelRangeFunc func;
+} RigidBodyParallelData;
+
+static void rigidbody_parallel_cb(void *userdata, void *UNUSED(userdata_chunk), const int iter, const int thread_id)
+{
+	RigidBodyParallelData *data = userdata;
+
+	data->func(data->userdata, iter, thread_id);
+}
+
+/* Parallel-for handed to the physics world, backed by the task scheduler. */
+static void rigidbody_parallel_for(int start, int stop, void *userdata, rbParallelRangeFunc func)
+{
+	RigidBodyParallelData data;
+
+	data.userdata = userdata;
+	data.func = func;
+
+	BLI_task_parallel_range_ex(start, stop, &data, NULL, 0, rigidbody_parallel_cb, (stop - start) > 1, true);
+}
+
 /* Create physics sim world given RigidBody world settings */
 // NOTE: this does NOT update object references that the scene uses, in case those aren't ready yet!
 void BKE_rigidbody_validate_sim_world(Scene *scene, RigidBodyWorld *rbw, bool rebuild)
@@ -913,6 +937,24 @@ void BKE_rigidbody_validate_sim_world(Scene *scene, RigidBodyWorld *rbw, bool re
 
 	RB_dworld_set_solver_iterations(rbw->physics_world, rbw->num_solver_iterations);
 	RB_dworld_set_split_impulse(rbw->physics_world, rbw->flag & RBW_FLAG_USE_SPLIT_IMPULSE);
+
+	BKE_rigidbody_world_update_threads(rbw);
+}
+
+/* Apply the multithreading option to the physics world, if any */
+void BKE_rigidbody_world_update_threads(RigidBodyWorld *rbw)
+{
+	if (rbw->physics_world == NULL)
+		return;
+
+	if (rbw->flag & RBW_FLAG_USE_THREADS) {
+		TaskScheduler *scheduler = BLI_task_scheduler_get();
+
+		RB_dworld_set_parallel(rbw->physics_world, rigidbody_parallel_for, BLI_task_scheduler_num_threads(scheduler));
+	}
+	else {
+		RB_dworld_set_parallel(rbw->physics_world, NULL, 0);
+	}
 }
 
 /* ************************************** */
@@ -1635,6 +1677,7 @@ struct RigidBodyOb *BKE_rigidbody_copy_object(Object *ob) { return NULL; }
 struct RigidBodyCon *BKE_rigidbody_copy_constraint(Object *ob) { return NULL; }
 void BKE_rigidbody_relink_constraint(RigidBodyCon *rbc) {}
 void BKE_rigidbody_validate_sim_world(Scene *scene, RigidBodyWorld *rbw, bool rebuild) {}
+void BKE_rigidbody_world_update_threads(RigidBodyWorld *rbw) {}
 void BKE_rigidbody_calc_volume(Object *ob, float *r_vol) { if (r_vol) *r_vol = 0.0f; }
 void BKE_rigidbody_calc_center_of_mass(Object *ob, float r_center[3]) { zero_v3(r_center); }
 struct RigidBodyWorld *BKE_rigidbody_create_world(Scene *scene) { return NULL; }
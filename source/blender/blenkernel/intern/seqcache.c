@@ -27,20 +27,37 @@
  */
 
 #include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <zlib.h>
 
 #include "BLI_sys_types.h"  /* for intptr_t */
 
 #include "MEM_guardedalloc.h"
 
+#include "DNA_anim_types.h"
+#include "DNA_color_types.h"
 #include "DNA_sequence_types.h"
 #include "DNA_scene_types.h"
+#include "DNA_userdef_types.h"
 
 #include "IMB_moviecache.h"
 #include "IMB_imbuf.h"
 #include "IMB_imbuf_types.h"
+#include "IMB_colormanagement.h"
 
+#include "BLI_fileops.h"
+#include "BLI_fileops_types.h"
+#include "BLI_ghash.h"
+#include "BLI_hash_mm2a.h"
 #include "BLI_listbase.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "BLI_utildefines.h"
 
+#include "BKE_main.h"
 #include "BKE_sequencer.h"
 #include "BKE_scene.h"
 
@@ -69,6 +86,10 @@ typedef struct SeqPreprocessCache {
 static struct MovieCache *moviecache = NULL;
 static struct SeqPreprocessCache *preprocess_cache = NULL;
 
+/* look-ahead frames are put into the cache from a background task */
+static ThreadMutex cache_lock = BLI_MUTEX_INITIALIZER;
+
+static void preprocessed_cache_clear(void);
 static void preprocessed_cache_destruct(void);
 
 static bool seq_cmp_render_data(const SeqRenderData *a, const SeqRenderData *b)
@@ -121,22 +142,855 @@ static bool seqcache_hashcmp(const void *a_, const void *b_)
 	        seq_cmp_render_data(&a->context, &b->context));
 }
 
+/* ********************** disk cache ********************** */
+
+/* Optional second tier below the memory cache: results are also written
+ * compressed to U.sequencer_disk_cache_dir, so they survive the memory
+ * limiter and restarts.
+ *
+ * Pointers can't be part of a persistent key, so files are named after
+ * a hash of the render settings (like seq_hash_render_data) and a hash of
+ * everything the result depends on: strip settings, inputs, animation and
+ * source file time stamps, plus the strips below for composited results.
+ * Changing any of these makes the old files unreachable, they age out with
+ * the least recently used ones once the directory exceeds its size limit.
+ */
+
+#define SEQ_DISK_CACHE_ID       "BSEQCACH"
+#define SEQ_DISK_CACHE_VERSION  2
+#define SEQ_DISK_CACHE_EXT      ".bseqcache"
+/* queued writes hold on to their buffers, don't queue more than this */
+#define SEQ_DISK_CACHE_MAX_PENDING  16
+
+/* SeqDiskCacheHeader.flag */
+#define SEQ_DISK_CACHE_FLOAT    (1 << 0)
+
+typedef struct SeqDiskCacheHeader {
+	char id[8];
+	int version;
+	unsigned int render_hash, content_hash;
+	int type;
+	float cfra;
+	int x, y, channels, flag;
+	char colorspace[64];
+	/* payload size before and after compression */
+	unsigned int raw_len, stored_len;
+} SeqDiskCacheHeader;
+
+typedef struct SeqDiskCacheFile {
+	struct SeqDiskCacheFile *next, *prev;
+	char name[64];
+	size_t size;
+	int64_t mtime;
+} SeqDiskCacheFile;
+
+typedef struct SeqDiskCacheWrite {
+	char dir[FILE_MAX];
+	char name[64];
+	SeqDiskCacheHeader header;
+	ImBuf *ibuf;
+} SeqDiskCacheWrite;
+
+static struct {
+	/* directory the index was built for */
+	char dir[FILE_MAX];
+	/* least recently used first */
+	ListBase files;
+	GHash *files_hash;
+	size_t size;
+
+	TaskPool *write_pool;
+	int pending;
+} disk_cache = {{0}};
+
+static ThreadMutex disk_cache_lock = BLI_MUTEX_INITIALIZER;
+
+static bool disk_cache_enabled(const SeqRenderData *context)
+{
+	return ((U.sequencer_disk_cache_size_limit > 0) &&
+	        (U.sequencer_disk_cache_dir[0] != '\0') &&
+	        (context->skip_cache == false) &&
+	        (context->is_proxy_render == false));
+}
+
+static void disk_cache_hash_add_string(BLI_HashMurmur2A *mm2, const char *str)
+{
+	BLI_hash_mm2a_add(mm2, (const unsigned char *)str, strlen(str));
+}
+
+static void disk_cache_hash_add_float(BLI_HashMurmur2A *mm2, float value)
+{
+	BLI_hash_mm2a_add(mm2, (const unsigned char *)&value, sizeof(value));
+}
+
+static unsigned int disk_cache_hash_render_data(const SeqRenderData *context)
+{
+	const Scene *scene = context->scene;
+	BLI_HashMurmur2A mm2;
+
+	BLI_hash_mm2a_init(&mm2, SEQ_DISK_CACHE_VERSION);
+
+	BLI_hash_mm2a_add_int(&mm2, context->rectx);
+	BLI_hash_mm2a_add_int(&mm2, context->recty);
+	BLI_hash_mm2a_add_int(&mm2, context->preview_render_size);
+	BLI_hash_mm2a_add_int(&mm2, context->motion_blur_samples);
+	disk_cache_hash_add_float(&mm2, context->motion_blur_shutter);
+	BLI_hash_mm2a_add_int(&mm2, scene->r.views_format);
+	BLI_hash_mm2a_add_int(&mm2, context->view_id);
+	BLI_hash_mm2a_add_int(&mm2, scene->r.frs_sec);
+	disk_cache_hash_add_float(&mm2, scene->r.frs_sec_base);
+	disk_cache_hash_add_string(&mm2, scene->sequencer_colorspace_settings.name);
+
+	return BLI_hash_mm2a_end(&mm2);
+}
+
+/* F-Curves of the strip, results are only valid as long as these don't change */
+static bool disk_cache_hash_animation(BLI_HashMurmur2A *mm2, Scene *scene, Sequence *seq)
+{
+	AnimData *adt = scene->adt;
+	char name_esc[SEQ_NAME_MAXSTR * 2];
+	char prefix[SEQ_NAME_MAXSTR * 2 + 64];
+	size_t prefix_len;
+	FCurve *fcu;
+
+	if (adt == NULL)
+		return true;
+
+	BLI_strescape(name_esc, seq->name + 2, sizeof(name_esc));
+	prefix_len = BLI_snprintf_rlen(prefix, sizeof(prefix), "sequence_editor.sequences_all[\"%s\"]", name_esc);
+
+	for (fcu = adt->drivers.first; fcu; fcu = fcu->next) {
+		if (fcu->rna_path && STREQLEN(fcu->rna_path, prefix, prefix_len))
+			return false;
+	}
+
+	if (adt->action == NULL)
+		return true;
+
+	/* NLA strips could change the result without touching these curves */
+	if (!BLI_listbase_is_empty(&adt->nla_tracks))
+		return false;
+
+	for (fcu = adt->action->curves.first; fcu; fcu = fcu->next) {
+		if (fcu->rna_path == NULL || !STREQLEN(fcu->rna_path, prefix, prefix_len))
+			continue;
+
+		if (fcu->fpt || !BLI_listbase_is_empty(&fcu->modifiers))
+			return false;
+
+		disk_cache_hash_add_string(mm2, fcu->rna_path);
+		BLI_hash_mm2a_add_int(mm2, fcu->array_index);
+		BLI_hash_mm2a_add_int(mm2, fcu->extend);
+		BLI_hash_mm2a_add_int(mm2, fcu->totvert);
+		if (fcu->bezt) {
+			BLI_hash_mm2a_add(mm2, (const unsigned char *)fcu->bezt, sizeof(BezTriple) * fcu->totvert);
+		}
+	}
+
+	return true;
+}
+
+static void disk_cache_hash_curve_mapping(BLI_HashMurmur2A *mm2, const CurveMapping *cumap)
+{
+	int i;
+
+	BLI_hash_mm2a_add_int(mm2, cumap->flag);
+	BLI_hash_mm2a_add(mm2, (const unsigned char *)&cumap->clipr, sizeof(cumap->clipr));
+	BLI_hash_mm2a_add(mm2, (const unsigned char *)cumap->black, sizeof(cumap->black));
+	BLI_hash_mm2a_add(mm2, (const unsigned char *)cumap->white, sizeof(cumap->white));
+
+	for (i = 0; i < CM_TOT; i++) {
+		const CurveMap *cuma = &cumap->cm[i];
+
+		BLI_hash_mm2a_add_int(mm2, cuma->flag);
+		BLI_hash_mm2a_add_int(mm2, cuma->totpoint);
+		if (cuma->curve) {
+			BLI_hash_mm2a_add(mm2, (const unsigned char *)cuma->curve, sizeof(CurveMapPoint) * cuma->totpoint);
+		}
+	}
+}
+
+static bool disk_cache_hash_sequence(BLI_HashMurmur2A *mm2, const SeqRenderData *context, Sequence *seq, float cfra);
+
+static bool disk_cache_hash_modifiers(
+        BLI_HashMurmur2A *mm2, const SeqRenderData *context, Sequence *seq, float cfra)
+{
+	SequenceModifierData *smd;
+
+	for (smd = seq->modifiers.first; smd; smd = smd->next) {
+		BLI_hash_mm2a_add_int(mm2, smd->type);
+		BLI_hash_mm2a_add_int(mm2, smd->flag);
+		BLI_hash_mm2a_add_int(mm2, smd->mask_input_type);
+		BLI_hash_mm2a_add_int(mm2, smd->mask_time);
+
+		if (smd->mask_id)
+			return false;
+
+		if (smd->mask_sequence && !disk_cache_hash_sequence(mm2, context, smd->mask_sequence, cfra))
+			return false;
+
+		switch (smd->type) {
+			case seqModifierType_Curves:
+				disk_cache_hash_curve_mapping(mm2, &((CurvesModifierData *)smd)->curve_mapping);
+				break;
+			case seqModifierType_HueCorrect:
+				disk_cache_hash_curve_mapping(mm2, &((HueCorrectModifierData *)smd)->curve_mapping);
+				break;
+			default:
+			{
+				/* remaining modifiers only hold plain settings */
+				const size_t size = MEM_allocN_len(smd);
+
+				if (size > sizeof(SequenceModifierData)) {
+					BLI_hash_mm2a_add(mm2, (const unsigned char *)(smd + 1), size - sizeof(SequenceModifierData));
+				}
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+
+static void disk_cache_hash_filepath(BLI_HashMurmur2A *mm2, const char *path)
+{
+	BLI_stat_t st;
+
+	if (BLI_stat(path, &st) == 0) {
+		int64_t mtime = (int64_t)st.st_mtime;
+		int64_t size = (int64_t)st.st_size;
+
+		BLI_hash_mm2a_add(mm2, (const unsigned char *)&mtime, sizeof(mtime));
+		BLI_hash_mm2a_add(mm2, (const unsigned char *)&size, sizeof(size));
+	}
+}
+
+static void disk_cache_hash_file(BLI_HashMurmur2A *mm2, const SeqRenderData *context, Strip *strip, const char *name)
+{
+	char path[FILE_MAX];
+
+	BLI_join_dirfile(path, sizeof(path), strip->dir, name);
+	BLI_path_abs(path, context->bmain->name);
+
+	disk_cache_hash_filepath(mm2, path);
+}
+
+/* Everything the strip rendered at cfra depends on, returns false for strips
+ * whose result can't be described this way (scenes, clips, masks, drivers). */
+static bool disk_cache_hash_sequence(BLI_HashMurmur2A *mm2, const SeqRenderData *context, Sequence *seq, float cfra)
+{
+	const int flag_ui = SEQ_ALLSEL | SEQ_OVERLAP | SEQ_LOCK | SEQ_FLAG_DELETE | SEQ_AUDIO_DRAW_WAVEFORM;
+	Strip *strip = seq->strip;
+	Sequence *iseq;
+	float input_cfra;
+	int offset;
+
+	if (ELEM(seq->type, SEQ_TYPE_SCENE, SEQ_TYPE_MOVIECLIP, SEQ_TYPE_MASK))
+		return false;
+
+	disk_cache_hash_add_string(mm2, seq->name);
+	BLI_hash_mm2a_add_int(mm2, seq->type);
+	BLI_hash_mm2a_add_int(mm2, seq->flag & ~flag_ui);
+	BLI_hash_mm2a_add_int(mm2, seq->len);
+	BLI_hash_mm2a_add_int(mm2, seq->start);
+	BLI_hash_mm2a_add_int(mm2, seq->startofs);
+	BLI_hash_mm2a_add_int(mm2, seq->endofs);
+	BLI_hash_mm2a_add_int(mm2, seq->startstill);
+	BLI_hash_mm2a_add_int(mm2, seq->endstill);
+	BLI_hash_mm2a_add_int(mm2, seq->machine);
+	BLI_hash_mm2a_add_int(mm2, seq->anim_startofs);
+	BLI_hash_mm2a_add_int(mm2, seq->anim_endofs);
+	BLI_hash_mm2a_add_int(mm2, seq->streamindex);
+	BLI_hash_mm2a_add_int(mm2, seq->multicam_source);
+	BLI_hash_mm2a_add_int(mm2, seq->blend_mode);
+	BLI_hash_mm2a_add_int(mm2, seq->alpha_mode);
+	BLI_hash_mm2a_add_int(mm2, seq->views_format);
+	disk_cache_hash_add_float(mm2, seq->sat);
+	disk_cache_hash_add_float(mm2, seq->mul);
+	disk_cache_hash_add_float(mm2, seq->effect_fader);
+	disk_cache_hash_add_float(mm2, seq->speed_fader);
+	disk_cache_hash_add_float(mm2, seq->blend_opacity);
+	disk_cache_hash_add_float(mm2, seq->strobe);
+
+	if (seq->stereo3d_format) {
+		BLI_hash_mm2a_add(mm2, (const unsigned char *)seq->stereo3d_format, sizeof(*seq->stereo3d_format));
+	}
+
+	if (strip) {
+		disk_cache_hash_add_string(mm2, strip->dir);
+		disk_cache_hash_add_string(mm2, strip->colorspace_settings.name);
+
+		if (strip->stripdata && ELEM(seq->type, SEQ_TYPE_IMAGE, SEQ_TYPE_MOVIE)) {
+			/* the file shown at this frame, movies only have one */
+			StripElem *se = BKE_sequencer_give_stripelem(seq, cfra);
+
+			if (se == NULL)
+				return false;
+
+			disk_cache_hash_add_string(mm2, se->name);
+			disk_cache_hash_file(mm2, context, strip, se->name);
+		}
+		if (strip->crop) {
+			BLI_hash_mm2a_add(mm2, (const unsigned char *)strip->crop, sizeof(*strip->crop));
+		}
+		if (strip->transform) {
+			BLI_hash_mm2a_add(mm2, (const unsigned char *)strip->transform, sizeof(*strip->transform));
+		}
+		if (strip->proxy) {
+			/* movies are read with the timecode whether proxies are used or not */
+			BLI_hash_mm2a_add_int(mm2, strip->proxy->tc);
+		}
+		if (strip->proxy && (seq->flag & SEQ_USE_PROXY)) {
+			BLI_hash_mm2a_add_int(mm2, strip->proxy->storage);
+			disk_cache_hash_add_string(mm2, strip->proxy->dir);
+			disk_cache_hash_add_string(mm2, strip->proxy->file);
+		}
+	}
+
+	if (ELEM(seq->type, SEQ_TYPE_IMAGE, SEQ_TYPE_MOVIE)) {
+		/* rebuilt proxies change the result without any setting changing */
+		char proxy_path[FILE_MAX];
+
+		if (BKE_sequencer_proxy_filepath_get(context, seq, (int)cfra, proxy_path)) {
+			disk_cache_hash_filepath(mm2, proxy_path);
+		}
+	}
+
+	if (seq->effectdata) {
+		if (seq->type == SEQ_TYPE_SPEED) {
+			/* frame map is derived data */
+			SpeedControlVars *v = seq->effectdata;
+
+			disk_cache_hash_add_float(mm2, v->globalSpeed);
+			BLI_hash_mm2a_add_int(mm2, v->flags);
+		}
+		else {
+			BLI_hash_mm2a_add(mm2, (const unsigned char *)seq->effectdata, MEM_allocN_len(seq->effectdata));
+		}
+	}
+
+	if (!disk_cache_hash_modifiers(mm2, context, seq, cfra))
+		return false;
+
+	if (!disk_cache_hash_animation(mm2, context->scene, seq))
+		return false;
+
+	/* frame the inputs are rendered at, as in seq_render_strip */
+	input_cfra = seq->start + BKE_sequencer_give_stripelem_index(seq, cfra);
+
+	if (seq->type == SEQ_TYPE_SPEED) {
+		SpeedControlVars *v = seq->effectdata;
+		const int nr = (int)BKE_sequencer_give_stripelem_index(seq, cfra);
+
+		/* the map is built on render, files written by it use the same one */
+		if (v == NULL || v->frameMap == NULL || nr < 0 || nr >= v->length)
+			return false;
+
+		input_cfra = seq->start + v->frameMap[nr];
+	}
+
+	if ((seq->seq1 && !disk_cache_hash_sequence(mm2, context, seq->seq1, input_cfra)) ||
+	    (seq->seq2 && !disk_cache_hash_sequence(mm2, context, seq->seq2, input_cfra)) ||
+	    (seq->seq3 && !disk_cache_hash_sequence(mm2, context, seq->seq3, input_cfra)))
+	{
+		return false;
+	}
+
+	if (seq->type == SEQ_TYPE_META && BKE_sequence_seqbase_get(seq, &offset)) {
+		const float meta_cfra = BKE_sequencer_give_stripelem_index(seq, cfra) + offset;
+
+		for (iseq = seq->seqbase.first; iseq; iseq = iseq->next) {
+			if (!disk_cache_hash_sequence(mm2, context, iseq, meta_cfra))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static ListBase *disk_cache_seqbase_find(ListBase *seqbase, Sequence *seq)
+{
+	Sequence *iseq;
+
+	for (iseq = seqbase->first; iseq; iseq = iseq->next) {
+		ListBase *lb;
+
+		if (iseq == seq)
+			return seqbase;
+
+		if ((lb = disk_cache_seqbase_find(&iseq->seqbase, seq)))
+			return lb;
+	}
+
+	return NULL;
+}
+
+static bool disk_cache_hash_key(
+        const SeqRenderData *context, Sequence *seq, float cfra, eSeqStripElemIBuf type, unsigned int *r_hash)
+{
+	Editing *ed = context->scene->ed;
+	BLI_HashMurmur2A mm2;
+
+	BLI_hash_mm2a_init(&mm2, type);
+
+	if (ed == NULL || !disk_cache_hash_sequence(&mm2, context, seq, cfra))
+		return false;
+
+	/* composited results, adjustment layers and multicam use the strips below */
+	if (type == SEQ_STRIPELEM_IBUF_COMP || ELEM(seq->type, SEQ_TYPE_ADJUSTMENT, SEQ_TYPE_MULTICAM)) {
+		ListBase *seqbase = disk_cache_seqbase_find(&ed->seqbase, seq);
+		Sequence *iseq;
+
+		if (seqbase == NULL)
+			return false;
+
+		for (iseq = seqbase->first; iseq; iseq = iseq->next) {
+			if (iseq->machine >= seq->machine || iseq->startdisp > cfra || iseq->enddisp <= cfra)
+				continue;
+
+			if (!disk_cache_hash_sequence(&mm2, context, iseq, cfra))
+				return false;
+		}
+	}
+
+	*r_hash = BLI_hash_mm2a_end(&mm2);
+
+	return true;
+}
+
+/* fill in the header identifying a result, returns false when it can't go to disk */
+static bool disk_cache_header_init(
+        const SeqRenderData *context, Sequence *seq, float cfra, eSeqStripElemIBuf type,
+        SeqDiskCacheHeader *header, char name[64])
+{
+	const float key_cfra = cfra - seq->start;
+
+	/* sub-frames (motion blur) aren't worth keeping */
+	if (key_cfra != floorf(key_cfra))
+		return false;
+
+	memset(header, 0, sizeof(*header));
+
+	if (!disk_cache_hash_key(context, seq, cfra, type, &header->content_hash))
+		return false;
+
+	memcpy(header->id, SEQ_DISK_CACHE_ID, sizeof(header->id));
+	header->version = SEQ_DISK_CACHE_VERSION;
+	header->render_hash = disk_cache_hash_render_data(context);
+	header->type = type;
+	header->cfra = key_cfra;
+
+	BLI_snprintf(name, 64, "%08x%08x_%d_%d" SEQ_DISK_CACHE_EXT,
+	             header->render_hash, header->content_hash, (int)type, (int)key_cfra);
+
+	return true;
+}
+
+static void disk_cache_index_free(void)
+{
+	if (disk_cache.files_hash) {
+		BLI_ghash_free(disk_cache.files_hash, NULL, NULL);
+		disk_cache.files_hash = NULL;
+	}
+	BLI_freelistN(&disk_cache.files);
+	disk_cache.size = 0;
+	disk_cache.dir[0] = '\0';
+}
+
+static int disk_cache_file_cmp_mtime(const void *a_, const void *b_)
+{
+	const SeqDiskCacheFile *a = a_, *b = b_;
+
+	return (a->mtime > b->mtime) - (a->mtime < b->mtime);
+}
+
+/* make sure the index describes the current directory, lock must be held */
+static void disk_cache_index_ensure(const char *dir)
+{
+	struct direntry *entries;
+	unsigned int tot, i;
+
+	if (disk_cache.files_hash && STREQ(disk_cache.dir, dir))
+		return;
+
+	disk_cache_index_free();
+
+	BLI_strncpy(disk_cache.dir, dir, sizeof(disk_cache.dir));
+	disk_cache.files_hash = BLI_ghash_str_new(__func__);
+
+	if (!BLI_is_dir(dir))
+		return;
+
+	tot = BLI_filelist_dir_contents(dir, &entries);
+
+	for (i = 0; i < tot; i++) {
+		struct direntry *entry = &entries[i];
+		SeqDiskCacheFile *file;
+
+		if (!S_ISREG(entry->type) || !BLI_testextensie(entry->relname, SEQ_DISK_CACHE_EXT))
+			continue;
+
+		if (strlen(entry->relname) >= sizeof(file->name))
+			continue;
+
+		file = MEM_callocN(sizeof(SeqDiskCacheFile), "sequencer disk cache file");
+		BLI_strncpy(file->name, entry->relname, sizeof(file->name));
+		file->size = (size_t)entry->s.st_size;
+		file->mtime = (int64_t)entry->s.st_mtime;
+
+		BLI_addtail(&disk_cache.files, file);
+		BLI_ghash_insert(disk_cache.files_hash, file->name, file);
+		disk_cache.size += file->size;
+	}
+
+	BLI_filelist_free(entries, tot);
+
+	BLI_listbase_sort(&disk_cache.files, disk_cache_file_cmp_mtime);
+}
+
+/* lock must be held */
+static void disk_cache_file_remove(SeqDiskCacheFile *file)
+{
+	char path[FILE_MAX];
+
+	BLI_join_dirfile(path, sizeof(path), disk_cache.dir, file->name);
+	BLI_delete(path, false, false);
+
+	BLI_ghash_remove(disk_cache.files_hash, file->name, NULL, NULL);
+	disk_cache.size -= file->size;
+	BLI_freelinkN(&disk_cache.files, file);
+}
+
+/* drop least recently used files until the directory fits the limit, lock must be held */
+static void disk_cache_evict(void)
+{
+	const size_t limit = (size_t)U.sequencer_disk_cache_size_limit * 1024 * 1024;
+
+	while (disk_cache.size > limit && disk_cache.files.first) {
+		disk_cache_file_remove(disk_cache.files.first);
+	}
+}
+
+static ImBuf *disk_cache_read_file(const char *path, const SeqDiskCacheHeader *key)
+{
+	SeqDiskCacheHeader header;
+	ImBuf *ibuf = NULL;
+	unsigned char *stored = NULL, *dst;
+	uLongf dst_len;
+	FILE *f;
+	bool ok = false;
+
+	f = BLI_fopen(path, "rb");
+	if (f == NULL)
+		return NULL;
+
+	if (fread(&header, sizeof(header), 1, f) != 1)
+		goto finally;
+
+	if (!STREQLEN(header.id, key->id, sizeof(header.id)) ||
+	    (header.version != key->version) ||
+	    (header.render_hash != key->render_hash) ||
+	    (header.content_hash != key->content_hash) ||
+	    (header.type != key->type) ||
+	    (header.cfra != key->cfra))
+	{
+		goto finally;
+	}
+
+	if (header.flag & SEQ_DISK_CACHE_FLOAT) {
+		ibuf = IMB_allocImBuf(header.x, header.y, 32, IB_rectfloat);
+		if (ibuf == NULL)
+			goto finally;
+		ibuf->channels = header.channels;
+		dst = (unsigned char *)ibuf->rect_float;
+		dst_len = sizeof(float) * header.channels * header.x * header.y;
+	}
+	else {
+		ibuf = IMB_allocImBuf(header.x, header.y, 32, IB_rect);
+		if (ibuf == NULL)
+			goto finally;
+		dst = (unsigned char *)ibuf->rect;
+		dst_len = sizeof(unsigned int) * header.x * header.y;
+	}
+
+	if (header.raw_len != dst_len)
+		goto finally;
+
+	if (header.stored_len == header.raw_len) {
+		ok = (fread(dst, dst_len, 1, f) == 1);
+	}
+	else {
+		stored = MEM_mallocN(header.stored_len, "sequencer disk cache read");
+		if (fread(stored, header.stored_len, 1, f) == 1) {
+			ok = (uncompress(dst, &dst_len, stored, header.stored_len) == Z_OK) && (dst_len == header.raw_len);
+		}
+	}
+
+	if (ok) {
+		if (header.flag & SEQ_DISK_CACHE_FLOAT)
+			IMB_colormanagement_assign_float_colorspace(ibuf, header.colorspace);
+		else
+			IMB_colormanagement_assign_rect_colorspace(ibuf, header.colorspace);
+	}
+
+finally:
+	fclose(f);
+
+	if (stored)
+		MEM_freeN(stored);
+
+	if (!ok && ibuf) {
+		IMB_freeImBuf(ibuf);
+		ibuf = NULL;
+	}
+
+	return ibuf;
+}
+
+static ImBuf *disk_cache_get(const SeqRenderData *context, Sequence *seq, float cfra, eSeqStripElemIBuf type)
+{
+	SeqDiskCacheHeader key;
+	SeqDiskCacheFile *file;
+	char name[64], path[FILE_MAX];
+	ImBuf *ibuf;
+
+	if (!disk_cache_header_init(context, seq, cfra, type, &key, name))
+		return NULL;
+
+	BLI_mutex_lock(&disk_cache_lock);
+
+	disk_cache_index_ensure(U.sequencer_disk_cache_dir);
+
+	if (!BLI_ghash_haskey(disk_cache.files_hash, name)) {
+		BLI_mutex_unlock(&disk_cache_lock);
+		return NULL;
+	}
+
+	BLI_join_dirfile(path, sizeof(path), disk_cache.dir, name);
+
+	BLI_mutex_unlock(&disk_cache_lock);
+
+	/* don't block writes while reading, the file might get evicted meanwhile */
+	ibuf = disk_cache_read_file(path, &key);
+
+	BLI_mutex_lock(&disk_cache_lock);
+
+	file = BLI_ghash_lookup(disk_cache.files_hash, name);
+	if (file) {
+		if (ibuf) {
+			/* most recently used, also on disk for the next session */
+			BLI_remlink(&disk_cache.files, file);
+			BLI_addtail(&disk_cache.files, file);
+			BLI_file_touch(path);
+		}
+		else {
+			disk_cache_file_remove(file);
+		}
+	}
+
+	BLI_mutex_unlock(&disk_cache_lock);
+
+	return ibuf;
+}
+
+static void disk_cache_write_task(TaskPool * __restrict pool, void *taskdata, int UNUSED(threadid))
+{
+	SeqDiskCacheWrite *write = taskdata;
+	SeqDiskCacheHeader *header = &write->header;
+	ImBuf *ibuf = write->ibuf;
+	const unsigned char *src;
+	unsigned char *stored;
+	uLongf stored_len;
+	char path[FILE_MAX], path_tmp[FILE_MAX];
+	FILE *f;
+	bool ok = false;
+
+	if (BLI_task_pool_canceled(pool))
+		goto finally;
+
+	if (header->flag & SEQ_DISK_CACHE_FLOAT)
+		src = (const unsigned char *)ibuf->rect_float;
+	else
+		src = (const unsigned char *)ibuf->rect;
+
+	stored_len = compressBound(header->raw_len);
+	stored = MEM_mallocN(stored_len, "sequencer disk cache write");
+
+	if (U.sequencer_disk_cache_compression > 0 &&
+	    compress2(stored, &stored_len, src, header->raw_len, U.sequencer_disk_cache_compression) == Z_OK &&
+	    stored_len < header->raw_len)
+	{
+		header->stored_len = stored_len;
+	}
+	else {
+		/* stored as is */
+		header->stored_len = header->raw_len;
+	}
+
+	BLI_dir_create_recursive(write->dir);
+	BLI_join_dirfile(path, sizeof(path), write->dir, write->name);
+	BLI_snprintf(path_tmp, sizeof(path_tmp), "%s~", path);
+
+	f = BLI_fopen(path_tmp, "wb");
+	if (f) {
+		ok = (fwrite(header, sizeof(*header), 1, f) == 1) &&
+		     (fwrite((header->stored_len == header->raw_len) ? src : stored, header->stored_len, 1, f) == 1);
+		ok = (fclose(f) == 0) && ok;
+
+		/* readers only ever see complete files */
+		if (!ok || BLI_rename(path_tmp, path) != 0) {
+			BLI_delete(path_tmp, false, false);
+			ok = false;
+		}
+	}
+
+	MEM_freeN(stored);
+
+	if (ok) {
+		BLI_mutex_lock(&disk_cache_lock);
+
+		if (STREQ(disk_cache.dir, write->dir)) {
+			SeqDiskCacheFile *file = BLI_ghash_lookup(disk_cache.files_hash, write->name);
+
+			if (file == NULL) {
+				file = MEM_callocN(sizeof(SeqDiskCacheFile), "sequencer disk cache file");
+				BLI_strncpy(file->name, write->name, sizeof(file->name));
+				BLI_ghash_insert(disk_cache.files_hash, file->name, file);
+			}
+			else {
+				BLI_remlink(&disk_cache.files, file);
+				disk_cache.size -= file->size;
+			}
+
+			file->size = sizeof(*header) + header->stored_len;
+			BLI_addtail(&disk_cache.files, file);
+			disk_cache.size += file->size;
+
+			disk_cache_evict();
+		}
+
+		BLI_mutex_unlock(&disk_cache_lock);
+	}
+
+finally:
+	IMB_freeImBuf(ibuf);
+
+	BLI_mutex_lock(&disk_cache_lock);
+	disk_cache.pending--;
+	BLI_mutex_unlock(&disk_cache_lock);
+}
+
+/* results are compressed and written by a background task */
+static void disk_cache_put(const SeqRenderData *context, Sequence *seq, float cfra, eSeqStripElemIBuf type, ImBuf *ibuf)
+{
+	SeqDiskCacheWrite *write;
+	SeqDiskCacheHeader header;
+	char name[64];
+	const char *colorspace;
+
+	if (ibuf->rect_float == NULL && ibuf->rect == NULL)
+		return;
+
+	if (!disk_cache_header_init(context, seq, cfra, type, &header, name))
+		return;
+
+	header.x = ibuf->x;
+	header.y = ibuf->y;
+
+	if (ibuf->rect_float) {
+		header.flag |= SEQ_DISK_CACHE_FLOAT;
+		header.channels = ibuf->channels;
+		header.raw_len = sizeof(float) * ibuf->channels * ibuf->x * ibuf->y;
+		colorspace = IMB_colormanagement_get_float_colorspace(ibuf);
+	}
+	else {
+		header.channels = 4;
+		header.raw_len = sizeof(unsigned int) * ibuf->x * ibuf->y;
+		colorspace = IMB_colormanagement_get_rect_colorspace(ibuf);
+	}
+
+	if (colorspace) {
+		BLI_strncpy(header.colorspace, colorspace, sizeof(header.colorspace));
+	}
+
+	BLI_mutex_lock(&disk_cache_lock);
+
+	disk_cache_index_ensure(U.sequencer_disk_cache_dir);
+
+	/* the pool is created by BKE_sequencer_disk_cache_init(), not from here,
+	 * this may run in a task */
+	if (disk_cache.write_pool == NULL ||
+	    BLI_ghash_haskey(disk_cache.files_hash, name) ||
+	    disk_cache.pending >= SEQ_DISK_CACHE_MAX_PENDING)
+	{
+		BLI_mutex_unlock(&disk_cache_lock);
+		return;
+	}
+
+	disk_cache.pending++;
+
+	write = MEM_callocN(sizeof(SeqDiskCacheWrite), "sequencer disk cache write");
+	BLI_strncpy(write->dir, disk_cache.dir, sizeof(write->dir));
+	BLI_strncpy(write->name, name, sizeof(write->name));
+	write->header = header;
+	write->ibuf = ibuf;
+	IMB_refImBuf(ibuf);
+
+	BLI_task_pool_push(disk_cache.write_pool, disk_cache_write_task, write, true, TASK_PRIORITY_LOW);
+
+	BLI_mutex_unlock(&disk_cache_lock);
+}
+
+/* Set up writing to the disk cache, called by BKE_sequencer_new_render_data()
+ * from the thread starting a render. Background pools can't be created from
+ * tasks, which look-ahead frames are rendered by. */
+void BKE_sequencer_disk_cache_init(void)
+{
+	BLI_mutex_lock(&disk_cache_lock);
+
+	if (disk_cache.write_pool == NULL && U.sequencer_disk_cache_size_limit > 0) {
+		disk_cache.write_pool = BLI_task_pool_create_background(BLI_task_scheduler_get(), NULL);
+	}
+
+	BLI_mutex_unlock(&disk_cache_lock);
+}
+
+static void disk_cache_destruct(void)
+{
+	if (disk_cache.write_pool) {
+		/* finish pending writes */
+		BLI_task_pool_work_and_wait(disk_cache.write_pool);
+		BLI_task_pool_free(disk_cache.write_pool);
+		disk_cache.write_pool = NULL;
+	}
+
+	disk_cache_index_free();
+}
+
 void BKE_sequencer_cache_destruct(void)
 {
+	BKE_sequencer_prefetch_free();
+
 	if (moviecache)
 		IMB_moviecache_free(moviecache);
 
 	preprocessed_cache_destruct();
+
+	disk_cache_destruct();
 }
 
 void BKE_sequencer_cache_cleanup(void)
 {
+	BKE_sequencer_prefetch_stop();
+
+	BLI_mutex_lock(&cache_lock);
 	if (moviecache) {
 		IMB_moviecache_free(moviecache);
 		moviecache = IMB_moviecache_create("seqcache", sizeof(SeqCacheKey), seqcache_hashhash, seqcache_hashcmp);
 	}
+	BLI_mutex_unlock(&cache_lock);
 
-	BKE_sequencer_preprocessed_cache_cleanup();
+	preprocessed_cache_clear();
 }
 
 static bool seqcache_key_check_seq(ImBuf *UNUSED(ibuf), void *userkey, void *userdata)
@@ -149,13 +1003,38 @@ static bool seqcache_key_check_seq(ImBuf *UNUSED(ibuf), void *userkey, void *use
 
 void BKE_sequencer_cache_cleanup_sequence(Sequence *seq)
 {
+	BKE_sequencer_prefetch_stop();
+
+	BLI_mutex_lock(&cache_lock);
 	if (moviecache)
 		IMB_moviecache_cleanup(moviecache, seqcache_key_check_seq, seq);
+	BLI_mutex_unlock(&cache_lock);
+}
+
+static void seqcache_put_memory(const SeqRenderData *context, SeqCacheKey *key, ImBuf *ibuf)
+{
+	BLI_mutex_lock(&cache_lock);
+
+	if (!moviecache) {
+		moviecache = IMB_moviecache_create("seqcache", sizeof(SeqCacheKey), seqcache_hashhash, seqcache_hashcmp);
+	}
+
+	if (context->is_prefetch_render) {
+		/* frames rendered ahead never evict anything */
+		IMB_moviecache_put_if_possible(moviecache, key, ibuf);
+	}
+	else {
+		IMB_moviecache_put(moviecache, key, ibuf);
+	}
+
+	BLI_mutex_unlock(&cache_lock);
 }
 
 struct ImBuf *BKE_sequencer_cache_get(const SeqRenderData *context, Sequence *seq, float cfra, eSeqStripElemIBuf type)
 {
-	if (moviecache && seq) {
+	ImBuf *ibuf = NULL;
+
+	if (seq) {
 		SeqCacheKey key;
 
 		key.seq = seq;
@@ -163,10 +1042,21 @@ struct ImBuf *BKE_sequencer_cache_get(const SeqRenderData *context, Sequence *se
 		key.cfra = cfra - seq->start;
 		key.type = type;
 
-		return IMB_moviecache_get(moviecache, &key);
+		BLI_mutex_lock(&cache_lock);
+		if (moviecache)
+			ibuf = IMB_moviecache_get(moviecache, &key);
+		BLI_mutex_unlock(&cache_lock);
+
+		if (ibuf == NULL && disk_cache_enabled(context)) {
+			ibuf = disk_cache_get(context, seq, cfra, type);
+
+			if (ibuf) {
+				seqcache_put_memory(context, &key, ibuf);
+			}
+		}
 	}
 
-	return NULL;
+	return ibuf;
 }
 
 void BKE_sequencer_cache_put(const SeqRenderData *context, Sequence *seq, float cfra, eSeqStripElemIBuf type, ImBuf *i)
@@ -177,19 +1067,19 @@ void BKE_sequencer_cache_put(const SeqRenderData *context, Sequence *seq, float
 		return;
 	}
 
-	if (!moviecache) {
-		moviecache = IMB_moviecache_create("seqcache", sizeof(SeqCacheKey), seqcache_hashhash, seqcache_hashcmp);
-	}
-
 	key.seq = seq;
 	key.context = *context;
 	key.cfra = cfra - seq->start;
 	key.type = type;
 
-	IMB_moviecache_put(moviecache, &key, i);
+	seqcache_put_memory(context, &key, i);
+
+	if (disk_cache_enabled(context)) {
+		disk_cache_put(context, seq, cfra, type, i);
+	}
 }
 
-void BKE_sequencer_preprocessed_cache_cleanup(void)
+static void preprocessed_cache_clear(void)
 {
 	SeqPreprocessCacheElem *elem;
 
@@ -204,12 +1094,19 @@ void BKE_sequencer_preprocessed_cache_cleanup(void)
 	BLI_listbase_clear(&preprocess_cache->elems);
 }
 
+void BKE_sequencer_preprocessed_cache_cleanup(void)
+{
+	BKE_sequencer_prefetch_stop();
+
+	preprocessed_cache_clear();
+}
+
 static void preprocessed_cache_destruct(void)
 {
 	if (!preprocess_cache)
 		return;
 
-	BKE_sequencer_preprocessed_cache_cleanup();
+	preprocessed_cache_clear();
 
 	MEM_freeN(preprocess_cache);
 	preprocess_cache = NULL;
@@ -251,7 +1148,7 @@ void BKE_sequencer_preprocessed_cache_put(const SeqRenderData *context, Sequence
 	}
 	else {
 		if (preprocess_cache->cfra != cfra)
-			BKE_sequencer_preprocessed_cache_cleanup();
+			preprocessed_cache_clear();
 	}
 
 	elem = MEM_callocN(sizeof(SeqPreprocessCacheElem), "sequencer preprocessed cache element");
@@ -275,6 +1172,8 @@ void BKE_sequencer_preprocessed_cache_cleanup_sequence(Sequence *seq)
 	if (!preprocess_cache)
 		return;
 
+	BKE_sequencer_prefetch_stop();
+
 	for (elem = preprocess_cache->elems.first; elem; elem = elem_next) {
 		elem_next = elem->next;
 
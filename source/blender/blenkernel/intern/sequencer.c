@@ -32,6 +32,7 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <math.h>
 
 #include "MEM_guardedalloc.h"
@@ -51,6 +52,7 @@
 #include "BLI_path_util.h"
 #include "BLI_string.h"
 #include "BLI_string_utf8.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 #include "BLI_utildefines.h"
 
@@ -79,8 +81,6 @@
 
 #include "RE_pipeline.h"
 
-#include <pthread.h>
-
 #include "IMB_imbuf.h"
 #include "IMB_imbuf_types.h"
 #include "IMB_colormanagement.h"
@@ -161,6 +161,9 @@ int BKE_sequencer_recursive_apply(Sequence *seq, int (*apply_func)(Sequence *, v
 
 static void free_proxy_seq(Sequence *seq)
 {
+	/* the look-ahead task could be reading from it */
+	BKE_sequencer_prefetch_stop();
+
 	if (seq->strip && seq->strip->proxy && seq->strip->proxy->anim) {
 		IMB_free_anim(seq->strip->proxy->anim);
 		seq->strip->proxy->anim = NULL;
@@ -201,6 +204,8 @@ static void seq_free_strip(Strip *strip)
 /* only give option to skip cache locally (static func) */
 static void BKE_sequence_free_ex(Scene *scene, Sequence *seq, const bool do_cache)
 {
+	BKE_sequencer_prefetch_stop();
+
 	if (seq->strip)
 		seq_free_strip(seq->strip);
 
@@ -264,8 +269,7 @@ void BKE_sequence_free(Scene *scene, Sequence *seq)
 	BKE_sequence_free_ex(scene, seq, true);
 }
 
-/* Function to free imbuf and anim data on changes */
-void BKE_sequence_free_anim(Sequence *seq)
+static void seq_free_anims(Sequence *seq)
 {
 	while (seq->anims.last) {
 		StripAnim *sanim = seq->anims.last;
@@ -280,6 +284,15 @@ void BKE_sequence_free_anim(Sequence *seq)
 	BLI_listbase_clear(&seq->anims);
 }
 
+/* Function to free imbuf and anim data on changes */
+void BKE_sequence_free_anim(Sequence *seq)
+{
+	/* the look-ahead task could be reading from them */
+	BKE_sequencer_prefetch_stop();
+
+	seq_free_anims(seq);
+}
+
 /* cache must be freed before calling this function
  * since it leaves the seqbase in an invalid state */
 static void seq_free_sequence_recurse(Scene *scene, Sequence *seq)
@@ -578,10 +591,13 @@ void BKE_sequencer_new_render_data(
 	r_context->motion_blur_shutter = 0;
 	r_context->skip_cache = false;
 	r_context->is_proxy_render = false;
+	r_context->is_prefetch_render = false;
 	r_context->view_id = 0;
 	r_context->gpu_offscreen = NULL;
 	r_context->gpu_samples = (scene->r.mode & R_OSA) ? scene->r.osa : 0;
 	r_context->gpu_full_samples = (r_context->gpu_samples) && (scene->r.scemode & R_FULL_SAMPLE);
+
+	BKE_sequencer_disk_cache_init();
 }
 
 /* ************************* iterator ************************** */
@@ -831,6 +847,8 @@ void BKE_sequence_reload_new_file(Scene *scene, Sequence *seq, const bool lock_r
 	int prev_startdisp = 0, prev_enddisp = 0;
 	/* note: don't rename the strip, will break animation curves */
 
+	BKE_sequencer_prefetch_stop();
+
 	if (ELEM(seq->type,
 	          SEQ_TYPE_MOVIE, SEQ_TYPE_IMAGE, SEQ_TYPE_SOUND_RAM,
 	          SEQ_TYPE_SCENE, SEQ_TYPE_META, SEQ_TYPE_MOVIECLIP, SEQ_TYPE_MASK) == 0)
@@ -1253,7 +1271,7 @@ static void multibuf(ImBuf *ibuf, const float fmul)
 	}
 }
 
-static float give_stripelem_index(Sequence *seq, float cfra)
+float BKE_sequencer_give_stripelem_index(Sequence *seq, float cfra)
 {
 	float nr;
 	int sta = seq->start;
@@ -1297,7 +1315,7 @@ StripElem *BKE_sequencer_give_stripelem(Sequence *seq, int cfra)
 		 * all other strips don't use this...
 		 */
 
-		int nr = (int) give_stripelem_index(seq, cfra);
+		int nr = (int) BKE_sequencer_give_stripelem_index(seq, cfra);
 
 		if (nr == -1 || se == NULL)
 			return NULL;
@@ -1507,8 +1525,9 @@ static void seq_open_anim_file(Scene *scene, Sequence *seq, bool openfile)
 		return;
 	}
 
-	/* reset all the previously created anims */
-	BKE_sequence_free_anim(seq);
+	/* reset all the previously created anims,
+	 * runs while rendering so look-ahead is not stopped here */
+	seq_free_anims(seq);
 
 	BLI_join_dirfile(name, sizeof(name),
 	                 seq->strip->dir, seq->strip->stripdata->name);
@@ -1706,7 +1725,7 @@ static bool seq_proxy_get_fname(Editing *ed, Sequence *seq, int cfra, int render
 		frameno = 1;
 	}
 	else {
-		frameno = (int)give_stripelem_index(seq, cfra) + seq->anim_startofs;
+		frameno = (int)BKE_sequencer_give_stripelem_index(seq, cfra) + seq->anim_startofs;
 		BLI_snprintf(name, PROXY_MAXFILE, "%s/proxy_misc/%d/####%s", dir, render_size, suffix);
 	}
 
@@ -1745,7 +1764,7 @@ static ImBuf *seq_proxy_fetch(const SeqRenderData *context, Sequence *seq, int c
 	}
 
 	if (proxy->storage & SEQ_STORAGE_PROXY_CUSTOM_FILE) {
-		int frameno = (int)give_stripelem_index(seq, cfra) + seq->anim_startofs;
+		int frameno = (int)BKE_sequencer_give_stripelem_index(seq, cfra) + seq->anim_startofs;
 		if (proxy->anim == NULL) {
 			if (seq_proxy_get_fname(ed, seq, cfra, render_size, name, context->view_id) == 0) {
 				return NULL;
@@ -1782,6 +1801,66 @@ static ImBuf *seq_proxy_fetch(const SeqRenderData *context, Sequence *seq, int c
 	}
 }
 
+/* File the proxy of seq is read from at cfra, for the preview size of context.
+ * Movies are found without opening them, returns false when no proxy is used. */
+bool BKE_sequencer_proxy_filepath_get(const SeqRenderData *context, Sequence *seq, int cfra, char *filepath)
+{
+	char name[PROXY_MAXFILE];
+	IMB_Proxy_Size psize = seq_rendersize_to_proxysize(context->preview_render_size);
+	int render_size = context->preview_render_size;
+	StripProxy *proxy = seq->strip ? seq->strip->proxy : NULL;
+	Editing *ed = context->scene->ed;
+
+	if (psize == IMB_PROXY_NONE || ed == NULL) {
+		return false;
+	}
+
+	if (seq->type == SEQ_TYPE_MOVIE && !(proxy && (proxy->storage & SEQ_STORAGE_PROXY_CUSTOM_FILE))) {
+		/* ImBuf reads movie proxies from the index directory, as set up by seq_open_anim_file */
+		char dir[FILE_MAX];
+
+		if (seq->strip->stripdata == NULL) {
+			return false;
+		}
+
+		if (proxy && ((proxy->storage & SEQ_STORAGE_PROXY_CUSTOM_DIR) ||
+		              (ed->proxy_storage == SEQ_EDIT_PROXY_DIR_STORAGE)))
+		{
+			if (ed->proxy_storage != SEQ_EDIT_PROXY_DIR_STORAGE)
+				BLI_strncpy(dir, proxy->dir, sizeof(dir));
+			else if (ed->proxy_dir[0] == 0)
+				BLI_strncpy(dir, "//BL_proxy", sizeof(dir));
+			else
+				BLI_strncpy(dir, ed->proxy_dir, sizeof(dir));
+		}
+		else {
+			BLI_join_dirfile(dir, sizeof(dir), seq->strip->dir, "BL_proxy");
+		}
+		BLI_path_append(dir, sizeof(dir), seq->strip->stripdata->name);
+		BLI_path_abs(dir, context->bmain->name);
+
+		IMB_anim_proxy_filepath_get(dir, seq->streamindex, psize, filepath);
+		return true;
+	}
+
+	/* same conditions as seq_proxy_fetch */
+	if (!(seq->flag & SEQ_USE_PROXY) || proxy == NULL || (proxy->build_size_flags & psize) != psize) {
+		return false;
+	}
+
+	/* dirty hack to distinguish 100% render size from PROXY_100 */
+	if (render_size == 99) {
+		render_size = 100;
+	}
+
+	if (!seq_proxy_get_fname(ed, seq, cfra, render_size, name, context->view_id)) {
+		return false;
+	}
+
+	BLI_strncpy(filepath, name, FILE_MAX);
+	return true;
+}
+
 static void seq_proxy_build_frame(
         const SeqRenderData *context, SeqRenderState *state,
         Sequence *seq, int cfra,
@@ -2032,6 +2111,15 @@ void BKE_sequencer_proxy_rebuild(SeqIndexBuildContext *context, short *stop, sho
 	}
 }
 
+/* Movie strips only read their own file and write their own proxy and
+ * timecode files, so several of them can be rebuilt at the same time.
+ * Other strips are rendered through the sequencer and should be rebuilt
+ * one after another. */
+bool BKE_sequencer_proxy_rebuild_is_threadsafe(SeqIndexBuildContext *context)
+{
+	return context->seq->type == SEQ_TYPE_MOVIE;
+}
+
 void BKE_sequencer_proxy_rebuild_finish(SeqIndexBuildContext *context, bool stop)
 {
 	if (context->index_context) {
@@ -3425,7 +3513,7 @@ static ImBuf *do_render_strip_uncached(
         Sequence *seq, float cfra)
 {
 	ImBuf *ibuf = NULL;
-	float nr = give_stripelem_index(seq, cfra);
+	float nr = BKE_sequencer_give_stripelem_index(seq, cfra);
 	int type = (seq->type & SEQ_TYPE_EFFECT && seq->type != SEQ_TYPE_SPEED) ? SEQ_TYPE_EFFECT : seq->type;
 	bool use_preprocess = BKE_sequencer_input_have_to_preprocess(context, seq, cfra);
 
@@ -3561,7 +3649,7 @@ static ImBuf *seq_render_strip(
 	ImBuf *ibuf = NULL;
 	bool use_preprocess = false;
 	bool is_proxy_image = false;
-	float nr = give_stripelem_index(seq, cfra);
+	float nr = BKE_sequencer_give_stripelem_index(seq, cfra);
 	/* all effects are handled similarly with the exception of speed effect */
 	int type = (seq->type & SEQ_TYPE_EFFECT && seq->type != SEQ_TYPE_SPEED) ? SEQ_TYPE_EFFECT : seq->type;
 	bool is_preprocessed = !ELEM(type, SEQ_TYPE_IMAGE, SEQ_TYPE_MOVIE, SEQ_TYPE_SCENE, SEQ_TYPE_MOVIECLIP);
@@ -3827,6 +3915,17 @@ static ImBuf *seq_render_strip_stack(
 	return out;
 }
 
+static ListBase *seq_render_seqbase_get(Editing *ed, int chanshown)
+{
+	if ((chanshown < 0) && !BLI_listbase_is_empty(&ed->metastack)) {
+		int count = BLI_listbase_count(&ed->metastack);
+		count = max_ii(count + chanshown, 0);
+		return ((MetaStack *)BLI_findlink(&ed->metastack, count))->oldbasep;
+	}
+
+	return ed->seqbasep;
+}
+
 /*
  * returned ImBuf is refed!
  * you have to free after usage!
@@ -3839,14 +3938,10 @@ ImBuf *BKE_sequencer_give_ibuf(const SeqRenderData *context, float cfra, int cha
 	
 	if (ed == NULL) return NULL;
 
-	if ((chanshown < 0) && !BLI_listbase_is_empty(&ed->metastack)) {
-		int count = BLI_listbase_count(&ed->metastack);
-		count = max_ii(count + chanshown, 0);
-		seqbasep = ((MetaStack *)BLI_findlink(&ed->metastack, count))->oldbasep;
-	}
-	else {
-		seqbasep = ed->seqbasep;
-	}
+	seqbasep = seq_render_seqbase_get(ed, chanshown);
+
+	/* strips can't be rendered by two threads at once */
+	BKE_sequencer_prefetch_stop();
 
 	SeqRenderState state;
 	sequencer_state_init(&state);
@@ -3868,159 +3963,299 @@ ImBuf *BKE_sequencer_give_ibuf_direct(const SeqRenderData *context, float cfra,
 	SeqRenderState state;
 	sequencer_state_init(&state);
 
+	BKE_sequencer_prefetch_stop();
+
 	return seq_render_strip(context, &state, seq, cfra);
 }
 
-/* *********************** threading api ******************* */
+/* *********************** look-ahead prefetch ******************* */
 
-static ListBase running_threads;
-static ListBase prefetch_wait;
-static ListBase prefetch_done;
+/* While playing back, the frames following the displayed one are rendered
+ * into the cache by a background task, so the display only has to pick up
+ * cached results.
+ *
+ * Rendering touches the strips' animation handles and the preprocess cache,
+ * neither of which can be shared between threads, so the look-ahead frames
+ * are rendered in order by a single task (effects still use all threads for
+ * each frame). Any other rendering or change of the strips stops the task
+ * first, see BKE_sequencer_prefetch_stop().
+ *
+ * Strip settings are written by the animation system for the displayed frame
+ * while the task renders, so look-ahead stops before the first frame showing
+ * an animated or driven strip.
+ */
 
-static pthread_mutex_t queue_lock          = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t wakeup_lock         = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t wakeup_cond          = PTHREAD_COND_INITIALIZER;
+typedef struct SeqPrefetchJob {
+	SeqRenderData context;
+	ListBase *seqbasep;
+	int chanshown;
 
-//static pthread_mutex_t prefetch_ready_lock = PTHREAD_MUTEX_INITIALIZER;
-//static pthread_cond_t  prefetch_ready_cond = PTHREAD_COND_INITIALIZER;
+	/* last displayed frame and how far to render ahead of it,
+	 * updated by the display while the task is running */
+	volatile int cfra;
+	volatile int tot_frames;
+	/* first frame showing an animated strip, not rendered ahead */
+	volatile int anim_frame;
 
-static pthread_mutex_t frame_done_lock     = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t frame_done_cond      = PTHREAD_COND_INITIALIZER;
+	volatile bool running;
+	/* the cache limiter refused a look-ahead frame, don't restart
+	 * until the display had to render a frame itself */
+	bool cache_full;
+} SeqPrefetchJob;
 
-static volatile bool seq_thread_shutdown = true; 
-static volatile int seq_last_given_monoton_cfra = 0;
-static int monoton_cfra = 0;
+static TaskPool *prefetch_pool = NULL;
+static SeqPrefetchJob prefetch_job;
+static ThreadMutex prefetch_lock = BLI_MUTEX_INITIALIZER;
 
-typedef struct PrefetchThread {
-	struct PrefetchThread *next, *prev;
-	
-	Scene *scene;
-	struct PrefetchQueueElem *current;
-	pthread_t pthread;
-	int running;
-	
-} PrefetchThread;
+/* Strips rendered through other parts of Blender (OpenGL, the render
+ * pipeline, the movie clip cache) can only be rendered by the display. */
+static bool seq_prefetch_frame_supported(ListBase *seqbase, int cfra)
+{
+	Sequence *seq;
 
-typedef struct PrefetchQueueElem {
-	struct PrefetchQueueElem *next, *prev;
-	
-	int rectx;
-	int recty;
-	float cfra;
-	int chanshown;
-	int preview_render_size;
+	for (seq = seqbase->first; seq; seq = seq->next) {
+		if (seq->startdisp > cfra || seq->enddisp <= cfra)
+			continue;
+
+		if (ELEM(seq->type, SEQ_TYPE_SCENE, SEQ_TYPE_MOVIECLIP))
+			return false;
 
-	int monoton_cfra;
+		if (seq->type == SEQ_TYPE_META && !seq_prefetch_frame_supported(&seq->seqbase, cfra))
+			return false;
+	}
 
-	ImBuf *ibuf;
-} PrefetchQueueElem;
+	return true;
+}
 
-void BKE_sequencer_give_ibuf_prefetch_request(const SeqRenderData *context, float cfra, int chanshown)
+static void seq_prefetch_animated_fcurves(Editing *ed, ListBase *fcurves, int cfra, int *r_frame)
 {
-	PrefetchQueueElem *e;
-	if (seq_thread_shutdown) {
-		return;
-	}
+	FCurve *fcu;
 
-	e = MEM_callocN(sizeof(PrefetchQueueElem), "prefetch_queue_elem");
-	e->rectx = context->rectx;
-	e->recty = context->recty;
-	e->cfra = cfra;
-	e->chanshown = chanshown;
-	e->preview_render_size = context->preview_render_size;
-	e->monoton_cfra = monoton_cfra++;
+	for (fcu = fcurves->first; fcu; fcu = fcu->next) {
+		Sequence *seq;
+		char *name;
 
-	pthread_mutex_lock(&queue_lock);
-	BLI_addtail(&prefetch_wait, e);
-	pthread_mutex_unlock(&queue_lock);
-	
-	pthread_mutex_lock(&wakeup_lock);
-	pthread_cond_signal(&wakeup_cond);
-	pthread_mutex_unlock(&wakeup_lock);
+		if (fcu->rna_path == NULL || !STRPREFIX(fcu->rna_path, "sequence_editor.sequences_all["))
+			continue;
+
+		name = BLI_str_quoted_substrN(fcu->rna_path, "sequences_all[");
+		seq = (name) ? BKE_sequence_get_by_name(&ed->seqbase, name, true) : NULL;
+		if (name)
+			MEM_freeN(name);
+
+		if (seq && seq->enddisp > cfra)
+			*r_frame = min_ii(*r_frame, seq->startdisp);
+	}
 }
 
-ImBuf *BKE_sequencer_give_ibuf_threaded(const SeqRenderData *context, float cfra, int chanshown)
+/* First frame after cfra showing a strip with animated or driven settings,
+ * these are only valid for the displayed frame. */
+static int seq_prefetch_animated_frame(Scene *scene, int cfra)
 {
-	PrefetchQueueElem *e = NULL;
-	bool found_something = false;
+	Editing *ed = scene->ed;
+	AnimData *adt = scene->adt;
+	int frame = INT_MAX;
 
-	if (seq_thread_shutdown) {
-		return BKE_sequencer_give_ibuf(context, cfra, chanshown);
-	}
+	if (ed == NULL || adt == NULL)
+		return frame;
 
-	while (!e) {
-		bool success = false;
-		pthread_mutex_lock(&queue_lock);
+	if (adt->action)
+		seq_prefetch_animated_fcurves(ed, &adt->action->curves, cfra, &frame);
+	seq_prefetch_animated_fcurves(ed, &adt->drivers, cfra, &frame);
 
-		for (e = prefetch_done.first; e; e = e->next) {
-			if (cfra == e->cfra &&
-			    chanshown == e->chanshown &&
-			    context->rectx == e->rectx &&
-			    context->recty == e->recty &&
-			    context->preview_render_size == e->preview_render_size)
-			{
-				success = true;
-				found_something = true;
-				break;
-			}
-		}
+	if (adt->nla_tracks.first) {
+		NlaTrack *nlt;
+		NlaStrip *strip;
 
-		if (!e) {
-			for (e = prefetch_wait.first; e; e = e->next) {
-				if (cfra == e->cfra &&
-				    chanshown == e->chanshown &&
-				    context->rectx == e->rectx &&
-				    context->recty == e->recty &&
-				    context->preview_render_size == e->preview_render_size)
-				{
-					found_something = true;
-					break;
-				}
+		for (nlt = adt->nla_tracks.first; nlt; nlt = nlt->next) {
+			for (strip = nlt->strips.first; strip; strip = strip->next) {
+				if (strip->act)
+					seq_prefetch_animated_fcurves(ed, &strip->act->curves, cfra, &frame);
 			}
 		}
+	}
 
-		if (!e) {
-			PrefetchThread *tslot;
+	return frame;
+}
 
-			for (tslot = running_threads.first;
-			     tslot;
-			     tslot = tslot->next)
-			{
-				if (tslot->current &&
-				    cfra == tslot->current->cfra &&
-				    chanshown == tslot->current->chanshown &&
-				    context->rectx == tslot->current->rectx &&
-				    context->recty == tslot->current->recty &&
-				    context->preview_render_size == tslot->current->preview_render_size)
-				{
-					found_something = true;
-					break;
-				}
-			}
-		}
+/* Check whether the composited frame is in the cache, returns it refed.
+ * Empty frames count as cached. */
+static bool seq_prefetch_cache_lookup(
+        const SeqRenderData *context, ListBase *seqbasep, int cfra, int chanshown, ImBuf **r_ibuf)
+{
+	Sequence *seq_arr[MAXSEQ + 1];
+	int count;
 
-		/* e->ibuf is unrefed by render thread on next round. */
+	count = get_shown_sequences(seqbasep, cfra, chanshown, (Sequence **)&seq_arr);
 
-		if (e) {
-			seq_last_given_monoton_cfra = e->monoton_cfra;
+	if (count == 0) {
+		*r_ibuf = NULL;
+		return true;
+	}
+
+	*r_ibuf = BKE_sequencer_cache_get(context, seq_arr[count - 1], cfra, SEQ_STRIPELEM_IBUF_COMP);
+
+	return *r_ibuf != NULL;
+}
+
+static bool seq_prefetch_job_matches(const SeqRenderData *context, ListBase *seqbasep, int chanshown)
+{
+	const SeqRenderData *job_context = &prefetch_job.context;
+
+	return ((prefetch_job.seqbasep == seqbasep) &&
+	        (prefetch_job.chanshown == chanshown) &&
+	        (job_context->bmain == context->bmain) &&
+	        (job_context->scene == context->scene) &&
+	        (job_context->rectx == context->rectx) &&
+	        (job_context->recty == context->recty) &&
+	        (job_context->preview_render_size == context->preview_render_size) &&
+	        (job_context->view_id == context->view_id));
+}
+
+static void seq_prefetch_task(TaskPool * __restrict pool, void *UNUSED(taskdata), int UNUSED(threadid))
+{
+	SeqPrefetchJob *job = BLI_task_pool_userdata(pool);
+	Scene *scene = job->context.scene;
+	int frame = job->cfra;
+
+	while (!BLI_task_pool_canceled(pool)) {
+		SeqRenderState state;
+		ImBuf *ibuf;
+		int cfra = job->cfra;
+
+		/* playback could have overtaken us */
+		frame = max_ii(frame + 1, cfra + 1);
+
+		if (frame > cfra + job->tot_frames || frame > PEFRA || frame >= job->anim_frame)
+			break;
+
+		if (!seq_prefetch_frame_supported(job->seqbasep, frame))
+			break;
+
+		if (seq_prefetch_cache_lookup(&job->context, job->seqbasep, frame, job->chanshown, &ibuf)) {
+			if (ibuf)
+				IMB_freeImBuf(ibuf);
+			continue;
 		}
 
-		pthread_mutex_unlock(&queue_lock);
+		sequencer_state_init(&state);
+		ibuf = seq_render_strip_stack(&job->context, &state, job->seqbasep, frame, job->chanshown);
 
-		if (!success) {
-			e = NULL;
+		if (ibuf) {
+			IMB_freeImBuf(ibuf);
 
-			if (!found_something) {
-				fprintf(stderr, "SEQ-THREAD: Requested frame not in queue ???\n");
+			/* rendering further ahead would only push
+			 * frames the display still needs out of the cache */
+			if (!seq_prefetch_cache_lookup(&job->context, job->seqbasep, frame, job->chanshown, &ibuf)) {
+				job->cache_full = true;
 				break;
 			}
-			pthread_mutex_lock(&frame_done_lock);
-			pthread_cond_wait(&frame_done_cond, &frame_done_lock);
-			pthread_mutex_unlock(&frame_done_lock);
+
+			if (ibuf)
+				IMB_freeImBuf(ibuf);
 		}
 	}
-	
-	return e ? e->ibuf : NULL;
+
+	job->running = false;
+}
+
+static void seq_prefetch_start(
+        const SeqRenderData *context, ListBase *seqbasep, int cfra, int chanshown, int tot_frames, int anim_frame)
+{
+	if (prefetch_pool == NULL) {
+		prefetch_pool = BLI_task_pool_create_background(BLI_task_scheduler_get(), &prefetch_job);
+	}
+
+	prefetch_job.context = *context;
+	prefetch_job.context.is_prefetch_render = true;
+	prefetch_job.context.skip_cache = false;
+	prefetch_job.seqbasep = seqbasep;
+	prefetch_job.chanshown = chanshown;
+	prefetch_job.cfra = cfra;
+	prefetch_job.tot_frames = tot_frames;
+	prefetch_job.anim_frame = anim_frame;
+	prefetch_job.running = true;
+
+	BLI_task_pool_push(prefetch_pool, seq_prefetch_task, NULL, false, TASK_PRIORITY_LOW);
+}
+
+static void seq_prefetch_cancel(void)
+{
+	if (prefetch_pool) {
+		/* waits for the frame being rendered */
+		BLI_task_pool_cancel(prefetch_pool);
+		prefetch_job.running = false;
+	}
+}
+
+void BKE_sequencer_prefetch_stop(void)
+{
+	BLI_mutex_lock(&prefetch_lock);
+	seq_prefetch_cancel();
+	BLI_mutex_unlock(&prefetch_lock);
+}
+
+void BKE_sequencer_prefetch_free(void)
+{
+	BLI_mutex_lock(&prefetch_lock);
+	if (prefetch_pool) {
+		seq_prefetch_cancel();
+		BLI_task_pool_free(prefetch_pool);
+		prefetch_pool = NULL;
+	}
+	BLI_mutex_unlock(&prefetch_lock);
+}
+
+/*
+ * Same as BKE_sequencer_give_ibuf, but renders up to prefetch_frames
+ * frames ahead of cfra in the background.
+ *
+ * returned ImBuf is refed!
+ */
+ImBuf *BKE_sequencer_give_ibuf_threaded(const SeqRenderData *context, float cfra, int chanshown, int prefetch_frames)
+{
+	Editing *ed = BKE_sequencer_editing_get(context->scene, false);
+	ListBase *seqbasep;
+	ImBuf *ibuf = NULL;
+	const int frame = (int)cfra;
+	int anim_frame;
+
+	if (ed == NULL) return NULL;
+
+	seqbasep = seq_render_seqbase_get(ed, chanshown);
+
+	BLI_mutex_lock(&prefetch_lock);
+
+	if (!(prefetch_pool && seq_prefetch_job_matches(context, seqbasep, chanshown) &&
+	      seq_prefetch_cache_lookup(context, seqbasep, frame, chanshown, &ibuf)))
+	{
+		SeqRenderState state;
+
+		/* seek, or the frame isn't ready yet: render it here,
+		 * look-ahead continues from the new position */
+		seq_prefetch_cancel();
+		prefetch_job.cache_full = false;
+
+		sequencer_state_init(&state);
+		ibuf = seq_render_strip_stack(context, &state, seqbasep, cfra, chanshown);
+	}
+
+	anim_frame = seq_prefetch_animated_frame(context->scene, frame);
+
+	prefetch_job.cfra = frame;
+	prefetch_job.tot_frames = prefetch_frames;
+	prefetch_job.anim_frame = anim_frame;
+
+	if (!prefetch_job.running && !prefetch_job.cache_full && !context->skip_cache &&
+	    prefetch_frames > 0 && frame + 1 < anim_frame &&
+	    seq_prefetch_frame_supported(seqbasep, frame + 1))
+	{
+		seq_prefetch_start(context, seqbasep, frame, chanshown, prefetch_frames, anim_frame);
+	}
+
+	BLI_mutex_unlock(&prefetch_lock);
+
+	return ibuf;
 }
 
 /* check whether sequence cur depends on seq */
@@ -4072,6 +4307,8 @@ static void sequence_invalidate_cache(Scene *scene, Sequence *seq, bool invalida
 {
 	Editing *ed = scene->ed;
 
+	BKE_sequencer_prefetch_stop();
+
 	/* invalidate cache for current sequence */
 	if (invalidate_self) {
 		/* Animation structure holds some buffers inside,
@@ -4191,6 +4428,8 @@ void BKE_sequencer_update_changed_seq_and_deps(Scene *scene, Sequence *changed_s
 	Sequence *seq;
 	
 	if (ed == NULL) return;
+
+	BKE_sequencer_prefetch_stop();
 	
 	for (seq = ed->seqbase.first; seq; seq = seq->next)
 		update_changed_seq_recurs(scene, seq, changed_seq, len_change, ibuf_change);
@@ -2584,6 +2584,8 @@ static void step(Scene *scene, Object *ob, SmokeModifierData *smd, DerivedMesh *
 
 	// printf("totalSubsteps: %d, maxVelMag: %f, dt: %f\n", totalSubsteps, maxVelMag, dt);
 
+	smoke_set_sparse(sds->fluid, (sds->flags & MOD_SMOKE_SPARSE_BLOCKS) != 0);
+
 	for (substep = 0; substep < totalSubsteps; substep++)
 	{
 		// calc animated obstacle velocities
@@ -2814,6 +2816,7 @@ static void smokeModifier_process(SmokeModifierData *smd, Scene *scene, Object *
 		smoke_calc_transparency(sds, scene);
 
 		if (sds->wt && sds->total_cells > 1) {
+			smoke_turbulence_set_sparse(sds->wt, (sds->flags & MOD_SMOKE_SPARSE_BLOCKS) != 0);
 			smoke_turbulence_step(sds->wt, sds->fluid);
 		}
 
@@ -69,7 +69,10 @@ variables on the UI for now
 #include "BLI_utildefines.h"
 #include "BLI_listbase.h"
 #include "BLI_ghash.h"
-#include "BLI_threads.h"
+#include "BLI_buffer.h"
+#include "BLI_kdopbvh.h"
+#include "BLI_sort_utils.h"
+#include "BLI_task.h"
 
 #include "BKE_curve.h"
 #include "BKE_effect.h"
@@ -138,10 +141,11 @@ typedef struct  SB_thread_context {
 		int do_deflector;
 		float fieldfactor;
 		float windfactor;
-		int nr;
-		int tot;
 } SB_thread_context;
 
+/* Points or springs handled by a single task. */
+#define SB_TASK_CHUNK_SIZE 100
+
 #define MID_PRESERVE 1
 
 #define SOFTGOALSNAP  0.999f
@@ -274,11 +278,72 @@ typedef struct ccd_Mesh {
 	const MVertTri *tri;
 	int savety;
 	ccdf_minmax *mima;
+	/* tree of the mima boxes, refitted when the collider moves */
+	BVHTree *bvhtree;
 	/* Axis Aligned Bounding Box AABB */
 	float bbmin[3];
 	float bbmax[3];
 } ccd_Mesh;
 
+typedef struct ccdQueryData {
+	const ccdf_minmax *mima;
+	const float *aabbmin, *aabbmax;
+	BLI_Buffer *r_tris;
+} ccdQueryData;
+
+static bool ccd_mesh_walk_parent_cb(const BVHTreeAxisRange *bounds, void *userdata)
+{
+	const ccdQueryData *data = userdata;
+
+	return !((data->aabbmax[0] < bounds[0].min) ||
+	         (data->aabbmin[0] > bounds[0].max) ||
+	         (data->aabbmax[1] < bounds[1].min) ||
+	         (data->aabbmin[1] > bounds[1].max) ||
+	         (data->aabbmax[2] < bounds[2].min) ||
+	         (data->aabbmin[2] > bounds[2].max));
+}
+
+static bool ccd_mesh_walk_leaf_cb(const BVHTreeAxisRange *UNUSED(bounds), int index, void *userdata)
+{
+	const ccdQueryData *data = userdata;
+	const ccdf_minmax *mima = &data->mima[index];
+
+	if (!((data->aabbmax[0] < mima->minx) ||
+	      (data->aabbmin[0] > mima->maxx) ||
+	      (data->aabbmax[1] < mima->miny) ||
+	      (data->aabbmin[1] > mima->maxy) ||
+	      (data->aabbmax[2] < mima->minz) ||
+	      (data->aabbmin[2] > mima->maxz)))
+	{
+		BLI_buffer_append(data->r_tris, int, index);
+	}
+	return true;
+}
+
+static bool ccd_mesh_walk_order_cb(const BVHTreeAxisRange *UNUSED(bounds), char UNUSED(axis), void *UNUSED(userdata))
+{
+	return true;
+}
+
+/* Collect the triangles whose padded bounds overlap the given box, in index order
+ * so forces accumulate the same way as a plain loop over all triangles would. */
+static void ccd_mesh_tris_in_box(const ccd_Mesh *ccdm, const float aabbmin[3], const float aabbmax[3], BLI_Buffer *r_tris)
+{
+	ccdQueryData data;
+
+	data.mima = ccdm->mima;
+	data.aabbmin = aabbmin;
+	data.aabbmax = aabbmax;
+	data.r_tris = r_tris;
+
+	BLI_buffer_empty(r_tris);
+	BLI_bvhtree_walk_dfs(ccdm->bvhtree, ccd_mesh_walk_parent_cb, ccd_mesh_walk_leaf_cb, ccd_mesh_walk_order_cb, &data);
+
+	if (r_tris->count > 1) {
+		qsort(r_tris->data, r_tris->count, sizeof(int), BLI_sortutil_cmp_int);
+	}
+}
+
 
 static ccd_Mesh *ccd_mesh_make(Object *ob)
 {
@@ -363,6 +428,13 @@ static ccd_Mesh *ccd_mesh_make(Object *ob)
 		mima->maxz = max_ff(mima->maxz, v[2] + hull);
 	}
 
+	/* the min and max corners of a ccdf_minmax are the two points of each leaf */
+	pccd_M->bvhtree = BLI_bvhtree_new(pccd_M->tri_num, 0.0f, 4, 6);
+	for (i = 0, mima = pccd_M->mima; i < pccd_M->tri_num; i++, mima++) {
+		BLI_bvhtree_insert(pccd_M->bvhtree, i, (const float *)mima, 2);
+	}
+	BLI_bvhtree_balance(pccd_M->bvhtree);
+
 	return pccd_M;
 }
 static void ccd_mesh_update(Object *ob, ccd_Mesh *pccd_M)
@@ -482,6 +554,12 @@ static void ccd_mesh_update(Object *ob, ccd_Mesh *pccd_M)
 		mima->maxy = max_ff(mima->maxy, v[1] + hull);
 		mima->maxz = max_ff(mima->maxz, v[2] + hull);
 	}
+
+	for (i = 0, mima = pccd_M->mima; i < pccd_M->tri_num; i++, mima++) {
+		BLI_bvhtree_update_node(pccd_M->bvhtree, i, (const float *)mima, NULL, 2);
+	}
+	BLI_bvhtree_update_tree(pccd_M->bvhtree);
+
 	return;
 }
 
@@ -492,6 +570,7 @@ static void ccd_mesh_free(ccd_Mesh *ccdm)
 		MEM_freeN((void *)ccdm->tri);
 		if (ccdm->mprevvert) MEM_freeN((void *)ccdm->mprevvert);
 		MEM_freeN(ccdm->mima);
+		BLI_bvhtree_free(ccdm->bvhtree);
 		MEM_freeN(ccdm);
 		ccdm = NULL;
 	}
@@ -1175,6 +1254,7 @@ static int sb_detect_face_collisionCached(float face_v1[3], float face_v2[3], fl
 	float nv1[3], nv2[3], nv3[3], edge1[3], edge2[3], d_nvect[3], aabbmin[3], aabbmax[3];
 	float t, tune = 10.0f;
 	int a, deflected=0;
+	BLI_buffer_declare_static(int, tris, BLI_BUFFER_NOP, 64);
 
 	aabbmin[0] = min_fff(face_v1[0], face_v2[0], face_v3[0]);
 	aabbmin[1] = min_fff(face_v1[1], face_v2[1], face_v3[1]);
@@ -1195,14 +1275,10 @@ static int sb_detect_face_collisionCached(float face_v1[3], float face_v2[3], fl
 				const MVert *mvert = NULL;
 				const MVert *mprevvert = NULL;
 				const MVertTri *vt = NULL;
-				const ccdf_minmax *mima = NULL;
 
 				if (ccdm) {
 					mvert = ccdm->mvert;
-					vt = ccdm->tri;
 					mprevvert = ccdm->mprevvert;
-					mima = ccdm->mima;
-					a = ccdm->tri_num;
 
 					if ((aabbmax[0] < ccdm->bbmin[0]) ||
 					    (aabbmax[1] < ccdm->bbmin[1]) ||
@@ -1226,19 +1302,9 @@ static int sb_detect_face_collisionCached(float face_v1[3], float face_v2[3], fl
 
 
 				/* use mesh*/
-				while (a--) {
-					if ((aabbmax[0] < mima->minx) ||
-					    (aabbmin[0] > mima->maxx) ||
-					    (aabbmax[1] < mima->miny) ||
-					    (aabbmin[1] > mima->maxy) ||
-					    (aabbmax[2] < mima->minz) ||
-					    (aabbmin[2] > mima->maxz))
-					{
-						mima++;
-						vt++;
-						continue;
-					}
-
+				ccd_mesh_tris_in_box(ccdm, aabbmin, aabbmax, &tris);
+				for (a = 0; a < (int)tris.count; a++) {
+					vt = &ccdm->tri[BLI_buffer_at(&tris, int, a)];
 
 					if (mvert) {
 
@@ -1271,14 +1337,13 @@ static int sb_detect_face_collisionCached(float face_v1[3], float face_v2[3], fl
 						*damp=tune*ob->pd->pdef_sbdamp;
 						deflected = 2;
 					}
-					mima++;
-					vt++;
-				}/* while a */
+				}/* for tris */
 			} /* if (ob->pd && ob->pd->deflect) */
 			BLI_ghashIterator_step(ihash);
 		}
 	} /* while () */
 	BLI_ghashIterator_free(ihash);
+	BLI_buffer_free(&tris);
 	return deflected;
 }
 
@@ -1359,6 +1424,7 @@ static int sb_detect_edge_collisionCached(float edge_v1[3], float edge_v2[3], fl
 	float nv1[3], nv2[3], nv3[3], edge1[3], edge2[3], d_nvect[3], aabbmin[3], aabbmax[3];
 	float t, el;
 	int a, deflected=0;
+	BLI_buffer_declare_static(int, tris, BLI_BUFFER_NOP, 64);
 
 	minmax_v3v3_v3(aabbmin, aabbmax, edge_v1);
 	minmax_v3v3_v3(aabbmin, aabbmax, edge_v2);
@@ -1377,14 +1443,10 @@ static int sb_detect_edge_collisionCached(float edge_v1[3], float edge_v2[3], fl
 				const MVert *mvert = NULL;
 				const MVert *mprevvert = NULL;
 				const MVertTri *vt = NULL;
-				const ccdf_minmax *mima = NULL;
 
 				if (ccdm) {
 					mvert = ccdm->mvert;
 					mprevvert = ccdm->mprevvert;
-					vt = ccdm->tri;
-					mima = ccdm->mima;
-					a = ccdm->tri_num;
 
 					if ((aabbmax[0] < ccdm->bbmin[0]) ||
 					    (aabbmax[1] < ccdm->bbmin[1]) ||
@@ -1408,19 +1470,9 @@ static int sb_detect_edge_collisionCached(float edge_v1[3], float edge_v2[3], fl
 
 
 				/* use mesh*/
-				while (a--) {
-					if ((aabbmax[0] < mima->minx) ||
-					    (aabbmin[0] > mima->maxx) ||
-					    (aabbmax[1] < mima->miny) ||
-					    (aabbmin[1] > mima->maxy) ||
-					    (aabbmax[2] < mima->minz) ||
-					    (aabbmin[2] > mima->maxz))
-					{
-						mima++;
-						vt++;
-						continue;
-					}
-
+				ccd_mesh_tris_in_box(ccdm, aabbmin, aabbmax, &tris);
+				for (a = 0; a < (int)tris.count; a++) {
+					vt = &ccdm->tri[BLI_buffer_at(&tris, int, a)];
 
 					if (mvert) {
 
@@ -1458,15 +1510,13 @@ static int sb_detect_edge_collisionCached(float edge_v1[3], float edge_v2[3], fl
 						*damp=ob->pd->pdef_sbdamp;
 						deflected = 2;
 					}
-
-					mima++;
-					vt++;
-				}/* while a */
+				}/* for tris */
 			} /* if (ob->pd && ob->pd->deflect) */
 			BLI_ghashIterator_step(ihash);
 		}
 	} /* while () */
 	BLI_ghashIterator_free(ihash);
+	BLI_buffer_free(&tris);
 	return deflected;
 }
 
@@ -1554,67 +1604,30 @@ static void scan_for_ext_spring_forces(Scene *scene, Object *ob, float timenow)
 	pdEndEffectors(&do_effector);
 }
 
-static void *exec_scan_for_ext_spring_forces(void *data)
+static void exec_scan_for_ext_spring_forces(void *userdata, const int chunk)
 {
-	SB_thread_context *pctx = (SB_thread_context*)data;
-	_scan_for_ext_spring_forces(pctx->scene, pctx->ob, pctx->timenow, pctx->ifirst, pctx->ilast, pctx->do_effector);
-	return NULL;
+	SB_thread_context *pctx = userdata;
+	const int ifirst = pctx->ifirst + chunk * SB_TASK_CHUNK_SIZE;
+	const int ilast = min_ii(ifirst + SB_TASK_CHUNK_SIZE, pctx->ilast);
+
+	_scan_for_ext_spring_forces(pctx->scene, pctx->ob, pctx->timenow, ifirst, ilast, pctx->do_effector);
 }
 
 static void sb_sfesf_threads_run(Scene *scene, struct Object *ob, float timenow, int totsprings, int *UNUSED(ptr_to_break_func(void)))
 {
-	ListBase *do_effector = NULL;
-	ListBase threads;
-	SB_thread_context *sb_threads;
-	int i, totthread, left, dec;
-	int lowsprings =100; /* wild guess .. may increase with better thread management 'above' or even be UI option sb->spawn_cf_threads_nopts */
-
-	do_effector= pdInitEffectors(scene, ob, NULL, ob->soft->effector_weights, true);
-
-	/* figure the number of threads while preventing pretty pointless threading overhead */
-	totthread= BKE_scene_num_threads(scene);
-	/* what if we got zillions of CPUs running but less to spread*/
-	while ((totsprings/totthread < lowsprings) && (totthread > 1)) {
-		totthread--;
-	}
-
-	sb_threads= MEM_callocN(sizeof(SB_thread_context)*totthread, "SBSpringsThread");
-	memset(sb_threads, 0, sizeof(SB_thread_context)*totthread);
-	left = totsprings;
-	dec = totsprings/totthread +1;
-	for (i=0; i<totthread; i++) {
-		sb_threads[i].scene = scene;
-		sb_threads[i].ob = ob;
-		sb_threads[i].forcetime = 0.0; // not used here
-		sb_threads[i].timenow = timenow;
-		sb_threads[i].ilast   = left;
-		left = left - dec;
-		if (left >0) {
-			sb_threads[i].ifirst  = left;
-		}
-		else
-			sb_threads[i].ifirst  = 0;
-		sb_threads[i].do_effector = do_effector;
-		sb_threads[i].do_deflector = false;// not used here
-		sb_threads[i].fieldfactor = 0.0f;// not used here
-		sb_threads[i].windfactor  = 0.0f;// not used here
-		sb_threads[i].nr= i;
-		sb_threads[i].tot= totthread;
-	}
-	if (totthread > 1) {
-		BLI_init_threads(&threads, exec_scan_for_ext_spring_forces, totthread);
+	SB_thread_context ctx = {NULL};
+	const int totchunk = (totsprings + SB_TASK_CHUNK_SIZE - 1) / SB_TASK_CHUNK_SIZE;
 
-		for (i=0; i<totthread; i++)
-			BLI_insert_thread(&threads, &sb_threads[i]);
+	ctx.scene = scene;
+	ctx.ob = ob;
+	ctx.timenow = timenow;
+	ctx.ifirst = 0;
+	ctx.ilast = totsprings;
+	ctx.do_effector = pdInitEffectors(scene, ob, NULL, ob->soft->effector_weights, true);
 
-		BLI_end_threads(&threads);
-	}
-	else
-		exec_scan_for_ext_spring_forces(&sb_threads[0]);
-	/* clean up */
-	MEM_freeN(sb_threads);
+	BLI_task_parallel_range(0, totchunk, &ctx, exec_scan_for_ext_spring_forces, totchunk > 1);
 
-	pdEndEffectors(&do_effector);
+	pdEndEffectors(&ctx.do_effector);
 }
 
 
@@ -1662,6 +1675,7 @@ static int sb_detect_vertex_collisionCached(
 	      innerfacethickness = -0.5f, outerfacethickness = 0.2f,
 	      ee = 5.0f, ff = 0.1f, fa=1;
 	int a, deflected=0, cavel=0, ci=0;
+	BLI_buffer_declare_static(int, tris, BLI_BUFFER_NOP, 64);
 /* init */
 	*intrusion = 0.0f;
 	hash  = vertexowner->soft->scratch->colliderhash;
@@ -1679,14 +1693,10 @@ static int sb_detect_vertex_collisionCached(
 				const MVert *mvert = NULL;
 				const MVert *mprevvert = NULL;
 				const MVertTri *vt = NULL;
-				const ccdf_minmax *mima = NULL;
 
 				if (ccdm) {
 					mvert = ccdm->mvert;
 					mprevvert = ccdm->mprevvert;
-					vt = ccdm->tri;
-					mima = ccdm->mima;
-					a = ccdm->tri_num;
 
 					minx = ccdm->bbmin[0];
 					miny = ccdm->bbmin[1];
@@ -1724,18 +1734,9 @@ static int sb_detect_vertex_collisionCached(
 				fa = 1.0f/fa;
 				avel[0]=avel[1]=avel[2]=0.0f;
 				/* use mesh*/
-				while (a--) {
-					if ((opco[0] < mima->minx) ||
-					    (opco[0] > mima->maxx) ||
-					    (opco[1] < mima->miny) ||
-					    (opco[1] > mima->maxy) ||
-					    (opco[2] < mima->minz) ||
-					    (opco[2] > mima->maxz))
-					{
-						mima++;
-						vt++;
-						continue;
-					}
+				ccd_mesh_tris_in_box(ccdm, opco, opco, &tris);
+				for (a = 0; a < (int)tris.count; a++) {
+					vt = &ccdm->tri[BLI_buffer_at(&tris, int, a)];
 
 					if (mvert) {
 
@@ -1801,10 +1802,7 @@ static int sb_detect_vertex_collisionCached(
 							ci++;
 						}
 					}
-
-					mima++;
-					vt++;
-				}/* while a */
+				}/* for tris */
 			} /* if (ob->pd && ob->pd->deflect) */
 			BLI_ghashIterator_step(ihash);
 		}
@@ -1829,6 +1827,7 @@ static int sb_detect_vertex_collisionCached(
 	}
 
 	BLI_ghashIterator_free(ihash);
+	BLI_buffer_free(&tris);
 	if (cavel) mul_v3_fl(avel, 1.0f/(float)cavel);
 	copy_v3_v3(vel, avel);
 	if (ci) *intrusion /= ci;
@@ -2169,66 +2168,32 @@ static int _softbody_calc_forces_slice_in_a_thread(Scene *scene, Object *ob, flo
 	return 0; /*done fine*/
 }
 
-static void *exec_softbody_calc_forces(void *data)
+static void exec_softbody_calc_forces(void *userdata, const int chunk)
 {
-	SB_thread_context *pctx = (SB_thread_context*)data;
-	_softbody_calc_forces_slice_in_a_thread(pctx->scene, pctx->ob, pctx->forcetime, pctx->timenow, pctx->ifirst, pctx->ilast, NULL, pctx->do_effector, pctx->do_deflector, pctx->fieldfactor, pctx->windfactor);
-	return NULL;
+	SB_thread_context *pctx = userdata;
+	const int ifirst = pctx->ifirst + chunk * SB_TASK_CHUNK_SIZE;
+	const int ilast = min_ii(ifirst + SB_TASK_CHUNK_SIZE, pctx->ilast);
+
+	_softbody_calc_forces_slice_in_a_thread(pctx->scene, pctx->ob, pctx->forcetime, pctx->timenow, ifirst, ilast, NULL, pctx->do_effector, pctx->do_deflector, pctx->fieldfactor, pctx->windfactor);
 }
 
 static void sb_cf_threads_run(Scene *scene, Object *ob, float forcetime, float timenow, int totpoint, int *UNUSED(ptr_to_break_func(void)), struct ListBase *do_effector, int do_deflector, float fieldfactor, float windfactor)
 {
-	ListBase threads;
-	SB_thread_context *sb_threads;
-	int i, totthread, left, dec;
-	int lowpoints =100; /* wild guess .. may increase with better thread management 'above' or even be UI option sb->spawn_cf_threads_nopts */
-
-	/* figure the number of threads while preventing pretty pointless threading overhead */
-	totthread= BKE_scene_num_threads(scene);
-	/* what if we got zillions of CPUs running but less to spread*/
-	while ((totpoint/totthread < lowpoints) && (totthread > 1)) {
-		totthread--;
-	}
-
-	/* printf("sb_cf_threads_run spawning %d threads\n", totthread); */
-
-	sb_threads= MEM_callocN(sizeof(SB_thread_context)*totthread, "SBThread");
-	memset(sb_threads, 0, sizeof(SB_thread_context)*totthread);
-	left = totpoint;
-	dec = totpoint/totthread +1;
-	for (i=0; i<totthread; i++) {
-		sb_threads[i].scene = scene;
-		sb_threads[i].ob = ob;
-		sb_threads[i].forcetime = forcetime;
-		sb_threads[i].timenow = timenow;
-		sb_threads[i].ilast   = left;
-		left = left - dec;
-		if (left >0) {
-			sb_threads[i].ifirst  = left;
-		}
-		else
-			sb_threads[i].ifirst  = 0;
-		sb_threads[i].do_effector = do_effector;
-		sb_threads[i].do_deflector = do_deflector;
-		sb_threads[i].fieldfactor = fieldfactor;
-		sb_threads[i].windfactor  = windfactor;
-		sb_threads[i].nr= i;
-		sb_threads[i].tot= totthread;
-	}
-
-
-	if (totthread > 1) {
-		BLI_init_threads(&threads, exec_softbody_calc_forces, totthread);
-
-		for (i=0; i<totthread; i++)
-			BLI_insert_thread(&threads, &sb_threads[i]);
-
-		BLI_end_threads(&threads);
-	}
-	else
-		exec_softbody_calc_forces(&sb_threads[0]);
-	/* clean up */
-	MEM_freeN(sb_threads);
+	SB_thread_context ctx = {NULL};
+	const int totchunk = (totpoint + SB_TASK_CHUNK_SIZE - 1) / SB_TASK_CHUNK_SIZE;
+
+	ctx.scene = scene;
+	ctx.ob = ob;
+	ctx.forcetime = forcetime;
+	ctx.timenow = timenow;
+	ctx.ifirst = 0;
+	ctx.ilast = totpoint;
+	ctx.do_effector = do_effector;
+	ctx.do_deflector = do_deflector;
+	ctx.fieldfactor = fieldfactor;
+	ctx.windfactor = windfactor;
+
+	BLI_task_parallel_range(0, totchunk, &ctx, exec_softbody_calc_forces, totchunk > 1);
 }
 
 static void softbody_calc_forcesEx(Scene *scene, Object *ob, float forcetime, float timenow)
@@ -55,6 +55,7 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads);
 void BLI_task_scheduler_free(TaskScheduler *scheduler);
 
 int BLI_task_scheduler_num_threads(TaskScheduler *scheduler);
+bool BLI_task_scheduler_thread_is_worker(TaskScheduler *scheduler);
 
 /* Task Pool
  *
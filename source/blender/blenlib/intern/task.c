@@ -443,6 +443,22 @@ int BLI_task_scheduler_num_threads(TaskScheduler *scheduler)
 	return scheduler->num_threads + 1;
 }
 
+/* Check whether the calling thread is one of the scheduler's worker threads,
+ * background task pools can't be created from these. */
+bool BLI_task_scheduler_thread_is_worker(TaskScheduler *scheduler)
+{
+	const pthread_t thread_id = pthread_self();
+	int i;
+
+	for (i = 0; i < scheduler->num_threads; i++) {
+		if (pthread_equal(scheduler->threads[i], thread_id)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 static void task_scheduler_push(TaskScheduler *scheduler, Task *task, TaskPriority priority)
 {
 	task_pool_num_increase(task->pool);
@@ -4333,7 +4333,7 @@ static void direct_link_particlesystems(FileData *fd, ListBase *particles)
 		}
 
 		psys->tree = NULL;
-		psys->bvhtree = NULL;
+		psys->sph_grid = NULL;
 	}
 	return;
 }
@@ -111,4 +111,24 @@ typedef enum OrderOfChunks {
 
 #define COM_BLUR_BOKEH_PIXELS 512
 
+/**
+ * Blur size in pixels from which gaussian and bell shaped blur kernels are
+ * replaced by the recursive gaussian or box cascade of FastGaussianBlurOperation.
+ * The bokeh kernel grows with the square of the size and is replaced earlier.
+ */
+#define COM_BLUR_FAST_SIZE 32
+#define COM_BLUR_BOKEH_FAST_SIZE 8
+
+/**
+ * Maximum number of pixels passed to SocketReader::executeRow at once,
+ * allows row kernels to keep their input spans on the stack. Kept small since
+ * nested row kernels each take about 36 bytes of stack per pixel.
+ */
+#define COM_ROW_MAX_WIDTH 32
+
+/**
+ * Maximum size in bytes of the results of complex groups kept between executions.
+ */
+#define COM_RESULT_CACHE_SIZE ((size_t)512 * 1024 * 1024)
+
 #endif  /* __COM_DEFINES_H__ */
@@ -375,6 +375,17 @@ public:
 	 * @param system
 	 */
 	void execute(ExecutionSystem *system);
+
+	/**
+	 * @brief check if all chunks of this ExecutionGroup have been executed
+	 * @note only valid between initExecution and deinitExecution
+	 */
+	bool isExecuted() const;
+
+	/**
+	 * @brief tag all chunks as executed, used when the result is restored from the ResultCache
+	 */
+	void setExecuted();
 	
 	/**
 	 * @brief this method determines the MemoryProxy's where this execution group depends on.
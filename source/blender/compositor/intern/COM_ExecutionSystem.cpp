@@ -36,6 +36,7 @@ extern "C" {
 #include "COM_ExecutionGroup.h"
 #include "COM_WorkScheduler.h"
 #include "COM_ReadBufferOperation.h"
+#include "COM_ResultCache.h"
 #include "COM_Debug.h"
 
 #ifdef WITH_CXX_GUARDEDALLOC
@@ -174,6 +175,9 @@ void ExecutionSystem::execute()
 		executionGroup->initExecution();
 	}
 
+	/* reuse results of unchanged complex groups of earlier executions */
+	unsigned int cache_generation = ResultCache::restoreGroups(this->m_context, this->m_groups);
+
 	WorkScheduler::start(this->m_context);
 
 	executeGroups(COM_PRIORITY_HIGH);
@@ -185,6 +189,8 @@ void ExecutionSystem::execute()
 	WorkScheduler::finish();
 	WorkScheduler::stop();
 
+	ResultCache::storeGroups(this->m_context, this->m_groups, cache_generation);
+
 	editingtree->stats_draw(editingtree->sdh, IFACE_("Compositing | De-initializing execution"));
 	for (index = 0; index < this->m_operations.size(); index++) {
 		NodeOperation *operation = this->m_operations[index];
@@ -249,7 +249,35 @@ public:
 		float *buffer = &this->m_buffer[offset];
 		memcpy(result, buffer, sizeof(float) * this->m_num_channels);
 	}
-	
+
+	/**
+	 * @brief read a horizontal span of width pixels starting at x, y
+	 * pixels outside the buffer rect are zero, same as read with COM_MB_CLIP
+	 */
+	inline void readRow(float *result, int x, int y, int width)
+	{
+		const int nc = this->m_num_channels;
+		if (y < m_rect.ymin || y >= m_rect.ymax ||
+		    x + width <= m_rect.xmin || x >= m_rect.xmax)
+		{
+			memset(result, 0, sizeof(float) * nc * width);
+			return;
+		}
+		if (x < m_rect.xmin) {
+			const int skip = m_rect.xmin - x;
+			memset(result, 0, sizeof(float) * nc * skip);
+			result += nc * skip;
+			width -= skip;
+			x = m_rect.xmin;
+		}
+		const int inside = min_ii(width, m_rect.xmax - x);
+		const int offset = (this->m_width * y + x) * nc;
+		memcpy(result, &this->m_buffer[offset], sizeof(float) * nc * inside);
+		if (inside < width) {
+			memset(result + nc * inside, 0, sizeof(float) * nc * (width - inside));
+		}
+	}
+
 	void writePixel(int x, int y, const float color[4]);
 	void addPixel(int x, int y, const float color[4]);
 	inline void readBilinear(float *result, float x, float y,
@@ -125,6 +125,18 @@ private:
 	 * @brief set to truth when resolution for this operation is set
 	 */
 	bool m_isResolutionSet;
+
+	/**
+	 * @brief hash of the node settings this operation was created with
+	 * @see ResultCache
+	 */
+	unsigned int m_settingsHash;
+
+	/**
+	 * @brief false when the result depends on data outside of the node tree
+	 * @see ResultCache
+	 */
+	bool m_resultCacheable;
 	
 public:
 	virtual ~NodeOperation();
@@ -295,6 +307,10 @@ public:
 	virtual bool isProxyOperation() const { return false; }
 	
 	virtual bool useDatatypeConversion() const { return true; }
+
+	void setSettingsHash(unsigned int hash, bool cacheable) { this->m_settingsHash = hash; this->m_resultCacheable = cacheable; }
+	unsigned int getSettingsHash() const { return this->m_settingsHash; }
+	bool isResultCacheable() const { return this->m_resultCacheable; }
 	
 	inline bool isBreaked() const {
 		return this->m_btree->test_break(this->m_btree->tbh);
@@ -21,6 +21,7 @@
 
 extern "C" {
 #include "BLI_utildefines.h"
+#include "BLI_hash_mm2a.h"
 }
 
 #include "COM_NodeConverter.h"
@@ -28,6 +29,7 @@ extern "C" {
 #include "COM_Debug.h"
 #include "COM_ExecutionSystem.h"
 #include "COM_Node.h"
+#include "COM_ResultCache.h"
 #include "COM_SocketProxyNode.h"
 
 #include "COM_NodeOperation.h"
@@ -45,6 +47,9 @@ extern "C" {
 NodeOperationBuilder::NodeOperationBuilder(const CompositorContext *context, bNodeTree *b_nodetree) :
     m_context(context),
     m_current_node(NULL),
+    m_current_node_hash(0),
+    m_current_node_cacheable(true),
+    m_current_node_operations(0),
     m_active_viewer(NULL)
 {
 	m_graph.from_bNodeTree(*context, b_nodetree);
@@ -63,6 +68,14 @@ void NodeOperationBuilder::convertToOperations(ExecutionSystem *system)
 		Node *node = (Node *)m_graph.nodes()[index];
 		
 		m_current_node = node;
+		m_current_node_operations = 0;
+		if (node->getbNode()) {
+			m_current_node_hash = ResultCache::hashNode(*m_context, node->getbNode(), &m_current_node_cacheable);
+		}
+		else {
+			m_current_node_hash = 0;
+			m_current_node_cacheable = true;
+		}
 		
 		DebugInfo::node_to_operations(node);
 		node->convertToOperations(converter, *m_context);
@@ -130,6 +143,13 @@ void NodeOperationBuilder::convertToOperations(ExecutionSystem *system)
 
 void NodeOperationBuilder::addOperation(NodeOperation *operation)
 {
+	if (m_current_node) {
+		/* nodes can add several operations with the same inputs, e.g. one per output */
+		BLI_HashMurmur2A mm2;
+		BLI_hash_mm2a_init(&mm2, m_current_node_hash);
+		BLI_hash_mm2a_add_int(&mm2, m_current_node_operations++);
+		operation->setSettingsHash(BLI_hash_mm2a_end(&mm2), m_current_node_cacheable);
+	}
 	m_operations.push_back(operation);
 }
 
@@ -325,6 +345,7 @@ void NodeOperationBuilder::add_input_constant_value(NodeOperationInput *input, N
 			
 			SetValueOperation *op = new SetValueOperation();
 			op->setValue(value);
+			op->setSettingsHash(BLI_hash_mm2((const unsigned char *)&value, sizeof(value), 0), true);
 			addOperation(op);
 			addLink(op->getOutputSocket(), input);
 			break;
@@ -338,6 +359,7 @@ void NodeOperationBuilder::add_input_constant_value(NodeOperationInput *input, N
 			
 			SetColorOperation *op = new SetColorOperation();
 			op->setChannels(value);
+			op->setSettingsHash(BLI_hash_mm2((const unsigned char *)value, sizeof(value), 0), true);
 			addOperation(op);
 			addLink(op->getOutputSocket(), input);
 			break;
@@ -351,6 +373,7 @@ void NodeOperationBuilder::add_input_constant_value(NodeOperationInput *input, N
 			
 			SetVectorOperation *op = new SetVectorOperation();
 			op->setVector(value);
+			op->setSettingsHash(BLI_hash_mm2((const unsigned char *)value, sizeof(value), 0), true);
 			addOperation(op);
 			addLink(op->getOutputSocket(), input);
 			break;
@@ -87,6 +87,11 @@ private:
 	OutputSocketMap m_output_map;
 	
 	Node *m_current_node;
+	/** Settings hash of the current node, see ResultCache */
+	unsigned int m_current_node_hash;
+	bool m_current_node_cacheable;
+	/** Number of operations added for the current node */
+	unsigned int m_current_node_operations;
 	
 	/** Operation that will be writing to the viewer image
 	 *  Only one operation can occupy this place at a time,
@@ -0,0 +1,360 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <list>
+#include <map>
+#include <string.h>
+
+#include "COM_ResultCache.h"
+#include "COM_ReadBufferOperation.h"
+#include "COM_WriteBufferOperation.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#  include "BLI_hash_mm2a.h"
+#  include "BLI_listbase.h"
+#  include "BLI_threads.h"
+#  include "BKE_camera.h"
+#  include "BKE_node.h"
+#  include "DNA_camera_types.h"
+#  include "DNA_color_types.h"
+#  include "DNA_node_types.h"
+#  include "DNA_object_types.h"
+#  include "DNA_scene_types.h"
+}
+
+typedef struct ResultCacheEntry {
+	unsigned int hash;
+	int width;
+	int height;
+	int num_channels;
+	size_t size;
+	float *buffer;
+} ResultCacheEntry;
+
+typedef std::list<ResultCacheEntry> ResultCacheEntries;
+typedef std::pair<unsigned int, bool> OperationHash;
+typedef std::map<NodeOperation *, OperationHash> OperationHashes;
+
+/* most recently used entries first */
+static ResultCacheEntries s_entries;
+static size_t s_size = 0;
+/* incremented on every clear, results computed from cleared data are not stored */
+static unsigned int s_generation = 0;
+static ThreadMutex s_mutex = BLI_MUTEX_INITIALIZER;
+
+static void hash_add_data(BLI_HashMurmur2A *mm2, const void *data)
+{
+	if (data) {
+		BLI_hash_mm2a_add(mm2, (const unsigned char *)data, MEM_allocN_len(data));
+	}
+}
+
+/* the mapping also holds pointers and view settings, only the settings used
+ * for evaluation are hashed */
+static void hash_add_curvemapping(BLI_HashMurmur2A *mm2, const CurveMapping *cumap)
+{
+	if (cumap == NULL) {
+		return;
+	}
+
+	BLI_hash_mm2a_add_int(mm2, cumap->flag);
+	BLI_hash_mm2a_add(mm2, (const unsigned char *)&cumap->clipr, sizeof(cumap->clipr));
+	BLI_hash_mm2a_add(mm2, (const unsigned char *)cumap->black, sizeof(cumap->black));
+	BLI_hash_mm2a_add(mm2, (const unsigned char *)cumap->white, sizeof(cumap->white));
+
+	for (int a = 0; a < CM_TOT; a++) {
+		const CurveMap *cuma = &cumap->cm[a];
+		BLI_hash_mm2a_add_int(mm2, cuma->totpoint);
+		BLI_hash_mm2a_add_int(mm2, cuma->flag);
+		if (cuma->curve) {
+			BLI_hash_mm2a_add(mm2, (const unsigned char *)cuma->curve, sizeof(CurveMapPoint) * cuma->totpoint);
+		}
+	}
+}
+
+static void hash_add_camera(BLI_HashMurmur2A *mm2, Object *camob)
+{
+	if (camob && camob->type == OB_CAMERA) {
+		const Camera *camera = (Camera *)camob->data;
+		const float dof_distance = BKE_camera_object_dof_distance(camob);
+		BLI_hash_mm2a_add(mm2, (const unsigned char *)&camera->lens, sizeof(camera->lens));
+		BLI_hash_mm2a_add(mm2, (const unsigned char *)&camera->sensor_x, sizeof(camera->sensor_x));
+		BLI_hash_mm2a_add(mm2, (const unsigned char *)&camera->sensor_y, sizeof(camera->sensor_y));
+		BLI_hash_mm2a_add_int(mm2, camera->sensor_fit);
+		BLI_hash_mm2a_add(mm2, (const unsigned char *)&dof_distance, sizeof(dof_distance));
+	}
+}
+
+unsigned int ResultCache::hashNode(const CompositorContext &context, bNode *node, bool *r_cacheable)
+{
+	BLI_HashMurmur2A mm2;
+	bNodeSocket *sock;
+
+	switch (node->type) {
+		/* output depends on data outside of the node tree */
+		case CMP_NODE_IMAGE:
+		case CMP_NODE_TEXTURE:
+		case CMP_NODE_MOVIECLIP:
+		case CMP_NODE_MOVIEDISTORTION:
+		case CMP_NODE_STABILIZE2D:
+		case CMP_NODE_MASK:
+		case CMP_NODE_KEYINGSCREEN:
+		case CMP_NODE_TRACKPOS:
+		case CMP_NODE_PLANETRACKDEFORM:
+			*r_cacheable = false;
+			return 0;
+		default:
+			*r_cacheable = true;
+			break;
+	}
+
+	BLI_hash_mm2a_init(&mm2, 0);
+	BLI_hash_mm2a_add_int(&mm2, node->type);
+	BLI_hash_mm2a_add_int(&mm2, node->custom1);
+	BLI_hash_mm2a_add_int(&mm2, node->custom2);
+	BLI_hash_mm2a_add(&mm2, (const unsigned char *)&node->custom3, sizeof(node->custom3));
+	BLI_hash_mm2a_add(&mm2, (const unsigned char *)&node->custom4, sizeof(node->custom4));
+	/* render layers are freed by ntreeCompositTagRender, so the scene pointer is enough */
+	BLI_hash_mm2a_add(&mm2, (const unsigned char *)&node->id, sizeof(node->id));
+
+	switch (node->type) {
+		case CMP_NODE_TIME:
+		case CMP_NODE_CURVE_VEC:
+		case CMP_NODE_CURVE_RGB:
+		case CMP_NODE_HUECORRECT:
+			hash_add_curvemapping(&mm2, (CurveMapping *)node->storage);
+			break;
+		default:
+			hash_add_data(&mm2, node->storage);
+			break;
+	}
+
+	switch (node->type) {
+		case CMP_NODE_R_LAYERS:
+		{
+			/* custom1 is the layer index, which points at another layer once layers are removed */
+			Scene *scene = node->id ? (Scene *)node->id : context.getScene();
+			SceneRenderLayer *srl = scene ? (SceneRenderLayer *)BLI_findlink(&scene->r.layers, node->custom1) : NULL;
+			if (srl) {
+				BLI_hash_mm2a_add(&mm2, (const unsigned char *)srl->name, strlen(srl->name));
+			}
+			break;
+		}
+		case CMP_NODE_DEFOCUS:
+		{
+			Scene *scene = node->id ? (Scene *)node->id : context.getScene();
+			if (scene) {
+				hash_add_camera(&mm2, scene->camera);
+			}
+			break;
+		}
+	}
+
+	/* unconnected inputs and value/color nodes use the socket values */
+	for (sock = (bNodeSocket *)node->inputs.first; sock; sock = sock->next) {
+		hash_add_data(&mm2, sock->default_value);
+	}
+	for (sock = (bNodeSocket *)node->outputs.first; sock; sock = sock->next) {
+		hash_add_data(&mm2, sock->default_value);
+	}
+
+	return BLI_hash_mm2a_end(&mm2);
+}
+
+static OperationHash hash_operation(OperationHashes &hashes, NodeOperation *operation)
+{
+	OperationHashes::iterator it = hashes.find(operation);
+	if (it != hashes.end()) {
+		return it->second;
+	}
+
+	BLI_HashMurmur2A mm2;
+	bool cacheable = operation->isResultCacheable();
+
+	BLI_hash_mm2a_init(&mm2, operation->getSettingsHash());
+	BLI_hash_mm2a_add_int(&mm2, operation->getWidth());
+	BLI_hash_mm2a_add_int(&mm2, operation->getHeight());
+
+	for (unsigned int index = 0; index < operation->getNumberOfInputSockets(); index++) {
+		NodeOperationInput *input = operation->getInputSocket(index);
+		BLI_hash_mm2a_add_int(&mm2, input->getDataType());
+		BLI_hash_mm2a_add_int(&mm2, input->getResizeMode());
+		if (input->isConnected()) {
+			NodeOperation *link_operation = &input->getLink()->getOperation();
+			for (unsigned int output = 0; output < link_operation->getNumberOfOutputSockets(); output++) {
+				if (link_operation->getOutputSocket(output) == input->getLink()) {
+					BLI_hash_mm2a_add_int(&mm2, output);
+				}
+			}
+
+			OperationHash link_hash = hash_operation(hashes, link_operation);
+			BLI_hash_mm2a_add_int(&mm2, link_hash.first);
+			cacheable &= link_hash.second;
+		}
+	}
+
+	if (operation->isReadBufferOperation()) {
+		ReadBufferOperation *read_operation = (ReadBufferOperation *)operation;
+		OperationHash write_hash = hash_operation(hashes, read_operation->getMemoryProxy()->getWriteBufferOperation());
+		BLI_hash_mm2a_add_int(&mm2, write_hash.first);
+		cacheable &= write_hash.second;
+	}
+
+	OperationHash result(BLI_hash_mm2a_end(&mm2), cacheable);
+	hashes[operation] = result;
+	return result;
+}
+
+static bool hash_group(const CompositorContext &context, OperationHashes &hashes, ExecutionGroup *group,
+                       unsigned int *r_hash)
+{
+	/* only keep the results of expensive groups */
+	if (group->isOutputExecutionGroup() || !group->isComplex()) {
+		return false;
+	}
+
+	OperationHash operation_hash = hash_operation(hashes, group->getOutputOperation());
+	if (!operation_hash.second) {
+		return false;
+	}
+
+	BLI_HashMurmur2A mm2;
+	const char *view_name = context.getViewName();
+
+	BLI_hash_mm2a_init(&mm2, operation_hash.first);
+	BLI_hash_mm2a_add_int(&mm2, context.getFramenumber());
+	BLI_hash_mm2a_add_int(&mm2, context.getQuality());
+	BLI_hash_mm2a_add_int(&mm2, context.isFastCalculation());
+	if (view_name) {
+		BLI_hash_mm2a_add(&mm2, (const unsigned char *)view_name, strlen(view_name));
+	}
+	*r_hash = BLI_hash_mm2a_end(&mm2);
+	return true;
+}
+
+static MemoryBuffer *group_buffer(ExecutionGroup *group)
+{
+	WriteBufferOperation *operation = (WriteBufferOperation *)group->getOutputOperation();
+	return operation->getMemoryProxy()->getBuffer();
+}
+
+/* call with s_mutex locked */
+static ResultCacheEntries::iterator entry_find(unsigned int hash, MemoryBuffer *buffer)
+{
+	for (ResultCacheEntries::iterator it = s_entries.begin(); it != s_entries.end(); ++it) {
+		if (it->hash == hash &&
+		    it->width == buffer->getWidth() &&
+		    it->height == buffer->getHeight() &&
+		    it->num_channels == (int)buffer->get_num_channels())
+		{
+			/* move to front */
+			s_entries.splice(s_entries.begin(), s_entries, it);
+			return s_entries.begin();
+		}
+	}
+	return s_entries.end();
+}
+
+/* call with s_mutex locked */
+static void entries_limit(size_t max_size)
+{
+	while (s_size > max_size && !s_entries.empty()) {
+		ResultCacheEntry &entry = s_entries.back();
+		s_size -= entry.size;
+		MEM_freeN(entry.buffer);
+		s_entries.pop_back();
+	}
+}
+
+unsigned int ResultCache::restoreGroups(const CompositorContext &context, Groups &groups)
+{
+	OperationHashes hashes;
+	unsigned int generation;
+
+	BLI_mutex_lock(&s_mutex);
+	generation = s_generation;
+	for (Groups::iterator it = groups.begin(); it != groups.end(); ++it) {
+		ExecutionGroup *group = *it;
+		unsigned int hash;
+
+		if (!hash_group(context, hashes, group, &hash)) {
+			continue;
+		}
+
+		MemoryBuffer *buffer = group_buffer(group);
+		ResultCacheEntries::iterator entry = entry_find(hash, buffer);
+		if (entry != s_entries.end()) {
+			memcpy(buffer->getBuffer(), entry->buffer, entry->size);
+			group->setExecuted();
+		}
+	}
+	BLI_mutex_unlock(&s_mutex);
+
+	return generation;
+}
+
+void ResultCache::storeGroups(const CompositorContext &context, Groups &groups, unsigned int generation)
+{
+	OperationHashes hashes;
+
+	BLI_mutex_lock(&s_mutex);
+	if (generation != s_generation) {
+		BLI_mutex_unlock(&s_mutex);
+		return;
+	}
+
+	for (Groups::iterator it = groups.begin(); it != groups.end(); ++it) {
+		ExecutionGroup *group = *it;
+		unsigned int hash;
+
+		/* canceled or only partially executed (viewer border) */
+		if (!group->isExecuted() || !hash_group(context, hashes, group, &hash)) {
+			continue;
+		}
+
+		MemoryBuffer *buffer = group_buffer(group);
+		if (entry_find(hash, buffer) != s_entries.end()) {
+			continue;
+		}
+
+		ResultCacheEntry entry;
+		entry.hash = hash;
+		entry.width = buffer->getWidth();
+		entry.height = buffer->getHeight();
+		entry.num_channels = buffer->get_num_channels();
+		entry.size = sizeof(float) * entry.width * entry.height * entry.num_channels;
+		if (entry.size > COM_RESULT_CACHE_SIZE) {
+			continue;
+		}
+
+		entries_limit(COM_RESULT_CACHE_SIZE - entry.size);
+		entry.buffer = (float *)MEM_mallocN(entry.size, "COM ResultCacheEntry");
+		memcpy(entry.buffer, buffer->getBuffer(), entry.size);
+		s_entries.push_front(entry);
+		s_size += entry.size;
+	}
+	BLI_mutex_unlock(&s_mutex);
+}
+
+void ResultCache::clear()
+{
+	BLI_mutex_lock(&s_mutex);
+	entries_limit(0);
+	s_generation++;
+	BLI_mutex_unlock(&s_mutex);
+}
@@ -0,0 +1,72 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _COM_ResultCache_h_
+#define _COM_ResultCache_h_
+
+#include <vector>
+
+#include "COM_CompositorContext.h"
+#include "COM_ExecutionGroup.h"
+#include "COM_NodeOperation.h"
+
+struct bNode;
+
+/**
+ * @brief Cache of the results of complex execution groups between executions.
+ *
+ * Every operation gets a hash of the node settings it was created from
+ * (see NodeOperationBuilder). The result hash of a group combines these
+ * with the hashes of all operations it depends on, so a tweak to a node
+ * only changes the hashes of the groups downstream of that node.
+ * Groups of complex operations (blurs, defocus, vector blur ...) store their
+ * buffers in a size limited cache, and their chunks are not executed again
+ * as long as an execution asks for the same hash.
+ *
+ * @ingroup Execution
+ */
+class ResultCache {
+public:
+	typedef std::vector<ExecutionGroup *> Groups;
+
+	/**
+	 * @brief hash the settings of a node
+	 * @param r_cacheable set to false when the output of the node depends on
+	 * data that can change without the node tree changing (images, movie clips ...)
+	 */
+	static unsigned int hashNode(const CompositorContext &context, bNode *node, bool *r_cacheable);
+
+	/**
+	 * @brief fill the buffers of all cached groups and tag their chunks as executed
+	 * @note call after ExecutionGroup.initExecution
+	 * @return generation of the cache, to pass to storeGroups
+	 */
+	static unsigned int restoreGroups(const CompositorContext &context, Groups &groups);
+
+	/**
+	 * @brief store the buffers of fully executed complex groups
+	 * @note call before the write buffer operations are deinitialized
+	 */
+	static void storeGroups(const CompositorContext &context, Groups &groups, unsigned int generation);
+
+	/**
+	 * @brief free all cached results
+	 * results of executions that were running during the clear are not stored
+	 */
+	static void clear();
+};
+
+#endif /* _COM_ResultCache_h_ */
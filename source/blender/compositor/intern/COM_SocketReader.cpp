@@ -20,6 +20,20 @@
  *		Monique Dewanchand
  */
 
+#include <string.h>
+
 #include "COM_SocketReader.h"
 
 
+
+void SocketReader::executeRow(float *output, int x, int y, int width, int num_channels)
+{
+	float color[4];
+	int i;
+
+	for (i = 0; i < width; i++) {
+		executePixelSampled(color, x + i, y, COM_PS_NEAREST);
+		memcpy(output, color, sizeof(float) * num_channels);
+		output += num_channels;
+	}
+}
@@ -95,6 +95,19 @@ protected:
 	                                  float /*x*/, float /*y*/,
 	                                  float /*dx*/[2], float /*dy*/[2]) {}
 
+	/**
+	 * @brief calculate a horizontal span of pixels
+	 * @note this method is called for non-complex, operations with a point-wise
+	 * kernel override it to process the whole span in one call.
+	 * The default implementation calls executePixelSampled for every pixel.
+	 * @param output array of width * num_channels floats to store the result
+	 * @param x the x-coordinate of the first pixel in image space
+	 * @param y the y-coordinate of the span in image space
+	 * @param width number of pixels in the span, at most COM_ROW_MAX_WIDTH
+	 * @param num_channels number of channels per pixel in output
+	 */
+	virtual void executeRow(float *output, int x, int y, int width, int num_channels);
+
 public:
 	inline void readSampled(float result[4], float x, float y, PixelSampler sampler) {
 		executePixelSampled(result, x, y, sampler);
@@ -105,6 +118,9 @@ public:
 	inline void readFiltered(float result[4], float x, float y, float dx[2], float dy[2]) {
 		executePixelFiltered(result, x, y, dx, dy);
 	}
+	inline void readRow(float *result, int x, int y, int width, int num_channels) {
+		executeRow(result, x, y, width, num_channels);
+	}
 
 	virtual void *initializeTileData(rcti * /*rect*/) { return 0; }
 	virtual void deinitializeTileData(rcti * /*rect*/, void * /*data*/) {}
@@ -38,6 +38,35 @@ BlurNode::BlurNode(bNode *editorNode) : Node(editorNode)
 	/* pass */
 }
 
+/* Largest blur size in pixels, the input resolution is not known yet,
+ * relative sizes are estimated from the render resolution. */
+static float blur_node_size(const NodeBlurData *data, float size, const CompositorContext &context)
+{
+	float sizex = data->sizex, sizey = data->sizey;
+
+	if (data->relative) {
+		const RenderData *rd = context.getRenderData();
+		const float width = rd ? rd->xsch * rd->size / 100.0f : 0.0f;
+		const float height = rd ? rd->ysch * rd->size / 100.0f : 0.0f;
+		switch (data->aspect) {
+			case CMP_NODE_BLUR_ASPECT_NONE:
+				sizex = data->percentx * 0.01f * width;
+				sizey = data->percenty * 0.01f * height;
+				break;
+			case CMP_NODE_BLUR_ASPECT_Y:
+				sizex = data->percentx * 0.01f * width;
+				sizey = data->percenty * 0.01f * width;
+				break;
+			case CMP_NODE_BLUR_ASPECT_X:
+				sizex = data->percentx * 0.01f * height;
+				sizey = data->percenty * 0.01f * height;
+				break;
+		}
+	}
+
+	return max_ff(sizex, sizey) * size;
+}
+
 void BlurNode::convertToOperations(NodeConverter &converter, const CompositorContext &context) const
 {
 	bNode *editorNode = this->getbNode();
@@ -106,6 +135,22 @@ void BlurNode::convertToOperations(NodeConverter &converter, const CompositorCon
 		output_operation = operation;
 		input_operation = operation;
 	}
+	else if (!connectedSizeSocket && FastGaussianBlurOperation::canApproximate(data->filtertype) &&
+	         blur_node_size(data, size, context) >= (data->bokeh ? COM_BLUR_BOKEH_FAST_SIZE : COM_BLUR_FAST_SIZE))
+	{
+		/* large kernel, approximated at a constant cost per pixel */
+		FastGaussianBlurOperation *operationfgb = new FastGaussianBlurOperation();
+		operationfgb->setData(data);
+		operationfgb->setFilter(data->filtertype, data->bokeh);
+		operationfgb->setSize(size);
+		operationfgb->setExtendBounds(extend_bounds);
+		converter.addOperation(operationfgb);
+
+		converter.mapInputSocket(getInputSocket(1), operationfgb->getInputSocket(1));
+
+		input_operation = operationfgb;
+		output_operation = operationfgb;
+	}
 	else if (!data->bokeh) {
 		GaussianXBlurOperation *operationx = new GaussianXBlurOperation();
 		operationx->setData(data);
@@ -58,6 +58,16 @@ void ConvertValueToColorOperation::executePixelSampled(float output[4], float x,
 	output[3] = 1.0f;
 }
 
+void ConvertValueToColorOperation::executeRow(float *output, int x, int y, int width, int num_channels)
+{
+	float values[COM_ROW_MAX_WIDTH];
+	this->m_inputOperation->readRow(values, x, y, width, COM_NUM_CHANNELS_VALUE);
+	for (int i = 0; i < width; i++, output += num_channels) {
+		output[0] = output[1] = output[2] = values[i];
+		output[3] = 1.0f;
+	}
+}
+
 
 /* ******** Color to Value ******** */
 
@@ -74,6 +84,16 @@ void ConvertColorToValueOperation::executePixelSampled(float output[4], float x,
 	output[0] = (inputColor[0] + inputColor[1] + inputColor[2]) / 3.0f;
 }
 
+void ConvertColorToValueOperation::executeRow(float *output, int x, int y, int width, int num_channels)
+{
+	float colors[COM_ROW_MAX_WIDTH * COM_NUM_CHANNELS_COLOR];
+	const float *color = colors;
+	this->m_inputOperation->readRow(colors, x, y, width, COM_NUM_CHANNELS_COLOR);
+	for (int i = 0; i < width; i++, output += num_channels, color += COM_NUM_CHANNELS_COLOR) {
+		output[0] = (color[0] + color[1] + color[2]) / 3.0f;
+	}
+}
+
 
 /* ******** Color to BW ******** */
 
@@ -90,6 +110,16 @@ void ConvertColorToBWOperation::executePixelSampled(float output[4], float x, fl
 	output[0] = IMB_colormanagement_get_luminance(inputColor);
 }
 
+void ConvertColorToBWOperation::executeRow(float *output, int x, int y, int width, int num_channels)
+{
+	float colors[COM_ROW_MAX_WIDTH * COM_NUM_CHANNELS_COLOR];
+	const float *color = colors;
+	this->m_inputOperation->readRow(colors, x, y, width, COM_NUM_CHANNELS_COLOR);
+	for (int i = 0; i < width; i++, output += num_channels, color += COM_NUM_CHANNELS_COLOR) {
+		output[0] = IMB_colormanagement_get_luminance(color);
+	}
+}
+
 
 /* ******** Color to Vector ******** */
 
@@ -105,6 +135,16 @@ void ConvertColorToVectorOperation::executePixelSampled(float output[4], float x
 	this->m_inputOperation->readSampled(color, x, y, sampler);
 	copy_v3_v3(output, color);}
 
+void ConvertColorToVectorOperation::executeRow(float *output, int x, int y, int width, int num_channels)
+{
+	float colors[COM_ROW_MAX_WIDTH * COM_NUM_CHANNELS_COLOR];
+	const float *color = colors;
+	this->m_inputOperation->readRow(colors, x, y, width, COM_NUM_CHANNELS_COLOR);
+	for (int i = 0; i < width; i++, output += num_channels, color += COM_NUM_CHANNELS_COLOR) {
+		copy_v3_v3(output, color);
+	}
+}
+
 
 /* ******** Value to Vector ******** */
 
@@ -121,6 +161,15 @@ void ConvertValueToVectorOperation::executePixelSampled(float output[4], float x
 	output[0] = output[1] = output[2] = value;
 }
 
+void ConvertValueToVectorOperation::executeRow(float *output, int x, int y, int width, int num_channels)
+{
+	float values[COM_ROW_MAX_WIDTH];
+	this->m_inputOperation->readRow(values, x, y, width, COM_NUM_CHANNELS_VALUE);
+	for (int i = 0; i < width; i++, output += num_channels) {
+		output[0] = output[1] = output[2] = values[i];
+	}
+}
+
 
 /* ******** Vector to Color ******** */
 
@@ -136,6 +185,17 @@ void ConvertVectorToColorOperation::executePixelSampled(float output[4], float x
 	output[3] = 1.0f;
 }
 
+void ConvertVectorToColorOperation::executeRow(float *output, int x, int y, int width, int num_channels)
+{
+	float vectors[COM_ROW_MAX_WIDTH * COM_NUM_CHANNELS_VECTOR];
+	const float *vector = vectors;
+	this->m_inputOperation->readRow(vectors, x, y, width, COM_NUM_CHANNELS_VECTOR);
+	for (int i = 0; i < width; i++, output += num_channels, vector += COM_NUM_CHANNELS_VECTOR) {
+		copy_v3_v3(output, vector);
+		output[3] = 1.0f;
+	}
+}
+
 
 /* ******** Vector to Value ******** */
 
@@ -20,15 +20,26 @@
  *		Monique Dewanchand
  */
 
-#include <limits.h>
-
 #include "COM_FastGaussianBlurOperation.h"
 #include "MEM_guardedalloc.h"
 #include "BLI_utildefines.h"
+#include "BLI_math.h"
+#include "BLI_task.h"
+
+extern "C" {
+#  include "RE_pipeline.h"
+}
+
+/* number of lines of a channel filtered by one task */
+#define FAST_BLUR_LINES_PER_TASK 16
 
 FastGaussianBlurOperation::FastGaussianBlurOperation() : BlurBaseOperation(COM_DT_COLOR)
 {
 	this->m_iirgaus = NULL;
+	this->m_sigma_factor = 0.5f;
+	this->m_use_box = false;
+	this->m_clamp_size = false;
+	this->m_clip = false;
 }
 
 void FastGaussianBlurOperation::executePixel(float output[4], int x, int y, void *data)
@@ -88,21 +99,30 @@ void *FastGaussianBlurOperation::initializeTileData(rcti *rect)
 		updateSize();
 
 		int c;
-		this->m_sx = this->m_data.sizex * this->m_size / 2.0f;
-		this->m_sy = this->m_data.sizey * this->m_size / 2.0f;
-		
+		float sizex = this->m_data.sizex * this->m_size;
+		float sizey = this->m_data.sizey * this->m_size;
+		if (this->m_clamp_size) {
+			CLAMP(sizex, 0.0f, this->getWidth() / 2.0f);
+			CLAMP(sizey, 0.0f, this->getHeight() / 2.0f);
+		}
+		this->m_sx = sizex * this->m_sigma_factor;
+		this->m_sy = sizey * this->m_sigma_factor;
+
+		void (*blur)(MemoryBuffer *src, float sigma, unsigned int channel, unsigned int xy, bool clip);
+		blur = this->m_use_box ? box_cascade : IIR_gauss;
+
 		if ((this->m_sx == this->m_sy) && (this->m_sx > 0.0f)) {
 			for (c = 0; c < COM_NUM_CHANNELS_COLOR; ++c)
-				IIR_gauss(copy, this->m_sx, c, 3);
+				blur(copy, this->m_sx, c, 3, this->m_clip);
 		}
 		else {
 			if (this->m_sx > 0.0f) {
 				for (c = 0; c < COM_NUM_CHANNELS_COLOR; ++c)
-					IIR_gauss(copy, this->m_sx, c, 1);
+					blur(copy, this->m_sx, c, 1, this->m_clip);
 			}
 			if (this->m_sy > 0.0f) {
 				for (c = 0; c < COM_NUM_CHANNELS_COLOR; ++c)
-					IIR_gauss(copy, this->m_sy, c, 2);
+					blur(copy, this->m_sy, c, 2, this->m_clip);
 			}
 		}
 		this->m_iirgaus = copy;
@@ -111,28 +131,223 @@ void *FastGaussianBlurOperation::initializeTileData(rcti *rect)
 	return this->m_iirgaus;
 }
 
-void FastGaussianBlurOperation::IIR_gauss(MemoryBuffer *src, float sigma, unsigned int chan, unsigned int xy)
+bool FastGaussianBlurOperation::canApproximate(int filtertype)
 {
-	double q, q2, sc, cf[4], tsM[9], tsu[3], tsv[3];
-	double *X, *Y, *W;
-	const unsigned int src_width = src->getWidth();
-	const unsigned int src_height = src->getHeight();
-	unsigned int x, y, sz;
+	/* box keeps its hard edged bokeh, mitchell and catmull-rom their negative lobes */
+	switch (filtertype) {
+		case R_FILTER_GAUSS:
+		case R_FILTER_TENT:
+		case R_FILTER_QUAD:
+		case R_FILTER_CUBIC:
+			return true;
+		default:
+			return false;
+	}
+}
+
+void FastGaussianBlurOperation::setFilter(int filtertype, bool bokeh)
+{
+	/* standard deviation along one axis of the kernel for a blur size of one pixel */
+	const int steps = 1024;
+	double sum = 0.0, sum_sq = 0.0;
+	for (int i = 0; i < steps; i++) {
+		const double x = (i + 0.5) / steps;
+		const double f = RE_filter_value(filtertype, (float)x);
+		if (bokeh) {
+			/* radial kernel, the variance along one axis is half the radial one */
+			sum += f * x;
+			sum_sq += f * x * x * x * 0.5;
+		}
+		else {
+			sum += f;
+			sum_sq += f * x * x;
+		}
+	}
+
+	this->m_sigma_factor = (sum > 0.0) ? (float)sqrt(sum_sq / sum) : 0.0f;
+	this->m_use_box = (filtertype != R_FILTER_GAUSS);
+	this->m_clamp_size = bokeh;
+	this->m_clip = true;
+}
+
+struct FastBlurLines;
+typedef void (*FastBlurLineFunc)(const FastBlurLines *data, double *line, double *temp, const int length);
+
+typedef struct FastBlurLines {
+	float *buffer;
+	/* pixels in a line and number of lines */
+	unsigned int length;
+	unsigned int lines;
+	/* offsets in floats between pixels of a line and between lines */
+	unsigned int pixel_stride;
+	unsigned int line_stride;
+
+	/* filter a line in place, temp holds two lines */
+	FastBlurLineFunc filter_line;
+	/* leave pixels outside the line out of the kernel, instead of repeating the border pixels */
+	bool clip;
+	/* for clip, zero pixels on both sides of a line, for filters that do not
+	 * include the pixels outside the line in their intermediate results */
+	unsigned int pad;
+	/* for clip, inverse of the kernel weights inside the line */
+	double *norm;
+
+	/* recursive gaussian coefficients */
+	double cf[4];
+	double tsM[9];
+
+	/* box cascade radii */
+	int radius[3];
+} FastBlurLines;
+
+static void fast_blur_lines_task(void *userdata, const int iter)
+{
+	const FastBlurLines *data = (const FastBlurLines *)userdata;
+	const unsigned int L = data->length;
+	const unsigned int pad = data->pad;
+	const unsigned int first = iter * FAST_BLUR_LINES_PER_TASK;
+	const unsigned int last = min(first + FAST_BLUR_LINES_PER_TASK, data->lines);
+	unsigned int line, i;
+
+	// intermediate buffers
+	double *X_pad = (double *)MEM_mallocN(3 * (L + 2 * pad) * sizeof(double), "fast blur line");
+	double *temp = X_pad + L + 2 * pad;
+	double *X = X_pad + pad;
+
+	for (line = first; line < last; line++) {
+		float *pixel = data->buffer + line * data->line_stride;
+		for (i = 0; i < L; i++) {
+			X[i] = pixel[i * data->pixel_stride];
+		}
+		if (pad) {
+			memset(X_pad, 0, pad * sizeof(double));
+			memset(X + L, 0, pad * sizeof(double));
+		}
+		data->filter_line(data, X_pad, temp, L + 2 * pad);
+		if (data->norm) {
+			for (i = 0; i < L; i++) {
+				X[i] *= data->norm[i];
+			}
+		}
+		for (i = 0; i < L; i++) {
+			pixel[i * data->pixel_stride] = X[i];
+		}
+	}
+
+	MEM_freeN(X_pad);
+}
+
+static void fast_blur_run(FastBlurLines *data)
+{
+	const unsigned int L = data->length;
+	const unsigned int ext = data->length + 2 * data->pad;
 	unsigned int i;
-	float *buffer = src->getBuffer();
+
+	data->norm = NULL;
+	if (data->clip) {
+		/* the filtered line of ones is the weight of the kernel inside the line */
+		double *norm_pad = (double *)MEM_callocN(3 * ext * sizeof(double), "fast blur norm");
+		for (i = 0; i < L; i++) {
+			norm_pad[data->pad + i] = 1.0;
+		}
+		data->filter_line(data, norm_pad, norm_pad + ext, ext);
+		data->norm = (double *)MEM_mallocN(L * sizeof(double), "fast blur norm");
+		for (i = 0; i < L; i++) {
+			const double weight = norm_pad[data->pad + i];
+			data->norm[i] = (weight > 0.0) ? 1.0 / weight : 0.0;
+		}
+		MEM_freeN(norm_pad);
+	}
+
+	BLI_task_parallel_range(0, (data->lines + FAST_BLUR_LINES_PER_TASK - 1) / FAST_BLUR_LINES_PER_TASK,
+	                        data, fast_blur_lines_task, data->lines > FAST_BLUR_LINES_PER_TASK);
+
+	if (data->norm) {
+		MEM_freeN(data->norm);
+		data->norm = NULL;
+	}
+}
+
+/* filter all lines of a channel, along x for xy & 1 and along y for xy & 2 */
+static void fast_blur_lines(MemoryBuffer *src, unsigned int chan, unsigned int xy, FastBlurLines *data)
+{
+	const unsigned int width = src->getWidth();
+	const unsigned int height = src->getHeight();
 	const unsigned int num_channels = src->get_num_channels();
+
+	data->buffer = src->getBuffer() + chan;
+
+	if (xy & 1) {   // H
+		data->length = width;
+		data->lines = height;
+		data->pixel_stride = num_channels;
+		data->line_stride = width * num_channels;
+		fast_blur_run(data);
+	}
+	if (xy & 2) {   // V
+		data->length = height;
+		data->lines = width;
+		data->pixel_stride = width * num_channels;
+		data->line_stride = num_channels;
+		fast_blur_run(data);
+	}
+}
+
+/* filters X in place, border values are X[0] and X[L - 1], or zero for clip */
+static void YVV(const double cf[4], const double tsM[9], double *X, double *W, const int L, const bool clip)
+{
+	const double x_first = clip ? 0.0 : X[0];
+	const double x_last = clip ? 0.0 : X[L - 1];
+	double tsu[3], tsv[3];
+	double *Y = X; /* X is not read after the forward pass */
+	int i;
+
+	W[0] = cf[0] * X[0] + cf[1] * x_first + cf[2] * x_first + cf[3] * x_first;
+	W[1] = cf[0] * X[1] + cf[1] * W[0] + cf[2] * x_first + cf[3] * x_first;
+	W[2] = cf[0] * X[2] + cf[1] * W[1] + cf[2] * W[0] + cf[3] * x_first;
+	for (i = 3; i < L; i++) {
+		W[i] = cf[0] * X[i] + cf[1] * W[i - 1] + cf[2] * W[i - 2] + cf[3] * W[i - 3];
+	}
+	tsu[0] = W[L - 1] - x_last;
+	tsu[1] = W[L - 2] - x_last;
+	tsu[2] = W[L - 3] - x_last;
+	tsv[0] = tsM[0] * tsu[0] + tsM[1] * tsu[1] + tsM[2] * tsu[2] + x_last;
+	tsv[1] = tsM[3] * tsu[0] + tsM[4] * tsu[1] + tsM[5] * tsu[2] + x_last;
+	tsv[2] = tsM[6] * tsu[0] + tsM[7] * tsu[1] + tsM[8] * tsu[2] + x_last;
+	Y[L - 1] = cf[0] * W[L - 1] + cf[1] * tsv[0] + cf[2] * tsv[1] + cf[3] * tsv[2];
+	Y[L - 2] = cf[0] * W[L - 2] + cf[1] * Y[L - 1] + cf[2] * tsv[0] + cf[3] * tsv[1];
+	Y[L - 3] = cf[0] * W[L - 3] + cf[1] * Y[L - 2] + cf[2] * Y[L - 1] + cf[3] * tsv[0];
+	for (i = L - 4; i >= 0; i--) {
+		Y[i] = cf[0] * W[i] + cf[1] * Y[i + 1] + cf[2] * Y[i + 2] + cf[3] * Y[i + 3];
+	}
+}
+
+static void IIR_gauss_line(const FastBlurLines *data, double *line, double *temp, const int length)
+{
+	YVV(data->cf, data->tsM, line, temp, length, data->clip);
+}
+
+void FastGaussianBlurOperation::IIR_gauss(MemoryBuffer *src, float sigma, unsigned int chan, unsigned int xy, bool clip)
+{
+	double q, q2, sc, *cf, *tsM;
+	FastBlurLines data;
+	const unsigned int src_width = src->getWidth();
+	const unsigned int src_height = src->getHeight();
 	
 	// <0.5 not valid, though can have a possibly useful sort of sharpening effect
 	if (sigma < 0.5f) return;
 	
 	if ((xy < 1) || (xy > 3)) xy = 3;
 	
-	// XXX The YVV macro defined below explicitly expects sources of at least 3x3 pixels,
+	// XXX YVV explicitly expects sources of at least 3x3 pixels,
 	//     so just skiping blur along faulty direction if src's def is below that limit!
 	if (src_width < 3) xy &= ~1;
 	if (src_height < 3) xy &= ~2;
 	if (xy < 1) return;
 	
+	cf = data.cf;
+	tsM = data.tsM;
+
 	// see "Recursive Gabor Filtering" by Young/VanVliet
 	// all factors here in double.prec. Required, because for single.prec it seems to blow up if sigma > ~200
 	if (sigma >= 3.556f)
@@ -167,75 +382,78 @@ void FastGaussianBlurOperation::IIR_gauss(MemoryBuffer *src, float sigma, unsign
 	tsM[7] = sc * (cf[1] * cf[2] + cf[3] * cf[2] * cf[2] - cf[1] * cf[3] * cf[3] - cf[3] * cf[3] * cf[3] - cf[3] * cf[2] + cf[3]);
 	tsM[8] = sc * (cf[3] * (cf[1] + cf[3] * cf[2]));
 	
-#define YVV(L)                                                                          \
-{                                                                                       \
-	W[0] = cf[0] * X[0] + cf[1] * X[0] + cf[2] * X[0] + cf[3] * X[0];                   \
-	W[1] = cf[0] * X[1] + cf[1] * W[0] + cf[2] * X[0] + cf[3] * X[0];                   \
-	W[2] = cf[0] * X[2] + cf[1] * W[1] + cf[2] * W[0] + cf[3] * X[0];                   \
-	for (i = 3; i < L; i++) {                                                           \
-		W[i] = cf[0] * X[i] + cf[1] * W[i - 1] + cf[2] * W[i - 2] + cf[3] * W[i - 3];   \
-	}                                                                                   \
-	tsu[0] = W[L - 1] - X[L - 1];                                                       \
-	tsu[1] = W[L - 2] - X[L - 1];                                                       \
-	tsu[2] = W[L - 3] - X[L - 1];                                                       \
-	tsv[0] = tsM[0] * tsu[0] + tsM[1] * tsu[1] + tsM[2] * tsu[2] + X[L - 1];            \
-	tsv[1] = tsM[3] * tsu[0] + tsM[4] * tsu[1] + tsM[5] * tsu[2] + X[L - 1];            \
-	tsv[2] = tsM[6] * tsu[0] + tsM[7] * tsu[1] + tsM[8] * tsu[2] + X[L - 1];            \
-	Y[L - 1] = cf[0] * W[L - 1] + cf[1] * tsv[0] + cf[2] * tsv[1] + cf[3] * tsv[2];     \
-	Y[L - 2] = cf[0] * W[L - 2] + cf[1] * Y[L - 1] + cf[2] * tsv[0] + cf[3] * tsv[1];   \
-	Y[L - 3] = cf[0] * W[L - 3] + cf[1] * Y[L - 2] + cf[2] * Y[L - 1] + cf[3] * tsv[0]; \
-	/* 'i != UINT_MAX' is really 'i >= 0', but necessary for unsigned int wrapping */   \
-	for (i = L - 4; i != UINT_MAX; i--) {                                               \
-		Y[i] = cf[0] * W[i] + cf[1] * Y[i + 1] + cf[2] * Y[i + 2] + cf[3] * Y[i + 3];   \
-	}                                                                                   \
-} (void)0
-	
-	// intermediate buffers
-	sz = max(src_width, src_height);
-	X = (double *)MEM_callocN(sz * sizeof(double), "IIR_gauss X buf");
-	Y = (double *)MEM_callocN(sz * sizeof(double), "IIR_gauss Y buf");
-	W = (double *)MEM_callocN(sz * sizeof(double), "IIR_gauss W buf");
-	if (xy & 1) {   // H
-		int offset;
-		for (y = 0; y < src_height; ++y) {
-			const int yx = y * src_width;
-			offset = yx * num_channels + chan;
-			for (x = 0; x < src_width; ++x) {
-				X[x] = buffer[offset];
-				offset += num_channels;
-			}
-			YVV(src_width);
-			offset = yx * num_channels + chan;
-			for (x = 0; x < src_width; ++x) {
-				buffer[offset] = Y[x];
-				offset += num_channels;
-			}
+	data.filter_line = IIR_gauss_line;
+	data.clip = clip;
+	/* the recursive filter carries on past the end of the line by itself */
+	data.pad = 0;
+	fast_blur_lines(src, chan, xy, &data);
+}
+
+/* running sum box blur of radius r */
+static void box_blur(const double *X, double *Y, const int L, const int r, const bool clip)
+{
+	const double fac = 1.0 / (2 * r + 1);
+	double sum = 0.0;
+	int i;
+
+	if (clip) {
+		for (i = 0; i <= r && i < L; i++) {
+			sum += X[i];
+		}
+		for (i = 0; i < L; i++) {
+			Y[i] = sum * fac;
+			if (i + r + 1 < L) sum += X[i + r + 1];
+			if (i - r >= 0) sum -= X[i - r];
 		}
 	}
-	if (xy & 2) {   // V
-		int offset;
-		const int add = src_width * num_channels;
-
-		for (x = 0; x < src_width; ++x) {
-			offset = x * num_channels + chan;
-			for (y = 0; y < src_height; ++y) {
-				X[y] = buffer[offset];
-				offset += add;
-			}
-			YVV(src_height);
-			offset = x * num_channels + chan;
-			for (y = 0; y < src_height; ++y) {
-				buffer[offset] = Y[y];
-				offset += add;
-			}
+	else {
+		sum = X[0] * (r + 1);
+		for (i = 1; i <= r; i++) {
+			sum += X[min_ii(i, L - 1)];
+		}
+		for (i = 0; i < L; i++) {
+			Y[i] = sum * fac;
+			sum += X[min_ii(i + r + 1, L - 1)] - X[max_ii(i - r, 0)];
 		}
 	}
-	
-	MEM_freeN(X);
-	MEM_freeN(W);
-	MEM_freeN(Y);
-#undef YVV
-	
+}
+
+static void box_cascade_line(const FastBlurLines *data, double *line, double *temp, const int L)
+{
+	box_blur(line, temp, L, data->radius[0], data->clip);
+	box_blur(temp, temp + L, L, data->radius[1], data->clip);
+	box_blur(temp + L, line, L, data->radius[2], data->clip);
+}
+
+/* Approximates a gaussian, or any other bell shaped kernel with the same
+ * standard deviation, by three box blurs. The box widths are picked so
+ * their combined variance matches sigma, see "Fast Almost-Gaussian
+ * Filtering" by Kovesi. Cost per pixel does not depend on sigma. */
+void FastGaussianBlurOperation::box_cascade(MemoryBuffer *src, float sigma, unsigned int chan, unsigned int xy, bool clip)
+{
+	FastBlurLines data;
+	const int n = 3;
+	const float var12 = 12.0f * sigma * sigma;
+	int wl, wu, m, i;
+
+	if (sigma < 0.5f) return;
+
+	if ((xy < 1) || (xy > 3)) xy = 3;
+
+	/* odd widths around the ideal one, the first m boxes use the smaller width */
+	wl = (int)sqrtf(var12 / n + 1.0f);
+	if (wl % 2 == 0) wl--;
+	wu = wl + 2;
+	m = iroundf((var12 - n * wl * wl - 4 * n * wl - 3 * n) / (-4 * wl - 4));
+	for (i = 0; i < n; i++) {
+		data.radius[i] = ((i < m ? wl : wu) - 1) / 2;
+	}
+
+	data.filter_line = box_cascade_line;
+	data.clip = clip;
+	/* room for the results of the first boxes outside the line */
+	data.pad = clip ? data.radius[0] + data.radius[1] : 0;
+	fast_blur_lines(src, chan, xy, &data);
 }
 
 
@@ -31,15 +31,46 @@ private:
 	float m_sx;
 	float m_sy;
 	MemoryBuffer *m_iirgaus;
+
+	/**
+	 * sigma per pixel of blur size, 0.5 for the fast gaussian filter type,
+	 * matches the kernel of m_data.filtertype when used by setFilter.
+	 */
+	float m_sigma_factor;
+	/** approximate with a box cascade instead of the recursive gaussian */
+	bool m_use_box;
+	/** limit the size to half the image, as the bokeh kernel does */
+	bool m_clamp_size;
+	/** leave pixels outside the image out of the kernel, as the other blurs do */
+	bool m_clip;
 public:
 	FastGaussianBlurOperation();
 	bool determineDependingAreaOfInterest(rcti *input, ReadBufferOperation *readOperation, rcti *output);
 	void executePixel(float output[4], int x, int y, void *data);
 	
-	static void IIR_gauss(MemoryBuffer *src, float sigma, unsigned int channel, unsigned int xy);
+	/**
+	 * @brief blur a channel of src in place
+	 * @param xy 1: along x, 2: along y, 3: both
+	 * @param clip leave pixels outside src out of the kernel, instead of repeating the border pixels
+	 */
+	static void IIR_gauss(MemoryBuffer *src, float sigma, unsigned int channel, unsigned int xy, bool clip = false);
+	static void box_cascade(MemoryBuffer *src, float sigma, unsigned int channel, unsigned int xy, bool clip = false);
 	void *initializeTileData(rcti *rect);
 	void deinitExecution();
 	void initExecution();
+
+	/**
+	 * @brief check if the kernel of a filter type can be replaced by this operation
+	 */
+	static bool canApproximate(int filtertype);
+
+	/**
+	 * @brief approximate the kernel of another blur with the same blur size
+	 * @param bokeh match the 2D kernel of GaussianBokehBlurOperation
+	 * instead of the separable kernel of GaussianXBlurOperation and GaussianYBlurOperation
+	 * @see canApproximate
+	 */
+	void setFilter(int filtertype, bool bokeh);
 };
 
 enum {
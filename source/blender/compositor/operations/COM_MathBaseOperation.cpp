@@ -72,6 +72,12 @@ void MathBaseOperation::clampIfNeeded(float *color)
 	}
 }
 
+void MathBaseOperation::readInputRows(float *values1, float *values2, int x, int y, int width)
+{
+	this->m_inputValue1Operation->readRow(values1, x, y, width, COM_NUM_CHANNELS_VALUE);
+	this->m_inputValue2Operation->readRow(values2, x, y, width, COM_NUM_CHANNELS_VALUE);
+}
+
 void MathAddOperation::executePixelSampled(float output[4], float x, float y, PixelSampler sampler)
 {
 	float inputValue1[4];
@@ -85,6 +91,20 @@ void MathAddOperation::executePixelSampled(float output[4], float x, float y, Pi
 	clampIfNeeded(output);
 }
 
+void MathAddOperation::executeRow(float *output, int x, int y, int width, int num_channels)
+{
+	float inputValues1[COM_ROW_MAX_WIDTH];
+	float inputValues2[COM_ROW_MAX_WIDTH];
+
+	readInputRows(inputValues1, inputValues2, x, y, width);
+
+	for (int i = 0; i < width; i++, output += num_channels) {
+		output[0] = inputValues1[i] + inputValues2[i];
+
+		clampIfNeeded(output);
+	}
+}
+
 void MathSubtractOperation::executePixelSampled(float output[4], float x, float y, PixelSampler sampler)
 {
 	float inputValue1[4];
@@ -98,6 +118,20 @@ void MathSubtractOperation::executePixelSampled(float output[4], float x, float
 	clampIfNeeded(output);
 }
 
+void MathSubtractOperation::executeRow(float *output, int x, int y, int width, int num_channels)
+{
+	float inputValues1[COM_ROW_MAX_WIDTH];
+	float inputValues2[COM_ROW_MAX_WIDTH];
+
+	readInputRows(inputValues1, inputValues2, x, y, width);
+
+	for (int i = 0; i < width; i++, output += num_channels) {
+		output[0] = inputValues1[i] - inputValues2[i];
+
+		clampIfNeeded(output);
+	}
+}
+
 void MathMultiplyOperation::executePixelSampled(float output[4], float x, float y, PixelSampler sampler)
 {
 	float inputValue1[4];
@@ -111,6 +145,20 @@ void MathMultiplyOperation::executePixelSampled(float output[4], float x, float
 	clampIfNeeded(output);
 }
 
+void MathMultiplyOperation::executeRow(float *output, int x, int y, int width, int num_channels)
+{
+	float inputValues1[COM_ROW_MAX_WIDTH];
+	float inputValues2[COM_ROW_MAX_WIDTH];
+
+	readInputRows(inputValues1, inputValues2, x, y, width);
+
+	for (int i = 0; i < width; i++, output += num_channels) {
+		output[0] = inputValues1[i] * inputValues2[i];
+
+		clampIfNeeded(output);
+	}
+}
+
 void MathDivideOperation::executePixelSampled(float output[4], float x, float y, PixelSampler sampler)
 {
 	float inputValue1[4];
@@ -69,6 +69,19 @@ void MixBaseOperation::executePixelSampled(float output[4], float x, float y, Pi
 	output[3] = inputColor1[3];
 }
 
+void MixBaseOperation::readInputRows(float *values, float *colors1, float *colors2, int x, int y, int width)
+{
+	this->m_inputValueOperation->readRow(values, x, y, width, COM_NUM_CHANNELS_VALUE);
+	this->m_inputColor1Operation->readRow(colors1, x, y, width, COM_NUM_CHANNELS_COLOR);
+	this->m_inputColor2Operation->readRow(colors2, x, y, width, COM_NUM_CHANNELS_COLOR);
+
+	if (this->useValueAlphaMultiply()) {
+		for (int i = 0; i < width; i++) {
+			values[i] *= colors2[i * COM_NUM_CHANNELS_COLOR + 3];
+		}
+	}
+}
+
 void MixBaseOperation::determineResolution(unsigned int resolution[2], unsigned int preferredResolution[2])
 {
 	NodeOperationInput *socket;
@@ -129,6 +142,27 @@ void MixAddOperation::executePixelSampled(float output[4], float x, float y, Pix
 	clampIfNeeded(output);
 }
 
+void MixAddOperation::executeRow(float *output, int x, int y, int width, int num_channels)
+{
+	float values[COM_ROW_MAX_WIDTH];
+	float colors1[COM_ROW_MAX_WIDTH * COM_NUM_CHANNELS_COLOR];
+	float colors2[COM_ROW_MAX_WIDTH * COM_NUM_CHANNELS_COLOR];
+
+	readInputRows(values, colors1, colors2, x, y, width);
+
+	for (int i = 0; i < width; i++, output += num_channels) {
+		const float *inputColor1 = &colors1[i * COM_NUM_CHANNELS_COLOR];
+		const float *inputColor2 = &colors2[i * COM_NUM_CHANNELS_COLOR];
+		const float value = values[i];
+		output[0] = inputColor1[0] + value * inputColor2[0];
+		output[1] = inputColor1[1] + value * inputColor2[1];
+		output[2] = inputColor1[2] + value * inputColor2[2];
+		output[3] = inputColor1[3];
+
+		clampIfNeeded(output);
+	}
+}
+
 /* ******** Mix Blend Operation ******** */
 
 MixBlendOperation::MixBlendOperation() : MixBaseOperation()
@@ -160,6 +194,28 @@ void MixBlendOperation::executePixelSampled(float output[4], float x, float y, P
 	clampIfNeeded(output);
 }
 
+void MixBlendOperation::executeRow(float *output, int x, int y, int width, int num_channels)
+{
+	float values[COM_ROW_MAX_WIDTH];
+	float colors1[COM_ROW_MAX_WIDTH * COM_NUM_CHANNELS_COLOR];
+	float colors2[COM_ROW_MAX_WIDTH * COM_NUM_CHANNELS_COLOR];
+
+	readInputRows(values, colors1, colors2, x, y, width);
+
+	for (int i = 0; i < width; i++, output += num_channels) {
+		const float *inputColor1 = &colors1[i * COM_NUM_CHANNELS_COLOR];
+		const float *inputColor2 = &colors2[i * COM_NUM_CHANNELS_COLOR];
+		const float value = values[i];
+		const float valuem = 1.0f - value;
+		output[0] = valuem * (inputColor1[0]) + value * (inputColor2[0]);
+		output[1] = valuem * (inputColor1[1]) + value * (inputColor2[1]);
+		output[2] = valuem * (inputColor1[2]) + value * (inputColor2[2]);
+		output[3] = inputColor1[3];
+
+		clampIfNeeded(output);
+	}
+}
+
 /* ******** Mix Burn Operation ******** */
 
 MixBurnOperation::MixBurnOperation() : MixBaseOperation()
@@ -623,6 +679,28 @@ void MixMultiplyOperation::executePixelSampled(float output[4], float x, float y
 	clampIfNeeded(output);
 }
 
+void MixMultiplyOperation::executeRow(float *output, int x, int y, int width, int num_channels)
+{
+	float values[COM_ROW_MAX_WIDTH];
+	float colors1[COM_ROW_MAX_WIDTH * COM_NUM_CHANNELS_COLOR];
+	float colors2[COM_ROW_MAX_WIDTH * COM_NUM_CHANNELS_COLOR];
+
+	readInputRows(values, colors1, colors2, x, y, width);
+
+	for (int i = 0; i < width; i++, output += num_channels) {
+		const float *inputColor1 = &colors1[i * COM_NUM_CHANNELS_COLOR];
+		const float *inputColor2 = &colors2[i * COM_NUM_CHANNELS_COLOR];
+		const float value = values[i];
+		const float valuem = 1.0f - value;
+		output[0] = inputColor1[0] * (valuem + value * inputColor2[0]);
+		output[1] = inputColor1[1] * (valuem + value * inputColor2[1]);
+		output[2] = inputColor1[2] * (valuem + value * inputColor2[2]);
+		output[3] = inputColor1[3];
+
+		clampIfNeeded(output);
+	}
+}
+
 /* ******** Mix Ovelray Operation ******** */
 
 MixOverlayOperation::MixOverlayOperation() : MixBaseOperation()
@@ -740,6 +818,28 @@ void MixScreenOperation::executePixelSampled(float output[4], float x, float y,
 	clampIfNeeded(output);
 }
 
+void MixScreenOperation::executeRow(float *output, int x, int y, int width, int num_channels)
+{
+	float values[COM_ROW_MAX_WIDTH];
+	float colors1[COM_ROW_MAX_WIDTH * COM_NUM_CHANNELS_COLOR];
+	float colors2[COM_ROW_MAX_WIDTH * COM_NUM_CHANNELS_COLOR];
+
+	readInputRows(values, colors1, colors2, x, y, width);
+
+	for (int i = 0; i < width; i++, output += num_channels) {
+		const float *inputColor1 = &colors1[i * COM_NUM_CHANNELS_COLOR];
+		const float *inputColor2 = &colors2[i * COM_NUM_CHANNELS_COLOR];
+		const float value = values[i];
+		const float valuem = 1.0f - value;
+		output[0] = 1.0f - (valuem + value * (1.0f - inputColor2[0])) * (1.0f - inputColor1[0]);
+		output[1] = 1.0f - (valuem + value * (1.0f - inputColor2[1])) * (1.0f - inputColor1[1]);
+		output[2] = 1.0f - (valuem + value * (1.0f - inputColor2[2])) * (1.0f - inputColor1[2]);
+		output[3] = inputColor1[3];
+
+		clampIfNeeded(output);
+	}
+}
+
 /* ******** Mix Soft Light Operation ******** */
 
 MixSoftLightOperation::MixSoftLightOperation() : MixBaseOperation()
@@ -806,6 +906,27 @@ void MixSubtractOperation::executePixelSampled(float output[4], float x, float y
 	clampIfNeeded(output);
 }
 
+void MixSubtractOperation::executeRow(float *output, int x, int y, int width, int num_channels)
+{
+	float values[COM_ROW_MAX_WIDTH];
+	float colors1[COM_ROW_MAX_WIDTH * COM_NUM_CHANNELS_COLOR];
+	float colors2[COM_ROW_MAX_WIDTH * COM_NUM_CHANNELS_COLOR];
+
+	readInputRows(values, colors1, colors2, x, y, width);
+
+	for (int i = 0; i < width; i++, output += num_channels) {
+		const float *inputColor1 = &colors1[i * COM_NUM_CHANNELS_COLOR];
+		const float *inputColor2 = &colors2[i * COM_NUM_CHANNELS_COLOR];
+		const float value = values[i];
+		output[0] = inputColor1[0] - value * (inputColor2[0]);
+		output[1] = inputColor1[1] - value * (inputColor2[1]);
+		output[2] = inputColor1[2] - value * (inputColor2[2]);
+		output[3] = inputColor1[3];
+
+		clampIfNeeded(output);
+	}
+}
+
 /* ******** Mix Value Operation ******** */
 
 MixValueOperation::MixValueOperation() : MixBaseOperation()
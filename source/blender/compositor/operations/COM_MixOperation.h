@@ -50,6 +50,12 @@ protected:
 			CLAMP(color[3], 0.0f, 1.0f);
 		}
 	}
+
+	/**
+	 * Read a span of all inputs for executeRow, values are already
+	 * multiplied by the alpha of color2 when useValueAlphaMultiply is set.
+	 */
+	void readInputRows(float *values, float *colors1, float *colors2, int x, int y, int width);
 	
 public:
 	/**
@@ -84,12 +90,14 @@ class MixAddOperation : public MixBaseOperation {
 public:
 	MixAddOperation();
 	void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+	void executeRow(float *output, int x, int y, int width, int num_channels);
 };
 
 class MixBlendOperation : public MixBaseOperation {
 public:
 	MixBlendOperation();
 	void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+	void executeRow(float *output, int x, int y, int width, int num_channels);
 };
 
 class MixBurnOperation : public MixBaseOperation {
@@ -156,6 +164,7 @@ class MixMultiplyOperation : public MixBaseOperation {
 public:
 	MixMultiplyOperation();
 	void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+	void executeRow(float *output, int x, int y, int width, int num_channels);
 };
 
 class MixOverlayOperation : public MixBaseOperation {
@@ -174,6 +183,7 @@ class MixScreenOperation : public MixBaseOperation {
 public:
 	MixScreenOperation();
 	void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+	void executeRow(float *output, int x, int y, int width, int num_channels);
 };
 
 class MixSoftLightOperation : public MixBaseOperation {
@@ -186,6 +196,7 @@ class MixSubtractOperation : public MixBaseOperation {
 public:
 	MixSubtractOperation();
 	void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+	void executeRow(float *output, int x, int y, int width, int num_channels);
 };
 
 class MixValueOperation : public MixBaseOperation {
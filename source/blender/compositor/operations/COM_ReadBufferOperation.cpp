@@ -74,6 +74,24 @@ void ReadBufferOperation::executePixelSampled(float output[4], float x, float y,
 	}
 }
 
+void ReadBufferOperation::executeRow(float *output, int x, int y, int width, int num_channels)
+{
+	if (m_single_value) {
+		/* write buffer has a single value stored at (0,0) */
+		float value[4];
+		m_buffer->read(value, 0, 0);
+		for (int i = 0; i < width; i++, output += num_channels) {
+			memcpy(output, value, sizeof(float) * num_channels);
+		}
+	}
+	else if (m_buffer->get_num_channels() == num_channels) {
+		m_buffer->readRow(output, x, y, width);
+	}
+	else {
+		NodeOperation::executeRow(output, x, y, width, num_channels);
+	}
+}
+
 void ReadBufferOperation::executePixelExtend(float output[4], float x, float y, PixelSampler sampler,
                                              MemoryBufferExtend extend_x, MemoryBufferExtend extend_y)
 {
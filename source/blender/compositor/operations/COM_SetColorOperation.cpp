@@ -34,6 +34,13 @@ void SetColorOperation::executePixelSampled(float output[4],
 	copy_v4_v4(output, this->m_color);
 }
 
+void SetColorOperation::executeRow(float *output, int /*x*/, int /*y*/, int width, int num_channels)
+{
+	for (int i = 0; i < width; i++, output += num_channels) {
+		memcpy(output, this->m_color, sizeof(float) * num_channels);
+	}
+}
+
 void SetColorOperation::determineResolution(unsigned int resolution[2], unsigned int preferredResolution[2])
 {
 	resolution[0] = preferredResolution[0];
@@ -74,6 +74,12 @@ void WrapOperation::executePixelSampled(float output[4], float x, float y, Pixel
 	executePixelExtend(output, nx, ny, sampler, extend_x, extend_y);
 }
 
+void WrapOperation::executeRow(float *output, int x, int y, int width, int num_channels)
+{
+	/* the buffer is read with wrapping, which the span read of ReadBufferOperation doesn't do */
+	NodeOperation::executeRow(output, x, y, width, num_channels);
+}
+
 bool WrapOperation::determineDependingAreaOfInterest(rcti *input, ReadBufferOperation *readOperation, rcti *output)
 {
 	rcti newInput;
@@ -98,9 +98,11 @@ void WriteBufferOperation::executeRegion(rcti *rect, unsigned int /*tileNumber*/
 		bool breaked = false;
 		for (y = y1; y < y2 && (!breaked); y++) {
 			int offset4 = (y * memoryBuffer->getWidth() + x1) * num_channels;
-			for (x = x1; x < x2; x++) {
-				this->m_input->readSampled(&(buffer[offset4]), x, y, COM_PS_NEAREST);
-				offset4 += num_channels;
+			/* evaluate the input in spans, point-wise operations process them at once */
+			for (x = x1; x < x2; x += COM_ROW_MAX_WIDTH) {
+				const int width = min_ii(COM_ROW_MAX_WIDTH, x2 - x);
+				this->m_input->readRow(&(buffer[offset4]), x, y, width, num_channels);
+				offset4 += width * num_channels;
 			}
 			if (isBreaked()) {
 				breaked = true;
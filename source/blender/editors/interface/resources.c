@@ -2758,6 +2758,14 @@ void init_userdef_do_versions(void)
 		}
 	}
 
+	if (!USER_VERSION_ATLEAST(278, 5)) {
+		U.modcachelimit = 256;
+	}
+
+	if (!USER_VERSION_ATLEAST(278, 6)) {
+		U.sequencer_disk_cache_compression = 1;
+	}
+
 	/**
 	 * Include next version bump.
 	 *
@@ -810,7 +810,16 @@ static void fluidsim_delete_until_lastframe(FluidsimSettings *fss, const char *r
 	char targetDir[FILE_MAX], targetFile[FILE_MAX];
 	char targetDirVel[FILE_MAX], targetFileVel[FILE_MAX];
 	char previewDir[FILE_MAX], previewFile[FILE_MAX];
-	int curFrame = 1, exists = 0;
+	const char *sequences[2] = {OB_FLUIDSIM_SURF_FINAL_SEQ_FNAME, OB_FLUIDSIM_SURF_PREVIEW_SEQ_FNAME};
+	int curFrame = 1, exists = 0, i;
+
+	for (i = 0; i < ARRAY_SIZE(sequences); i++) {
+		BLI_join_dirfile(targetFile, sizeof(targetFile), fss->surfdataPath, sequences[i]);
+		BLI_path_abs(targetFile, relbase);
+
+		BKE_fluidsim_meshseq_forget(targetFile);
+		BLI_delete(targetFile, false, false);
+	}
 
 	BLI_join_dirfile(targetDir,    sizeof(targetDir),    fss->surfdataPath, OB_FLUIDSIM_SURF_FINAL_OBJ_FNAME);
 	BLI_join_dirfile(targetDirVel, sizeof(targetDirVel), fss->surfdataPath, OB_FLUIDSIM_SURF_FINAL_VEL_FNAME);
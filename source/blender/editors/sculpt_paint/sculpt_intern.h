@@ -86,6 +86,7 @@ typedef struct SculptUndoNode {
 	short (*no)[3];
 	float *mask;
 	int totvert;
+	size_t alloc_size;          /* counted in the undo step once added to it */
 
 	/* non-multires */
 	int maxvert;                /* to verify if totvert it still the same */
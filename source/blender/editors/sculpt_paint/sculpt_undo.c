@@ -634,7 +634,7 @@ SculptUndoNode *sculpt_undo_get_node(PBVHNode *node)
 		return NULL;
 	}
 
-	return BLI_findptr(lb, node, offsetof(SculptUndoNode, node));
+	return BKE_pbvh_node_undo_data_get(node);
 }
 
 static void sculpt_undo_alloc_and_store_hidden(PBVH *pbvh,
@@ -663,7 +663,6 @@ static void sculpt_undo_alloc_and_store_hidden(PBVH *pbvh,
 static SculptUndoNode *sculpt_undo_alloc_node(Object *ob, PBVHNode *node,
                                               SculptUndoType type)
 {
-	ListBase *lb = undo_paint_push_get_list(UNDO_PAINT_MESH);
 	SculptUndoNode *unode;
 	SculptSession *ss = ob->sculpt;
 	int totvert, allvert, totgrid, maxgrid, gridsize, *grids;
@@ -690,10 +689,9 @@ static SculptUndoNode *sculpt_undo_alloc_node(Object *ob, PBVHNode *node,
 		case SCULPT_UNDO_COORDS:
 			unode->co = MEM_mapallocN(sizeof(float) * 3 * allvert, "SculptUndoNode.co");
 			unode->no = MEM_mapallocN(sizeof(short) * 3 * allvert, "SculptUndoNode.no");
-			undo_paint_push_count_alloc(UNDO_PAINT_MESH,
-			                            (sizeof(float) * 3 +
-			                             sizeof(short) * 3 +
-			                             sizeof(int)) * allvert);
+			unode->alloc_size = (sizeof(float) * 3 +
+			                     sizeof(short) * 3 +
+			                     sizeof(int)) * allvert;
 			break;
 		case SCULPT_UNDO_HIDDEN:
 			if (maxgrid)
@@ -704,7 +702,7 @@ static SculptUndoNode *sculpt_undo_alloc_node(Object *ob, PBVHNode *node,
 			break;
 		case SCULPT_UNDO_MASK:
 			unode->mask = MEM_mapallocN(sizeof(float) * allvert, "SculptUndoNode.mask");
-			undo_paint_push_count_alloc(UNDO_PAINT_MESH, (sizeof(float) * sizeof(int)) * allvert);
+			unode->alloc_size = (sizeof(float) * sizeof(int)) * allvert;
 			break;
 		case SCULPT_UNDO_DYNTOPO_BEGIN:
 		case SCULPT_UNDO_DYNTOPO_END:
@@ -712,8 +710,6 @@ static SculptUndoNode *sculpt_undo_alloc_node(Object *ob, PBVHNode *node,
 			BLI_assert(!"Dynamic topology should've already been handled");
 			break;
 	}
-	
-	BLI_addtail(lb, unode);
 
 	if (maxgrid) {
 		/* multires */
@@ -875,20 +871,32 @@ static SculptUndoNode *sculpt_undo_bmesh_push(Object *ob,
 	return unode;
 }
 
+/* Serializes adding nodes to the undo list from threads. */
+static ThreadMutex sculpt_undo_list_lock = BLI_MUTEX_INITIALIZER;
+
+/* Free a node which lost the race for a PBVH node against another thread. */
+static void sculpt_undo_free_unused_node(SculptUndoNode *unode)
+{
+	ListBase lb = {unode, unode};
+
+	sculpt_undo_free(&lb);
+	MEM_freeN(unode);
+}
+
 SculptUndoNode *sculpt_undo_push_node(Object *ob, PBVHNode *node,
                                       SculptUndoType type)
 {
 	SculptSession *ss = ob->sculpt;
-	SculptUndoNode *unode;
-
-	/* list is manipulated by multiple threads, so we lock */
-	BLI_lock_thread(LOCK_CUSTOM1);
+	SculptUndoNode *unode, *unode_found;
 
 	if (ss->bm ||
 	    ELEM(type,
 	         SCULPT_UNDO_DYNTOPO_BEGIN,
 	         SCULPT_UNDO_DYNTOPO_END))
 	{
+		/* list is manipulated by multiple threads, so we lock */
+		BLI_lock_thread(LOCK_CUSTOM1);
+
 		/* Dynamic topology stores only one undo node per stroke,
 		 * regardless of the number of PBVH nodes modified */
 		unode = sculpt_undo_bmesh_push(ob, node, type);
@@ -896,13 +904,27 @@ SculptUndoNode *sculpt_undo_push_node(Object *ob, PBVHNode *node,
 		return unode;
 	}
 	else if ((unode = sculpt_undo_get_node(node))) {
-		BLI_unlock_thread(LOCK_CUSTOM1);
 		return unode;
 	}
 
+	/* The undo node is owned by the PBVH node until it's added to the undo
+	 * list, so only adding it to the list needs to be serialized. Nodes are
+	 * normally only pushed by the thread processing them, losing the race
+	 * here is rare. */
 	unode = sculpt_undo_alloc_node(ob, node, type);
-	
-	BLI_unlock_thread(LOCK_CUSTOM1);
+
+	unode_found = BKE_pbvh_node_undo_data_set_if_unset(node, unode);
+	if (unode_found != unode) {
+		sculpt_undo_free_unused_node(unode);
+		return unode_found;
+	}
+
+	BLI_mutex_lock(&sculpt_undo_list_lock);
+	BLI_addtail(undo_paint_push_get_list(UNDO_PAINT_MESH), unode);
+	if (unode->alloc_size) {
+		undo_paint_push_count_alloc(UNDO_PAINT_MESH, unode->alloc_size);
+	}
+	BLI_mutex_unlock(&sculpt_undo_list_lock);
 
 	/* copy threaded, hopefully this is the performance critical part */
 
@@ -962,8 +984,10 @@ void sculpt_undo_push_end(const bContext *C)
 			unode->no = NULL;
 		}
 
-		if (unode->node)
+		if (unode->node) {
 			BKE_pbvh_node_layer_disp_free(unode->node);
+			BKE_pbvh_node_undo_data_clear(unode->node);
+		}
 	}
 
 	ED_undo_paint_push_end(UNDO_PAINT_MESH);
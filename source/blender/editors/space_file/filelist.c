@@ -239,6 +239,8 @@ typedef struct FileListEntryCache {
 	/* Block cache: all entries between start and end index. used for part of the list on diplay. */
 	FileDirEntry **block_entries;
 	int block_start_index, block_end_index, block_center_index, block_cursor;
+	/* Number of entries actually visible around block_center_index, their previews are generated first. */
+	int block_visible_size;
 
 	/* Misc cache: random indices, FIFO behavior.
 	 * Note: Not 100% sure we actually need that, time will say. */
@@ -1171,7 +1173,7 @@ static void filelist_cache_previews_free(FileListEntryCache *cache)
 	cache->flags &= ~FLC_PREVIEWS_ACTIVE;
 }
 
-static void filelist_cache_previews_push(FileList *filelist, FileDirEntry *entry, const int index)
+static void filelist_cache_previews_push(FileList *filelist, FileDirEntry *entry, const int index, const int priority)
 {
 	FileListEntryCache *cache = &filelist->filelist_cache;
 
@@ -1191,7 +1193,7 @@ static void filelist_cache_previews_push(FileList *filelist, FileDirEntry *entry
 
 		filelist_cache_preview_ensure_running(cache);
 		BLI_task_pool_push_ex(cache->previews_pool, filelist_cache_preview_runf, preview,
-		                      true, filelist_cache_preview_freef, TASK_PRIORITY_LOW);
+		                      true, filelist_cache_preview_freef, priority);
 	}
 }
 
@@ -1525,7 +1527,7 @@ static FileDirEntry *filelist_file_ex(struct FileList *filelist, const int index
 
 #if 0  /* Actually no, only block cached entries should have preview imho. */
 	if (cache->previews_pool) {
-		filelist_cache_previews_push(filelist, ret, index);
+		filelist_cache_previews_push(filelist, ret, index, TASK_PRIORITY_LOW);
 	}
 #endif
 
@@ -1598,6 +1600,7 @@ void filelist_file_cache_slidingwindow_set(FileList *filelist, size_t window_siz
 	if (size != filelist->filelist_cache.size) {
 		filelist_cache_clear(&filelist->filelist_cache, size);
 	}
+	filelist->filelist_cache.block_visible_size = (int)window_size / 2;
 }
 
 /* Helpers, low-level, they assume cursor + size <= cache_size */
@@ -1644,6 +1647,24 @@ static void filelist_file_cache_block_release(struct FileList *filelist, const i
 }
 
 /* Load in cache all entries "around" given index (as much as block cache may hold). */
+/* Push previews of the block entries at given distance of index, if they are in [start_index, end_index[. */
+static void filelist_file_cache_block_previews_push(
+        FileList *filelist, const int index, const int dist, const int start_index, const int end_index,
+        const int priority)
+{
+	FileListEntryCache *cache = &filelist->filelist_cache;
+	const size_t cache_size = cache->size;
+
+	if ((index - dist) >= start_index) {
+		const int idx = (cache->block_cursor + (index - start_index) - dist) % cache_size;
+		filelist_cache_previews_push(filelist, cache->block_entries[idx], index - dist, priority);
+	}
+	if (dist && (index + dist) < end_index) {
+		const int idx = (cache->block_cursor + (index - start_index) + dist) % cache_size;
+		filelist_cache_previews_push(filelist, cache->block_entries[idx], index + dist, priority);
+	}
+}
+
 bool filelist_file_cache_block(struct FileList *filelist, const int index)
 {
 	FileListEntryCache *cache = &filelist->filelist_cache;
@@ -1823,17 +1844,18 @@ bool filelist_file_cache_block(struct FileList *filelist, const int index)
 
 //	printf("Re-queueing previews...\n");
 
-	/* Note we try to preview first images around given index - i.e. assumed visible ones. */
+	/* Note we try to preview first images around given index - i.e. assumed visible ones.
+	 * Visible entries go to the head of the task queue, ahead of previews of any other file browser,
+	 * pushed from the outermost one inwards so that the center ones are handled first.
+	 * Remaining cached entries are appended to the queue, closest ones first. */
 	if (cache->flags & FLC_PREVIEWS_ACTIVE) {
-		for (i = 0; ((index + i) < end_index) || ((index - i) >= start_index); i++) {
-			if ((index - i) >= start_index) {
-				const int idx = (cache->block_cursor + (index - start_index) - i) % cache_size;
-				filelist_cache_previews_push(filelist, cache->block_entries[idx], index - i);
-			}
-			if ((index + i) < end_index) {
-				const int idx = (cache->block_cursor + (index - start_index) + i) % cache_size;
-				filelist_cache_previews_push(filelist, cache->block_entries[idx], index + i);
-			}
+		const int visible_half = max_ii(1, (cache->block_visible_size + 1) / 2);
+
+		for (i = visible_half - 1; i >= 0; i--) {
+			filelist_file_cache_block_previews_push(filelist, index, i, start_index, end_index, TASK_PRIORITY_HIGH);
+		}
+		for (i = visible_half; ((index + i) < end_index) || ((index - i) >= start_index); i++) {
+			filelist_file_cache_block_previews_push(filelist, index, i, start_index, end_index, TASK_PRIORITY_LOW);
 		}
 	}
 
@@ -941,10 +941,13 @@ ImBuf *sequencer_ibuf_get(struct Main *bmain, Scene *scene, SpaceSeq *sseq, int
 
 	if (special_seq_update)
 		ibuf = BKE_sequencer_give_ibuf_direct(&context, cfra + frame_ofs, special_seq_update);
-	else if (!U.prefetchframes) // XXX || (G.f & G_PLAYANIM) == 0) {
+	else if (!U.prefetchframes)
 		ibuf = BKE_sequencer_give_ibuf(&context, cfra + frame_ofs, sseq->chanshown);
-	else
-		ibuf = BKE_sequencer_give_ibuf_threaded(&context, cfra + frame_ofs, sseq->chanshown);
+	else {
+		/* only render ahead while playing, not on every redraw */
+		const int prefetch_frames = ED_screen_animation_playing(bmain->wm.first) ? U.prefetchframes : 0;
+		ibuf = BKE_sequencer_give_ibuf_threaded(&context, cfra + frame_ofs, sseq->chanshown, prefetch_frames);
+	}
 
 	/* restore state so real rendering would be canceled (if needed) */
 	G.is_break = is_break;
@@ -37,6 +37,8 @@
 #include "BLI_blenlib.h"
 #include "BLI_ghash.h"
 #include "BLI_math.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 #include "BLI_timecode.h"
 #include "BLI_utildefines.h"
 
@@ -143,22 +145,110 @@ static void proxy_freejob(void *pjv)
 	MEM_freeN(pj);
 }
 
+/* Shared by the job thread and the movie tasks, the progress is the
+ * fraction of finished contexts and is only written under the lock. */
+typedef struct ProxyJobTaskData {
+	ThreadMutex lock;
+	int num_items;
+	int num_done;
+	short *stop;
+	short *do_update;
+	float *progress;
+} ProxyJobTaskData;
+
+static void proxy_rebuild_context(ProxyJobTaskData *data, struct SeqIndexBuildContext *context)
+{
+	/* per context progress is not shown, it is written from several threads */
+	short do_update = false;
+	float progress = 0.0f;
+
+	BKE_sequencer_proxy_rebuild(context, data->stop, &do_update, &progress);
+
+	BLI_mutex_lock(&data->lock);
+	data->num_done++;
+	*data->progress = (float)data->num_done / data->num_items;
+	*data->do_update = true;
+	BLI_mutex_unlock(&data->lock);
+}
+
+static void proxy_rebuild_task(TaskPool *__restrict pool, void *taskdata, int UNUSED(threadid))
+{
+	proxy_rebuild_context(BLI_task_pool_userdata(pool), taskdata);
+}
+
+/* Movies are decoded and encoded independently of each other, so they are
+ * rebuilt by a task pool, several at a time. Each of them uses a thread per
+ * proxy size too, so only half of the system threads are used for clips.
+ * Other strips are rendered through the sequencer, that may create its own
+ * pools, so they are rebuilt one after another on the job thread.
+ *
+ * Rebuilds the contexts from first to the end of the queue, returns the last one. */
+static LinkData *proxy_rebuild_batch(LinkData *first, short *stop, short *do_update, float *progress)
+{
+	ProxyJobTaskData data;
+	TaskPool *task_pool = NULL;
+	LinkData *link, *last = NULL;
+
+	BLI_mutex_init(&data.lock);
+	data.num_items = 0;
+	data.num_done = 0;
+	data.stop = stop;
+	data.do_update = do_update;
+	data.progress = progress;
+
+	for (link = first; link; link = link->next) {
+		data.num_items++;
+	}
+
+	for (link = first; link; link = link->next) {
+		if (BKE_sequencer_proxy_rebuild_is_threadsafe(link->data)) {
+			if (task_pool == NULL) {
+				task_pool = BLI_task_pool_create(BLI_task_scheduler_get(), &data);
+				BLI_pool_set_num_threads(task_pool, max_ii(1, BLI_system_thread_count() / 2));
+			}
+			BLI_task_pool_push(task_pool, proxy_rebuild_task, link->data, false, TASK_PRIORITY_LOW);
+		}
+	}
+
+	/* the movie tasks keep running in the background meanwhile */
+	for (link = first; link; link = link->next) {
+		last = link;
+
+		if (!*stop && !BKE_sequencer_proxy_rebuild_is_threadsafe(link->data)) {
+			proxy_rebuild_context(&data, link->data);
+		}
+	}
+
+	if (task_pool) {
+		BLI_task_pool_work_and_wait(task_pool);
+		BLI_task_pool_free(task_pool);
+	}
+
+	BLI_mutex_end(&data.lock);
+
+	return last;
+}
+
 /* only this runs inside thread */
 static void proxy_startjob(void *pjv, short *stop, short *do_update, float *progress)
 {
 	ProxyJob *pj = pjv;
-	LinkData *link;
+	LinkData *last = NULL;
 
-	for (link = pj->queue.first; link; link = link->next) {
-		struct SeqIndexBuildContext *context = link->data;
+	/* strips can be added to the queue while the job is running */
+	while (!*stop) {
+		LinkData *first = last ? last->next : pj->queue.first;
 
-		BKE_sequencer_proxy_rebuild(context, stop, do_update, progress);
-		
-		if (*stop) {
-			pj->stop = 1;
-			fprintf(stderr,  "Canceling proxy rebuild on users request...\n");
+		if (first == NULL) {
 			break;
 		}
+
+		last = proxy_rebuild_batch(first, stop, do_update, progress);
+	}
+
+	if (*stop) {
+		pj->stop = 1;
+		fprintf(stderr,  "Canceling proxy rebuild on users request...\n");
 	}
 }
 
@@ -119,6 +119,16 @@ struct ImBuf *IMB_testiffname(const char *filepath, int flags);
  */
 struct ImBuf *IMB_loadiffname(const char *filepath, int flags, char colorspace[IM_MAX_SPACE]);
 
+/**
+ * Load at a reduced resolution of at least \a max_thumb_size pixels on the largest side,
+ * for formats that can, others are loaded at full resolution.
+ * \a r_width and \a r_height are set to the full resolution of the image.
+ *
+ * \attention Defined in readimage.c
+ */
+struct ImBuf *IMB_loadiffname_thumbnail(const char *filepath, int flags, size_t max_thumb_size,
+                                        char colorspace[IM_MAX_SPACE], size_t *r_width, size_t *r_height);
+
 /**
  *
  * \attention Defined in allocimbuf.c
@@ -264,6 +274,10 @@ typedef enum IMB_Proxy_Size {
 void IMB_anim_set_index_dir(struct anim *anim, const char *dir);
 void IMB_anim_get_fname(struct anim *anim, char *file, int size);
 
+/* proxy file of the given size within an index directory, filepath is FILE_MAX long */
+void IMB_anim_proxy_filepath_get(const char *index_dir, int streamindex, IMB_Proxy_Size preview_size,
+                                 char *filepath);
+
 int IMB_anim_index_get_frame_index(struct anim *anim, IMB_Timecode_Type tc,
                                    int position);
 
@@ -376,6 +390,8 @@ void IMB_filtery(struct ImBuf *ibuf);
 struct ImBuf *IMB_onehalf(struct ImBuf *ibuf1);
 
 /**
+ * Scales both the byte and float buffer in place, averaging when shrinking
+ * and interpolating when enlarging. A zero size keeps that axis unchanged.
  *
  * \attention Defined in scaling.c
  */
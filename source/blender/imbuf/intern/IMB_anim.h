@@ -81,6 +81,8 @@
 #  include <libavformat/avformat.h>
 #  include <libavcodec/avcodec.h>
 #  include <libswscale/swscale.h>
+
+#  include "BLI_threads.h"
 #endif
 
 /* more endianness... should move to a separate file... */
@@ -102,6 +104,19 @@
 
 struct _AviMovie;
 struct anim_index;
+struct TaskPool;
+
+#ifdef WITH_FFMPEG
+/* frames decoded ahead of playback, limited by ANIM_PREFETCH_MAX_MEMORY in anim_movie.c */
+#define ANIM_PREFETCH_MAX_FRAMES 8
+
+typedef struct AnimPrefetchFrame {
+	struct ImBuf *ibuf;
+	int position;
+	/* the frame is displayed for pts_to_search in [pts, next_pts) */
+	int64_t pts, next_pts;
+} AnimPrefetchFrame;
+#endif
 
 struct anim {
 	int ib_flags;
@@ -160,6 +175,24 @@ struct anim {
 	int64_t last_pts;
 	int64_t next_pts;
 	AVPacket next_packet;
+
+	/* decoder threads taken from the budget shared by all movies */
+	int decode_threads;
+
+	/* decoding ahead, the task owns the decoder while it is running */
+	struct TaskPool *prefetch_pool;
+	/* not opened from a task, which can't create the pool */
+	int prefetch_allowed;
+	ThreadMutex prefetch_lock;
+	AnimPrefetchFrame prefetch[ANIM_PREFETCH_MAX_FRAMES];
+	int prefetch_tot, prefetch_max;
+	int prefetch_running;
+	/* the task has started, it no longer waits for a worker thread */
+	int prefetch_decoding;
+	/* signaled by the task for every frame decoded ahead */
+	ThreadCondition prefetch_cond;
+	/* position of the frame before the one pending in the decoder */
+	int prefetch_position;
 #endif
 
 	char index_dir[768];
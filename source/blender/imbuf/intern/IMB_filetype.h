@@ -49,6 +49,11 @@ typedef struct ImFileType {
 	int flag;
 	int filetype;
 	int default_save_role;
+
+	/* optional, decode at a reduced resolution of at least max_thumb_size pixels on the
+	 * largest side, r_width and r_height are set to the full resolution of the image */
+	struct ImBuf *(*load_thumbnail)(const unsigned char *mem, size_t size, int flags, size_t max_thumb_size,
+	                                char colorspace[IM_MAX_SPACE], size_t *r_width, size_t *r_height);
 } ImFileType;
 
 extern const ImFileType IMB_FILE_TYPES[];
@@ -89,6 +94,8 @@ int imb_savejp2(struct ImBuf *ibuf, const char *name, int flags);
 int imb_is_a_jpeg(const unsigned char *mem);
 int imb_savejpeg(struct ImBuf *ibuf, const char *name, int flags);
 struct ImBuf *imb_load_jpeg(const unsigned char *buffer, size_t size, int flags, char colorspace[IM_MAX_SPACE]);
+struct ImBuf *imb_thumbnail_jpeg(const unsigned char *buffer, size_t size, int flags, size_t max_thumb_size,
+                                 char colorspace[IM_MAX_SPACE], size_t *r_width, size_t *r_height);
 
 /* bmp */
 int imb_is_a_bmp(const unsigned char *buf);
@@ -67,6 +67,8 @@
 #include "BLI_utildefines.h"
 #include "BLI_string.h"
 #include "BLI_path_util.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 
 #include "MEM_guardedalloc.h"
 
@@ -443,11 +445,40 @@ static ImBuf *avi_fetchibuf(struct anim *anim, int position)
 
 #ifdef WITH_FFMPEG
 
+/* memory used for frames decoded ahead, per movie */
+#define ANIM_PREFETCH_MAX_MEMORY (256 * 1024 * 1024)
+
 BLI_INLINE bool need_aligned_ffmpeg_buffer(struct anim *anim)
 {
 	return (anim->x & 31) != 0;
 }
 
+/* Decoder threads of all open movies together stay within the system's thread
+ * count, each movie takes half of what is left. */
+static ThreadMutex ffmpeg_decode_threads_lock = BLI_MUTEX_INITIALIZER;
+static int ffmpeg_decode_threads_used = 0;
+
+static int ffmpeg_decode_threads_acquire(void)
+{
+	int threads;
+
+	BLI_mutex_lock(&ffmpeg_decode_threads_lock);
+	threads = max_ii((BLI_system_thread_count() - ffmpeg_decode_threads_used + 1) / 2, 1);
+	ffmpeg_decode_threads_used += threads;
+	BLI_mutex_unlock(&ffmpeg_decode_threads_lock);
+
+	return threads;
+}
+
+static void ffmpeg_decode_threads_release(struct anim *anim)
+{
+	BLI_mutex_lock(&ffmpeg_decode_threads_lock);
+	ffmpeg_decode_threads_used -= anim->decode_threads;
+	BLI_mutex_unlock(&ffmpeg_decode_threads_lock);
+
+	anim->decode_threads = 0;
+}
+
 static int startffmpeg(struct anim *anim)
 {
 	int i, videoStream;
@@ -512,7 +543,13 @@ static int startffmpeg(struct anim *anim)
 
 	pCodecCtx->workaround_bugs = 1;
 
+	/* decode with frame threads where the codec supports it, slices otherwise */
+	anim->decode_threads = ffmpeg_decode_threads_acquire();
+	pCodecCtx->thread_count = anim->decode_threads;
+	pCodecCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
 	if (avcodec_open2(pCodecCtx, pCodec, NULL) < 0) {
+		ffmpeg_decode_threads_release(anim);
 		avformat_close_input(&pFormatCtx);
 		return -1;
 	}
@@ -560,6 +597,15 @@ static int startffmpeg(struct anim *anim)
 	anim->next_pts = -1;
 	anim->next_packet.stream_index = -1;
 
+	/* created on first use, see ffmpeg_prefetch_start() */
+	anim->prefetch_pool = NULL;
+	anim->prefetch_allowed = !BLI_task_scheduler_thread_is_worker(BLI_task_scheduler_get());
+	anim->prefetch_tot = 0;
+	anim->prefetch_max = CLAMPIS((int)(ANIM_PREFETCH_MAX_MEMORY / MAX2(anim->framesize, 1)), 2, ANIM_PREFETCH_MAX_FRAMES);
+	anim->prefetch_running = false;
+	anim->prefetch_decoding = false;
+	anim->prefetch_position = -1;
+
 	anim->pFrame = av_frame_alloc();
 	anim->pFrameComplete = false;
 	anim->pFrameDeinterlaced = av_frame_alloc();
@@ -578,6 +624,7 @@ static int startffmpeg(struct anim *anim)
 			av_frame_free(&anim->pFrameDeinterlaced);
 			av_frame_free(&anim->pFrame);
 			anim->pCodecCtx = NULL;
+			ffmpeg_decode_threads_release(anim);
 			return -1;
 		}
 	}
@@ -593,6 +640,7 @@ static int startffmpeg(struct anim *anim)
 		av_frame_free(&anim->pFrameDeinterlaced);
 		av_frame_free(&anim->pFrame);
 		anim->pCodecCtx = NULL;
+		ffmpeg_decode_threads_release(anim);
 		return -1;
 	}
 
@@ -634,6 +682,7 @@ static int startffmpeg(struct anim *anim)
 		av_frame_free(&anim->pFrameDeinterlaced);
 		av_frame_free(&anim->pFrame);
 		anim->pCodecCtx = NULL;
+		ffmpeg_decode_threads_release(anim);
 		return -1;
 	}
 
@@ -655,20 +704,22 @@ static int startffmpeg(struct anim *anim)
 		fprintf(stderr, "Warning: Could not set libswscale colorspace details.\n");
 	}
 #endif
-		
+
+	BLI_mutex_init(&anim->prefetch_lock);
+	BLI_condition_init(&anim->prefetch_cond);
+
 	return (0);
 }
 
 /* postprocess the image in anim->pFrame and do color conversion
  * and deinterlacing stuff.
  *
- * Output is anim->last_frame
+ * Output is ibuf
  */
 
-static void ffmpeg_postprocess(struct anim *anim)
+static void ffmpeg_postprocess(struct anim *anim, ImBuf *ibuf)
 {
 	AVFrame *input = anim->pFrame;
-	ImBuf *ibuf = anim->last_frame;
 	int filter_y = 0;
 
 	if (!anim->pFrameComplete) {
@@ -895,8 +946,209 @@ static int ffmpeg_decode_video_frame(struct anim *anim)
 	return (rval >= 0);
 }
 
+/* ******** decoding ahead ******** */
+
+/* While playing forward the frames following the current one are decoded in a
+ * background task, so decoding overlaps with displaying and compositing the
+ * current frame. The task owns the decoder while it runs, it has to be stopped
+ * with ffmpeg_prefetch_stop() before anything else uses the decoder. Fetching
+ * the frame the task is decoding waits for it instead.
+ *
+ * Playing backward needs a seek for every frame, there the frames decoded on the
+ * way from the key frame to the requested one are kept instead of dropped.
+ *
+ * Frames are looked up by pts, the array is sorted by it and also holds the
+ * frame returned last.
+ *
+ * Background pools can't be created from tasks, movies opened or played by
+ * one (sequencer look-ahead) don't decode ahead. */
+
+static void ffmpeg_prefetch_discard(struct anim *anim, int tot)
+{
+	int i;
+
+	for (i = 0; i < tot; i++) {
+		IMB_freeImBuf(anim->prefetch[i].ibuf);
+	}
+
+	anim->prefetch_tot -= tot;
+	memmove(anim->prefetch, anim->prefetch + tot, sizeof(*anim->prefetch) * anim->prefetch_tot);
+}
+
+static void ffmpeg_prefetch_add(struct anim *anim, ImBuf *ibuf, int position, int64_t pts, int64_t next_pts)
+{
+	AnimPrefetchFrame *frame;
+
+	if (anim->prefetch_tot == anim->prefetch_max) {
+		ffmpeg_prefetch_discard(anim, 1);
+	}
+
+	frame = &anim->prefetch[anim->prefetch_tot++];
+	frame->ibuf = ibuf;
+	frame->position = position;
+	frame->pts = pts;
+	/* last frame of the stream, there is no next one */
+	frame->next_pts = MAX2(next_pts, pts + 1);
+}
+
+static void ffmpeg_prefetch_task(TaskPool *__restrict pool, void *UNUSED(taskdata), int UNUSED(threadid))
+{
+	struct anim *anim = BLI_task_pool_userdata(pool);
+	ThreadMutex *mutex = &anim->prefetch_lock;
+
+	BLI_mutex_lock(mutex);
+	anim->prefetch_decoding = true;
+	BLI_mutex_unlock(mutex);
+
+	while (!BLI_task_pool_canceled(pool) && anim->pFrameComplete) {
+		ImBuf *ibuf;
+		int64_t pts = anim->next_pts;
+		bool full;
+
+		BLI_mutex_lock(mutex);
+		full = (anim->prefetch_tot == anim->prefetch_max);
+		BLI_mutex_unlock(mutex);
+
+		if (full) {
+			break;
+		}
+
+		ibuf = IMB_allocImBuf(anim->x, anim->y, 32, IB_rect);
+		ibuf->rect_colorspace = colormanage_colorspace_get_named(anim->colorspace);
+		ffmpeg_postprocess(anim, ibuf);
+
+		ffmpeg_decode_video_frame(anim);
+
+		BLI_mutex_lock(mutex);
+		anim->prefetch_position++;
+		ffmpeg_prefetch_add(anim, ibuf, anim->prefetch_position, pts, anim->next_pts);
+		BLI_condition_notify_all(&anim->prefetch_cond);
+		BLI_mutex_unlock(mutex);
+	}
+
+	BLI_mutex_lock(mutex);
+	anim->prefetch_running = false;
+	anim->prefetch_decoding = false;
+	BLI_condition_notify_all(&anim->prefetch_cond);
+	BLI_mutex_unlock(mutex);
+}
+
+static void ffmpeg_prefetch_start(struct anim *anim)
+{
+	ThreadMutex *mutex = &anim->prefetch_lock;
+	bool start;
+
+	if (anim->prefetch_pool == NULL) {
+		TaskScheduler *scheduler = BLI_task_scheduler_get();
+
+		if (!anim->prefetch_allowed || BLI_task_scheduler_thread_is_worker(scheduler)) {
+			return;
+		}
+
+		anim->prefetch_pool = BLI_task_pool_create_background(scheduler, anim);
+	}
+
+	BLI_mutex_lock(mutex);
+	start = !anim->prefetch_running && anim->prefetch_tot < anim->prefetch_max;
+	if (start) {
+		anim->prefetch_running = true;
+	}
+	BLI_mutex_unlock(mutex);
+
+	if (start) {
+		BLI_task_pool_push(anim->prefetch_pool, ffmpeg_prefetch_task, NULL, false, TASK_PRIORITY_LOW);
+	}
+}
+
+/* stop decoding ahead and bring the decoder state back to how a direct fetch would leave it */
+static void ffmpeg_prefetch_stop(struct anim *anim)
+{
+	if (anim->prefetch_pool) {
+		BLI_task_pool_cancel(anim->prefetch_pool);
+		anim->prefetch_running = false;
+		anim->prefetch_decoding = false;
+	}
+
+	if (anim->prefetch_tot) {
+		AnimPrefetchFrame *frame = &anim->prefetch[anim->prefetch_tot - 1];
+
+		/* the decoder continues after this frame */
+		if (frame->position == anim->prefetch_position && frame->next_pts == anim->next_pts) {
+			IMB_freeImBuf(anim->last_frame);
+			anim->last_frame = frame->ibuf;
+			anim->last_pts = frame->pts;
+			IMB_refImBuf(anim->last_frame);
+		}
+
+		ffmpeg_prefetch_discard(anim, anim->prefetch_tot);
+	}
+
+	anim->curposition = anim->prefetch_position;
+}
+
+static ImBuf *ffmpeg_prefetch_take(struct anim *anim, int position, int64_t pts_to_search)
+{
+	ThreadMutex *mutex = &anim->prefetch_lock;
+	ImBuf *ibuf = NULL;
+	const bool forward = (position > anim->curposition);
+	int i;
+
+	BLI_mutex_lock(mutex);
+	for (;;) {
+		for (i = 0; i < anim->prefetch_tot; i++) {
+			AnimPrefetchFrame *frame = &anim->prefetch[i];
+
+			if (frame->pts <= pts_to_search && frame->next_pts > pts_to_search) {
+				ibuf = frame->ibuf;
+				IMB_refImBuf(ibuf);
+
+				/* frames played already */
+				if (forward) {
+					ffmpeg_prefetch_discard(anim, i);
+				}
+				break;
+			}
+		}
+
+		/* the frame is being decoded, cancelling would throw that work away. A task
+		 * still waiting for a worker is not waited for, this may be a worker itself */
+		if (ibuf || !anim->prefetch_decoding || position != anim->prefetch_position + 1) {
+			break;
+		}
+		BLI_condition_wait(&anim->prefetch_cond, mutex);
+	}
+	BLI_mutex_unlock(mutex);
+
+	if (ibuf) {
+		av_log(anim->pFormatCtx, AV_LOG_DEBUG, "FETCH: decoded ahead\n");
+
+		anim->curposition = position;
+
+		if (forward) {
+			ffmpeg_prefetch_start(anim);
+		}
+	}
+
+	return ibuf;
+}
+
+static void ffmpeg_prefetch_free(struct anim *anim)
+{
+	if (anim->prefetch_pool) {
+		BLI_task_pool_cancel(anim->prefetch_pool);
+		BLI_task_pool_free(anim->prefetch_pool);
+		anim->prefetch_pool = NULL;
+	}
+	BLI_mutex_end(&anim->prefetch_lock);
+	BLI_condition_end(&anim->prefetch_cond);
+
+	ffmpeg_prefetch_discard(anim, anim->prefetch_tot);
+}
+
+/* when keep_frames is set, the frames before pts_to_search are kept for playing backward */
+
 static void ffmpeg_decode_video_frame_scan(
-        struct anim *anim, int64_t pts_to_search)
+        struct anim *anim, int64_t pts_to_search, bool keep_frames)
 {
 	/* there seem to exist *very* silly GOP lengths out in the wild... */
 	int count = 1000;
@@ -911,7 +1163,21 @@ static void ffmpeg_decode_video_frame_scan(
 		       AV_LOG_DEBUG, 
 		       "  WHILE: pts=%lld in search of %lld\n", 
 		       (long long int)anim->next_pts, (long long int)pts_to_search);
-		if (!ffmpeg_decode_video_frame(anim)) {
+		if (keep_frames && anim->pFrameComplete && anim->next_pts >= 0) {
+			ImBuf *ibuf = IMB_allocImBuf(anim->x, anim->y, 32, IB_rect);
+			int64_t pts = anim->next_pts;
+
+			ibuf->rect_colorspace = colormanage_colorspace_get_named(anim->colorspace);
+			ffmpeg_postprocess(anim, ibuf);
+
+			if (!ffmpeg_decode_video_frame(anim)) {
+				IMB_freeImBuf(ibuf);
+				break;
+			}
+
+			ffmpeg_prefetch_add(anim, ibuf, -1, pts, anim->next_pts);
+		}
+		else if (!ffmpeg_decode_video_frame(anim)) {
 			break;
 		}
 		count--;
@@ -982,8 +1248,10 @@ static ImBuf *ffmpeg_fetchibuf(struct anim *anim, int position,
 	long long st_time; 
 	struct anim_index *tc_index = 0;
 	AVStream *v_st;
+	ImBuf *ibuf;
 	int new_frame_index = 0; /* To quiet gcc barking... */
 	int old_frame_index = 0; /* To quiet gcc barking... */
+	bool backward, sequential;
 
 	if (anim == NULL) return (0);
 
@@ -1003,8 +1271,6 @@ static ImBuf *ffmpeg_fetchibuf(struct anim *anim, int position,
 	if (tc_index) {
 		new_frame_index = IMB_indexer_get_frame_index(
 		        tc_index, position);
-		old_frame_index = IMB_indexer_get_frame_index(
-		        tc_index, anim->curposition);
 		pts_to_search = IMB_indexer_get_pts(
 		        tc_index, new_frame_index);
 	}
@@ -1023,6 +1289,21 @@ static ImBuf *ffmpeg_fetchibuf(struct anim *anim, int position,
 	       "(pts_timebase=%g, frame_rate=%g, st_time=%lld)\n", 
 	       (long long int)pts_to_search, pts_time_base, frame_rate, st_time);
 
+	if ((ibuf = ffmpeg_prefetch_take(anim, position, pts_to_search))) {
+		return ibuf;
+	}
+
+	backward = (position < anim->curposition);
+	sequential = (anim->curposition != -1 && position == anim->curposition + 1);
+
+	/* the decoder is ours from here on */
+	ffmpeg_prefetch_stop(anim);
+
+	if (tc_index) {
+		old_frame_index = IMB_indexer_get_frame_index(
+		        tc_index, anim->curposition);
+	}
+
 	if (anim->last_frame && 
 	    anim->last_pts <= pts_to_search && anim->next_pts > pts_to_search)
 	{
@@ -1032,6 +1313,11 @@ static ImBuf *ffmpeg_fetchibuf(struct anim *anim, int position,
 		       (long long int)anim->next_pts);
 		IMB_refImBuf(anim->last_frame);
 		anim->curposition = position;
+		anim->prefetch_position = position;
+
+		if (sequential) {
+			ffmpeg_prefetch_start(anim);
+		}
 		return anim->last_frame;
 	}
 	 
@@ -1043,7 +1329,7 @@ static ImBuf *ffmpeg_fetchibuf(struct anim *anim, int position,
 		av_log(anim->pFormatCtx, AV_LOG_DEBUG, 
 		       "FETCH: within preseek interval (no index)\n");
 
-		ffmpeg_decode_video_frame_scan(anim, pts_to_search);
+		ffmpeg_decode_video_frame_scan(anim, pts_to_search, false);
 	}
 	else if (tc_index &&
 	         IMB_indexer_can_scan(tc_index, old_frame_index,
@@ -1053,7 +1339,7 @@ static ImBuf *ffmpeg_fetchibuf(struct anim *anim, int position,
 		       "FETCH: within preseek interval "
 		       "(index tells us)\n");
 
-		ffmpeg_decode_video_frame_scan(anim, pts_to_search);
+		ffmpeg_decode_video_frame_scan(anim, pts_to_search, false);
 	}
 	else if (position != anim->curposition + 1) {
 		long long pos;
@@ -1132,7 +1418,7 @@ static ImBuf *ffmpeg_fetchibuf(struct anim *anim, int position,
 		/* memset(anim->pFrame, ...) ?? */
 
 		if (ret >= 0) {
-			ffmpeg_decode_video_frame_scan(anim, pts_to_search);
+			ffmpeg_decode_video_frame_scan(anim, pts_to_search, backward);
 		}
 	}
 	else if (position == 0 && anim->curposition == -1) {
@@ -1148,13 +1434,19 @@ static ImBuf *ffmpeg_fetchibuf(struct anim *anim, int position,
 	anim->last_frame = IMB_allocImBuf(anim->x, anim->y, 32, IB_rect);
 	anim->last_frame->rect_colorspace = colormanage_colorspace_get_named(anim->colorspace);
 
-	ffmpeg_postprocess(anim);
+	ffmpeg_postprocess(anim, anim->last_frame);
 
 	anim->last_pts = anim->next_pts;
 	
 	ffmpeg_decode_video_frame(anim);
 	
 	anim->curposition = position;
+	anim->prefetch_position = position;
+
+	if (sequential) {
+		/* playing forward, decode the following frames while this one is used */
+		ffmpeg_prefetch_start(anim);
+	}
 	
 	IMB_refImBuf(anim->last_frame);
 
@@ -1166,6 +1458,9 @@ static void free_anim_ffmpeg(struct anim *anim)
 	if (anim == NULL) return;
 
 	if (anim->pCodecCtx) {
+		ffmpeg_prefetch_free(anim);
+		ffmpeg_decode_threads_release(anim);
+
 		avcodec_close(anim->pCodecCtx);
 		avformat_close_input(&anim->pFormatCtx);
 
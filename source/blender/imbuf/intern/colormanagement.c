@@ -52,9 +52,11 @@
 #include "MEM_guardedalloc.h"
 
 #include "BLI_blenlib.h"
+#include "BLI_ghash.h"
 #include "BLI_math.h"
 #include "BLI_math_color.h"
 #include "BLI_string.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 #include "BLI_rect.h"
 
@@ -68,6 +70,10 @@
 
 #include <ocio_capi.h>
 
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
 /*********************** Global declarations *************************/
 
 #define DISPLAY_BUFFER_CHANNELS 4
@@ -90,6 +96,9 @@ static int global_tot_display = 0;
 static int global_tot_view = 0;
 static int global_tot_looks = 0;
 
+/* fallback configuration only has cheap analytic transforms, baking LUTs for them doesn't pay off */
+static bool global_use_display_lut = false;
+
 /* Set to ITU-BT.709 / sRGB primaries weight. Brute force stupid, but only
  * option with no colormanagement in place.
  */
@@ -105,9 +114,13 @@ static pthread_mutex_t processor_lock = BLI_MUTEX_INITIALIZER;
 typedef struct ColormanageProcessor {
 	OCIO_ConstProcessorRcPtr *processor;
 	CurveMapping *curve_mapping;
+	/* LUT baked from processor, used instead of it for buffers when set */
+	struct DisplayLUT *display_lut;
 	bool is_data_result;
 } ColormanageProcessor;
 
+static void display_luts_free(void);
+
 static struct global_glsl_state {
 	/* Actual processor used for GLSL baked LUTs. */
 	OCIO_ConstProcessorRcPtr *processor;
@@ -165,8 +178,16 @@ static struct global_glsl_state {
  *      shouldn't lead extra buffers adding to cache, it shall
  *      invalidate cached images.
  *
- *      Currently such a data contains only exposure and gamma, but
- *      would likely extended further.
+ *      Currently such a data contains gamma, dither and curve mapping,
+ *      but would likely extended further. Look and exposure are part
+ *      of the key instead, so switching between a few of them (as well
+ *      as between views) re-uses buffers computed before.
+ *
+ *      Since several buffers are cached for the same view, the view
+ *      bits of display_buffer_flags are not enough to tell whether
+ *      a cached buffer is up to date. The cache generation is increased
+ *      every time display buffers are invalidated, and cached buffers
+ *      of an older generation are not used.
  *
  *      data field is not null only for elements of cache, not used for
  *      original image buffers.
@@ -212,22 +233,26 @@ typedef struct ColormanageCacheDisplaySettings {
 typedef struct ColormanageCacheKey {
 	int view;            /* view transformation used for display buffer */
 	int display;         /* display device name */
+	int look;            /* additional artistic transform */
+	float exposure;      /* exposure value display buffer is calculated with */
 } ColormanageCacheKey;
 
 typedef struct ColormnaageCacheData {
 	int flag;        /* view flags of cached buffer */
-	int look;        /* Additional artistics transform */
-	float exposure;  /* exposure value cached buffer is calculated with */
 	float gamma;     /* gamma value cached buffer is calculated with */
 	float dither;    /* dither value cached buffer is calculated with */
 	CurveMapping *curve_mapping;  /* curve mapping used for cached buffer */
 	int curve_mapping_timestamp;  /* time stamp of curve mapping used for cached buffer */
+	unsigned int generation;      /* generation of the image buffer cache the buffer was computed in */
 } ColormnaageCacheData;
 
 typedef struct ColormanageCache {
 	struct MovieCache *moviecache;
 
 	ColormnaageCacheData *data;
+
+	/* increased when display buffers of the image buffer are invalidated */
+	unsigned int generation;
 } ColormanageCache;
 
 static struct MovieCache *colormanage_moviecache_get(const ImBuf *ibuf)
@@ -249,9 +274,12 @@ static ColormnaageCacheData *colormanage_cachedata_get(const ImBuf *ibuf)
 static unsigned int colormanage_hashhash(const void *key_v)
 {
 	const ColormanageCacheKey *key = key_v;
+	union { float f; unsigned int i; } exposure = {key->exposure};
 
 	unsigned int rval = (key->display << 16) | (key->view % 0xffff);
 
+	rval ^= BLI_ghashutil_uinthash((unsigned int)key->look) ^ BLI_ghashutil_uinthash(exposure.i);
+
 	return rval;
 }
 
@@ -261,7 +289,9 @@ static bool colormanage_hashcmp(const void *av, const void *bv)
 	const ColormanageCacheKey *b = bv;
 
 	return ((a->view != b->view) ||
-	        (a->display != b->display));
+	        (a->display != b->display) ||
+	        (a->look != b->look) ||
+	        (a->exposure != b->exposure));
 }
 
 static struct MovieCache *colormanage_moviecache_ensure(ImBuf *ibuf)
@@ -289,6 +319,23 @@ static void colormanage_cachedata_set(ImBuf *ibuf, ColormnaageCacheData *data)
 	ibuf->colormanage_cache->data = data;
 }
 
+/* mark all display buffers of the image buffer as out of date */
+static void colormanage_cache_invalidate(ImBuf *ibuf)
+{
+	memset(ibuf->display_buffer_flags, 0, global_tot_display * sizeof(unsigned int));
+
+	if (ibuf->colormanage_cache)
+		ibuf->colormanage_cache->generation++;
+}
+
+/* keep a cached display buffer up to date after invalidating the others */
+static void colormanage_cache_handle_validate(ImBuf *ibuf, void *cache_handle)
+{
+	ColormnaageCacheData *cache_data = colormanage_cachedata_get(cache_handle);
+
+	cache_data->generation = ibuf->colormanage_cache->generation;
+}
+
 static void colormanage_view_settings_to_cache(ImBuf *ibuf,
                                                ColormanageCacheViewSettings *cache_view_settings,
                                                const ColorManagedViewSettings *view_settings)
@@ -319,6 +366,8 @@ static void colormanage_settings_to_key(ColormanageCacheKey *key,
 {
 	key->view = view_settings->view;
 	key->display = display_settings->display;
+	key->look = view_settings->look;
+	key->exposure = view_settings->exposure;
 }
 
 static ImBuf *colormanage_cache_get_ibuf(ImBuf *ibuf, ColormanageCacheKey *key, void **cache_handle)
@@ -366,17 +415,16 @@ static unsigned char *colormanage_cache_get(ImBuf *ibuf, const ColormanageCacheV
 		BLI_assert(cache_ibuf->x == ibuf->x &&
 		           cache_ibuf->y == ibuf->y);
 
-		/* only buffers with different color space conversions are being stored
-		 * in cache separately. buffer which were used only different exposure/gamma
-		 * are re-suing the same cached buffer
+		/* only buffers with different color space conversions, looks or exposures
+		 * are being stored in cache separately. buffer which were used only different
+		 * gamma/curve are re-suing the same cached buffer
 		 *
-		 * check here which exposure/gamma/curve was used for cached buffer and if they're
+		 * check here which gamma/curve was used for cached buffer and if they're
 		 * different from requested buffer should be re-generated
 		 */
 		cache_data = colormanage_cachedata_get(cache_ibuf);
 
-		if (cache_data->look != view_settings->look ||
-		    cache_data->exposure != view_settings->exposure ||
+		if (cache_data->generation != ibuf->colormanage_cache->generation ||
 		    cache_data->gamma != view_settings->gamma ||
 		    cache_data->dither != view_settings->dither ||
 		    cache_data->flag != view_settings->flag ||
@@ -422,13 +470,12 @@ static void colormanage_cache_put(ImBuf *ibuf, const ColormanageCacheViewSetting
 
 	/* store data which is needed to check whether cached buffer could be used for color managed display settings */
 	cache_data = MEM_callocN(sizeof(ColormnaageCacheData), "color manage cache imbuf data");
-	cache_data->look = view_settings->look;
-	cache_data->exposure = view_settings->exposure;
 	cache_data->gamma = view_settings->gamma;
 	cache_data->dither = view_settings->dither;
 	cache_data->flag = view_settings->flag;
 	cache_data->curve_mapping = curve_mapping;
 	cache_data->curve_mapping_timestamp = curve_mapping_timestamp;
+	cache_data->generation = ibuf->colormanage_cache->generation;
 
 	colormanage_cachedata_set(cache_ibuf, cache_data);
 
@@ -655,6 +702,9 @@ void colormanagement_init(void)
 
 		config = OCIO_configCreateFallback();
 	}
+	else {
+		global_use_display_lut = true;
+	}
 
 	if (config) {
 		OCIO_setCurrentConfig(config);
@@ -674,6 +724,8 @@ void colormanagement_init(void)
 		/* Initialize fallback config. */
 		config = OCIO_configCreateFallback();
 		colormanage_load_config(config);
+
+		global_use_display_lut = false;
 	}
 
 	BLI_init_srgb_conversion();
@@ -696,6 +748,8 @@ void colormanagement_exit(void)
 	if (global_glsl_state.transform_ocio_glsl_state)
 		OCIO_freeOGLState(global_glsl_state.transform_ocio_glsl_state);
 
+	display_luts_free();
+
 	colormanage_free_config();
 }
 
@@ -1235,6 +1289,354 @@ const char *IMB_colormanagement_get_rect_colorspace(ImBuf *ibuf)
 	}
 }
 
+/*********************** Baked display transform *************************/
+
+/* Byte display buffers of large float images are computed with a 3D LUT baked
+ * from the display processor, similar to what GLSL drawing does. The LUT is
+ * accurate to about one step of 8 bit, so it's not used for float display
+ * buffers or images which are being saved.
+ *
+ * Scene linear values are mapped to LUT coordinates with a log2(x + offset)
+ * shaper, pixels with values outside of [0, DISPLAY_LUT_MAX] are transformed
+ * with the processor itself. Baked LUTs are cached per display transform
+ * settings, so switching between a few views or looks doesn't bake them again.
+ */
+
+#define DISPLAY_LUT_SIZE 65
+#define DISPLAY_LUT_OFFSET (1.0f / 4096.0f)
+#define DISPLAY_LUT_MAX 64.0f
+#define DISPLAY_LUT_MAX_CACHED 4
+/* baking is about as expensive as transforming a 512x512 image */
+#define DISPLAY_LUT_MIN_PIXELS (512 * 512)
+
+typedef struct DisplayLUT {
+	struct DisplayLUT *next, *prev;
+
+	/* settings the LUT was baked for */
+	char look[MAX_COLORSPACE_NAME];
+	char view[MAX_COLORSPACE_NAME];
+	char display[MAX_COLORSPACE_NAME];
+	float exposure, gamma;
+
+	/* number of processors using the LUT, protected by display_lut_lock */
+	int users;
+
+	/* DISPLAY_LUT_SIZE^3 RGBA entries with red varying fastest,
+	 * alpha is only there to load entries as a whole */
+	float *table;
+} DisplayLUT;
+
+static ListBase global_display_luts = {NULL, NULL};
+static pthread_mutex_t display_lut_lock = BLI_MUTEX_INITIALIZER;
+
+BLI_INLINE float display_lut_shaper_min(void)
+{
+	return log2f(DISPLAY_LUT_OFFSET);
+}
+
+BLI_INLINE float display_lut_shaper_scale(void)
+{
+	return (DISPLAY_LUT_SIZE - 1) / (log2f(DISPLAY_LUT_MAX + DISPLAY_LUT_OFFSET) - display_lut_shaper_min());
+}
+
+typedef struct DisplayLUTBakeData {
+	OCIO_ConstProcessorRcPtr *processor;
+	float *table;
+	/* scene linear value of every LUT coordinate */
+	float nodes[DISPLAY_LUT_SIZE];
+} DisplayLUTBakeData;
+
+static void display_lut_bake_slice(void *userdata, int b)
+{
+	DisplayLUTBakeData *data = userdata;
+	const int size = DISPLAY_LUT_SIZE;
+	float *slice = data->table + ((size_t)4) * size * size * b;
+	float *entry = slice;
+	OCIO_PackedImageDesc *img;
+	int r, g;
+
+	for (g = 0; g < size; g++) {
+		for (r = 0; r < size; r++, entry += 4) {
+			entry[0] = data->nodes[r];
+			entry[1] = data->nodes[g];
+			entry[2] = data->nodes[b];
+			entry[3] = 1.0f;
+		}
+	}
+
+	img = OCIO_createOCIO_PackedImageDesc(slice, size, size, 4, sizeof(float),
+	                                      4 * sizeof(float), 4 * sizeof(float) * size);
+	OCIO_processorApply(data->processor, img);
+	OCIO_PackedImageDescRelease(img);
+}
+
+static void display_lut_bake(DisplayLUT *lut, OCIO_ConstProcessorRcPtr *processor)
+{
+	DisplayLUTBakeData data;
+	const float shaper_min = display_lut_shaper_min();
+	const float shaper_scale = display_lut_shaper_scale();
+	int i;
+
+	data.processor = processor;
+	data.table = lut->table;
+
+	for (i = 0; i < DISPLAY_LUT_SIZE; i++) {
+		data.nodes[i] = exp2f(shaper_min + i / shaper_scale) - DISPLAY_LUT_OFFSET;
+	}
+	data.nodes[0] = 0.0f;
+	data.nodes[DISPLAY_LUT_SIZE - 1] = DISPLAY_LUT_MAX;
+
+	BLI_task_parallel_range(0, DISPLAY_LUT_SIZE, &data, display_lut_bake_slice, true);
+}
+
+static DisplayLUT *display_lut_acquire(OCIO_ConstProcessorRcPtr *processor,
+                                       const ColorManagedViewSettings *view_settings,
+                                       const ColorManagedDisplaySettings *display_settings)
+{
+	DisplayLUT *lut, *lut_prev;
+	int tot_lut = 0;
+
+	BLI_mutex_lock(&display_lut_lock);
+
+	for (lut = global_display_luts.first; lut; lut = lut->next) {
+		if (STREQ(lut->look, view_settings->look) &&
+		    STREQ(lut->view, view_settings->view_transform) &&
+		    STREQ(lut->display, display_settings->display_device) &&
+		    lut->exposure == view_settings->exposure &&
+		    lut->gamma == view_settings->gamma)
+		{
+			/* most recently used LUTs are kept first */
+			BLI_remlink(&global_display_luts, lut);
+			BLI_addhead(&global_display_luts, lut);
+			lut->users++;
+
+			BLI_mutex_unlock(&display_lut_lock);
+
+			return lut;
+		}
+		tot_lut++;
+	}
+
+	/* free least recently used LUTs which are not in use */
+	for (lut = global_display_luts.last; lut && tot_lut >= DISPLAY_LUT_MAX_CACHED; lut = lut_prev) {
+		lut_prev = lut->prev;
+
+		if (lut->users == 0) {
+			BLI_remlink(&global_display_luts, lut);
+			MEM_freeN(lut->table);
+			MEM_freeN(lut);
+			tot_lut--;
+		}
+	}
+
+	lut = MEM_callocN(sizeof(DisplayLUT), "display transform LUT");
+	BLI_strncpy(lut->look, view_settings->look, sizeof(lut->look));
+	BLI_strncpy(lut->view, view_settings->view_transform, sizeof(lut->view));
+	BLI_strncpy(lut->display, display_settings->display_device, sizeof(lut->display));
+	lut->exposure = view_settings->exposure;
+	lut->gamma = view_settings->gamma;
+	lut->table = MEM_mallocN_aligned(sizeof(float) * 4 * DISPLAY_LUT_SIZE * DISPLAY_LUT_SIZE * DISPLAY_LUT_SIZE,
+	                                 16, "display transform LUT table");
+
+	display_lut_bake(lut, processor);
+
+	lut->users = 1;
+	BLI_addhead(&global_display_luts, lut);
+
+	BLI_mutex_unlock(&display_lut_lock);
+
+	return lut;
+}
+
+static void display_lut_release(DisplayLUT *lut)
+{
+	BLI_mutex_lock(&display_lut_lock);
+	lut->users--;
+	BLI_mutex_unlock(&display_lut_lock);
+}
+
+static void display_luts_free(void)
+{
+	DisplayLUT *lut;
+
+	for (lut = global_display_luts.first; lut; lut = lut->next) {
+		BLI_assert(lut->users == 0);
+		MEM_freeN(lut->table);
+	}
+
+	BLI_freelistN(&global_display_luts);
+}
+
+#ifdef __SSE2__
+/* log2 of positive normalized values, accurate to about 1e-7 */
+BLI_INLINE __m128 display_lut_log2_v4(__m128 x)
+{
+	const __m128i bits = _mm_castps_si128(x);
+	__m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+	__m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)),
+	                                         _mm_set1_epi32(0x3f800000)));
+	/* move mantissa into [sqrt(0.5), sqrt(2)) */
+	const __m128 high = _mm_cmpgt_ps(m, _mm_set1_ps((float)M_SQRT2));
+	__m128 z, z2, p;
+
+	m = _mm_sub_ps(m, _mm_and_ps(high, _mm_mul_ps(m, _mm_set1_ps(0.5f))));
+	e = _mm_add_ps(e, _mm_and_ps(high, _mm_set1_ps(1.0f)));
+
+	/* log(m) = 2 * atanh((m - 1) / (m + 1)) */
+	z = _mm_div_ps(_mm_sub_ps(m, _mm_set1_ps(1.0f)), _mm_add_ps(m, _mm_set1_ps(1.0f)));
+	z2 = _mm_mul_ps(z, z);
+	p = _mm_add_ps(_mm_set1_ps(1.0f / 5.0f), _mm_mul_ps(z2, _mm_set1_ps(1.0f / 7.0f)));
+	p = _mm_add_ps(_mm_set1_ps(1.0f / 3.0f), _mm_mul_ps(z2, p));
+	p = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(z2, p));
+	p = _mm_mul_ps(_mm_mul_ps(z, p), _mm_set1_ps((float)(2.0 / M_LN2)));
+
+	return _mm_add_ps(e, p);
+}
+#endif
+
+/* tetrahedral interpolation of the LUT, rgb is expected to be in [0, DISPLAY_LUT_MAX] */
+static void display_lut_evaluate(const DisplayLUT *lut, float rgb[3])
+{
+	const int size = DISPLAY_LUT_SIZE;
+	const int stride[3] = {4, 4 * size, 4 * size * size};
+	float fr[4], w[4];
+	int ofs[2], base;
+	const float *table = lut->table;
+
+	/* LUT cell and position inside of it */
+#ifdef __SSE2__
+	__m128 v = _mm_set_ps(0.0f, rgb[2], rgb[1], rgb[0]);
+	__m128 index_f;
+	int index[4];
+
+	v = display_lut_log2_v4(_mm_add_ps(v, _mm_set1_ps(DISPLAY_LUT_OFFSET)));
+	v = _mm_mul_ps(_mm_sub_ps(v, _mm_set1_ps(display_lut_shaper_min())), _mm_set1_ps(display_lut_shaper_scale()));
+	v = _mm_max_ps(v, _mm_setzero_ps());
+	index_f = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(v)), _mm_set1_ps(size - 2));
+	_mm_storeu_ps(fr, _mm_sub_ps(v, index_f));
+	_mm_storeu_si128((__m128i *)index, _mm_cvttps_epi32(index_f));
+	base = index[0] * stride[0] + index[1] * stride[1] + index[2] * stride[2];
+#else
+	int i;
+
+	base = 0;
+	for (i = 0; i < 3; i++) {
+		const float co = max_ff((log2f(rgb[i] + DISPLAY_LUT_OFFSET) - display_lut_shaper_min()) *
+		                        display_lut_shaper_scale(), 0.0f);
+		const int index = min_ii((int)co, size - 2);
+
+		fr[i] = co - index;
+		base += index * stride[i];
+	}
+#endif
+
+	/* pick the tetrahedron containing the point, walking from the
+	 * lower corner to the upper one along the largest fraction first */
+	if (fr[0] > fr[1]) {
+		if (fr[1] > fr[2]) {
+			ofs[0] = stride[0];
+			ofs[1] = stride[0] + stride[1];
+			w[0] = 1.0f - fr[0]; w[1] = fr[0] - fr[1]; w[2] = fr[1] - fr[2]; w[3] = fr[2];
+		}
+		else if (fr[0] > fr[2]) {
+			ofs[0] = stride[0];
+			ofs[1] = stride[0] + stride[2];
+			w[0] = 1.0f - fr[0]; w[1] = fr[0] - fr[2]; w[2] = fr[2] - fr[1]; w[3] = fr[1];
+		}
+		else {
+			ofs[0] = stride[2];
+			ofs[1] = stride[2] + stride[0];
+			w[0] = 1.0f - fr[2]; w[1] = fr[2] - fr[0]; w[2] = fr[0] - fr[1]; w[3] = fr[1];
+		}
+	}
+	else {
+		if (fr[2] > fr[1]) {
+			ofs[0] = stride[2];
+			ofs[1] = stride[2] + stride[1];
+			w[0] = 1.0f - fr[2]; w[1] = fr[2] - fr[1]; w[2] = fr[1] - fr[0]; w[3] = fr[0];
+		}
+		else if (fr[2] > fr[0]) {
+			ofs[0] = stride[1];
+			ofs[1] = stride[1] + stride[2];
+			w[0] = 1.0f - fr[1]; w[1] = fr[1] - fr[2]; w[2] = fr[2] - fr[0]; w[3] = fr[0];
+		}
+		else {
+			ofs[0] = stride[1];
+			ofs[1] = stride[1] + stride[0];
+			w[0] = 1.0f - fr[1]; w[1] = fr[1] - fr[0]; w[2] = fr[0] - fr[2]; w[3] = fr[2];
+		}
+	}
+
+	table += base;
+
+#ifdef __SSE2__
+	v = _mm_mul_ps(_mm_load_ps(table), _mm_set1_ps(w[0]));
+	v = _mm_add_ps(v, _mm_mul_ps(_mm_load_ps(table + ofs[0]), _mm_set1_ps(w[1])));
+	v = _mm_add_ps(v, _mm_mul_ps(_mm_load_ps(table + ofs[1]), _mm_set1_ps(w[2])));
+	v = _mm_add_ps(v, _mm_mul_ps(_mm_load_ps(table + stride[0] + stride[1] + stride[2]), _mm_set1_ps(w[3])));
+	{
+		float result[4];
+
+		_mm_storeu_ps(result, v);
+		copy_v3_v3(rgb, result);
+	}
+#else
+	{
+		const float *c1 = table + ofs[0], *c2 = table + ofs[1], *c3 = table + stride[0] + stride[1] + stride[2];
+
+		for (i = 0; i < 3; i++) {
+			rgb[i] = w[0] * table[i] + w[1] * c1[i] + w[2] * c2[i] + w[3] * c3[i];
+		}
+	}
+#endif
+}
+
+BLI_INLINE bool display_lut_in_range(const float rgb[3])
+{
+	/* also false for NaN */
+	return (rgb[0] >= 0.0f && rgb[0] <= DISPLAY_LUT_MAX &&
+	        rgb[1] >= 0.0f && rgb[1] <= DISPLAY_LUT_MAX &&
+	        rgb[2] >= 0.0f && rgb[2] <= DISPLAY_LUT_MAX);
+}
+
+/* same as applying the OCIO processor to the buffer */
+static void display_lut_apply(ColormanageProcessor *cm_processor, float *buffer, size_t tot_pixel,
+                              int channels, bool predivide)
+{
+	const DisplayLUT *lut = cm_processor->display_lut;
+	float *pixel = buffer;
+	size_t i;
+
+	for (i = 0; i < tot_pixel; i++, pixel += channels) {
+		const float alpha = (channels == 4) ? pixel[3] : 1.0f;
+		const bool use_straight = predivide && channels == 4 && alpha != 1.0f && alpha != 0.0f;
+		float rgb[3];
+
+		if (use_straight)
+			mul_v3_v3fl(rgb, pixel, 1.0f / alpha);
+		else
+			copy_v3_v3(rgb, pixel);
+
+		if (display_lut_in_range(rgb)) {
+			display_lut_evaluate(lut, rgb);
+
+			if (use_straight)
+				mul_v3_v3fl(pixel, rgb, alpha);
+			else
+				copy_v3_v3(pixel, rgb);
+		}
+		else if (channels == 4) {
+			if (predivide)
+				OCIO_processorApplyRGBA_predivide(cm_processor->processor, pixel);
+			else
+				OCIO_processorApplyRGBA(cm_processor->processor, pixel);
+		}
+		else {
+			OCIO_processorApplyRGB(cm_processor->processor, pixel);
+		}
+	}
+}
+
 /*********************** Threaded display buffer transform routines *************************/
 
 typedef struct DisplayBufferThread {
@@ -1534,9 +1936,19 @@ static void colormanage_display_buffer_process_ex(ImBuf *ibuf, float *display_bu
 		skip_transform = is_ibuf_rect_in_display_space(ibuf, view_settings, display_settings);
 	}
 
-	if (skip_transform == false)
+	if (skip_transform == false) {
 		cm_processor = IMB_colormanagement_display_processor_new(view_settings, display_settings);
 
+		/* the baked transform is only accurate enough for byte display buffers */
+		if (global_use_display_lut && display_buffer == NULL && ibuf->rect_float && ibuf->channels >= 3 &&
+		    cm_processor->processor && !cm_processor->is_data_result &&
+		    (ibuf->colormanage_flag & IMB_COLORMANAGE_IS_DATA) == 0 &&
+		    ((size_t)ibuf->x) * ibuf->y >= DISPLAY_LUT_MIN_PIXELS)
+		{
+			cm_processor->display_lut = display_lut_acquire(cm_processor->processor, view_settings, display_settings);
+		}
+	}
+
 	display_buffer_apply_threaded(ibuf, ibuf->rect_float, (unsigned char *) ibuf->rect,
 	                              display_buffer, display_buffer_byte, cm_processor);
 
@@ -2059,7 +2471,7 @@ unsigned char *IMB_display_buffer_acquire(ImBuf *ibuf, const ColorManagedViewSet
 		/* all display buffers were marked as invalid from other areas,
 		 * now propagate this flag to internal color management routines
 		 */
-		memset(ibuf->display_buffer_flags, 0, global_tot_display * sizeof(unsigned int));
+		colormanage_cache_invalidate(ibuf);
 
 		ibuf->userflags &= ~IB_DISPLAY_BUFFER_INVALID;
 	}
@@ -2825,8 +3237,11 @@ static void imb_partial_display_buffer_update_ex(ImBuf *ibuf,
 		buffer_width = ibuf->x;
 
 		/* Mark all other buffers as invalid. */
-		memset(ibuf->display_buffer_flags, 0, global_tot_display * sizeof(unsigned int));
+		colormanage_cache_invalidate(ibuf);
 		ibuf->display_buffer_flags[display_index] |= view_flag;
+		if (display_buffer) {
+			colormanage_cache_handle_validate(ibuf, cache_handle);
+		}
 
 		BLI_unlock_thread(LOCK_COLORMANAGE);
 	}
@@ -3082,7 +3497,10 @@ void IMB_colormanagement_processor_apply(ColormanageProcessor *cm_processor, flo
 		}
 	}
 
-	if (cm_processor->processor && channels >= 3) {
+	if (cm_processor->display_lut && channels >= 3) {
+		display_lut_apply(cm_processor, buffer, ((size_t)width) * height, channels, predivide);
+	}
+	else if (cm_processor->processor && channels >= 3) {
 		OCIO_PackedImageDesc *img;
 
 		/* apply OCIO processor */
@@ -3104,6 +3522,8 @@ void IMB_colormanagement_processor_free(ColormanageProcessor *cm_processor)
 {
 	if (cm_processor->curve_mapping)
 		curvemapping_free(cm_processor->curve_mapping);
+	if (cm_processor->display_lut)
+		display_lut_release(cm_processor->display_lut);
 	if (cm_processor->processor)
 		OCIO_processorRelease(cm_processor->processor);
 
@@ -36,6 +36,8 @@
 #include "BLI_string.h"
 #include "BLI_fileops.h"
 #include "BLI_ghash.h"
+#include "BLI_listbase.h"
+#include "BLI_threads.h"
 
 #include "IMB_indexer.h"
 #include "IMB_anim.h"
@@ -380,10 +382,9 @@ void IMB_anim_get_fname(struct anim *anim, char *file, int size)
 	BLI_strncpy(file, fname, size);
 }
 
-static void get_proxy_filename(struct anim *anim, IMB_Proxy_Size preview_size,
-                               char *fname, bool temp)
+static void get_proxy_filename_ex(const char *index_dir, int streamindex, IMB_Proxy_Size preview_size,
+                                  char *fname, bool temp)
 {
-	char index_dir[FILE_MAXDIR];
 	int i = IMB_proxy_size_to_array_index(preview_size);
 
 	char proxy_name[256];
@@ -392,16 +393,29 @@ static void get_proxy_filename(struct anim *anim, IMB_Proxy_Size preview_size,
 	
 	stream_suffix[0] = 0;
 
-	if (anim->streamindex > 0) {
-		BLI_snprintf(stream_suffix, sizeof(stream_suffix), "_st%d", anim->streamindex);
+	if (streamindex > 0) {
+		BLI_snprintf(stream_suffix, sizeof(stream_suffix), "_st%d", streamindex);
 	}
 
 	BLI_snprintf(proxy_name, sizeof(proxy_name), name,
-	             (int) (proxy_fac[i] * 100), stream_suffix, anim->suffix);
+	             (int) (proxy_fac[i] * 100), stream_suffix);
+
+	BLI_join_dirfile(fname, FILE_MAXFILE + FILE_MAXDIR, index_dir, proxy_name);
+}
+
+static void get_proxy_filename(struct anim *anim, IMB_Proxy_Size preview_size,
+                               char *fname, bool temp)
+{
+	char index_dir[FILE_MAXDIR];
 
 	get_index_dir(anim, index_dir, sizeof(index_dir));
+	get_proxy_filename_ex(index_dir, anim->streamindex, preview_size, fname, temp);
+}
 
-	BLI_join_dirfile(fname, FILE_MAXFILE + FILE_MAXDIR, index_dir, proxy_name);
+void IMB_anim_proxy_filepath_get(const char *index_dir, int streamindex, IMB_Proxy_Size preview_size,
+                                 char *filepath)
+{
+	get_proxy_filename_ex(index_dir, streamindex, preview_size, filepath, false);
 }
 
 static void get_tc_filename(struct anim *anim, IMB_Timecode_Type tc,
@@ -459,8 +473,27 @@ struct proxy_output_ctx {
 	int proxy_size;
 	int orig_height;
 	struct anim *anim;
+
+	/* Frames waiting to be scaled and encoded by the worker thread of this
+	 * proxy size, at most PROXY_QUEUE_MAX_FRAMES so a slow encoder stalls the
+	 * decoder instead of piling up decoded frames. */
+	ThreadQueue *queue;
+	ThreadMutex queue_lock;
+	ThreadCondition queue_cond;
+	int queue_len;
+	bool cancel;
 };
 
+/* Decoded picture shared by the proxy workers, freed by the last user. */
+typedef struct ProxyFrame {
+	AVFrame *frame;
+	int users;
+} ProxyFrame;
+
+#define PROXY_QUEUE_MAX_FRAMES 8
+
+static ThreadMutex proxy_frame_lock = BLI_MUTEX_INITIALIZER;
+
 // work around stupid swscaler 16 bytes alignment bug...
 
 static int round_up(int x, int mod)
@@ -694,6 +727,85 @@ static void free_proxy_output_ffmpeg(struct proxy_output_ctx *ctx,
 	MEM_freeN(ctx);
 }
 
+/* decoded frames are only valid until the next decode call, so they are
+ * copied once and handed to all proxy workers */
+static ProxyFrame *proxy_frame_create(AVCodecContext *codec_ctx, AVFrame *in_frame, int users)
+{
+	ProxyFrame *pframe = MEM_mallocN(sizeof(ProxyFrame), "proxy frame");
+	int width = codec_ctx->width;
+	int height = codec_ctx->height;
+
+	pframe->frame = av_frame_alloc();
+	avpicture_fill((AVPicture *) pframe->frame,
+	               MEM_mallocN(avpicture_get_size(
+	                               codec_ctx->pix_fmt,
+	                               round_up(width, 16), height),
+	                           "proxy frame data"),
+	               codec_ctx->pix_fmt, round_up(width, 16), height);
+	av_picture_copy((AVPicture *) pframe->frame, (const AVPicture *) in_frame,
+	                codec_ctx->pix_fmt, width, height);
+
+	pframe->frame->width = width;
+	pframe->frame->height = height;
+	pframe->frame->format = codec_ctx->pix_fmt;
+	pframe->users = users;
+
+	return pframe;
+}
+
+static void proxy_frame_release(ProxyFrame *pframe)
+{
+	bool last_user;
+
+	BLI_mutex_lock(&proxy_frame_lock);
+	last_user = (--pframe->users == 0);
+	BLI_mutex_unlock(&proxy_frame_lock);
+
+	if (last_user) {
+		MEM_freeN(pframe->frame->data[0]);
+		av_free(pframe->frame);
+		MEM_freeN(pframe);
+	}
+}
+
+static void *proxy_output_thread(void *data)
+{
+	struct proxy_output_ctx *ctx = data;
+	ProxyFrame *pframe;
+
+	while ((pframe = BLI_thread_queue_pop(ctx->queue))) {
+		bool cancel;
+
+		BLI_mutex_lock(&ctx->queue_lock);
+		cancel = ctx->cancel;
+		BLI_mutex_unlock(&ctx->queue_lock);
+
+		if (!cancel) {
+			add_to_proxy_output_ffmpeg(ctx, pframe->frame);
+		}
+		proxy_frame_release(pframe);
+
+		BLI_mutex_lock(&ctx->queue_lock);
+		ctx->queue_len--;
+		BLI_condition_notify_one(&ctx->queue_cond);
+		BLI_mutex_unlock(&ctx->queue_lock);
+	}
+
+	return NULL;
+}
+
+static void proxy_output_push(struct proxy_output_ctx *ctx, ProxyFrame *pframe)
+{
+	BLI_mutex_lock(&ctx->queue_lock);
+	while (ctx->queue_len >= PROXY_QUEUE_MAX_FRAMES) {
+		BLI_condition_wait(&ctx->queue_cond, &ctx->queue_lock);
+	}
+	ctx->queue_len++;
+	BLI_mutex_unlock(&ctx->queue_lock);
+
+	BLI_thread_queue_push(ctx->queue, pframe);
+}
+
 typedef struct FFmpegIndexBuilderContext {
 	int anim_type;
 
@@ -709,6 +821,10 @@ typedef struct FFmpegIndexBuilderContext {
 	struct proxy_output_ctx *proxy_ctx[IMB_PROXY_MAX_SLOT];
 	anim_index_builder *indexer[IMB_TC_MAX_SLOT];
 
+	/* one scale and encode thread per proxy size */
+	ListBase proxy_threads;
+	int num_proxy_threads;
+
 	IMB_Timecode_Type tcs_in_use;
 	IMB_Proxy_Size proxy_sizes_in_use;
 
@@ -852,8 +968,15 @@ static void index_rebuild_ffmpeg_proc_decoded_frame(
 	unsigned long long s_dts = context->seek_pos_dts;
 	unsigned long long pts = av_get_pts_from_frame(context->iFormatCtx, in_frame);
 
-	for (i = 0; i < context->num_proxy_sizes; i++) {
-		add_to_proxy_output_ffmpeg(context->proxy_ctx[i], in_frame);
+	if (context->num_proxy_threads) {
+		ProxyFrame *pframe = proxy_frame_create(context->iCodecCtx, in_frame,
+		                                        context->num_proxy_threads);
+
+		for (i = 0; i < context->num_proxy_sizes; i++) {
+			if (context->proxy_ctx[i]) {
+				proxy_output_push(context->proxy_ctx[i], pframe);
+			}
+		}
 	}
 
 	if (!context->start_pts_set) {
@@ -896,6 +1019,74 @@ static void index_rebuild_ffmpeg_proc_decoded_frame(
 	context->frameno_gapless++;
 }
 
+static void index_rebuild_ffmpeg_begin_proxy_threads(FFmpegIndexBuilderContext *context)
+{
+	int i;
+
+	for (i = 0; i < context->num_proxy_sizes; i++) {
+		if (context->proxy_ctx[i]) {
+			context->num_proxy_threads++;
+		}
+	}
+
+	if (context->num_proxy_threads == 0) {
+		return;
+	}
+
+	BLI_init_threads(&context->proxy_threads, proxy_output_thread, context->num_proxy_threads);
+
+	for (i = 0; i < context->num_proxy_sizes; i++) {
+		struct proxy_output_ctx *ctx = context->proxy_ctx[i];
+
+		if (ctx) {
+			ctx->queue = BLI_thread_queue_init();
+			BLI_mutex_init(&ctx->queue_lock);
+			BLI_condition_init(&ctx->queue_cond);
+			ctx->queue_len = 0;
+			ctx->cancel = false;
+
+			BLI_insert_thread(&context->proxy_threads, ctx);
+		}
+	}
+}
+
+/* wait for the workers to encode the queued frames, or just drop them when cancelled */
+static void index_rebuild_ffmpeg_end_proxy_threads(FFmpegIndexBuilderContext *context, bool cancel)
+{
+	int i;
+
+	if (context->num_proxy_threads == 0) {
+		return;
+	}
+
+	for (i = 0; i < context->num_proxy_sizes; i++) {
+		struct proxy_output_ctx *ctx = context->proxy_ctx[i];
+
+		if (ctx) {
+			BLI_mutex_lock(&ctx->queue_lock);
+			ctx->cancel = cancel;
+			BLI_mutex_unlock(&ctx->queue_lock);
+
+			BLI_thread_queue_nowait(ctx->queue);
+		}
+	}
+
+	BLI_end_threads(&context->proxy_threads);
+
+	for (i = 0; i < context->num_proxy_sizes; i++) {
+		struct proxy_output_ctx *ctx = context->proxy_ctx[i];
+
+		if (ctx) {
+			BLI_thread_queue_free(ctx->queue);
+			BLI_mutex_end(&ctx->queue_lock);
+			BLI_condition_end(&ctx->queue_cond);
+			ctx->queue = NULL;
+		}
+	}
+
+	context->num_proxy_threads = 0;
+}
+
 static int index_rebuild_ffmpeg(FFmpegIndexBuilderContext *context,
                                 short *stop, short *do_update, float *progress)
 {
@@ -912,6 +1103,8 @@ static int index_rebuild_ffmpeg(FFmpegIndexBuilderContext *context,
 	context->frame_rate = av_q2d(av_get_r_frame_rate_compat(context->iStream));
 	context->pts_time_base = av_q2d(context->iStream->time_base);
 
+	index_rebuild_ffmpeg_begin_proxy_threads(context);
+
 	while (av_read_frame(context->iFormatCtx, &next_packet) >= 0) {
 		int frame_finished = 0;
 		float next_progress =  (float)((int)floor(((double) next_packet.pos) * 100 /
@@ -973,6 +1166,8 @@ static int index_rebuild_ffmpeg(FFmpegIndexBuilderContext *context,
 		} while (frame_finished);
 	}
 
+	index_rebuild_ffmpeg_end_proxy_threads(context, *stop != 0);
+
 	av_free(in_frame);
 
 	return 1;
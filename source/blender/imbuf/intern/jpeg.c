@@ -62,7 +62,8 @@ static void skip_input_data(j_decompress_ptr cinfo, long num_bytes);
 static void term_source(j_decompress_ptr cinfo);
 static void memory_source(j_decompress_ptr cinfo, const unsigned char *buffer, size_t size);
 static boolean handle_app1(j_decompress_ptr cinfo);
-static ImBuf *ibJpegImageFromCinfo(struct jpeg_decompress_struct *cinfo, int flags);
+static ImBuf *ibJpegImageFromCinfo(struct jpeg_decompress_struct *cinfo, int flags, size_t max_size,
+                                   size_t *r_width, size_t *r_height);
 
 static const uchar jpeg_default_quality = 75;
 static uchar ibuf_quality;
@@ -271,7 +272,9 @@ static boolean handle_app1(j_decompress_ptr cinfo)
 }
 
 
-static ImBuf *ibJpegImageFromCinfo(struct jpeg_decompress_struct *cinfo, int flags)
+/* max_size: when non-zero, decode at the lowest scale the image stays at least this large */
+static ImBuf *ibJpegImageFromCinfo(struct jpeg_decompress_struct *cinfo, int flags, size_t max_size,
+                                   size_t *r_width, size_t *r_height)
 {
 	JSAMPARRAY row_pointer;
 	JSAMPLE *buffer = NULL;
@@ -293,8 +296,30 @@ static ImBuf *ibJpegImageFromCinfo(struct jpeg_decompress_struct *cinfo, int fla
 		y = cinfo->image_height;
 		depth = cinfo->num_components;
 
+		if (r_width) {
+			*r_width = x;
+			*r_height = y;
+		}
+
 		if (cinfo->jpeg_color_space == JCS_YCCK) cinfo->out_color_space = JCS_CMYK;
 
+		if (max_size) {
+			/* DCT scaling, the decoder skips what a downscale would throw away */
+			const size_t largest = (size_t)MAX2(x, y);
+			unsigned int scale = 8;
+
+			while (scale > 1 && largest / scale < max_size) {
+				scale /= 2;
+			}
+			cinfo->scale_num = 1;
+			cinfo->scale_denom = scale;
+			cinfo->dct_method = JDCT_IFAST;
+			jpeg_calc_output_dimensions(cinfo);
+
+			x = cinfo->output_width;
+			y = cinfo->output_height;
+		}
+
 		jpeg_start_decompress(cinfo);
 
 		if (flags & IB_test) {
@@ -453,11 +478,38 @@ ImBuf *imb_load_jpeg(const unsigned char *buffer, size_t size, int flags, char c
 	jpeg_create_decompress(cinfo);
 	memory_source(cinfo, buffer, size);
 
-	ibuf = ibJpegImageFromCinfo(cinfo, flags);
+	ibuf = ibJpegImageFromCinfo(cinfo, flags, 0, NULL, NULL);
 	
 	return(ibuf);
 }
 
+ImBuf *imb_thumbnail_jpeg(const unsigned char *buffer, size_t size, int flags, size_t max_thumb_size,
+                          char colorspace[IM_MAX_SPACE], size_t *r_width, size_t *r_height)
+{
+	struct jpeg_decompress_struct _cinfo, *cinfo = &_cinfo;
+	struct my_error_mgr jerr;
+	ImBuf *ibuf;
+
+	if (!imb_is_a_jpeg(buffer)) return NULL;
+
+	colorspace_set_default_role(colorspace, IM_MAX_SPACE, COLOR_ROLE_DEFAULT_BYTE);
+
+	cinfo->err = jpeg_std_error(&jerr.pub);
+	jerr.pub.error_exit = jpeg_error;
+
+	if (setjmp(jerr.setjmp_buffer)) {
+		jpeg_destroy_decompress(cinfo);
+		return NULL;
+	}
+
+	jpeg_create_decompress(cinfo);
+	memory_source(cinfo, buffer, size);
+
+	ibuf = ibJpegImageFromCinfo(cinfo, flags, max_thumb_size, r_width, r_height);
+
+	return ibuf;
+}
+
 
 static void write_jpeg(struct jpeg_compress_struct *cinfo, struct ImBuf *ibuf)
 {
@@ -2101,6 +2101,98 @@ struct ImBuf *imb_load_openexr(const unsigned char *mem, size_t size, int flags,
 
 }
 
+struct ImBuf *imb_thumbnail_openexr(const unsigned char *mem, size_t size, int flags, size_t max_thumb_size,
+                                    char colorspace[IM_MAX_SPACE], size_t *r_width, size_t *r_height)
+{
+	struct ImBuf *ibuf = NULL;
+	Mem_IStream *membuf = NULL;
+	MultiPartInputFile *file = NULL;
+	float *row = NULL;
+
+	if (imb_is_a_openexr(mem) == 0) return(NULL);
+
+	colorspace_set_default_role(colorspace, IM_MAX_SPACE, COLOR_ROLE_DEFAULT_FLOAT);
+
+	try
+	{
+		membuf = new Mem_IStream((unsigned char *)mem, size);
+		file = new MultiPartInputFile(*membuf);
+
+		Box2i dw = file->header(0).dataWindow();
+		const int width  = dw.max.x - dw.min.x + 1;
+		const int height = dw.max.y - dw.min.y + 1;
+
+		/* multilayer, multiview and luminance files are left to the regular loader */
+		if (!imb_exr_is_multi(*file) && exr_has_rgb(*file)) {
+			const float scale = std::min(1.0f, (float)max_thumb_size / (float)std::max(width, height));
+			const int thumb_width = std::max((int)(width * scale), 1);
+			const int thumb_height = std::max((int)(height * scale), 1);
+			const int xstride = sizeof(float) * 4;
+			FrameBuffer frameBuffer;
+			float *first;
+
+			ibuf = IMB_allocImBuf(thumb_width, thumb_height, exr_has_alpha(*file) ? 32 : 24, IB_rectfloat);
+			ibuf->ftype = IMB_FTYPE_OPENEXR;
+
+			/* zero y stride, every scanline is read into the same row */
+			row = (float *)MEM_mallocN(sizeof(float) * 4 * width, __func__);
+			first = row - 4 * dw.min.x;
+
+			frameBuffer.insert(exr_rgba_channelname(*file, "R"),
+			                   Slice(Imf::FLOAT,  (char *) first, xstride, 0));
+			frameBuffer.insert(exr_rgba_channelname(*file, "G"),
+			                   Slice(Imf::FLOAT,  (char *) (first + 1), xstride, 0));
+			frameBuffer.insert(exr_rgba_channelname(*file, "B"),
+			                   Slice(Imf::FLOAT,  (char *) (first + 2), xstride, 0));
+			frameBuffer.insert(exr_rgba_channelname(*file, "A"),
+			                   Slice(Imf::FLOAT,  (char *) (first + 3), xstride, 0, 1, 1, 1.0f));
+
+			InputPart in (*file, 0);
+			in.setFrameBuffer(frameBuffer);
+
+			/* only decode the scanlines the thumbnail samples, instead of the full image */
+			for (int y = 0; y < thumb_height; y++) {
+				const int source_y = std::min((int)((y + 0.5f) / scale), height - 1);
+				/* y-flipped, the first scanline is the top of the image */
+				float *rect = ibuf->rect_float + (size_t)4 * thumb_width * (thumb_height - 1 - y);
+
+				in.readPixels(dw.min.y + source_y);
+
+				for (int x = 0; x < thumb_width; x++, rect += 4) {
+					const int source_x = std::min((int)((x + 0.5f) / scale), width - 1);
+					const float *pixel = row + 4 * source_x;
+					rect[0] = pixel[0];
+					rect[1] = pixel[1];
+					rect[2] = pixel[2];
+					rect[3] = pixel[3];
+				}
+			}
+
+			if (flags & IB_alphamode_detect)
+				ibuf->flags |= IB_alphamode_premul;
+
+			*r_width = width;
+			*r_height = height;
+		}
+
+		if (row) MEM_freeN(row);
+		delete file;
+		delete membuf;
+
+		return(ibuf);
+	}
+	catch (const std::exception& exc)
+	{
+		std::cerr << exc.what() << std::endl;
+		if (ibuf) IMB_freeImBuf(ibuf);
+		if (row) MEM_freeN(row);
+		delete file;
+		delete membuf;
+
+		return (0);
+	}
+}
+
 void imb_initopenexr(void)
 {
 	int num_threads = BLI_system_thread_count();
@@ -32,9 +32,13 @@
  */
 
 
+#include <string.h>
+
 #include "BLI_utildefines.h"
+#include "BLI_math_base.h"
 #include "BLI_math_color.h"
 #include "BLI_math_interp.h"
+#include "BLI_math_vector.h"
 #include "MEM_guardedalloc.h"
 
 #include "imbuf.h"
@@ -45,6 +49,10 @@
 
 #include "BLI_sys_types.h" // for intptr_t support
 
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
 /************************************************************************/
 /*								SCALING									*/
 /************************************************************************/
@@ -431,1058 +439,344 @@ ImBuf *IMB_onehalf(struct ImBuf *ibuf1)
 	return (ibuf2);
 }
 
-/* q_scale_linear_interpolation helper functions */
+/* ******** separable filter scaling ******** */
 
-static void enlarge_picture_byte(
-        unsigned char *src, unsigned char *dst, int src_width,
-        int src_height, int dst_width, int dst_height)
+/* Scaling is done in two separable passes, first along x into an intermediate
+ * float buffer, then along y into the new buffer. Both passes are threaded
+ * over scanlines.
+ *
+ * The filter weights for each destination sample are computed once up front.
+ * Taps falling outside the image are folded into the border pixel, so the
+ * inner loops never need to clamp. When shrinking the kernel is stretched to
+ * cover all source pixels, which gives the same area average as before for
+ * the box filter. */
+
+typedef enum eScaleFilter {
+	SCALE_FILTER_BOX,
+	SCALE_FILTER_LINEAR,
+} eScaleFilter;
+
+typedef struct ScaleFilterTable {
+	int *start;      /* first source sample of each destination sample */
+	int *tot;        /* number of source samples used */
+	float *weights;  /* tot_max weights for each destination sample */
+	int tot_max;
+} ScaleFilterTable;
+
+typedef struct ScaleFilterData {
+	const ScaleFilterTable *table_x, *table_y;
+	int src_x, dst_x;
+	int channels;
+
+	const unsigned char *src_byte;
+	const float *src_float;
+	float *tmp;
+	unsigned char *dst_byte;
+	float *dst_float;
+} ScaleFilterData;
+
+static void scale_filter_table_init(ScaleFilterTable *table, eScaleFilter filter, int src_len, int dst_len)
 {
-	double ratiox = (double) (dst_width - 1.0)  / (double) (src_width - 1.001);
-	double ratioy = (double) (dst_height - 1.0) / (double) (src_height - 1.001);
-	uintptr_t x_src, dx_src, x_dst;
-	uintptr_t y_src, dy_src, y_dst;
-
-	dx_src = 65536.0 / ratiox;
-	dy_src = 65536.0 / ratioy;
-
-	y_src = 0;
-	for (y_dst = 0; y_dst < dst_height; y_dst++) {
-		unsigned char *line1 = src + (y_src >> 16) * 4 * src_width;
-		unsigned char *line2 = line1 + 4 * src_width;
-		uintptr_t weight1y = 65536 - (y_src & 0xffff);
-		uintptr_t weight2y = 65536 - weight1y;
-
-		if ((y_src >> 16) == src_height - 1) {
-			line2 = line1;
-		}
-
-		x_src = 0;
-		for (x_dst = 0; x_dst < dst_width; x_dst++) {
-			uintptr_t weight1x = 65536 - (x_src & 0xffff);
-			uintptr_t weight2x = 65536 - weight1x;
-
-			unsigned long x = (x_src >> 16) * 4;
-
-			*dst++ = ((((line1[x]     * weight1y) >> 16) * weight1x) >> 16) +
-			         ((((line2[x]     * weight2y) >> 16) * weight1x) >> 16) +
-			         ((((line1[4 + x] * weight1y) >> 16) * weight2x) >> 16) +
-			         ((((line2[4 + x] * weight2y) >> 16) * weight2x) >> 16);
-
-			*dst++ = ((((line1[x + 1]     * weight1y) >> 16) * weight1x) >> 16) +
-			         ((((line2[x + 1]     * weight2y) >> 16) * weight1x) >> 16) +
-			         ((((line1[4 + x + 1] * weight1y) >> 16) * weight2x) >> 16) +
-			         ((((line2[4 + x + 1] * weight2y) >> 16) * weight2x) >> 16);
-
-			*dst++ = ((((line1[x + 2]     * weight1y) >> 16) * weight1x) >> 16) +
-			         ((((line2[x + 2]     * weight2y) >> 16) * weight1x) >> 16) +
-			         ((((line1[4 + x + 2] * weight1y) >> 16) * weight2x) >> 16) +
-			         ((((line2[4 + x + 2] * weight2y) >> 16) * weight2x) >> 16);
+	const float scale = (float)src_len / (float)dst_len;
+	const float stretch = max_ff(scale, 1.0f);
+	const float support = ((filter == SCALE_FILTER_BOX) ? 0.5f : 1.0f) * stretch;
+	int i;
 
-			*dst++ = ((((line1[x + 3]     * weight1y) >> 16) * weight1x) >> 16) +
-			         ((((line2[x + 3]     * weight2y) >> 16) * weight1x) >> 16) +
-			         ((((line1[4 + x + 3] * weight1y) >> 16) * weight2x) >> 16) +
-			         ((((line2[4 + x + 3] * weight2y) >> 16) * weight2x) >> 16);
+	table->tot_max = min_ii((int)ceilf(2.0f * support) + 2, src_len);
+	table->start = MEM_mallocN(sizeof(int) * dst_len, "scale filter start");
+	table->tot = MEM_mallocN(sizeof(int) * dst_len, "scale filter tot");
+	table->weights = MEM_callocN(sizeof(float) * dst_len * table->tot_max, "scale filter weights");
+
+	for (i = 0; i < dst_len; i++) {
+		/* source pixel j covers [j, j + 1] */
+		const float center = ((float)i + 0.5f) * scale;
+		const int lo = (int)floorf(center - support);
+		const int hi = (int)ceilf(center + support);
+		const int first = max_ii(lo, 0);
+		const int last = min_ii(hi, src_len - 1);
+		float *weights = table->weights + (size_t)i * table->tot_max;
+		float totweight = 0.0f;
+		int j, tot, ofs;
+
+		for (j = lo; j <= hi; j++) {
+			float weight;
+
+			if (filter == SCALE_FILTER_BOX) {
+				weight = min_ff((float)(j + 1), center + support) - max_ff((float)j, center - support);
+			}
+			else {
+				weight = 1.0f - fabsf((float)j + 0.5f - center) / stretch;
+			}
+			weight = max_ff(weight, 0.0f);
 
-			x_src += dx_src;
+			weights[CLAMPIS(j, first, last) - first] += weight;
 		}
-		y_src += dy_src;
-	}
-}
-
-struct scale_outpix_byte {
-	uintptr_t r;
-	uintptr_t g;
-	uintptr_t b;
-	uintptr_t a;
-
-	uintptr_t weight;
-};
 
-static void shrink_picture_byte(
-        unsigned char *src, unsigned char *dst, int src_width,
-        int src_height, int dst_width, int dst_height)
-{
-	double ratiox = (double) (dst_width) / (double) (src_width);
-	double ratioy = (double) (dst_height) / (double) (src_height);
-	uintptr_t x_src, dx_dst, x_dst;
-	uintptr_t y_src, dy_dst, y_dst;
-	intptr_t y_counter;
-	unsigned char *dst_begin = dst;
-
-	struct scale_outpix_byte *dst_line1 = NULL;
-	struct scale_outpix_byte *dst_line2 = NULL;
-
-	dst_line1 = (struct scale_outpix_byte *) MEM_callocN(
-	    (dst_width + 1) * sizeof(struct scale_outpix_byte),
-	    "shrink_picture_byte 1");
-	dst_line2 = (struct scale_outpix_byte *) MEM_callocN(
-	    (dst_width + 1) * sizeof(struct scale_outpix_byte),
-	    "shrink_picture_byte 2");
-
-	dx_dst = 65536.0 * ratiox;
-	dy_dst = 65536.0 * ratioy;
-
-	y_dst = 0;
-	y_counter = 65536;
-	for (y_src = 0; y_src < src_height; y_src++) {
-		unsigned char *line = src + y_src * 4 * src_width;
-		uintptr_t weight1y = 65535 - (y_dst & 0xffff);
-		uintptr_t weight2y = 65535 - weight1y;
-		x_dst = 0;
-		for (x_src = 0; x_src < src_width; x_src++) {
-			uintptr_t weight1x = 65535 - (x_dst & 0xffff);
-			uintptr_t weight2x = 65535 - weight1x;
-
-			uintptr_t x = x_dst >> 16;
-
-			uintptr_t w;
-
-			w = (weight1y * weight1x) >> 16;
-
-			/* ensure correct rounding, without this you get ugly banding, or too low color values (ton) */
-			dst_line1[x].r += (line[0] * w + 32767) >> 16;
-			dst_line1[x].g += (line[1] * w + 32767) >> 16;
-			dst_line1[x].b += (line[2] * w + 32767) >> 16;
-			dst_line1[x].a += (line[3] * w + 32767) >> 16;
-			dst_line1[x].weight += w;
-
-			w = (weight2y * weight1x) >> 16;
-
-			dst_line2[x].r += (line[0] * w + 32767) >> 16;
-			dst_line2[x].g += (line[1] * w + 32767) >> 16;
-			dst_line2[x].b += (line[2] * w + 32767) >> 16;
-			dst_line2[x].a += (line[3] * w + 32767) >> 16;
-			dst_line2[x].weight += w;
-
-			w = (weight1y * weight2x) >> 16;
-
-			dst_line1[x + 1].r += (line[0] * w + 32767) >> 16;
-			dst_line1[x + 1].g += (line[1] * w + 32767) >> 16;
-			dst_line1[x + 1].b += (line[2] * w + 32767) >> 16;
-			dst_line1[x + 1].a += (line[3] * w + 32767) >> 16;
-			dst_line1[x + 1].weight += w;
-
-			w = (weight2y * weight2x) >> 16;
-
-			dst_line2[x + 1].r += (line[0] * w + 32767) >> 16;
-			dst_line2[x + 1].g += (line[1] * w + 32767) >> 16;
-			dst_line2[x + 1].b += (line[2] * w + 32767) >> 16;
-			dst_line2[x + 1].a += (line[3] * w + 32767) >> 16;
-			dst_line2[x + 1].weight += w;
-
-			x_dst += dx_dst;
-			line += 4;
+		/* skip taps which don't contribute */
+		tot = last - first + 1;
+		for (ofs = 0; ofs < tot - 1 && weights[ofs] == 0.0f; ofs++) {
+			/* pass */
 		}
-
-		y_dst += dy_dst;
-		y_counter -= dy_dst;
-		if (y_counter < 0) {
-			int val;
-			uintptr_t x;
-			struct scale_outpix_byte *temp;
-
-			y_counter += 65536;
-			
-			for (x = 0; x < dst_width; x++) {
-				uintptr_t f =  0x80000000UL / dst_line1[x].weight;
-				*dst++ = (val = (dst_line1[x].r * f) >> 15) > 255 ? 255 : val;
-				*dst++ = (val = (dst_line1[x].g * f) >> 15) > 255 ? 255 : val;
-				*dst++ = (val = (dst_line1[x].b * f) >> 15) > 255 ? 255 : val;
-				*dst++ = (val = (dst_line1[x].a * f) >> 15) > 255 ? 255 : val;
-			}
-			memset(dst_line1, 0, dst_width *
-			       sizeof(struct scale_outpix_byte));
-			temp = dst_line1;
-			dst_line1 = dst_line2;
-			dst_line2 = temp;
+		tot -= ofs;
+		while (tot > 1 && weights[ofs + tot - 1] == 0.0f) {
+			tot--;
 		}
-	}
-	if (dst - dst_begin < dst_width * dst_height * 4) {
-		int val;
-		uintptr_t x;
-		for (x = 0; x < dst_width; x++) {
-			uintptr_t f = 0x80000000UL / dst_line1[x].weight;
-			*dst++ = (val = (dst_line1[x].r * f) >> 15) > 255 ? 255 : val;
-			*dst++ = (val = (dst_line1[x].g * f) >> 15) > 255 ? 255 : val;
-			*dst++ = (val = (dst_line1[x].b * f) >> 15) > 255 ? 255 : val;
-			*dst++ = (val = (dst_line1[x].a * f) >> 15) > 255 ? 255 : val;
+		if (ofs) {
+			memmove(weights, weights + ofs, sizeof(float) * tot);
+			memset(weights + tot, 0, sizeof(float) * ofs);
 		}
-	}
-	MEM_freeN(dst_line1);
-	MEM_freeN(dst_line2);
-}
 
+		for (j = 0; j < tot; j++) {
+			totweight += weights[j];
+		}
+		if (totweight != 0.0f) {
+			mul_vn_fl(weights, tot, 1.0f / totweight);
+		}
+		else {
+			weights[0] = 1.0f;
+		}
 
-static void q_scale_byte(unsigned char *in, unsigned char *out, int in_width,
-                         int in_height, int dst_width, int dst_height)
-{
-	if (dst_width > in_width && dst_height > in_height) {
-		enlarge_picture_byte(in, out, in_width, in_height,
-		                     dst_width, dst_height);
-	}
-	else if (dst_width < in_width && dst_height < in_height) {
-		shrink_picture_byte(in, out, in_width, in_height,
-		                    dst_width, dst_height);
+		table->start[i] = first + ofs;
+		table->tot[i] = tot;
 	}
 }
 
-static void enlarge_picture_float(
-        float *src, float *dst, int src_width,
-        int src_height, int dst_width, int dst_height)
+static void scale_filter_table_free(ScaleFilterTable *table)
 {
-	double ratiox = (double) (dst_width - 1.0) / (double) (src_width - 1.001);
-	double ratioy = (double) (dst_height - 1.0) / (double) (src_height - 1.001);
-	uintptr_t x_dst;
-	uintptr_t y_dst;
-	double x_src, dx_src;
-	double y_src, dy_src;
-
-	dx_src = 1.0 / ratiox;
-	dy_src = 1.0 / ratioy;
-
-	y_src = 0;
-	for (y_dst = 0; y_dst < dst_height; y_dst++) {
-		float *line1 = src + ((int) y_src) * 4 * src_width;
-		const float *line2 = line1 + 4 * src_width;
-		const float weight1y = (float)(1.0 - (y_src - (int) y_src));
-		const float weight2y = 1.0f - weight1y;
-
-		if ((int) y_src == src_height - 1) {
-			line2 = line1;
-		}
-
-		x_src = 0;
-		for (x_dst = 0; x_dst < dst_width; x_dst++) {
-			const float weight1x = (float)(1.0 - (x_src - (int) x_src));
-			const float weight2x = (float)(1.0f - weight1x);
-
-			const float w11 = weight1y * weight1x;
-			const float w21 = weight2y * weight1x;
-			const float w12 = weight1y * weight2x;
-			const float w22 = weight2y * weight2x;
-
-			uintptr_t x = ((int) x_src) * 4;
-
-			*dst++ = line1[x]     * w11 +
-			         line2[x]     * w21 +
-			         line1[4 + x] * w12 +
-			         line2[4 + x] * w22;
-
-			*dst++ = line1[x + 1]     * w11 +
-			         line2[x + 1]     * w21 +
-			         line1[4 + x + 1] * w12 +
-			         line2[4 + x + 1] * w22;
-
-			*dst++ = line1[x + 2]     * w11 +
-			         line2[x + 2]     * w21 +
-			         line1[4 + x + 2] * w12 +
-			         line2[4 + x + 2] * w22;
-
-			*dst++ = line1[x + 3]     * w11 +
-			         line2[x + 3]     * w21 +
-			         line1[4 + x + 3] * w12 +
-			         line2[4 + x + 3] * w22;
-
-			x_src += dx_src;
-		}
-		y_src += dy_src;
-	}
+	MEM_freeN(table->start);
+	MEM_freeN(table->tot);
+	MEM_freeN(table->weights);
 }
 
-struct scale_outpix_float {
-	float r;
-	float g;
-	float b;
-	float a;
-
-	float weight;
-};
-
-static void shrink_picture_float(
-        const float *src, float *dst, int src_width,
-        int src_height, int dst_width, int dst_height)
+#ifdef __SSE2__
+BLI_INLINE __m128 scale_load_uchar4(const unsigned char *in)
 {
-	double ratiox = (double) (dst_width) / (double) (src_width);
-	double ratioy = (double) (dst_height) / (double) (src_height);
-	uintptr_t x_src;
-	uintptr_t y_src;
-	float dx_dst, x_dst;
-	float dy_dst, y_dst;
-	float y_counter;
-	const float *dst_begin = dst;
-
-	struct scale_outpix_float *dst_line1;
-	struct scale_outpix_float *dst_line2;
-
-	dst_line1 = (struct scale_outpix_float *) MEM_callocN(
-	        (dst_width + 1) * sizeof(struct scale_outpix_float),
-	        "shrink_picture_float 1");
-	dst_line2 = (struct scale_outpix_float *) MEM_callocN(
-	        (dst_width + 1) * sizeof(struct scale_outpix_float),
-	        "shrink_picture_float 2");
-
-	dx_dst = ratiox;
-	dy_dst = ratioy;
-
-	y_dst = 0;
-	y_counter = 1.0;
-	for (y_src = 0; y_src < src_height; y_src++) {
-		const float *line = src + y_src * 4 * src_width;
-		uintptr_t weight1y = 1.0f - (y_dst - (int) y_dst);
-		uintptr_t weight2y = 1.0f - weight1y;
-		x_dst = 0;
-		for (x_src = 0; x_src < src_width; x_src++) {
-			uintptr_t weight1x = 1.0f - (x_dst - (int) x_dst);
-			uintptr_t weight2x = 1.0f - weight1x;
-
-			uintptr_t x = (int) x_dst;
-
-			float w;
-
-			w = weight1y * weight1x;
-
-			dst_line1[x].r += line[0] * w;
-			dst_line1[x].g += line[1] * w;
-			dst_line1[x].b += line[2] * w;
-			dst_line1[x].a += line[3] * w;
-			dst_line1[x].weight += w;
-
-			w = weight2y * weight1x;
-
-			dst_line2[x].r += line[0] * w;
-			dst_line2[x].g += line[1] * w;
-			dst_line2[x].b += line[2] * w;
-			dst_line2[x].a += line[3] * w;
-			dst_line2[x].weight += w;
-
-			w = weight1y * weight2x;
-
-			dst_line1[x + 1].r += line[0] * w;
-			dst_line1[x + 1].g += line[1] * w;
-			dst_line1[x + 1].b += line[2] * w;
-			dst_line1[x + 1].a += line[3] * w;
-			dst_line1[x + 1].weight += w;
-
-			w = weight2y * weight2x;
-
-			dst_line2[x + 1].r += line[0] * w;
-			dst_line2[x + 1].g += line[1] * w;
-			dst_line2[x + 1].b += line[2] * w;
-			dst_line2[x + 1].a += line[3] * w;
-			dst_line2[x + 1].weight += w;
-
-			x_dst += dx_dst;
-			line += 4;
-		}
-
-		y_dst += dy_dst;
-		y_counter -= dy_dst;
-		if (y_counter < 0) {
-			uintptr_t x;
-			struct scale_outpix_float *temp;
-
-			y_counter += 1.0f;
-			
-			for (x = 0; x < dst_width; x++) {
-				float f = 1.0f / dst_line1[x].weight;
-				*dst++ = dst_line1[x].r * f;
-				*dst++ = dst_line1[x].g * f;
-				*dst++ = dst_line1[x].b * f;
-				*dst++ = dst_line1[x].a * f;
-			}
-			memset(dst_line1, 0, dst_width *
-			       sizeof(struct scale_outpix_float));
-			temp = dst_line1;
-			dst_line1 = dst_line2;
-			dst_line2 = temp;
-		}
-	}
-	if (dst - dst_begin < dst_width * dst_height * 4) {
-		uintptr_t x;
-		for (x = 0; x < dst_width; x++) {
-			float f = 1.0f / dst_line1[x].weight;
-			*dst++ = dst_line1[x].r * f;
-			*dst++ = dst_line1[x].g * f;
-			*dst++ = dst_line1[x].b * f;
-			*dst++ = dst_line1[x].a * f;
-		}
-	}
-	MEM_freeN(dst_line1);
-	MEM_freeN(dst_line2);
+	const __m128i zero = _mm_setzero_si128();
+	__m128i val;
+	int packed;
+
+	memcpy(&packed, in, sizeof(packed));
+	val = _mm_cvtsi32_si128(packed);
+	val = _mm_unpacklo_epi16(_mm_unpacklo_epi8(val, zero), zero);
+	return _mm_cvtepi32_ps(val);
 }
+#endif
 
-
-static void q_scale_float(float *in, float *out, int in_width,
-                          int in_height, int dst_width, int dst_height)
+/* out = in * weight, for a full row */
+static void scale_row_mul(float *out, const float *in, float weight, size_t len)
 {
-	if (dst_width > in_width && dst_height > in_height) {
-		enlarge_picture_float(in, out, in_width, in_height,
-		                      dst_width, dst_height);
+	size_t i = 0;
+#ifdef __SSE2__
+	const __m128 weight_r = _mm_set1_ps(weight);
+
+	for (; i + 4 <= len; i += 4) {
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(in + i), weight_r));
 	}
-	else if (dst_width < in_width && dst_height < in_height) {
-		shrink_picture_float(in, out, in_width, in_height,
-		                     dst_width, dst_height);
+#endif
+	for (; i < len; i++) {
+		out[i] = in[i] * weight;
 	}
 }
 
-/**
- * q_scale_linear_interpolation (derived from ppmqscale, http://libdv.sf.net)
- *
- * q stands for quick _and_ quality :)
- *
- * only handles common cases when we either
- *
- * scale  both, x and y or
- * shrink both, x and y
- *
- * but that is pretty fast:
- * - does only blit once instead of two passes like the old code
- *   (fewer cache misses)
- * - uses fixed point integer arithmetic for byte buffers
- * - doesn't branch in tight loops
- *
- * Should be comparable in speed to the ImBuf ..._fast functions at least
- * for byte-buffers.
- *
- * NOTE: disabled, due to unacceptable inaccuracy and quality loss, see bug #18609 (ton)
- */
-static bool q_scale_linear_interpolation(
-        struct ImBuf *ibuf, int newx, int newy)
+/* out += in * weight, for a full row */
+static void scale_row_madd(float *out, const float *in, float weight, size_t len)
 {
-	if ((newx >= ibuf->x && newy <= ibuf->y) ||
-	    (newx <= ibuf->x && newy >= ibuf->y))
-	{
-		return false;
-	}
-
-	if (ibuf->rect) {
-		unsigned char *newrect =
-		    MEM_mallocN(newx * newy * sizeof(int), "q_scale rect");
-		q_scale_byte((unsigned char *)ibuf->rect, newrect, ibuf->x, ibuf->y,
-		             newx, newy);
+	size_t i = 0;
+#ifdef __SSE2__
+	const __m128 weight_r = _mm_set1_ps(weight);
 
-		imb_freerectImBuf(ibuf);
-		ibuf->mall |= IB_rect;
-		ibuf->rect = (unsigned int *) newrect;
+	for (; i + 4 <= len; i += 4) {
+		__m128 val = _mm_mul_ps(_mm_loadu_ps(in + i), weight_r);
+		_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), val));
 	}
-	if (ibuf->rect_float) {
-		float *newrect =
-		    MEM_mallocN(newx * newy * 4 * sizeof(float),
-		                "q_scale rectfloat");
-		q_scale_float(ibuf->rect_float, newrect, ibuf->x, ibuf->y,
-		              newx, newy);
-		imb_freerectfloatImBuf(ibuf);
-		ibuf->mall |= IB_rectfloat;
-		ibuf->rect_float = newrect;
+#endif
+	for (; i < len; i++) {
+		out[i] += in[i] * weight;
 	}
-	ibuf->x = newx;
-	ibuf->y = newy;
-
-	return true;
 }
 
-static ImBuf *scaledownx(struct ImBuf *ibuf, int newx)
+static void scale_filter_x_scanlines(void *custom_data, int start_scanline, int num_scanlines)
 {
-	const int do_rect = (ibuf->rect != NULL);
-	const int do_float = (ibuf->rect_float != NULL);
-	const size_t rect_size = ibuf->x * ibuf->y * 4;
-
-	uchar *rect, *_newrect, *newrect;
-	float *rectf, *_newrectf, *newrectf;
-	float sample, add, val[4], nval[4], valf[4], nvalf[4];
-	int x, y;
-
-	rectf = _newrectf = newrectf = NULL;
-	rect = _newrect = newrect = NULL;
-	nval[0] =  nval[1] = nval[2] = nval[3] = 0.0f;
-	nvalf[0] = nvalf[1] = nvalf[2] = nvalf[3] = 0.0f;
-
-	if (!do_rect && !do_float) return (ibuf);
-
-	if (do_rect) {
-		_newrect = MEM_mallocN(newx * ibuf->y * sizeof(uchar) * 4, "scaledownx");
-		if (_newrect == NULL) return(ibuf);
-	}
-	if (do_float) {
-		_newrectf = MEM_mallocN(newx * ibuf->y * sizeof(float) * 4, "scaledownxf");
-		if (_newrectf == NULL) {
-			if (_newrect) MEM_freeN(_newrect);
-			return(ibuf);
-		}
-	}
+	const ScaleFilterData *data = custom_data;
+	const ScaleFilterTable *table = data->table_x;
+	const int channels = data->channels;
+	int x, y, k, c;
 
-	add = (ibuf->x - 0.01) / newx;
+	for (y = start_scanline; y < start_scanline + num_scanlines; y++) {
+		float *out = data->tmp + (size_t)y * data->dst_x * channels;
+		const float *weights = table->weights;
 
-	if (do_rect) {
-		rect = (uchar *) ibuf->rect;
-		newrect = _newrect;
-	}
-	if (do_float) {
-		rectf = ibuf->rect_float;
-		newrectf = _newrectf;
-	}
-		
-	for (y = ibuf->y; y > 0; y--) {
-		sample = 0.0f;
-		val[0] =  val[1] = val[2] = val[3] = 0.0f;
-		valf[0] = valf[1] = valf[2] = valf[3] = 0.0f;
+		if (data->src_byte) {
+			const unsigned char *row = data->src_byte + (size_t)y * data->src_x * 4;
 
-		for (x = newx; x > 0; x--) {
-			if (do_rect) {
-				nval[0] = -val[0] * sample;
-				nval[1] = -val[1] * sample;
-				nval[2] = -val[2] * sample;
-				nval[3] = -val[3] * sample;
-			}
-			if (do_float) {
-				nvalf[0] = -valf[0] * sample;
-				nvalf[1] = -valf[1] * sample;
-				nvalf[2] = -valf[2] * sample;
-				nvalf[3] = -valf[3] * sample;
-			}
-			
-			sample += add;
+			for (x = 0; x < data->dst_x; x++, out += 4, weights += table->tot_max) {
+				const unsigned char *in = row + table->start[x] * 4;
+#ifdef __SSE2__
+				__m128 accum = _mm_setzero_ps();
 
-			while (sample >= 1.0f) {
-				sample -= 1.0f;
-				
-				if (do_rect) {
-					nval[0] += rect[0];
-					nval[1] += rect[1];
-					nval[2] += rect[2];
-					nval[3] += rect[3];
-					rect += 4;
+				for (k = 0; k < table->tot[x]; k++, in += 4) {
+					accum = _mm_add_ps(accum, _mm_mul_ps(scale_load_uchar4(in), _mm_set1_ps(weights[k])));
 				}
-				if (do_float) {
-					nvalf[0] += rectf[0];
-					nvalf[1] += rectf[1];
-					nvalf[2] += rectf[2];
-					nvalf[3] += rectf[3];
-					rectf += 4;
+				_mm_storeu_ps(out, accum);
+#else
+				zero_v4(out);
+				for (k = 0; k < table->tot[x]; k++, in += 4) {
+					out[0] += in[0] * weights[k];
+					out[1] += in[1] * weights[k];
+					out[2] += in[2] * weights[k];
+					out[3] += in[3] * weights[k];
 				}
+#endif
 			}
-			
-			if (do_rect) {
-				val[0] = rect[0]; val[1] = rect[1]; val[2] = rect[2]; val[3] = rect[3];
-				rect += 4;
-				
-				newrect[0] = ((nval[0] + sample * val[0]) / add + 0.5f);
-				newrect[1] = ((nval[1] + sample * val[1]) / add + 0.5f);
-				newrect[2] = ((nval[2] + sample * val[2]) / add + 0.5f);
-				newrect[3] = ((nval[3] + sample * val[3]) / add + 0.5f);
-				
-				newrect += 4;
-			}
-			if (do_float) {
-				
-				valf[0] = rectf[0]; valf[1] = rectf[1]; valf[2] = rectf[2]; valf[3] = rectf[3];
-				rectf += 4;
-				
-				newrectf[0] = ((nvalf[0] + sample * valf[0]) / add);
-				newrectf[1] = ((nvalf[1] + sample * valf[1]) / add);
-				newrectf[2] = ((nvalf[2] + sample * valf[2]) / add);
-				newrectf[3] = ((nvalf[3] + sample * valf[3]) / add);
-				
-				newrectf += 4;
+		}
+		else {
+			const float *row = data->src_float + (size_t)y * data->src_x * channels;
+
+			for (x = 0; x < data->dst_x; x++, out += channels, weights += table->tot_max) {
+				const float *in = row + table->start[x] * channels;
+#ifdef __SSE2__
+				if (channels == 4) {
+					__m128 accum = _mm_setzero_ps();
+
+					for (k = 0; k < table->tot[x]; k++, in += 4) {
+						accum = _mm_add_ps(accum, _mm_mul_ps(_mm_loadu_ps(in), _mm_set1_ps(weights[k])));
+					}
+					_mm_storeu_ps(out, accum);
+					continue;
+				}
+#endif
+				for (c = 0; c < channels; c++) {
+					out[c] = 0.0f;
+				}
+				for (k = 0; k < table->tot[x]; k++, in += channels) {
+					for (c = 0; c < channels; c++) {
+						out[c] += in[c] * weights[k];
+					}
+				}
 			}
-			
-			sample -= 1.0f;
 		}
 	}
-
-	if (do_rect) {
-		// printf("%ld %ld\n", (uchar *)rect - ((uchar *)ibuf->rect), rect_size);
-		BLI_assert((uchar *)rect - ((uchar *)ibuf->rect) == rect_size); /* see bug [#26502] */
-		imb_freerectImBuf(ibuf);
-		ibuf->mall |= IB_rect;
-		ibuf->rect = (unsigned int *) _newrect;
-	}
-	if (do_float) {
-		// printf("%ld %ld\n", rectf - ibuf->rect_float, rect_size);
-		BLI_assert((rectf - ibuf->rect_float) == rect_size); /* see bug [#26502] */
-		imb_freerectfloatImBuf(ibuf);
-		ibuf->mall |= IB_rectfloat;
-		ibuf->rect_float = _newrectf;
-	}
-	(void)rect_size; /* UNUSED in release builds */
-	
-	ibuf->x = newx;
-	return(ibuf);
 }
 
-
-static ImBuf *scaledowny(struct ImBuf *ibuf, int newy)
+static void scale_filter_y_scanlines(void *custom_data, int start_scanline, int num_scanlines)
 {
-	const int do_rect = (ibuf->rect != NULL);
-	const int do_float = (ibuf->rect_float != NULL);
-	const size_t rect_size = ibuf->x * ibuf->y * 4;
-
-	uchar *rect, *_newrect, *newrect;
-	float *rectf, *_newrectf, *newrectf;
-	float sample, add, val[4], nval[4], valf[4], nvalf[4];
-	int x, y, skipx;
-
-	rectf = _newrectf = newrectf = NULL;
-	rect = _newrect = newrect = NULL;
-	nval[0] =  nval[1] = nval[2] = nval[3] = 0.0f;
-	nvalf[0] = nvalf[1] = nvalf[2] = nvalf[3] = 0.0f;
-
-	if (!do_rect && !do_float) return (ibuf);
-
-	if (do_rect) {
-		_newrect = MEM_mallocN(newy * ibuf->x * sizeof(uchar) * 4, "scaledowny");
-		if (_newrect == NULL) return(ibuf);
-	}
-	if (do_float) {
-		_newrectf = MEM_mallocN(newy * ibuf->x * sizeof(float) * 4, "scaledownyf");
-		if (_newrectf == NULL) {
-			if (_newrect) MEM_freeN(_newrect);
-			return(ibuf);
-		}
+	const ScaleFilterData *data = custom_data;
+	const ScaleFilterTable *table = data->table_y;
+	const size_t row_len = (size_t)data->dst_x * data->channels;
+	float *accum = NULL;
+	int y, k;
+	size_t i;
+
+	if (data->dst_byte) {
+		accum = MEM_mallocN(sizeof(float) * row_len, __func__);
 	}
 
-	add = (ibuf->y - 0.01) / newy;
-	skipx = 4 * ibuf->x;
+	for (y = start_scanline; y < start_scanline + num_scanlines; y++) {
+		const float *weights = table->weights + (size_t)y * table->tot_max;
+		const float *in = data->tmp + table->start[y] * row_len;
+		float *out = (data->dst_float) ? data->dst_float + y * row_len : accum;
 
-	for (x = skipx - 4; x >= 0; x -= 4) {
-		if (do_rect) {
-			rect = ((uchar *) ibuf->rect) + x;
-			newrect = _newrect + x;
-		}
-		if (do_float) {
-			rectf = ibuf->rect_float + x;
-			newrectf = _newrectf + x;
+		scale_row_mul(out, in, weights[0], row_len);
+		for (k = 1; k < table->tot[y]; k++) {
+			in += row_len;
+			scale_row_madd(out, in, weights[k], row_len);
 		}
-		
-		sample = 0.0f;
-		val[0] =  val[1] = val[2] = val[3] = 0.0f;
-		valf[0] = valf[1] = valf[2] = valf[3] = 0.0f;
 
-		for (y = newy; y > 0; y--) {
-			if (do_rect) {
-				nval[0] = -val[0] * sample;
-				nval[1] = -val[1] * sample;
-				nval[2] = -val[2] * sample;
-				nval[3] = -val[3] * sample;
-			}
-			if (do_float) {
-				nvalf[0] = -valf[0] * sample;
-				nvalf[1] = -valf[1] * sample;
-				nvalf[2] = -valf[2] * sample;
-				nvalf[3] = -valf[3] * sample;
-			}
-			
-			sample += add;
-
-			while (sample >= 1.0f) {
-				sample -= 1.0f;
-				
-				if (do_rect) {
-					nval[0] += rect[0];
-					nval[1] += rect[1];
-					nval[2] += rect[2];
-					nval[3] += rect[3];
-					rect += skipx;
-				}
-				if (do_float) {
-					nvalf[0] += rectf[0];
-					nvalf[1] += rectf[1];
-					nvalf[2] += rectf[2];
-					nvalf[3] += rectf[3];
-					rectf += skipx;
-				}
-			}
+		if (data->dst_byte) {
+			unsigned char *out_byte = data->dst_byte + y * row_len;
 
-			if (do_rect) {
-				val[0] = rect[0]; val[1] = rect[1]; val[2] = rect[2]; val[3] = rect[3];
-				rect += skipx;
-				
-				newrect[0] = ((nval[0] + sample * val[0]) / add + 0.5f);
-				newrect[1] = ((nval[1] + sample * val[1]) / add + 0.5f);
-				newrect[2] = ((nval[2] + sample * val[2]) / add + 0.5f);
-				newrect[3] = ((nval[3] + sample * val[3]) / add + 0.5f);
-				
-				newrect += skipx;
-			}
-			if (do_float) {
-				
-				valf[0] = rectf[0]; valf[1] = rectf[1]; valf[2] = rectf[2]; valf[3] = rectf[3];
-				rectf += skipx;
-				
-				newrectf[0] = ((nvalf[0] + sample * valf[0]) / add);
-				newrectf[1] = ((nvalf[1] + sample * valf[1]) / add);
-				newrectf[2] = ((nvalf[2] + sample * valf[2]) / add);
-				newrectf[3] = ((nvalf[3] + sample * valf[3]) / add);
-				
-				newrectf += skipx;
+			for (i = 0; i < row_len; i++) {
+				const float val = accum[i];
+				out_byte[i] = (val <= 0.0f) ? 0 : (val >= 254.5f) ? 255 : (unsigned char)(val + 0.5f);
 			}
-			
-			sample -= 1.0f;
 		}
 	}
 
-	if (do_rect) {
-		// printf("%ld %ld\n", (uchar *)rect - ((uchar *)ibuf->rect), rect_size);
-		BLI_assert((uchar *)rect - ((uchar *)ibuf->rect) == rect_size); /* see bug [#26502] */
-		imb_freerectImBuf(ibuf);
-		ibuf->mall |= IB_rect;
-		ibuf->rect = (unsigned int *) _newrect;
-	}
-	if (do_float) {
-		// printf("%ld %ld\n", rectf - ibuf->rect_float, rect_size);
-		BLI_assert((rectf - ibuf->rect_float) == rect_size); /* see bug [#26502] */
-		imb_freerectfloatImBuf(ibuf);
-		ibuf->mall |= IB_rectfloat;
-		ibuf->rect_float = (float *) _newrectf;
+	if (accum) {
+		MEM_freeN(accum);
 	}
-	(void)rect_size; /* UNUSED in release builds */
-	
-	ibuf->y = newy;
-	return(ibuf);
 }
 
+static void scale_filter_buffer(ScaleFilterData *data, int src_y, int dst_y)
+{
+	IMB_processor_apply_threaded_scanlines(src_y, scale_filter_x_scanlines, data);
+	IMB_processor_apply_threaded_scanlines(dst_y, scale_filter_y_scanlines, data);
+}
+
+static void scalefast_Z_ImBuf(ImBuf *ibuf, int newx, int newy);
 
-static ImBuf *scaleupx(struct ImBuf *ibuf, int newx)
+static void scale_filter_ImBuf(ImBuf *ibuf, int newx, int newy, eScaleFilter filter_x, eScaleFilter filter_y)
 {
-	uchar *rect, *_newrect = NULL, *newrect;
-	float *rectf, *_newrectf = NULL, *newrectf;
-	float sample, add;
-	float val_a, nval_a, diff_a;
-	float val_b, nval_b, diff_b;
-	float val_g, nval_g, diff_g;
-	float val_r, nval_r, diff_r;
-	float val_af, nval_af, diff_af;
-	float val_bf, nval_bf, diff_bf;
-	float val_gf, nval_gf, diff_gf;
-	float val_rf, nval_rf, diff_rf;
-	int x, y;
-	bool do_rect = false, do_float = false;
+	ScaleFilterTable table_x, table_y;
+	ScaleFilterData data = {NULL};
+	const int channels = (ibuf->rect_float) ? max_ii(ibuf->channels, 4) : 4;
+	unsigned char *newrect = NULL;
+	float *newrectf = NULL;
 
-	val_a = nval_a = diff_a = val_b = nval_b = diff_b = 0;
-	val_g = nval_g = diff_g = val_r = nval_r = diff_r = 0;
-	val_af = nval_af = diff_af = val_bf = nval_bf = diff_bf = 0;
-	val_gf = nval_gf = diff_gf = val_rf = nval_rf = diff_rf = 0;
-	if (ibuf == NULL) return(NULL);
-	if (ibuf->rect == NULL && ibuf->rect_float == NULL) return (ibuf);
+	/* allocate everything first, the buffer is left untouched when that fails */
+
+	/* intermediate buffer, large enough for either of the buffers */
+	data.tmp = MEM_mapallocN(sizeof(float) * newx * ibuf->y * channels, "scale filter tmp");
 
 	if (ibuf->rect) {
-		do_rect = true;
-		_newrect = MEM_mallocN(newx * ibuf->y * sizeof(int), "scaleupx");
-		if (_newrect == NULL) return(ibuf);
+		newrect = MEM_mallocN(sizeof(unsigned char) * 4 * newx * newy, "scale filter byte");
 	}
 	if (ibuf->rect_float) {
-		do_float = true;
-		_newrectf = MEM_mallocN(newx * ibuf->y * sizeof(float) * 4, "scaleupxf");
-		if (_newrectf == NULL) {
-			if (_newrect) MEM_freeN(_newrect);
-			return(ibuf);
-		}
+		newrectf = MEM_mallocN(sizeof(float) * ibuf->channels * newx * newy, "scale filter float");
 	}
 
-	add = (ibuf->x - 1.001) / (newx - 1.0);
-
-	rect = (uchar *) ibuf->rect;
-	rectf = (float *) ibuf->rect_float;
-	newrect = _newrect;
-	newrectf = _newrectf;
-
-	for (y = ibuf->y; y > 0; y--) {
-
-		sample = 0;
-		
-		if (do_rect) {
-			val_a = rect[0];
-			nval_a = rect[4];
-			diff_a = nval_a - val_a;
-			val_a += 0.5f;
-
-			val_b = rect[1];
-			nval_b = rect[5];
-			diff_b = nval_b - val_b;
-			val_b += 0.5f;
-
-			val_g = rect[2];
-			nval_g = rect[6];
-			diff_g = nval_g - val_g;
-			val_g += 0.5f;
-
-			val_r = rect[3];
-			nval_r = rect[7];
-			diff_r = nval_r - val_r;
-			val_r += 0.5f;
-
-			rect += 8;
-		}
-		if (do_float) {
-			val_af = rectf[0];
-			nval_af = rectf[4];
-			diff_af = nval_af - val_af;
-	
-			val_bf = rectf[1];
-			nval_bf = rectf[5];
-			diff_bf = nval_bf - val_bf;
-
-			val_gf = rectf[2];
-			nval_gf = rectf[6];
-			diff_gf = nval_gf - val_gf;
-
-			val_rf = rectf[3];
-			nval_rf = rectf[7];
-			diff_rf = nval_rf - val_rf;
-
-			rectf += 8;
-		}
-		for (x = newx; x > 0; x--) {
-			if (sample >= 1.0f) {
-				sample -= 1.0f;
-
-				if (do_rect) {
-					val_a = nval_a;
-					nval_a = rect[0];
-					diff_a = nval_a - val_a;
-					val_a += 0.5f;
-
-					val_b = nval_b;
-					nval_b = rect[1];
-					diff_b = nval_b - val_b;
-					val_b += 0.5f;
-
-					val_g = nval_g;
-					nval_g = rect[2];
-					diff_g = nval_g - val_g;
-					val_g += 0.5f;
-
-					val_r = nval_r;
-					nval_r = rect[3];
-					diff_r = nval_r - val_r;
-					val_r += 0.5f;
-					rect += 4;
-				}
-				if (do_float) {
-					val_af = nval_af;
-					nval_af = rectf[0];
-					diff_af = nval_af - val_af;
-	
-					val_bf = nval_bf;
-					nval_bf = rectf[1];
-					diff_bf = nval_bf - val_bf;
-
-					val_gf = nval_gf;
-					nval_gf = rectf[2];
-					diff_gf = nval_gf - val_gf;
-
-					val_rf = nval_rf;
-					nval_rf = rectf[3];
-					diff_rf = nval_rf - val_rf;
-					rectf += 4;
-				}
-			}
-			if (do_rect) {
-				newrect[0] = val_a + sample * diff_a;
-				newrect[1] = val_b + sample * diff_b;
-				newrect[2] = val_g + sample * diff_g;
-				newrect[3] = val_r + sample * diff_r;
-				newrect += 4;
-			}
-			if (do_float) {
-				newrectf[0] = val_af + sample * diff_af;
-				newrectf[1] = val_bf + sample * diff_bf;
-				newrectf[2] = val_gf + sample * diff_gf;
-				newrectf[3] = val_rf + sample * diff_rf;
-				newrectf += 4;
-			}
-			sample += add;
-		}
+	if (data.tmp == NULL || (ibuf->rect && newrect == NULL) || (ibuf->rect_float && newrectf == NULL)) {
+		if (data.tmp) MEM_freeN(data.tmp);
+		if (newrect) MEM_freeN(newrect);
+		if (newrectf) MEM_freeN(newrectf);
+		return;
 	}
 
-	if (do_rect) {
-		imb_freerectImBuf(ibuf);
-		ibuf->mall |= IB_rect;
-		ibuf->rect = (unsigned int *) _newrect;
+	scale_filter_table_init(&table_x, filter_x, ibuf->x, newx);
+	scale_filter_table_init(&table_y, filter_y, ibuf->y, newy);
+
+	data.table_x = &table_x;
+	data.table_y = &table_y;
+	data.src_x = ibuf->x;
+	data.dst_x = newx;
+
+	if (newrect) {
+		data.channels = 4;
+		data.src_byte = (unsigned char *)ibuf->rect;
+		data.dst_byte = newrect;
+		scale_filter_buffer(&data, ibuf->y, newy);
+		data.src_byte = NULL;
+		data.dst_byte = NULL;
 	}
-	if (do_float) {
-		imb_freerectfloatImBuf(ibuf);
-		ibuf->mall |= IB_rectfloat;
-		ibuf->rect_float = (float *) _newrectf;
-	}
-	
-	ibuf->x = newx;
-	return(ibuf);
-}
 
-static ImBuf *scaleupy(struct ImBuf *ibuf, int newy)
-{
-	uchar *rect, *_newrect = NULL, *newrect;
-	float *rectf, *_newrectf = NULL, *newrectf;
-	float sample, add;
-	float val_a, nval_a, diff_a;
-	float val_b, nval_b, diff_b;
-	float val_g, nval_g, diff_g;
-	float val_r, nval_r, diff_r;
-	float val_af, nval_af, diff_af;
-	float val_bf, nval_bf, diff_bf;
-	float val_gf, nval_gf, diff_gf;
-	float val_rf, nval_rf, diff_rf;
-	int x, y, skipx;
-	bool do_rect = false, do_float = false;
-
-	val_a = nval_a = diff_a = val_b = nval_b = diff_b = 0;
-	val_g = nval_g = diff_g = val_r = nval_r = diff_r = 0;
-	val_af = nval_af = diff_af = val_bf = nval_bf = diff_bf = 0;
-	val_gf = nval_gf = diff_gf = val_rf = nval_rf = diff_rf = 0;
-	if (ibuf == NULL) return(NULL);
-	if (ibuf->rect == NULL && ibuf->rect_float == NULL) return (ibuf);
-
-	if (ibuf->rect) {
-		do_rect = true;
-		_newrect = MEM_mallocN(ibuf->x * newy * sizeof(int), "scaleupy");
-		if (_newrect == NULL) return(ibuf);
-	}
-	if (ibuf->rect_float) {
-		do_float = true;
-		_newrectf = MEM_mallocN(ibuf->x * newy * sizeof(float) * 4, "scaleupyf");
-		if (_newrectf == NULL) {
-			if (_newrect) MEM_freeN(_newrect);
-			return(ibuf);
-		}
+	if (newrectf) {
+		data.channels = ibuf->channels;
+		data.src_float = ibuf->rect_float;
+		data.dst_float = newrectf;
+		scale_filter_buffer(&data, ibuf->y, newy);
 	}
 
-	add = (ibuf->y - 1.001) / (newy - 1.0);
-	skipx = 4 * ibuf->x;
+	scale_filter_table_free(&table_x);
+	scale_filter_table_free(&table_y);
+	MEM_freeN(data.tmp);
 
-	rect = (uchar *) ibuf->rect;
-	rectf = (float *) ibuf->rect_float;
-	newrect = _newrect;
-	newrectf = _newrectf;
-
-	for (x = ibuf->x; x > 0; x--) {
-
-		sample = 0;
-		if (do_rect) {
-			rect = ((uchar *)ibuf->rect) + 4 * (x - 1);
-			newrect = _newrect + 4 * (x - 1);
-
-			val_a = rect[0];
-			nval_a = rect[skipx];
-			diff_a = nval_a - val_a;
-			val_a += 0.5f;
-
-			val_b = rect[1];
-			nval_b = rect[skipx + 1];
-			diff_b = nval_b - val_b;
-			val_b += 0.5f;
-
-			val_g = rect[2];
-			nval_g = rect[skipx + 2];
-			diff_g = nval_g - val_g;
-			val_g += 0.5f;
-
-			val_r = rect[3];
-			nval_r = rect[skipx + 3];
-			diff_r = nval_r - val_r;
-			val_r += 0.5f;
-
-			rect += 2 * skipx;
-		}
-		if (do_float) {
-			rectf = ibuf->rect_float + 4 * (x - 1);
-			newrectf = _newrectf + 4 * (x - 1);
-
-			val_af = rectf[0];
-			nval_af = rectf[skipx];
-			diff_af = nval_af - val_af;
-	
-			val_bf = rectf[1];
-			nval_bf = rectf[skipx + 1];
-			diff_bf = nval_bf - val_bf;
-
-			val_gf = rectf[2];
-			nval_gf = rectf[skipx + 2];
-			diff_gf = nval_gf - val_gf;
-
-			val_rf = rectf[3];
-			nval_rf = rectf[skipx + 3];
-			diff_rf = nval_rf - val_rf;
-
-			rectf += 2 * skipx;
-		}
-		
-		for (y = newy; y > 0; y--) {
-			if (sample >= 1.0f) {
-				sample -= 1.0f;
-
-				if (do_rect) {
-					val_a = nval_a;
-					nval_a = rect[0];
-					diff_a = nval_a - val_a;
-					val_a += 0.5f;
-
-					val_b = nval_b;
-					nval_b = rect[1];
-					diff_b = nval_b - val_b;
-					val_b += 0.5f;
-
-					val_g = nval_g;
-					nval_g = rect[2];
-					diff_g = nval_g - val_g;
-					val_g += 0.5f;
-
-					val_r = nval_r;
-					nval_r = rect[3];
-					diff_r = nval_r - val_r;
-					val_r += 0.5f;
-					rect += skipx;
-				}
-				if (do_float) {
-					val_af = nval_af;
-					nval_af = rectf[0];
-					diff_af = nval_af - val_af;
-	
-					val_bf = nval_bf;
-					nval_bf = rectf[1];
-					diff_bf = nval_bf - val_bf;
-
-					val_gf = nval_gf;
-					nval_gf = rectf[2];
-					diff_gf = nval_gf - val_gf;
-
-					val_rf = nval_rf;
-					nval_rf = rectf[3];
-					diff_rf = nval_rf - val_rf;
-					rectf += skipx;
-				}
-			}
-			if (do_rect) {
-				newrect[0] = val_a + sample * diff_a;
-				newrect[1] = val_b + sample * diff_b;
-				newrect[2] = val_g + sample * diff_g;
-				newrect[3] = val_r + sample * diff_r;
-				newrect += skipx;
-			}
-			if (do_float) {
-				newrectf[0] = val_af + sample * diff_af;
-				newrectf[1] = val_bf + sample * diff_bf;
-				newrectf[2] = val_gf + sample * diff_gf;
-				newrectf[3] = val_rf + sample * diff_rf;
-				newrectf += skipx;
-			}
-			sample += add;
-		}
-	}
+	/* uses the old size, so has to be done before it changes */
+	scalefast_Z_ImBuf(ibuf, newx, newy);
 
-	if (do_rect) {
+	if (newrect) {
 		imb_freerectImBuf(ibuf);
 		ibuf->mall |= IB_rect;
-		ibuf->rect = (unsigned int *) _newrect;
+		ibuf->rect = (unsigned int *)newrect;
 	}
-	if (do_float) {
+
+	if (newrectf) {
 		imb_freerectfloatImBuf(ibuf);
 		ibuf->mall |= IB_rectfloat;
-		ibuf->rect_float = (float *) _newrectf;
+		ibuf->rect_float = newrectf;
 	}
-	
+
+	ibuf->x = newx;
 	ibuf->y = newy;
-	return(ibuf);
 }
 
 static void scalefast_Z_ImBuf(ImBuf *ibuf, int newx, int newy)
@@ -1555,23 +849,18 @@ struct ImBuf *IMB_scaleImBuf(struct ImBuf *ibuf, unsigned int newx, unsigned int
 	if (ibuf == NULL) return (NULL);
 	if (ibuf->rect == NULL && ibuf->rect_float == NULL) return (ibuf);
 	
-	if (newx == ibuf->x && newy == ibuf->y) { return ibuf; }
+	/* zero keeps the size of that axis */
+	if (newx == 0) newx = ibuf->x;
+	if (newy == 0) newy = ibuf->y;
 
-	/* scaleup / scaledown functions below change ibuf->x and ibuf->y
-	 * so we first scale the Z-buffer (if any) */
-	scalefast_Z_ImBuf(ibuf, newx, newy);
+	if (newx == ibuf->x && newy == ibuf->y) { return ibuf; }
 
-	/* try to scale common cases in a fast way */
-	/* disabled, quality loss is unacceptable, see report #18609  (ton) */
-	if (0 && q_scale_linear_interpolation(ibuf, newx, newy)) {
-		return ibuf;
-	}
+	/* average when shrinking, interpolate when enlarging,
+	 * the Z-buffer (if any) is scaled along with the image */
+	scale_filter_ImBuf(ibuf, newx, newy,
+	                   (newx < ibuf->x) ? SCALE_FILTER_BOX : SCALE_FILTER_LINEAR,
+	                   (newy < ibuf->y) ? SCALE_FILTER_BOX : SCALE_FILTER_LINEAR);
 
-	if (newx && (newx < ibuf->x)) scaledownx(ibuf, newx);
-	if (newy && (newy < ibuf->y)) scaledowny(ibuf, newy);
-	if (newx && (newx > ibuf->x)) scaleupx(ibuf, newx);
-	if (newy && (newy > ibuf->y)) scaleupy(ibuf, newy);
-	
 	return(ibuf);
 }
 
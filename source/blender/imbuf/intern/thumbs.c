@@ -41,6 +41,7 @@
 #include "BLI_ghash.h"
 #include "BLI_hash_md5.h"
 #include "BLI_system.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 #include BLI_SYSTEM_PID_H
 
@@ -308,6 +309,75 @@ void IMB_thumb_makedirs(void)
 	}
 }
 
+/* ***** Writing ***** */
+/* Encoding and writing the PNG does not need to hold back the caller, which only needs the ImBuf.
+ * While thumbnail locks are acquired (i.e. previews are generated in a batch), thumbnails are written
+ * from a background task pool, which is finished when the last lock is released. */
+
+static struct IMBThumbWrites {
+	TaskPool *pool;
+	unsigned int counter;
+} thumb_writes = {NULL};
+
+typedef struct ThumbWrite {
+	ImBuf *img;
+	char temp[FILE_MAX];
+	char tpath[FILE_MAX];
+} ThumbWrite;
+
+static void thumb_write(ThumbWrite *write)
+{
+	if (IMB_saveiff(write->img, write->temp, IB_rect | IB_metadata)) {
+#ifndef WIN32
+		chmod(write->temp, S_IRUSR | S_IWUSR);
+#endif
+		// printf("%s saving thumb: '%s'\n", __func__, write->tpath);
+
+		BLI_rename(write->temp, write->tpath);
+	}
+}
+
+static void thumb_write_runf(TaskPool *__restrict UNUSED(pool), void *taskdata, int UNUSED(threadid))
+{
+	thumb_write(taskdata);
+}
+
+static void thumb_write_freef(TaskPool *__restrict UNUSED(pool), void *taskdata, int UNUSED(threadid))
+{
+	ThumbWrite *write = taskdata;
+
+	IMB_freeImBuf(write->img);
+	MEM_freeN(write);
+}
+
+static void thumb_save(ImBuf *img, const char *tdir, const char *thumb, const char *tpath)
+{
+	ThumbWrite *write = MEM_mallocN(sizeof(*write), __func__);
+	unsigned int counter;
+	bool pushed = false;
+
+	write->img = img;
+	BLI_strncpy(write->tpath, tpath, sizeof(write->tpath));
+
+	BLI_lock_thread(LOCK_IMAGE);
+	/* the same thumbnail may be written from several threads, give each write its own temp file */
+	counter = thumb_writes.counter++;
+	BLI_snprintf(write->temp, sizeof(write->temp), "%sblender_%d_%u_%s.png", tdir, abs(getpid()), counter, thumb);
+
+	if (thumb_writes.pool) {
+		write->img = IMB_dupImBuf(img);
+		IMB_metadata_copy(write->img, img);
+		BLI_task_pool_push_ex(thumb_writes.pool, thumb_write_runf, write, true, thumb_write_freef, TASK_PRIORITY_LOW);
+		pushed = true;
+	}
+	BLI_unlock_thread(LOCK_IMAGE);
+
+	if (!pushed) {
+		thumb_write(write);
+		MEM_freeN(write);
+	}
+}
+
 /* create thumbnail for file and returns new imbuf for thumbnail */
 static ImBuf *thumb_create_ex(
         const char *file_path, const char *uri, const char *thumb, const bool use_hash, const char *hash,
@@ -317,13 +387,13 @@ static ImBuf *thumb_create_ex(
 	char desc[URI_MAX + 22];
 	char tpath[FILE_MAX];
 	char tdir[FILE_MAX];
-	char temp[FILE_MAX];
 	char mtime[40] = "0"; /* in case we can't stat the file */
 	char cwidth[40] = "0"; /* in case images have no data */
 	char cheight[40] = "0";
 	short tsize = 128;
 	short ex, ey;
 	float scaledx, scaledy;
+	size_t full_width = 0, full_height = 0;
 	BLI_stat_t info;
 
 	switch (size) {
@@ -351,8 +421,6 @@ static ImBuf *thumb_create_ex(
 
 	if (get_thumb_dir(tdir, size)) {
 		BLI_snprintf(tpath, FILE_MAX, "%s%s", tdir, thumb);
-//		thumb[8] = '\0'; /* shorten for tempname, not needed anymore */
-		BLI_snprintf(temp, FILE_MAX, "%sblender_%d_%s.png", tdir, abs(getpid()), thumb);
 		if (BLI_path_ncmp(file_path, tdir, sizeof(tdir)) == 0) {
 			return NULL;
 		}
@@ -366,7 +434,8 @@ static ImBuf *thumb_create_ex(
 				if (img == NULL) {
 					switch (source) {
 						case THB_SOURCE_IMAGE:
-							img = IMB_loadiffname(file_path, IB_rect | IB_metadata, NULL);
+							img = IMB_loadiffname_thumbnail(file_path, IB_rect | IB_metadata, tsize, NULL,
+							                                &full_width, &full_height);
 							break;
 						case THB_SOURCE_BLEND:
 							img = IMB_thumb_load_blend(file_path, blen_group, blen_id);
@@ -383,8 +452,12 @@ static ImBuf *thumb_create_ex(
 					if (BLI_stat(file_path, &info) != -1) {
 						BLI_snprintf(mtime, sizeof(mtime), "%ld", (long int)info.st_mtime);
 					}
-					BLI_snprintf(cwidth, sizeof(cwidth), "%d", img->x);
-					BLI_snprintf(cheight, sizeof(cheight), "%d", img->y);
+					if (full_width == 0) {
+						full_width = img->x;
+						full_height = img->y;
+					}
+					BLI_snprintf(cwidth, sizeof(cwidth), "%d", (int)full_width);
+					BLI_snprintf(cheight, sizeof(cheight), "%d", (int)full_height);
 				}
 			}
 			else if (THB_SOURCE_MOVIE == source) {
@@ -448,14 +521,7 @@ static ImBuf *thumb_create_ex(
 		IMB_rect_from_float(img);
 		imb_freerectfloatImBuf(img);
 
-		if (IMB_saveiff(img, temp, IB_rect | IB_metadata)) {
-#ifndef WIN32
-			chmod(temp, S_IRUSR | S_IWUSR);
-#endif
-			// printf("%s saving thumb: '%s'\n", __func__, tpath);
-
-			BLI_rename(temp, tpath);
-		}
+		thumb_save(img, tdir, thumb, tpath);
 	}
 	return img;
 }
@@ -658,6 +724,9 @@ void IMB_thumb_locks_acquire(void)
 		BLI_assert(thumb_locks.locked_paths == NULL);
 		thumb_locks.locked_paths = BLI_gset_str_new(__func__);
 		BLI_condition_init(&thumb_locks.cond);
+
+		BLI_assert(thumb_writes.pool == NULL);
+		thumb_writes.pool = BLI_task_pool_create_background(BLI_task_scheduler_get(), NULL);
 	}
 	thumb_locks.lock_counter++;
 
@@ -668,6 +737,8 @@ void IMB_thumb_locks_acquire(void)
 
 void IMB_thumb_locks_release(void)
 {
+	TaskPool *write_pool = NULL;
+
 	BLI_lock_thread(LOCK_IMAGE);
 	BLI_assert((thumb_locks.locked_paths != NULL) && (thumb_locks.lock_counter > 0));
 
@@ -676,9 +747,18 @@ void IMB_thumb_locks_release(void)
 		BLI_gset_free(thumb_locks.locked_paths, MEM_freeN);
 		thumb_locks.locked_paths = NULL;
 		BLI_condition_end(&thumb_locks.cond);
+
+		write_pool = thumb_writes.pool;
+		thumb_writes.pool = NULL;
 	}
 
 	BLI_unlock_thread(LOCK_IMAGE);
+
+	if (write_pool) {
+		/* finish pending writes, outside of the lock as thumbnails created meanwhile are written directly */
+		BLI_task_pool_work_and_wait(write_pool);
+		BLI_task_pool_free(write_pool);
+	}
 }
 
 void IMB_thumb_path_lock(const char *path)
@@ -184,6 +184,10 @@ typedef struct FluidsimSettings {
 #define OB_FLUIDSIM_SURF_FINAL_VEL_FNAME   "fluidsurface_final_####.bvel.gz"
 #define OB_FLUIDSIM_SURF_PARTICLES_FNAME   "fluidsurface_particles_####.gz"
 
+/* all frames of a surface in one file, replaces the files above since 2.78 */
+#define OB_FLUIDSIM_SURF_PREVIEW_SEQ_FNAME "fluidsurface_preview.bmsh"
+#define OB_FLUIDSIM_SURF_FINAL_SEQ_FNAME   "fluidsurface_final.bmsh"
+
 #ifdef __cplusplus
 }
 #endif
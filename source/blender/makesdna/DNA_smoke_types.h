@@ -43,6 +43,7 @@ enum {
 #endif
 	MOD_SMOKE_FILE_LOAD = (1 << 6),  /* flag for file load */
 	MOD_SMOKE_ADAPTIVE_DOMAIN = (1 << 7),
+	MOD_SMOKE_SPARSE_BLOCKS = (1 << 8),  /* only advect scalar fields near non-empty cells */
 };
 
 /* noise */
@@ -497,7 +497,7 @@ typedef struct UserDef {
 	int prefetchframes;
 	float pad_rot_angle; /* control the rotation step of the view when PAD2, PAD4, PAD6&PAD8 is use */
 	short frameserverport;
-	short pad4;
+	short modcachelimit;	/* memory limit of the modifier result cache, in megabytes */
 	short obcenter_dia;
 	short rvisize;			/* rotating view icon size */
 	short rvibright;		/* rotating view icon brightness */
@@ -569,7 +569,9 @@ typedef struct UserDef {
 	struct WalkNavigation walk_navigation;
 
 	short opensubdiv_compute_type;
-	char pad5[6];
+	short sequencer_disk_cache_compression;	/* zlib level of the sequencer disk cache, 0 stores uncompressed */
+	int sequencer_disk_cache_size_limit;	/* in megabytes, 0 disables the sequencer disk cache */
+	char sequencer_disk_cache_dir[768];		/* FILE_MAXDIR length */
 } UserDef;
 
 extern UserDef U; /* from blenkernel blender.c */
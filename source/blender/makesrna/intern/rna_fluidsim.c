@@ -92,6 +92,15 @@ static int fluidsim_find_lastframe(Object *ob, FluidsimSettings *fss)
 	char targetFile[FILE_MAX];
 	int curFrame = 1;
 
+	BLI_join_dirfile(targetFile, sizeof(targetFile), fss->surfdataPath, OB_FLUIDSIM_SURF_FINAL_SEQ_FNAME);
+	BLI_path_abs(targetFile, modifier_path_relbase(ob));
+
+	if ((curFrame = BKE_fluidsim_meshseq_last_frame(targetFile)) != -1) {
+		return curFrame;
+	}
+
+	/* older bakes use a file per frame */
+	curFrame = 1;
 	BLI_join_dirfile(targetFile, sizeof(targetFile), fss->surfdataPath, OB_FLUIDSIM_SURF_FINAL_OBJ_FNAME);
 	BLI_path_abs(targetFile, modifier_path_relbase(ob));
 
@@ -158,6 +158,43 @@ static void rna_Cache_toggle_disk_cache(Main *UNUSED(bmain), Scene *UNUSED(scene
 	BLI_freelistN(&pidlist);
 }
 
+static void rna_Cache_toggle_single_file(Main *UNUSED(bmain), Scene *UNUSED(scene), PointerRNA *ptr)
+{
+	Object *ob = (Object *)ptr->id.data;
+	PointCache *cache = (PointCache *)ptr->data;
+	PTCacheID *pid = NULL;
+	ListBase pidlist;
+
+	if (!ob)
+		return;
+
+	BKE_ptcache_ids_from_object(&pidlist, ob, NULL, 0);
+
+	for (pid = pidlist.first; pid; pid = pid->next) {
+		if (pid->cache == cache)
+			break;
+	}
+
+	if (pid) {
+		/* remove frames written in the previous layout */
+		cache->flag ^= PTCACHE_DISK_SINGLE_FILE;
+		BKE_ptcache_id_clear(pid, PTCACHE_CLEAR_ALL, 0);
+		cache->flag ^= PTCACHE_DISK_SINGLE_FILE;
+
+		if (cache->cached_frames) {
+			MEM_freeN(cache->cached_frames);
+			cache->cached_frames = NULL;
+		}
+
+		cache->flag |= PTCACHE_OUTDATED;
+		BKE_ptcache_update_info(pid);
+	}
+
+	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+
+	BLI_freelistN(&pidlist);
+}
+
 static void rna_Cache_idname_change(Main *UNUSED(bmain), Scene *UNUSED(scene), PointerRNA *ptr)
 {
 	Object *ob = (Object *)ptr->id.data;
@@ -848,6 +885,13 @@ static void rna_def_pointcache(BlenderRNA *brna)
 	RNA_def_property_ui_text(prop, "Disk Cache", "Save cache files to disk (.blend file must be saved first)");
 	RNA_def_property_update(prop, NC_OBJECT, "rna_Cache_toggle_disk_cache");
 
+	prop = RNA_def_property(srna, "use_disk_cache_single_file", PROP_BOOLEAN, PROP_NONE);
+	RNA_def_property_boolean_sdna(prop, NULL, "flag", PTCACHE_DISK_SINGLE_FILE);
+	RNA_def_property_ui_text(prop, "Single File",
+	                         "Store all frames of the disk cache in one indexed file, "
+	                         "compressed and written in the background");
+	RNA_def_property_update(prop, NC_OBJECT, "rna_Cache_toggle_single_file");
+
 	prop = RNA_def_property(srna, "is_outdated", PROP_BOOLEAN, PROP_NONE);
 	RNA_def_property_boolean_sdna(prop, NULL, "flag", PTCACHE_OUTDATED);
 	RNA_def_property_clear_flag(prop, PROP_EDITABLE);
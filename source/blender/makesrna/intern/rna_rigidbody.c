@@ -144,6 +144,15 @@ static void rna_RigidBodyWorld_split_impulse_set(PointerRNA *ptr, int value)
 #endif
 }
 
+static void rna_RigidBodyWorld_use_multithreading_set(PointerRNA *ptr, int value)
+{
+	RigidBodyWorld *rbw = (RigidBodyWorld *)ptr->data;
+
+	RB_FLAG_SET(rbw->flag, value, RBW_FLAG_USE_THREADS);
+
+	BKE_rigidbody_world_update_threads(rbw);
+}
+
 /* ******************************** */
 
 static void rna_RigidBodyOb_reset(Main *UNUSED(bmain), Scene *scene, PointerRNA *UNUSED(ptr))
@@ -797,6 +806,14 @@ static void rna_def_rigidbody_world(BlenderRNA *brna)
 	                         "stability a little so use only when necessary)");
 	RNA_def_property_update(prop, NC_SCENE, "rna_RigidBodyWorld_reset");
 
+	prop = RNA_def_property(srna, "use_multithreading", PROP_BOOLEAN, PROP_NONE);
+	RNA_def_property_boolean_sdna(prop, NULL, "flag", RBW_FLAG_USE_THREADS);
+	RNA_def_property_boolean_funcs(prop, NULL, "rna_RigidBodyWorld_use_multithreading_set");
+	RNA_def_property_ui_text(prop, "Multithreading",
+	                         "Run collision detection and constraint solving on multiple threads "
+	                         "(results can differ slightly from single threaded simulation)");
+	RNA_def_property_update(prop, NC_SCENE, "rna_RigidBodyWorld_reset");
+
 	/* cache */
 	prop = RNA_def_property(srna, "point_cache", PROP_POINTER, PROP_NONE);
 	RNA_def_property_flag(prop, PROP_NEVER_NULL);
@@ -622,6 +622,7 @@ static void rna_Sequence_proxy_filepath_set(PointerRNA *ptr, const char *value)
 	StripProxy *proxy = (StripProxy *)(ptr->data);
 	BLI_split_dirfile(value, proxy->dir, proxy->file, sizeof(proxy->dir), sizeof(proxy->file));
 	if (proxy->anim) {
+		BKE_sequencer_prefetch_stop();
 		IMB_free_anim(proxy->anim);
 		proxy->anim = NULL;
 	}
@@ -101,6 +101,7 @@ static EnumPropertyItem rna_enum_language_default_items[] = {
 #include "BKE_depsgraph.h"
 #include "BKE_global.h"
 #include "BKE_main.h"
+#include "BKE_modifier_cache.h"
 #include "BKE_idprop.h"
 #include "BKE_pbvh.h"
 #include "BKE_paint.h"
@@ -366,6 +367,11 @@ static void rna_Userdef_memcache_update(Main *UNUSED(bmain), Scene *UNUSED(scene
 	MEM_CacheLimiter_set_maximum(((size_t) U.memcachelimit) * 1024 * 1024);
 }
 
+static void rna_Userdef_modcache_update(Main *UNUSED(bmain), Scene *UNUSED(scene), PointerRNA *UNUSED(ptr))
+{
+	BKE_modifier_cache_clear();
+}
+
 static void rna_UserDef_weight_color_update(Main *bmain, Scene *scene, PointerRNA *ptr)
 {
 	Object *ob;
@@ -4059,6 +4065,36 @@ static void rna_def_userdef_system(BlenderRNA *brna)
 	RNA_def_property_ui_text(prop, "Memory Cache Limit", "Memory cache limit (in megabytes)");
 	RNA_def_property_update(prop, 0, "rna_Userdef_memcache_update");
 
+	prop = RNA_def_property(srna, "sequencer_disk_cache_dir", PROP_STRING, PROP_DIRPATH);
+	RNA_def_property_string_sdna(prop, NULL, "sequencer_disk_cache_dir");
+	RNA_def_property_ui_text(prop, "Disk Cache Directory",
+	                         "Directory to keep rendered sequencer frames in, so they don't have to be rendered again "
+	                         "after they are dropped from the memory cache or Blender is restarted");
+
+	prop = RNA_def_property(srna, "sequencer_disk_cache_size_limit", PROP_INT, PROP_NONE);
+	RNA_def_property_int_sdna(prop, NULL, "sequencer_disk_cache_size_limit");
+	RNA_def_property_range(prop, 0, INT_MAX);
+	RNA_def_property_ui_range(prop, 0, 1024 * 1024, 1024, -1);
+	RNA_def_property_ui_text(prop, "Disk Cache Limit",
+	                         "Size limit of the sequencer disk cache in megabytes, least recently used frames "
+	                         "are removed first (0 disables the disk cache)");
+
+	prop = RNA_def_property(srna, "sequencer_disk_cache_compression", PROP_INT, PROP_NONE);
+	RNA_def_property_int_sdna(prop, NULL, "sequencer_disk_cache_compression");
+	RNA_def_property_range(prop, 0, 9);
+	RNA_def_property_ui_text(prop, "Disk Cache Compression",
+	                         "Compression level of frames in the sequencer disk cache, "
+	                         "higher levels use less disk space but take longer to write (0 disables compression)");
+
+	prop = RNA_def_property(srna, "modifier_cache_limit", PROP_INT, PROP_NONE);
+	RNA_def_property_int_sdna(prop, NULL, "modcachelimit");
+	RNA_def_property_range(prop, 0, (sizeof(void *) == 8) ? 1024 * 16 : 1024); /* 32 bit 1 GB, 64 bit 16 GB */
+	RNA_def_property_ui_text(prop, "Modifier Cache Limit",
+	                         "Memory limit for caching intermediate modifier results, "
+	                         "so unchanged parts of a modifier stack are not evaluated again "
+	                         "(in megabytes, 0 to disable)");
+	RNA_def_property_update(prop, 0, "rna_Userdef_modcache_update");
+
 	prop = RNA_def_property(srna, "frame_server_port", PROP_INT, PROP_NONE);
 	RNA_def_property_int_sdna(prop, NULL, "frameserverport");
 	RNA_def_property_range(prop, 0, 32727);
@@ -784,7 +784,8 @@ ModifierTypeInfo modifierType_Array = {
 	                        eModifierTypeFlag_SupportsMapping |
 	                        eModifierTypeFlag_SupportsEditmode |
 	                        eModifierTypeFlag_EnableInEditmode |
-	                        eModifierTypeFlag_AcceptsCVs,
+	                        eModifierTypeFlag_AcceptsCVs |
+	                        eModifierTypeFlag_SupportsResultCache,
 
 	/* copyData */          copyData,
 	/* deformVerts */       NULL,
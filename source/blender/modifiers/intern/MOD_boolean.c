@@ -446,7 +446,8 @@ ModifierTypeInfo modifierType_Boolean = {
 	/* structSize */        sizeof(BooleanModifierData),
 	/* type */              eModifierTypeType_Nonconstructive,
 	/* flags */             eModifierTypeFlag_AcceptsMesh |
-	                        eModifierTypeFlag_UsesPointCache,
+	                        eModifierTypeFlag_UsesPointCache |
+	                        eModifierTypeFlag_SupportsResultCache,
 
 	/* copyData */          copyData,
 	/* deformVerts */       NULL,
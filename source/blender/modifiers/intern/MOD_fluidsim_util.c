@@ -430,7 +430,9 @@ static DerivedMesh *fluidsim_read_cache(Object *ob, DerivedMesh *orgdm,
 	/* If we start with frame 0, we need to remap all animation channels, too, because they will all be 1 frame late if using frame-1! - DG */
 
 	char targetFile[FILE_MAX];
+	char sequenceFile[FILE_MAX];
 	FluidsimSettings *fss = fluidmd->fss;
+	FluidVertexVelocity *velocities;
 	DerivedMesh *dm = NULL;
 	MPoly *mpoly;
 	MPoly mp_example = {0};
@@ -449,10 +451,12 @@ static DerivedMesh *fluidsim_read_cache(Object *ob, DerivedMesh *orgdm,
 		case 2:
 			/* use preview mesh */
 			BLI_join_dirfile(targetFile, sizeof(targetFile), fss->surfdataPath, OB_FLUIDSIM_SURF_PREVIEW_OBJ_FNAME);
+			BLI_join_dirfile(sequenceFile, sizeof(sequenceFile), fss->surfdataPath, OB_FLUIDSIM_SURF_PREVIEW_SEQ_FNAME);
 			break;
 		default: /* 3 */
 			/* 3. use final mesh */
 			BLI_join_dirfile(targetFile, sizeof(targetFile), fss->surfdataPath, OB_FLUIDSIM_SURF_FINAL_OBJ_FNAME);
+			BLI_join_dirfile(sequenceFile, sizeof(sequenceFile), fss->surfdataPath, OB_FLUIDSIM_SURF_FINAL_SEQ_FNAME);
 			break;
 	}
 
@@ -460,6 +464,7 @@ static DerivedMesh *fluidsim_read_cache(Object *ob, DerivedMesh *orgdm,
 	curFrame += fss->frameOffset;
 
 	BLI_path_abs(targetFile, modifier_path_relbase(ob));
+	BLI_path_abs(sequenceFile, modifier_path_relbase(ob));
 	BLI_path_frame(targetFile, curFrame, 0); // fixed #frame-no
 
 	/* assign material + flags to new dm
@@ -470,6 +475,26 @@ static DerivedMesh *fluidsim_read_cache(Object *ob, DerivedMesh *orgdm,
 	}
 	/* else leave NULL'd */
 
+	/* bakes store all frames in one sequence file, older ones a file per frame */
+	dm = BKE_fluidsim_meshseq_read(sequenceFile, curFrame, &mp_example, (displaymode == 3) ? &velocities : NULL);
+
+	if (dm) {
+		if (fss->meshVelocities)
+			MEM_freeN(fss->meshVelocities);
+
+		fss->meshVelocities = NULL;
+
+		if (displaymode == 3) {
+			if (fss->domainNovecgen > 0) {
+				MEM_SAFE_FREE(velocities);
+			}
+			fss->meshVelocities = velocities;
+			fss->totvert = dm->getNumVerts(dm);
+		}
+
+		return dm;
+	}
+
 	dm = fluidsim_read_obj(targetFile, &mp_example);
 
 	if (!dm) {
@@ -362,7 +362,8 @@ ModifierTypeInfo modifierType_Mirror = {
 	                        eModifierTypeFlag_EnableInEditmode |
 	                        eModifierTypeFlag_AcceptsCVs |
 	                        /* this is only the case when 'MOD_MIR_VGROUP' is used */
-	                        eModifierTypeFlag_UsesPreview,
+	                        eModifierTypeFlag_UsesPreview |
+	                        eModifierTypeFlag_SupportsResultCache,
 
 	/* copyData */          copyData,
 	/* deformVerts */       NULL,
@@ -105,7 +105,8 @@ ModifierTypeInfo modifierType_Triangulate = {
 	                        eModifierTypeFlag_SupportsEditmode |
 	                        eModifierTypeFlag_SupportsMapping |
 	                        eModifierTypeFlag_EnableInEditmode |
-	                        eModifierTypeFlag_AcceptsCVs,
+	                        eModifierTypeFlag_AcceptsCVs |
+	                        eModifierTypeFlag_SupportsResultCache,
 
 	/* copyData */          copyData,
 	/* deformVerts */       NULL,
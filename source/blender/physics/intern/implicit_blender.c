@@ -43,6 +43,7 @@
 
 #include "BLI_math.h"
 #include "BLI_linklist.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #include "BKE_cloth.h"
@@ -56,9 +57,9 @@
 #  pragma GCC diagnostic ignored "-Wtype-limits"
 #endif
 
-#ifdef _OPENMP
-#  define CLOTH_OPENMP_LIMIT 512
-#endif
+/* Long vectors and big matrices are split in chunks of this many elements for threading.
+ * Reductions sum up the chunks in order, so results do not depend on the number of threads. */
+#define CLOTH_PARALLEL_CHUNK 1024
 
 //#define DEBUG_TIME
 
@@ -177,86 +178,159 @@ DO_INLINE void zero_lfvector(float (*to)[3], unsigned int verts)
 {
 	memset(to, 0.0f, verts * sizeof(lfVector));
 }
+BLI_INLINE int parallel_chunks(unsigned int count)
+{
+	return (int)((count + CLOTH_PARALLEL_CHUNK - 1) / CLOTH_PARALLEL_CHUNK);
+}
+
+typedef enum eLongVectorOp {
+	LFVECTOR_MUL_S,         /* A = B * float */
+	LFVECTOR_SUBMUL_S,      /* A -= B * float */
+	LFVECTOR_ADD,           /* A = B + C */
+	LFVECTOR_ADD_S,         /* A = B + C * float */
+	LFVECTOR_ADDS_S,        /* A = B * float + C * float */
+	LFVECTOR_SUB_S,         /* A = B - C * float */
+	LFVECTOR_SUB,           /* A = B - C */
+	LFVECTOR_DOT,           /* B . C, per chunk */
+} eLongVectorOp;
+
+typedef struct LongVectorOpData {
+	eLongVectorOp op;
+	float (*to)[3];
+	float (*a)[3];
+	float (*b)[3];
+	float aS, bS;
+	unsigned int verts;
+	float *chunk_dot;
+} LongVectorOpData;
+
+static void lfvector_op_cb(void *userdata, const int chunk)
+{
+	LongVectorOpData *data = userdata;
+	float (*to)[3] = data->to, (*a)[3] = data->a, (*b)[3] = data->b;
+	const float aS = data->aS, bS = data->bS;
+	const unsigned int start = (unsigned int)chunk * CLOTH_PARALLEL_CHUNK;
+	const unsigned int end = min_ii(start + CLOTH_PARALLEL_CHUNK, data->verts);
+	unsigned int i;
+
+	switch (data->op) {
+		case LFVECTOR_MUL_S:
+			for (i = start; i < end; i++) {
+				mul_fvector_S(to[i], a[i], aS);
+			}
+			break;
+		case LFVECTOR_SUBMUL_S:
+			for (i = start; i < end; i++) {
+				VECSUBMUL(to[i], a[i], aS);
+			}
+			break;
+		case LFVECTOR_ADD:
+			for (i = start; i < end; i++) {
+				VECADD(to[i], a[i], b[i]);
+			}
+			break;
+		case LFVECTOR_ADD_S:
+			for (i = start; i < end; i++) {
+				VECADDS(to[i], a[i], b[i], bS);
+			}
+			break;
+		case LFVECTOR_ADDS_S:
+			for (i = start; i < end; i++) {
+				VECADDSS(to[i], a[i], aS, b[i], bS);
+			}
+			break;
+		case LFVECTOR_SUB_S:
+			for (i = start; i < end; i++) {
+				VECSUBS(to[i], a[i], b[i], bS);
+			}
+			break;
+		case LFVECTOR_SUB:
+			for (i = start; i < end; i++) {
+				sub_v3_v3v3(to[i], a[i], b[i]);
+			}
+			break;
+		case LFVECTOR_DOT:
+		{
+			float temp = 0.0f;
+			for (i = start; i < end; i++) {
+				temp += dot_v3v3(a[i], b[i]);
+			}
+			data->chunk_dot[chunk] = temp;
+			break;
+		}
+	}
+}
+
+static void lfvector_op(eLongVectorOp op, float (*to)[3], float (*a)[3], float aS, float (*b)[3], float bS,
+                        unsigned int verts, float *chunk_dot)
+{
+	LongVectorOpData data = {op, to, a, b, aS, bS, verts, chunk_dot};
+	const int chunks = parallel_chunks(verts);
+
+	BLI_task_parallel_range(0, chunks, &data, lfvector_op_cb, chunks > 1);
+}
+
 /* multiply long vector with scalar*/
 DO_INLINE void mul_lfvectorS(float (*to)[3], float (*fLongVector)[3], float scalar, unsigned int verts)
 {
-	unsigned int i = 0;
-
-	for (i = 0; i < verts; i++) {
-		mul_fvector_S(to[i], fLongVector[i], scalar);
-	}
+	lfvector_op(LFVECTOR_MUL_S, to, fLongVector, scalar, NULL, 0.0f, verts, NULL);
 }
 /* multiply long vector with scalar*/
 /* A -= B * float */
 DO_INLINE void submul_lfvectorS(float (*to)[3], float (*fLongVector)[3], float scalar, unsigned int verts)
 {
-	unsigned int i = 0;
-	for (i = 0; i < verts; i++) {
-		VECSUBMUL(to[i], fLongVector[i], scalar);
-	}
+	lfvector_op(LFVECTOR_SUBMUL_S, to, fLongVector, scalar, NULL, 0.0f, verts, NULL);
 }
 /* dot product for big vector */
 DO_INLINE float dot_lfvector(float (*fLongVectorA)[3], float (*fLongVectorB)[3], unsigned int verts)
 {
-	long i = 0;
-	float temp = 0.0;
-// XXX brecht, disabled this for now (first schedule line was already disabled),
-// due to non-commutative nature of floating point ops this makes the sim give
-// different results each time you run it!
-// schedule(guided, 2)
-//#pragma omp parallel for reduction(+: temp) if (verts > CLOTH_OPENMP_LIMIT)
-	for (i = 0; i < (long)verts; i++) {
-		temp += dot_v3v3(fLongVectorA[i], fLongVectorB[i]);
+	/* Floating point addition is not associative, so the per chunk sums are added up
+	 * in a fixed order, otherwise the sim would give different results each time. */
+	float chunk_dot_stack[64], *chunk_dot = chunk_dot_stack;
+	const int chunks = parallel_chunks(verts);
+	float temp = 0.0f;
+	int i;
+
+	if (chunks > (int)ARRAY_SIZE(chunk_dot_stack)) {
+		chunk_dot = MEM_mallocN(sizeof(float) * (size_t)chunks, __func__);
 	}
+
+	lfvector_op(LFVECTOR_DOT, NULL, fLongVectorA, 0.0f, fLongVectorB, 0.0f, verts, chunk_dot);
+
+	for (i = 0; i < chunks; i++) {
+		temp += chunk_dot[i];
+	}
+
+	if (chunk_dot != chunk_dot_stack) {
+		MEM_freeN(chunk_dot);
+	}
+
 	return temp;
 }
 /* A = B + C  --> for big vector */
 DO_INLINE void add_lfvector_lfvector(float (*to)[3], float (*fLongVectorA)[3], float (*fLongVectorB)[3], unsigned int verts)
 {
-	unsigned int i = 0;
-
-	for (i = 0; i < verts; i++) {
-		VECADD(to[i], fLongVectorA[i], fLongVectorB[i]);
-	}
-
+	lfvector_op(LFVECTOR_ADD, to, fLongVectorA, 0.0f, fLongVectorB, 0.0f, verts, NULL);
 }
 /* A = B + C * float --> for big vector */
 DO_INLINE void add_lfvector_lfvectorS(float (*to)[3], float (*fLongVectorA)[3], float (*fLongVectorB)[3], float bS, unsigned int verts)
 {
-	unsigned int i = 0;
-
-	for (i = 0; i < verts; i++) {
-		VECADDS(to[i], fLongVectorA[i], fLongVectorB[i], bS);
-
-	}
+	lfvector_op(LFVECTOR_ADD_S, to, fLongVectorA, 0.0f, fLongVectorB, bS, verts, NULL);
 }
 /* A = B * float + C * float --> for big vector */
 DO_INLINE void add_lfvectorS_lfvectorS(float (*to)[3], float (*fLongVectorA)[3], float aS, float (*fLongVectorB)[3], float bS, unsigned int verts)
 {
-	unsigned int i = 0;
-
-	for (i = 0; i < verts; i++) {
-		VECADDSS(to[i], fLongVectorA[i], aS, fLongVectorB[i], bS);
-	}
+	lfvector_op(LFVECTOR_ADDS_S, to, fLongVectorA, aS, fLongVectorB, bS, verts, NULL);
 }
 /* A = B - C * float --> for big vector */
 DO_INLINE void sub_lfvector_lfvectorS(float (*to)[3], float (*fLongVectorA)[3], float (*fLongVectorB)[3], float bS, unsigned int verts)
 {
-	unsigned int i = 0;
-	for (i = 0; i < verts; i++) {
-		VECSUBS(to[i], fLongVectorA[i], fLongVectorB[i], bS);
-	}
-
+	lfvector_op(LFVECTOR_SUB_S, to, fLongVectorA, 0.0f, fLongVectorB, bS, verts, NULL);
 }
 /* A = B - C --> for big vector */
 DO_INLINE void sub_lfvector_lfvector(float (*to)[3], float (*fLongVectorA)[3], float (*fLongVectorB)[3], unsigned int verts)
 {
-	unsigned int i = 0;
-
-	for (i = 0; i < verts; i++) {
-		sub_v3_v3v3(to[i], fLongVectorA[i], fLongVectorB[i]);
-	}
-
+	lfvector_op(LFVECTOR_SUB, to, fLongVectorA, 0.0f, fLongVectorB, 0.0f, verts, NULL);
 }
 ///////////////////////////
 // 3x3 matrix
@@ -585,50 +659,131 @@ DO_INLINE void initdiag_bfmatrix(fmatrix3x3 *matrix, float m3[3][3])
 	}
 }
 
-/* SPARSE SYMMETRIC multiply big matrix with long vector*/
-/* STATUS: verified */
-DO_INLINE void mul_bfmatrix_lfvector( float (*to)[3], fmatrix3x3 *from, lfVector *fLongVector)
+/* Off-diagonal blocks of a big matrix per vertex, in block order.
+ * Lets matrix-vector products gather per vertex instead of scattering per block. */
+typedef struct fmatrixAdjacency {
+	unsigned int *row_offset, *row_blocks;  /* blocks with r == vertex */
+	unsigned int *col_offset, *col_blocks;  /* blocks with c == vertex */
+} fmatrixAdjacency;
+
+static void create_bfmatrix_adjacency_lists(
+        fmatrix3x3 *matrix, bool use_rows, unsigned int **r_offset, unsigned int **r_blocks)
 {
-	unsigned int i = 0;
-	unsigned int vcount = from[0].vcount;
-	lfVector *temp = create_lfvector(vcount);
-	
-	zero_lfvector(to, vcount);
+	const unsigned int vcount = matrix[0].vcount, scount = matrix[0].scount;
+	unsigned int *offset = MEM_callocN(sizeof(unsigned int) * (vcount + 1), "cloth_implicit_adjacency_offset");
+	unsigned int *blocks = MEM_mallocN(sizeof(unsigned int) * max_ii(scount, 1), "cloth_implicit_adjacency_blocks");
+	unsigned int i;
 
-#pragma omp parallel sections private(i) if (vcount > CLOTH_OPENMP_LIMIT)
-	{
-#pragma omp section
-		{
-			for (i = from[0].vcount; i < from[0].vcount+from[0].scount; i++) {
-				muladd_fmatrix_fvector(to[from[i].c], from[i].m, fLongVector[from[i].r]);
-			}
+	for (i = vcount; i < vcount + scount; i++) {
+		offset[(use_rows ? matrix[i].r : matrix[i].c) + 1]++;
+	}
+	for (i = 0; i < vcount; i++) {
+		offset[i + 1] += offset[i];
+	}
+	/* fill using offset[v] as cursor, which shifts the offsets by one vertex */
+	for (i = vcount; i < vcount + scount; i++) {
+		blocks[offset[use_rows ? matrix[i].r : matrix[i].c]++] = i;
+	}
+	for (i = vcount; i > 0; i--) {
+		offset[i] = offset[i - 1];
+	}
+	offset[0] = 0;
+
+	*r_offset = offset;
+	*r_blocks = blocks;
+}
+
+static void create_bfmatrix_adjacency(fmatrixAdjacency *adj, fmatrix3x3 *matrix)
+{
+	create_bfmatrix_adjacency_lists(matrix, true, &adj->row_offset, &adj->row_blocks);
+	create_bfmatrix_adjacency_lists(matrix, false, &adj->col_offset, &adj->col_blocks);
+}
+
+static void del_bfmatrix_adjacency(fmatrixAdjacency *adj)
+{
+	MEM_freeN(adj->row_offset);
+	MEM_freeN(adj->row_blocks);
+	MEM_freeN(adj->col_offset);
+	MEM_freeN(adj->col_blocks);
+}
+
+typedef struct BigMatrixMulData {
+	float (*to)[3];
+	fmatrix3x3 *from;
+	const fmatrixAdjacency *adj;
+	lfVector *fLongVector;
+} BigMatrixMulData;
+
+static void mul_bfmatrix_lfvector_cb(void *userdata, const int chunk)
+{
+	BigMatrixMulData *data = userdata;
+	fmatrix3x3 *from = data->from;
+	const fmatrixAdjacency *adj = data->adj;
+	lfVector *fLongVector = data->fLongVector;
+	const unsigned int start = (unsigned int)chunk * CLOTH_PARALLEL_CHUNK;
+	const unsigned int end = min_ii(start + CLOTH_PARALLEL_CHUNK, from[0].vcount);
+	unsigned int v, k;
+
+	for (v = start; v < end; v++) {
+		float to[3] = {0.0f, 0.0f, 0.0f}, temp[3] = {0.0f, 0.0f, 0.0f};
+
+		/* same summation order as a serial pass over the blocks:
+		 * lower triangle into 'to', diagonal and upper triangle into 'temp' */
+		for (k = adj->col_offset[v]; k < adj->col_offset[v + 1]; k++) {
+			const unsigned int i = adj->col_blocks[k];
+			muladd_fmatrix_fvector(to, from[i].m, fLongVector[from[i].r]);
 		}
-#pragma omp section
-		{
-			for (i = 0; i < from[0].vcount+from[0].scount; i++) {
-				muladd_fmatrix_fvector(temp[from[i].r], from[i].m, fLongVector[from[i].c]);
-			}
+
+		muladd_fmatrix_fvector(temp, from[v].m, fLongVector[v]);
+		for (k = adj->row_offset[v]; k < adj->row_offset[v + 1]; k++) {
+			const unsigned int i = adj->row_blocks[k];
+			muladd_fmatrix_fvector(temp, from[i].m, fLongVector[from[i].c]);
 		}
+
+		VECADD(data->to[v], to, temp);
 	}
-	add_lfvector_lfvector(to, to, temp, from[0].vcount);
-	
-	del_lfvector(temp);
-	
-	
+}
+
+/* SPARSE SYMMETRIC multiply big matrix with long vector*/
+/* STATUS: verified */
+DO_INLINE void mul_bfmatrix_lfvector( float (*to)[3], fmatrix3x3 *from, const fmatrixAdjacency *adj, lfVector *fLongVector)
+{
+	BigMatrixMulData data = {to, from, adj, fLongVector};
+	const int chunks = parallel_chunks(from[0].vcount);
+
+	BLI_assert(to != fLongVector);
+
+	BLI_task_parallel_range(0, chunks, &data, mul_bfmatrix_lfvector_cb, chunks > 1);
 }
 
 /* SPARSE SYMMETRIC sub big matrix with big matrix*/
 /* A -= B * float + C * float --> for big matrix */
 /* VERIFIED */
-DO_INLINE void subadd_bfmatrixS_bfmatrixS( fmatrix3x3 *to, fmatrix3x3 *from, float aS,  fmatrix3x3 *matrix, float bS)
+typedef struct BigMatrixOpData {
+	fmatrix3x3 *to, *from, *matrix;
+	float aS, bS;
+	unsigned int count;
+} BigMatrixOpData;
+
+static void subadd_bfmatrixS_bfmatrixS_cb(void *userdata, const int chunk)
 {
-	unsigned int i = 0;
+	BigMatrixOpData *data = userdata;
+	const unsigned int start = (unsigned int)chunk * CLOTH_PARALLEL_CHUNK;
+	const unsigned int end = min_ii(start + CLOTH_PARALLEL_CHUNK, data->count);
+	unsigned int i;
 
-	/* process diagonal elements */
-	for (i = 0; i < matrix[0].vcount+matrix[0].scount; i++) {
-		subadd_fmatrixS_fmatrixS(to[i].m, from[i].m, aS, matrix[i].m, bS);
+	for (i = start; i < end; i++) {
+		subadd_fmatrixS_fmatrixS(data->to[i].m, data->from[i].m, data->aS, data->matrix[i].m, data->bS);
 	}
+}
+
+DO_INLINE void subadd_bfmatrixS_bfmatrixS( fmatrix3x3 *to, fmatrix3x3 *from, float aS,  fmatrix3x3 *matrix, float bS)
+{
+	BigMatrixOpData data = {to, from, matrix, aS, bS, matrix[0].vcount + matrix[0].scount};
+	const int chunks = parallel_chunks(data.count);
 
+	/* process diagonal elements */
+	BLI_task_parallel_range(0, chunks, &data, subadd_bfmatrixS_bfmatrixS_cb, chunks > 1);
 }
 
 ///////////////////////////////////////////////////////////////////
@@ -738,15 +893,32 @@ BLI_INLINE void root_to_world_m3(Implicit_Data *data, int index, float r[3][3],
 
 /* ================================ */
 
-DO_INLINE void filter(lfVector *V, fmatrix3x3 *S)
+typedef struct FilterData {
+	lfVector *V;
+	fmatrix3x3 *S;
+} FilterData;
+
+static void filter_cb(void *userdata, const int chunk)
 {
-	unsigned int i=0;
+	FilterData *data = userdata;
+	fmatrix3x3 *S = data->S;
+	const unsigned int start = (unsigned int)chunk * CLOTH_PARALLEL_CHUNK;
+	const unsigned int end = min_ii(start + CLOTH_PARALLEL_CHUNK, S[0].vcount);
+	unsigned int i;
 
-	for (i = 0; i < S[0].vcount; i++) {
-		mul_m3_v3(S[i].m, V[S[i].r]);
+	for (i = start; i < end; i++) {
+		mul_m3_v3(S[i].m, data->V[S[i].r]);
 	}
 }
 
+DO_INLINE void filter(lfVector *V, fmatrix3x3 *S)
+{
+	FilterData data = {V, S};
+	const int chunks = parallel_chunks(S[0].vcount);
+
+	BLI_task_parallel_range(0, chunks, &data, filter_cb, chunks > 1);
+}
+
 #if 0 /* this version of the CG algorithm does not work very well with partial constraints (where S has non-zero elements) */
 static int  cg_filtered(lfVector *ldV, fmatrix3x3 *lA, lfVector *lB, lfVector *z, fmatrix3x3 *S)
 {
@@ -814,7 +986,7 @@ static int  cg_filtered(lfVector *ldV, fmatrix3x3 *lA, lfVector *lB, lfVector *z
 }
 #endif
 
-static int cg_filtered(lfVector *ldV, fmatrix3x3 *lA, lfVector *lB, lfVector *z, fmatrix3x3 *S, ImplicitSolverResult *result)
+static int cg_filtered(lfVector *ldV, fmatrix3x3 *lA, const fmatrixAdjacency *adj, lfVector *lB, lfVector *z, fmatrix3x3 *S, ImplicitSolverResult *result)
 {
 	// Solves for unknown X in equation AX=B
 	unsigned int conjgrad_loopcount=0, conjgrad_looplimit=100;
@@ -838,7 +1010,7 @@ static int cg_filtered(lfVector *ldV, fmatrix3x3 *lA, lfVector *lB, lfVector *z,
 	delta_target = conjgrad_epsilon*conjgrad_epsilon * bnorm2;
 	
 	/* r = filter(B - A * dV) */
-	mul_bfmatrix_lfvector(AdV, lA, ldV);
+	mul_bfmatrix_lfvector(AdV, lA, adj, ldV);
 	sub_lfvector_lfvector(r, lB, AdV, numverts);
 	filter(r, S);
 	
@@ -861,7 +1033,7 @@ static int cg_filtered(lfVector *ldV, fmatrix3x3 *lA, lfVector *lB, lfVector *z,
 #endif
 	
 	while (delta_new > delta_target && conjgrad_loopcount < conjgrad_looplimit) {
-		mul_bfmatrix_lfvector(q, lA, c);
+		mul_bfmatrix_lfvector(q, lA, adj, c);
 		filter(q, S);
 		
 		alpha = delta_new / dot_lfvector(c, q, numverts);
@@ -1103,13 +1275,17 @@ bool BPH_mass_spring_solve_velocities(Implicit_Data *data, float dt, ImplicitSol
 	unsigned int numverts = data->dFdV[0].vcount;
 
 	lfVector *dFdXmV = create_lfvector(numverts);
+	fmatrixAdjacency adj;
 	zero_lfvector(data->dV, numverts);
 
 	cp_bfmatrix(data->A, data->M);
 
 	subadd_bfmatrixS_bfmatrixS(data->A, data->dFdV, dt, data->dFdX, (dt*dt));
 
-	mul_bfmatrix_lfvector(dFdXmV, data->dFdX, data->V);
+	/* A and dFdX share their block layout */
+	create_bfmatrix_adjacency(&adj, data->A);
+
+	mul_bfmatrix_lfvector(dFdXmV, data->dFdX, &adj, data->V);
 
 	add_lfvectorS_lfvectorS(data->B, data->F, dt, dFdXmV, (dt*dt), numverts);
 
@@ -1117,7 +1293,7 @@ bool BPH_mass_spring_solve_velocities(Implicit_Data *data, float dt, ImplicitSol
 	double start = PIL_check_seconds_timer();
 #endif
 
-	cg_filtered(data->dV, data->A, data->B, data->z, data->S, result); /* conjugate gradient algorithm to solve Ax=b */
+	cg_filtered(data->dV, data->A, &adj, data->B, data->z, data->S, result); /* conjugate gradient algorithm to solve Ax=b */
 	// cg_filtered_pre(id->dV, id->A, id->B, id->z, id->S, id->P, id->Pinv, id->bigI);
 
 #ifdef DEBUG_TIME
@@ -1129,6 +1305,7 @@ bool BPH_mass_spring_solve_velocities(Implicit_Data *data, float dt, ImplicitSol
 	add_lfvector_lfvector(data->Vnew, data->V, data->dV, numverts);
 
 	del_lfvector(dFdXmV);
+	del_bfmatrix_adjacency(&adj);
 	
 	return result->status == BPH_SOLVER_SUCCESS;
 }
@@ -61,6 +61,7 @@
 #include "BKE_global.h"
 #include "BKE_material.h"
 #include "BKE_modifier.h"
+#include "BKE_modifier_cache.h"
 #include "BKE_node.h"
 #include "BKE_sound.h"
 #include "BKE_image.h"
@@ -361,6 +362,7 @@ int main(
 	BKE_cachefiles_init();
 	BKE_images_init();
 	BKE_modifier_init();
+	BKE_modifier_cache_init();
 	DAG_init();
 
 	BKE_brush_system_init();
@@ -77,6 +77,7 @@ extern "C"
 #include "BKE_library.h"
 #include "BKE_library_remap.h"
 #include "BKE_modifier.h"
+#include "BKE_modifier_cache.h"
 #include "BKE_material.h"
 #include "BKE_text.h"
 #include "BKE_sound.h"
@@ -509,6 +510,7 @@ int main(
 	IMB_init();
 	BKE_images_init();
 	BKE_modifier_init();
+	BKE_modifier_cache_init();
 	DAG_init();
 
 #ifdef WITH_FFMPEG
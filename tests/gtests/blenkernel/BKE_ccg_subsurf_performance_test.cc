@@ -0,0 +1,125 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_math.h"
+#include "BLI_threads.h"
+#include "PIL_time_utildefines.h"
+
+#include "CCGSubSurf.h"
+}
+
+/* Dense enough for the subdivision and normals passes to be threaded. */
+#define GRID_RES 128
+#define SUBDIV_LEVELS 3
+
+/* Coordinates followed by the normal. */
+#define VERT_DATA_SIZE (sizeof(float) * 6)
+#define NORMAL_OFFSET (sizeof(float) * 3)
+
+#define VERT_INDEX(x, y) ((y) * (GRID_RES + 1) + (x))
+
+static CCGSubSurf *ccg_grid_create(void)
+{
+	CCGMeshIFC ifc = {0};
+	CCGSubSurf *ss;
+	int x, y;
+
+	ifc.vertUserSize = ifc.edgeUserSize = ifc.faceUserSize = 8;
+	ifc.numLayers = 3;
+	ifc.vertDataSize = VERT_DATA_SIZE;
+
+	ss = ccgSubSurf_new(&ifc, SUBDIV_LEVELS, NULL, NULL);
+	ccgSubSurf_setCalcVertexNormals(ss, 1, NORMAL_OFFSET);
+
+	ccgSubSurf_initFullSync(ss);
+
+	for (y = 0; y <= GRID_RES; y++) {
+		for (x = 0; x <= GRID_RES; x++) {
+			float data[6] = {(float)x, (float)y, 0.0f, 0.0f, 0.0f, 0.0f};
+			CCGVert *v;
+			ccgSubSurf_syncVert(ss, SET_INT_IN_POINTER(VERT_INDEX(x, y)), data, 0, &v);
+		}
+	}
+
+	/* Horizontal edges first, then vertical ones. */
+	for (y = 0; y <= GRID_RES; y++) {
+		for (x = 0; x < GRID_RES; x++) {
+			CCGEdge *e;
+			ccgSubSurf_syncEdge(ss, SET_INT_IN_POINTER(y * GRID_RES + x),
+			                    SET_INT_IN_POINTER(VERT_INDEX(x, y)), SET_INT_IN_POINTER(VERT_INDEX(x + 1, y)),
+			                    0.0f, &e);
+		}
+	}
+	for (x = 0; x <= GRID_RES; x++) {
+		for (y = 0; y < GRID_RES; y++) {
+			CCGEdge *e;
+			ccgSubSurf_syncEdge(ss, SET_INT_IN_POINTER((GRID_RES + 1) * GRID_RES + x * GRID_RES + y),
+			                    SET_INT_IN_POINTER(VERT_INDEX(x, y)), SET_INT_IN_POINTER(VERT_INDEX(x, y + 1)),
+			                    0.0f, &e);
+		}
+	}
+
+	for (y = 0; y < GRID_RES; y++) {
+		for (x = 0; x < GRID_RES; x++) {
+			CCGVertHDL verts[4] = {
+			    SET_INT_IN_POINTER(VERT_INDEX(x, y)),
+			    SET_INT_IN_POINTER(VERT_INDEX(x + 1, y)),
+			    SET_INT_IN_POINTER(VERT_INDEX(x + 1, y + 1)),
+			    SET_INT_IN_POINTER(VERT_INDEX(x, y + 1))};
+			CCGFace *f;
+			ccgSubSurf_syncFace(ss, SET_INT_IN_POINTER(y * GRID_RES + x), 4, verts, &f);
+		}
+	}
+
+	TIMEIT_START(ccg_process_sync);
+	ccgSubSurf_processSync(ss);
+	TIMEIT_END(ccg_process_sync);
+
+	return ss;
+}
+
+TEST(ccg_subsurf, LegacyDenseGrid)
+{
+	BLI_threadapi_init();
+
+	CCGSubSurf *ss_a = ccg_grid_create();
+	CCGSubSurf *ss_b = ccg_grid_create();
+	const int gridSize = ccgSubSurf_getGridSize(ss_a);
+	const size_t grid_bytes = (size_t)gridSize * gridSize * VERT_DATA_SIZE;
+	int i, S, x, y;
+
+	EXPECT_EQ(GRID_RES * GRID_RES, ccgSubSurf_getNumFaces(ss_a));
+
+	for (i = 0; i < GRID_RES * GRID_RES; i++) {
+		CCGFace *f_a = ccgSubSurf_getFace(ss_a, SET_INT_IN_POINTER(i));
+		CCGFace *f_b = ccgSubSurf_getFace(ss_b, SET_INT_IN_POINTER(i));
+
+		for (S = 0; S < 4; S++) {
+			const float *grid_a = (const float *)ccgSubSurf_getFaceGridDataArray(ss_a, f_a, S);
+			const float *grid_b = (const float *)ccgSubSurf_getFaceGridDataArray(ss_b, f_b, S);
+
+			/* The flat grid must stay flat, with normals pointing along Z. */
+			for (y = 0; y < gridSize; y++) {
+				for (x = 0; x < gridSize; x++) {
+					const float *co = (const float *)ccgSubSurf_getFaceGridData(ss_a, f_a, S, x, y);
+					const float *no = co + 3;
+
+					ASSERT_EQ(0.0f, co[2]);
+					ASSERT_NEAR(1.0f, fabsf(no[2]), 1e-5f);
+				}
+			}
+
+			/* Threaded evaluation must not depend on scheduling. */
+			ASSERT_EQ(0, memcmp(grid_a, grid_b, grid_bytes));
+		}
+	}
+
+	ccgSubSurf_free(ss_a);
+	ccgSubSurf_free(ss_b);
+
+	BLI_threadapi_exit();
+}